@@ -3971,8 +3971,20 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const json &o,
   buffer->uri.clear();
   ParseStringProperty(&buffer->uri, err, o, "uri", false, "Buffer");
 
-  // having an empty uri for a non embedded image should not be valid
-  if (!is_binary && buffer->uri.empty()) {
+  // melo: EXT_meshopt_compression fallback buffers have no data, the decoder
+  // fills them in after loading.
+  bool meshoptFallback = false;
+  {
+    json_const_iterator extIt, meshoptIt;
+    if (buffer->uri.empty() && FindMember(o, "extensions", extIt) &&
+        FindMember(GetValue(extIt), "EXT_meshopt_compression", meshoptIt)) {
+      ParseBooleanProperty(&meshoptFallback, nullptr, GetValue(meshoptIt),
+                           "fallback", false);
+    }
+  }
+
+  if (!meshoptFallback && !is_binary && buffer->uri.empty()) {
+    // having an empty uri for a non embedded image should not be valid
     if (err) {
       (*err) += "'uri' is missing from non binary glTF file buffer.\n";
     }
@@ -3988,7 +4000,9 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const json &o,
     }
   }
 
-  if (is_binary) {
+  if (meshoptFallback) {
+    // buffer->data stays empty
+  } else if (is_binary) {
     // Still binary glTF accepts external dataURI.
     if (!buffer->uri.empty()) {
       // First try embedded data URI.
@@ -44,6 +44,20 @@ uniform mat4 u_ViewProjectionMatrix;
 uniform mat4 u_ModelMatrix;
 uniform mat4 u_NormalMatrix;
 
+#ifdef USE_INSTANCING
+// per instance, in place of u_ModelMatrix
+in mat4 a_InstanceMatrix;
+#endif
+
+mat4 getModelMatrix()
+{
+#ifdef USE_INSTANCING
+    return a_InstanceMatrix;
+#else
+    return u_ModelMatrix;
+#endif
+}
+
 vec4 getPosition()
 {
     vec4 pos = vec4(a_Position, 1.0);
@@ -95,18 +109,19 @@ vec3 getTangent()
 
 void main()
 {
-    vec4 pos = u_ModelMatrix * getPosition();
+    mat4 modelMatrix = getModelMatrix();
+    vec4 pos = modelMatrix * getPosition();
     v_Position = vec3(pos.xyz) / pos.w;
 
     #ifdef HAS_NORMALS
     #ifdef HAS_TANGENTS
         vec3 tangent = getTangent();
-        vec3 normalW = normalize(vec3(u_ModelMatrix * vec4(getNormal(), 0.0)));
-        vec3 tangentW = normalize(vec3(u_ModelMatrix * vec4(tangent, 0.0)));
+        vec3 normalW = normalize(vec3(modelMatrix * vec4(getNormal(), 0.0)));
+        vec3 tangentW = normalize(vec3(modelMatrix * vec4(tangent, 0.0)));
         vec3 bitangentW = cross(normalW, tangentW) * a_Tangent.w;
         v_TBN = mat3(tangentW, bitangentW, normalW);
     #else // !HAS_TANGENTS
-        v_Normal = normalize(vec3(u_ModelMatrix * vec4(getNormal(), 0.0)));
+        v_Normal = normalize(vec3(modelMatrix * vec4(getNormal(), 0.0)));
     #endif
     #endif // !HAS_NORMALS
 
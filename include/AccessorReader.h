@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace melo
+{
+    // Memory layout of one glTF accessor, componentType uses the glTF values (GltfComponentType)
+    struct AccessorLayout
+    {
+        const uint8_t* data = nullptr; // first element, null reads zeros (sparse only accessors)
+        size_t count = 0;
+        size_t byteStride = 0; // 0 means tightly packed
+        uint32_t componentType = 0;
+        uint32_t componentCount = 1;
+        bool normalized = false;
+
+        // sparse substitution, values are tightly packed with componentType
+        size_t sparseCount = 0;
+        const uint8_t* sparseIndices = nullptr;
+        uint32_t sparseIndexType = 0;
+        const uint8_t* sparseValues = nullptr;
+    };
+
+    size_t getComponentSize(uint32_t componentType);
+
+    // Reads count * componentCount values into dst, de-interleaving strided elements.
+    // Normalized integers are mapped to [0, 1] or [-1, 1] as the glTF spec describes.
+    // Returns false for unknown component types.
+    bool readAccessor(const AccessorLayout& layout, float* dst);
+    bool readAccessor(const AccessorLayout& layout, uint32_t* dst);
+
+    // Converts count components stored back to back, uses AVX2 or SSE2 when available.
+    void convertToFloat(const void* src, uint32_t componentType, bool normalized, size_t count, float* dst);
+    void convertToUint(const void* src, uint32_t componentType, size_t count, uint32_t* dst);
+
+    // reference implementations of the two above
+    void convertToFloatScalar(const void* src, uint32_t componentType, bool normalized, size_t count, float* dst);
+    void convertToUintScalar(const void* src, uint32_t componentType, size_t count, uint32_t* dst);
+
+    // "AVX2", "SSE2" or "scalar"
+    const char* getSimdName();
+}
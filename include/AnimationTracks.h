@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace melo
+{
+    typedef std::shared_ptr<struct BakedClip> BakedClipRef;
+    typedef std::shared_ptr<class AnimationBatch> AnimationBatchRef;
+
+    // Channels of one clip resampled at a fixed rate into SoA blocks of LANES channels.
+    // samples is frame major: for each frame, every block as x[LANES] y[LANES] z[LANES] w[LANES],
+    // the lerped (translation, scale) blocks first, then the nlerped (rotation) ones.
+    // Evaluating a time only touches two consecutive frames.
+    struct BakedClip
+    {
+        static const uint32_t LANES = 8;
+
+        // sample(channel, time) is called for every frame of every channel, channel by channel.
+        // rotations flags the channels holding (x, y, z, w) quaternions. The rate is rounded up so that the
+        // last frame lands on end.
+        static BakedClipRef create(float start, float end, float sampleRate, const std::vector<bool>& rotations,
+                                   const std::function<glm::vec4(uint32_t channel, float time)>& sample);
+
+        // one value per slot (getSlotCount() of them), the value of a channel is at getSlot(channel)
+        void evaluate(float time, glm::vec4* outputs) const;
+
+        uint32_t getSlot(uint32_t channel) const { return channelSlots[channel]; }
+        uint32_t getBlockCount() const { return vectorBlockCount + rotationBlockCount; }
+        uint32_t getSlotCount() const { return getBlockCount() * LANES; }
+        size_t getMemorySize() const { return samples.size() * sizeof(float) + channelSlots.size() * sizeof(uint32_t); }
+
+        float start = 0;
+        float end = 0;
+        float sampleRate = 0;
+        uint32_t frameCount = 0;
+        uint32_t vectorBlockCount = 0;
+        uint32_t rotationBlockCount = 0;
+        std::vector<uint32_t> channelSlots;
+        std::vector<float> samples; // frameCount * getBlockCount() * 4 * LANES
+    };
+
+    // Evaluates the channels of many clips in one pass, 4 or 8 channels at a time
+    class AnimationBatch
+    {
+    public:
+        static AnimationBatchRef create() { return AnimationBatchRef(new AnimationBatch()); }
+
+        // returns the first slot of the clip in the outputs of evaluate()
+        uint32_t addClip(const BakedClipRef& clip);
+
+        size_t getClipCount() const { return mClips.size(); }
+        uint32_t getSlotCount() const { return mSlotCount; }
+
+        // times: one per clip, clamped to the clip. outputs: getSlotCount() values
+        void evaluate(const float* times, glm::vec4* outputs) const;
+
+    private:
+        AnimationBatch() = default;
+
+        std::vector<BakedClipRef> mClips;
+        std::vector<uint32_t> mFirstSlots;
+        uint32_t mSlotCount = 0;
+    };
+}
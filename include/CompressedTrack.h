@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace melo
+{
+    typedef std::shared_ptr<class CompressedTrack> CompressedTrackRef;
+
+    // One translation / scale or rotation track after error-bounded key reduction and 16 bit quantization.
+    // Vectors keep 3 x uint16 per key within the per-track range, rotations are stored smallest-three: the
+    // index of the dropped component in 2 bits and the other three in 15 bits each. Key times are uint16
+    // frame numbers when the source keys are evenly spaced, floats otherwise. Keys are decoded on the fly.
+    class CompressedTrack
+    {
+    public:
+        // values: (x, y, z, w) quaternions if rotation is set, xyz otherwise. step keeps STEP interpolation,
+        // tracks are LINEAR (nlerp for rotations) otherwise. Only the keys needed to stay within tolerance of
+        // every source key, per component, are kept.
+        static CompressedTrackRef create(const float* times, const glm::vec4* values, size_t keyCount,
+                                         bool rotation, bool step, float tolerance);
+
+        // value at time, clamped to the first / last key. cursor caches the last key like
+        // AnimationSampler::findKey()
+        glm::vec4 sample(float time, size_t* cursor) const;
+
+        bool isRotation() const { return mRotation; }
+        size_t getKeyCount() const { return mKeyCount; }
+        size_t getSourceKeyCount() const { return mSourceKeyCount; }
+        size_t getMemorySize() const;
+
+    private:
+        CompressedTrack() = default;
+
+        // keys are searched in frame units for frame numbers, in seconds otherwise
+        float toPosition(float time) const { return mEven ? (time - mStart) * mRate : time; }
+        float getKeyPosition(size_t key) const { return mEven ? (float)mFrames[key] : mTimes[key]; }
+        glm::vec4 decode(size_t key) const;
+
+        bool mRotation = false;
+        bool mStep = false;
+        bool mEven = false; // mFrames is used rather than mTimes
+        size_t mKeyCount = 0;
+        size_t mSourceKeyCount = 0;
+
+        // times: frame numbers from mStart at mRate frames per second, or plain times
+        float mStart = 0;
+        float mRate = 0;
+        std::vector<uint16_t> mFrames;
+        std::vector<float> mTimes;
+
+        // 3 x uint16 per key
+        glm::vec3 mRangeMin = glm::vec3(0);
+        glm::vec3 mRangeScale = glm::vec3(0); // extent / 65535
+        std::vector<uint16_t> mValues;
+    };
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "Node.h"
+
+namespace melo
+{
+    typedef std::shared_ptr<class FrustumCuller> FrustumCullerRef;
+    class JobSystem;
+    class OcclusionCuller;
+    class TransformSystem;
+
+    // world space box around the local box boundsMin / boundsMax under transform
+    void transformBounds(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                         glm::vec3* worldMin, glm::vec3* worldMax);
+
+    // Frustum culling of a node tree. cull() gathers the world space box of every node into flat arrays, merges them
+    // bottom-up into subtree boxes and tests both against the six frustum planes, four or eight boxes at a time with
+    // SSE2 / AVX2, split over a JobSystem. treeDraw() then skips the culled subtrees and the draw() of culled nodes.
+    //
+    // Nodes without bounds (mBoundBoxMin not below mBoundBoxMax) are never culled themselves, those with children are
+    // bounded by them as a subtree. The flattened tree, with the local boxes, is only rebuilt when the hierarchy
+    // changed or after invalidate(); the world box of a node is only recomputed when its world transform changed.
+    class FrustumCuller
+    {
+    public:
+        struct Stats
+        {
+            size_t nodeCount = 0;
+            size_t visibleCount = 0; // nodes whose draw() runs
+            size_t culledCount = 0;
+            size_t occludedCount = 0; // of the culled nodes, those inside the frustum but behind the occluders
+            double milliseconds = 0;
+        };
+
+        static FrustumCullerRef create();
+
+        // viewProjection maps world space to OpenGL clip space. Call it after treeUpdate(), which computes the
+        // transforms flagged by Node::invalidateTransform(); the world transforms of root are updated here first.
+        // occlusion, rendered for the same viewProjection, also culls the nodes and subtrees it hides.
+        void cull(const NodeRef& root, const glm::mat4& viewProjection, JobSystem* jobs = nullptr,
+                  const OcclusionCuller* occlusion = nullptr);
+        // rereads the tree and the local boxes on the next cull(), after changing mBoundBoxMin / mBoundBoxMax
+        void invalidate() { mRoot = nullptr; }
+
+        // as of the last cull(), nodes that were not part of its tree are visible
+        bool isVisible(const Node& node) const { return (getVisibility(node) & VISIBLE_SELF) != 0; }
+        bool isSubtreeVisible(const Node& node) const { return (getVisibility(node) & VISIBLE_SUBTREE) != 0; }
+
+        const Stats& getStats() const { return mStats; }
+
+    private:
+        FrustumCuller() = default;
+        FrustumCuller(const FrustumCuller&) = delete;
+        FrustumCuller& operator=(const FrustumCuller&) = delete;
+
+        enum Visibility : uint8_t
+        {
+            VISIBLE_SELF = 1,
+            VISIBLE_SUBTREE = 2,
+        };
+        // nodes per job
+        static constexpr size_t GRAIN = 4096;
+
+        uint8_t getVisibility(const Node& node) const
+        {
+            uint32_t index = node.getTransformIndex();
+            if (index >= mSlotNodes.size() || mSlotNodes[index] != &node)
+                return VISIBLE_SELF | VISIBLE_SUBTREE;
+            return mSlotVisibility[index];
+        }
+
+        void rebuild(Node* root);
+        void gather(const TransformSystem& transforms, size_t begin, size_t end);
+        // returns the number of nodes whose draw() runs, adds those occlusion hid to occludedCount
+        size_t test(size_t begin, size_t end, const glm::vec4* planes, const OcclusionCuller* occlusion,
+                    size_t* occludedCount);
+
+        // the tree in parent-first order
+        Node* mRoot = nullptr;
+        uint32_t mHierarchyVersion = 0;
+        std::vector<const Node*> mNodes;
+        std::vector<uint32_t> mTransformIndices;
+        std::vector<int32_t> mParents; // -1 for the root
+        std::vector<uint8_t> mHasChildren;
+        std::vector<uint8_t> mHasBounds;
+        std::vector<glm::vec3> mLocalMin, mLocalMax;
+        // TransformSystem::getUpdatedWorldVersion() at the last gather, mBounds is current while it matches
+        std::vector<uint32_t> mWorldVersions;
+        bool mGathered = false;
+
+        // world space boxes of the nodes and of their subtrees, one array per component
+        std::vector<float> mBounds[6];        // min x, y, z, max x, y, z
+        std::vector<float> mSubtreeBounds[6];
+
+        // per transform slot, the node it belonged to in the last cull()
+        std::vector<const Node*> mSlotNodes;
+        std::vector<uint8_t> mSlotVisibility;
+
+        Stats mStats;
+    };
+}
@@ -3,13 +3,17 @@
 #undef near
 #undef far
 #include "../3rdparty/yocto/yocto_sceneio.h"
+#include "../include/MeshLod.h"
 #include "../include/Node.h"
+#include "../include/PickingScene.h"
+#include "../include/SceneCache.h"
 #include <filesystem>
 #include <Cinder/gl/gl.h>
 
 namespace fs = std::filesystem;
 
 typedef std::shared_ptr<struct GltfScene> GltfSceneRef;
+struct ShapeStreams;
 
 const int LightType_Directional = 0;
 const int LightType_Point = 1;
@@ -75,11 +79,23 @@ struct GltfMaterial
     ci::gl::Texture2dRef normal_tex;
     ci::gl::Texture2dRef occulusion_tex;
 
-    void bind();
+    // instanced binds getInstancedGlsl() instead of glsl
+    void bind(bool instanced = false);
 
     void unbind();
 
     ci::gl::GlslProgRef glsl;
+
+    // glsl with USE_INSTANCING, the model matrices come from the a_InstanceMatrix attribute (geom::CUSTOM_0).
+    // Compiled on the first instanced draw, null if that failed.
+    const ci::gl::GlslProgRef& getInstancedGlsl();
+
+private:
+    void setSamplers(const ci::gl::GlslProgRef& program);
+
+    ci::gl::GlslProg::Format format;
+    ci::gl::GlslProgRef instancedGlsl;
+    bool instancedCompiled = false;
 };
 
 struct GltfNode : melo::Node
@@ -91,22 +107,43 @@ struct GltfNode : melo::Node
     GltfMaterial::Ref material;
 
     void draw(melo::DrawOrder order) override;
+    void submitDraws(melo::RenderQueue& queue) override;
+    // nodes of the same shape and material drawn by one instanced draw of mesh
+    void drawInstances(melo::DrawOrder order, uint32_t item, const glm::mat4* transforms, uint32_t count) override;
     void reloadMaterial();
 
+    // draws the level of detail of mesh for the current GL matrices, the shadow pass keeps that of the camera.
+    // With instanceCount, draws the level of the nearest instance once per instance transform, for a program reading
+    // a_InstanceMatrix.
+    void drawMesh(melo::DrawOrder order, const glm::mat4* instanceTransforms = nullptr, uint32_t instanceCount = 0);
+
     GltfScene* scene;
     yocto::scene_instance property;
+    uint32_t lodLevel = 0; // of the last draw outside of the shadow pass
 };
 
 struct GltfScene : melo::Node
 {
     static void progress_callback(const std::string& message, int current, int total);
 
-    static GltfSceneRef create(const fs::path& path);
+    // With useCache the first load of a glTF, OBJ, PLY or STL writes a melo::SceneCache in cacheDir, or next to the
+    // asset when it is empty (shape streams, textures with their mip chains, materials and instances), and later
+    // loads skip yocto. Warm loads leave property.shapes and property.textures empty, meshes and textures are
+    // uploaded straight from the cache.
+    // lodLevels > 1 builds that many levels of detail per shape (melo::buildLodChain), which are cached too.
+    // optimizeMeshes reorders the triangles of every level for the vertex cache and overdraw, then the vertices in
+    // the order the triangles fetch them (melo::optimizeTriangleOrder, melo::optimizeVertexFetchRemap).
+    static GltfSceneRef create(const fs::path& path, bool useCache = false, uint32_t lodLevels = 1,
+                               bool optimizeMeshes = false, const fs::path& cacheDir = {});
 
     fs::path path;
+    melo::SceneCacheRef cache; // null on cold loads
 
     GltfLight lights[1] = {};
     std::vector<ci::gl::VboMeshRef> meshes;
+    std::vector<std::vector<melo::LodLevel>> meshLods; // per mesh, ranges of its index vbo, empty without levels
+    // per mesh, the a_InstanceMatrix stream appended to it by its first instanced draw
+    std::vector<ci::gl::VboRef> instanceVbos;
     std::vector<ci::gl::Texture2dRef> textures;
     std::vector<GltfMaterial::Ref> materials;
 
@@ -115,9 +152,14 @@ struct GltfScene : melo::Node
     static ci::gl::TextureCubeMapRef radianceTexture;
     static ci::gl::TextureCubeMapRef irradianceTexture;
     static ci::gl::Texture2dRef brdfLUTTexture;
+    // binds the three textures above, predraw() does it for treeDraw(), a RenderQueue draw needs it first
+    static void bindEnvironment();
 
     void createMaterials(DebugType debugType = DEBUG_NONE);
 
+    // adds every shape and every GltfNode instance, whose bounding boxes are set along the way
+    void addToPicking(melo::PickingScene& picking);
+
     ci::gl::Texture2dRef getTexture(yocto::texture_handle handle)
     {
         if (handle == yocto::invalid_handle) return {};
@@ -146,7 +188,14 @@ struct GltfScene : melo::Node
 
 private:
 
-    ci::gl::Texture2dRef createTexture(const yocto::scene_texture& texture);
+    uint32_t lodLevels = 1;
+    bool optimizeMeshes = false;
+
+    bool loadCache(const std::string& cachePath, uint64_t sourceHash);
+    // lodIndices: per shape, the indices of the levels after the first one
+    bool writeCache(const std::string& cachePath, const std::vector<std::vector<uint32_t>>& lodIndices) const;
+
+    ci::gl::Texture2dRef createTexture(const melo::CachedImage& image);
 
-    ci::gl::VboMeshRef createMesh(const yocto::scene_shape& shape);
-};
\ No newline at end of file
+    ci::gl::VboMeshRef createMesh(const ShapeStreams& streams);
+};
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace melo
+{
+    typedef std::shared_ptr<class JobSystem> JobSystemRef;
+    typedef std::shared_ptr<struct Job> JobRef;
+
+    // Worker pool, a job is queued once all the jobs it depends on are finished.
+    // Jobs must not throw.
+    class JobSystem
+    {
+    public:
+        // 0 picks one worker less than the hardware threads, the waiting thread is the last one
+        static JobSystemRef create(size_t threadCount = 0);
+        // shared pool, created on first use
+        static JobSystemRef getDefault();
+        ~JobSystem();
+
+        JobRef add(std::function<void()> func, const std::vector<JobRef>& dependencies = {});
+
+        // blocks until the jobs are finished, the calling thread runs queued jobs meanwhile
+        void wait(const JobRef& job);
+        void wait(const std::vector<JobRef>& jobs);
+
+        size_t getThreadCount() const { return mThreads.size(); }
+
+    private:
+        JobSystem() = default;
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        void workerLoop();
+        // called with mMutex locked, unlocks it while func runs
+        void run(std::unique_lock<std::mutex>& lock, JobRef job);
+
+        std::mutex mMutex;
+        std::condition_variable mJobQueued;
+        std::condition_variable mJobFinished;
+        std::deque<JobRef> mQueue;
+        std::vector<std::thread> mThreads;
+        bool mQuit = false;
+    };
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace melo
+{
+    typedef std::shared_ptr<class MappedFile> MappedFileRef;
+
+    // Read-only memory mapping of a whole file.
+    // Pointers returned by getData() stay valid as long as the MappedFile is alive.
+    class MappedFile
+    {
+    public:
+        static MappedFileRef create(const std::string& path);
+        ~MappedFile();
+
+        // starts reading the whole file in the background
+        void prefetch() const;
+
+        const uint8_t* getData() const { return mData; }
+        size_t getSize() const { return mSize; }
+
+    private:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const uint8_t* mData = nullptr;
+        size_t mSize = 0;
+#ifdef _WIN32
+        void* mFileHandle = nullptr;
+        void* mMappingHandle = nullptr;
+#endif
+    };
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace melo
+{
+    // Normals, tangents and bounds of an indexed triangle mesh in one pass over the triangles and one over the
+    // vertices, so that it runs on any thread and the GL thread only uploads the arrays.
+    // - normals are kept when there is one per vertex, otherwise they become the angle weighted face normals.
+    // - tangents follow texcoords, a MikkTSpace-style approximation: the unit face tangents weighted by the corner
+    //   angles, projected into the tangent plane of the vertex and normalized, w is the sign of the bitangent,
+    //   negated with flipV for shaders that sample at 1 - v. Unlike MikkTSpace, vertices whose faces disagree on
+    //   the tangent frame are not split, and the face tangents are orthogonalized against the face normal before
+    //   the angle weighted sum, not against the vertex normal at each corner, so baked normal maps can differ
+    //   slightly. Vertices are expected to be split at texcoord seams already, as OBJ and glTF vertices are.
+    //   Without texcoords they are any unit vector orthogonal to the normal.
+    // - boundsMin / boundsMax are 0 for a mesh without vertices.
+    void computeMeshGeometry(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+                             const glm::vec2* texcoords, std::vector<glm::vec3>* normals,
+                             std::vector<glm::vec4>* tangents, glm::vec3* boundsMin, glm::vec3* boundsMax,
+                             bool flipV = false);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace melo
+{
+    // One level of detail of an indexed triangle mesh, a range of a shared index buffer over the same vertices
+    struct LodLevel
+    {
+        uint32_t indexOffset;
+        uint32_t indexCount;
+        float error; // farthest the level may stray from the source surface, in mesh units
+    };
+
+    // Quadric error metric simplification by edge collapses onto existing vertices, so only the indices change.
+    // Vertices sharing a position with different attributes form UV / normal seams: they only collapse along the
+    // seam, both sides at once, and open borders only collapse along themselves. Vertices where more than two
+    // attribute sets meet, or where a seam reaches a border, never move.
+    //
+    // Writes at most indexCount indices to destination (which may be indices) and returns their count. Stops at
+    // targetIndexCount or once the next collapse would stray further than targetError, in mesh units. resultError
+    // receives the error of the result.
+    size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const glm::vec3* positions,
+                        size_t vertexCount, size_t targetIndexCount, float targetError = FLT_MAX,
+                        float* resultError = nullptr);
+
+    // Level 0 is the source indices, every next one simplifies the previous one down to ratio of its indices, until
+    // levelCount levels or until the simplification stalls. The levels are appended to lodIndices and levels, their
+    // errors add up along the chain.
+    void buildLodChain(const uint32_t* indices, size_t indexCount, const glm::vec3* positions, size_t vertexCount,
+                       uint32_t levelCount, float ratio, std::vector<uint32_t>* lodIndices,
+                       std::vector<LodLevel>* levels);
+
+    // Screen space error selection. pixelError is the error allowed on screen, a level is only given up for a
+    // coarser one once its error is within pixelError * (1 - hysteresis), so that a mesh doesn't flicker between
+    // two levels at the distance where they swap.
+    struct LodSettings
+    {
+        bool enabled = true;
+        float pixelError = 1.0f;
+        float hysteresis = 0.25f;
+    };
+
+    // shared by the nodes that select their level while drawing
+    LodSettings& getLodSettings();
+
+    // pixels covered by one mesh unit at the nearest point of the box (the origin when boundsMin isn't below
+    // boundsMax), for modelView / projection (OpenGL conventions) and a viewport viewportHeight pixels high
+    float getLodPixelScale(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight,
+                           const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+    // the level to draw now that current was drawn, pixelScale from getLodPixelScale()
+    uint32_t selectLod(const LodLevel* levels, size_t levelCount, uint32_t current, float pixelScale,
+                       const LodSettings& settings = getLodSettings());
+}
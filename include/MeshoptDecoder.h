@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// EXT_meshopt_compression decoding, the bitstreams are described in
+// https://github.com/KhronosGroup/glTF/tree/main/extensions/2.0/Vendor/EXT_meshopt_compression
+namespace melo
+{
+    enum MeshoptMode
+    {
+        MESHOPT_MODE_ATTRIBUTES,
+        MESHOPT_MODE_TRIANGLES,
+        MESHOPT_MODE_INDICES,
+    };
+
+    enum MeshoptFilter
+    {
+        MESHOPT_FILTER_NONE,
+        MESHOPT_FILTER_OCTAHEDRAL,
+        MESHOPT_FILTER_QUATERNION,
+        MESHOPT_FILTER_EXPONENTIAL,
+    };
+
+    // Compressed bytes of one bufferView, count and byteStride describe the decoded data
+    struct MeshoptBufferView
+    {
+        const uint8_t* data = nullptr;
+        size_t byteLength = 0;
+        size_t count = 0;
+        size_t byteStride = 0;
+        MeshoptMode mode = MESHOPT_MODE_ATTRIBUTES;
+        MeshoptFilter filter = MESHOPT_FILTER_NONE;
+    };
+
+    // Writes count * byteStride bytes to dst, returns false on malformed data.
+    bool decodeMeshopt(const MeshoptBufferView& view, uint8_t* dst);
+
+    // The codecs on their own, see decodeMeshopt() for the constraints on the sizes
+    bool decodeVertexBuffer(uint8_t* dst, size_t count, size_t byteStride, const uint8_t* src, size_t size);
+    bool decodeIndexBuffer(uint8_t* dst, size_t count, size_t indexSize, const uint8_t* src, size_t size);
+    bool decodeIndexSequence(uint8_t* dst, size_t count, size_t indexSize, const uint8_t* src, size_t size);
+
+    // In place on count elements of byteStride bytes, uses SSE2 when available.
+    void decodeFilter(MeshoptFilter filter, uint8_t* data, size_t count, size_t byteStride);
+
+    // reference implementations of the two above
+    bool decodeVertexBufferScalar(uint8_t* dst, size_t count, size_t byteStride, const uint8_t* src, size_t size);
+    void decodeFilterScalar(MeshoptFilter filter, uint8_t* data, size_t count, size_t byteStride);
+
+    MeshoptMode getMeshoptMode(const char* name, bool* valid = nullptr);
+    MeshoptFilter getMeshoptFilter(const char* name, bool* valid = nullptr);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace melo
+{
+    typedef std::shared_ptr<class MorphTargets> MorphTargetsRef;
+
+    // Blend shapes of one primitive stored as sparse deltas.
+    // A target only keeps the vertices it moves, grouped in spans of consecutive vertices: a span is one
+    // contiguous run of 3 * vertexCount floats, accumulating it is a dense SIMD multiply-add.
+    class MorphTargets
+    {
+    public:
+        struct Span
+        {
+            uint32_t firstVertex;
+            uint32_t vertexCount;
+            uint32_t firstDelta; // into Target::positionDeltas / normalDeltas
+        };
+
+        struct Target
+        {
+            std::vector<Span> spans;
+            std::vector<glm::vec3> positionDeltas;
+            std::vector<glm::vec3> normalDeltas; // empty if the target has no NORMAL
+        };
+
+        static MorphTargetsRef create(size_t vertexCount) { return MorphTargetsRef(new MorphTargets(vertexCount)); }
+
+        // positionDeltas / normalDeltas hold vertexCount deltas each, either may be null.
+        // Vertices whose deltas are all within epsilon are dropped, runs of up to maxGap of them between moved
+        // vertices are kept as zero deltas rather than starting a new span.
+        void addTarget(const glm::vec3* positionDeltas, const glm::vec3* normalDeltas, float epsilon = 0.0f,
+                       uint32_t maxGap = 4);
+
+        // positions = basePositions + sum of weights[t] * positionDeltas of target t, same for normals (not
+        // renormalized, normals may be null). Targets with |weight| <= minWeight are skipped, weights past
+        // weightCount count as zero. Returns the number of targets accumulated.
+        size_t apply(const float* weights, size_t weightCount, const glm::vec3* basePositions,
+                     const glm::vec3* baseNormals, glm::vec3* positions, glm::vec3* normals,
+                     float minWeight = 0.0f) const;
+
+        size_t getVertexCount() const { return mVertexCount; }
+        size_t getTargetCount() const { return mTargets.size(); }
+        const Target& getTarget(size_t index) const { return mTargets[index]; }
+        // stored deltas of every target, zero deltas filling span gaps included
+        size_t getDeltaCount() const;
+        size_t getMemorySize() const;
+
+    private:
+        MorphTargets(size_t vertexCount) : mVertexCount(vertexCount) {}
+
+        size_t mVertexCount;
+        std::vector<Target> mTargets;
+    };
+}
@@ -41,12 +41,16 @@
 #include <glm/vec3.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include "TransformSystem.h"
+
 namespace melo
 {
     typedef std::shared_ptr<class Node> NodeRef;
     typedef std::shared_ptr<const class Node> NodeConstRef;
     typedef std::weak_ptr<class Node> NodeWeakRef;
     typedef std::vector<NodeRef> NodeList;
+    class FrustumCuller;
+    class RenderQueue;
 
     enum DrawOrder
     {
@@ -67,7 +71,7 @@ namespace melo
 
         //! sets the node's parent node (using weak reference to avoid objects not getting
         //! destroyed)
-        void setParent(NodeRef node) { mParent = NodeWeakRef(node); }
+        void setParent(NodeRef node);
         //! returns the node's parent node
         NodeRef getParent() const { return mParent.lock(); }
         //! returns the node's parent node (provide a templated function for easier down-casting of
@@ -104,12 +108,17 @@ namespace melo
 
         //! returns the transformation matrix of this node
         const glm::mat4& getTransform() const;
-        //! sets the transformation matrices of this node
+        //! sets the transformation matrix of this node, the world transforms of its descendants
+        //! follow on the next treeUpdate() or getWorldTransform()
         void setTransform(const glm::mat4& transform) const;
-        //! returns the accumulated transformation matrix of this node
+        //! returns the accumulated transformation matrix of this node, only stale ancestors are
+        //! recomputed. Not thread safe for nodes sharing an ancestor, see TransformSystem::getWorld()
         const glm::mat4& getWorldTransform() const;
-        //!
+        //! flags the transformation matrix to be recomputed from position, rotation, scale and anchor
+        //! by the next getTransform(), getWorldTransform() or treeUpdate()
         void invalidateTransform() const;
+        //! the slot of this node in its TransformSystem
+        uint32_t getTransformIndex() const { return mTransformIndex; }
 
         // tree parse functions
         void treeVisitor(std::function<void(NodeRef)> visitor);
@@ -117,10 +126,23 @@ namespace melo
         void treeSetup();
         //! calls the shutdown() function of this node and all its decendants
         void treeShutdown();
-        //! calls the update() function of this node and all its decendants
+        //! calls the update() function of this node and all its decendants, then updates their
+        //! world transforms in one batch
         void treeUpdate(double elapsed = 0.0);
-        //! calls the draw() function of this node and all its decendants
-        void treeDraw(DrawOrder order = DRAW_SOLID);
+        //! calls the draw() function of this node and all its decendants, those culled by culler
+        //! are skipped
+        void treeDraw(DrawOrder order = DRAW_SOLID, const FrustumCuller* culler = nullptr);
+        //! calls the submitDraws() function of this node and all its decendants, see RenderQueue::build()
+        void treeSubmit(RenderQueue& queue);
+
+        //! adds the draw packets of this node to queue. Nodes that draw override it, the others are only drawn
+        //! by treeDraw()
+        virtual void submitDraws(RenderQueue& queue) {}
+        //! draws one of the packets added by submitDraws(), with the model matrix set to the world transform
+        virtual void drawPacket(DrawOrder order, uint32_t item) { draw(order); }
+        //! draws item of this node count times at transforms, for packets added with instanced set. The model
+        //! matrix is transforms[0]. Calls drawPacket() once per transform unless overridden.
+        virtual void drawInstances(DrawOrder order, uint32_t item, const glm::mat4* transforms, uint32_t count);
 
         void setName(const std::string& name);
         const std::string& getName() const;
@@ -159,11 +181,16 @@ namespace melo
         // required function (see: class Node)
         virtual void transform() const;
     private:
-        bool mIsSetup;
+        void treeUpdateNodes(double elapsed);
+        //! recomputes the transformation matrix if invalidateTransform() flagged it
+        void validateTransform() const;
 
+        bool mIsSetup;
         mutable bool mIsTransformInvalidated;
-        mutable glm::mat4 mTransform;
-        mutable glm::mat4 mWorldTransform;
+
+        // transforms live in flat arrays, the node only keeps its slot
+        TransformSystemRef mTransforms;
+        uint32_t mTransformIndex;
 
     public:
         static NodeRef create();
@@ -24,6 +24,7 @@
 #pragma once
 
 #include "Node.h"
+#include "PickingScene.h"
 #include "cinder/gl/gl.h"
 
 namespace cinder {
@@ -43,6 +44,7 @@ namespace melo
         static Ref create(float radius = 5, Color color = { 1,1,1 });
 
         void draw(DrawOrder order) override;
+        void submitDraws(RenderQueue& queue) override;
 
         float radius;
         Color color;
@@ -61,6 +63,7 @@ namespace melo
         GridNode(float meters = 10.0f);
 
         void draw(DrawOrder order) override;
+        void submitDraws(RenderQueue& queue) override;
     };
 
     struct MeshNode : public Node
@@ -69,6 +72,7 @@ namespace melo
 
         gl::VboMeshRef vboMesh;
         gl::GlslProgRef shader;
+        TriMeshRef triMesh;
 
         static Ref create(TriMeshRef triMesh);
 
@@ -76,5 +80,9 @@ namespace melo
         MeshNode(TriMeshRef triMesh);
 
         void draw(DrawOrder order) override;
+        void submitDraws(RenderQueue& queue) override;
+
+        //! adds the triangles of triMesh, placed by this node
+        void addToPicking(PickingScene& picking);
     };
 } // namespace nodes
\ No newline at end of file
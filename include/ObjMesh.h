@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "../3rdparty/tinyobjloader/tiny_obj_loader.h"
+
+namespace melo
+{
+    // The faces of one material of an OBJ shape as an indexed triangle mesh, the cpu side of MeshObj::SubMesh.
+    // normals / texcoords / colors are empty unless every corner has one.
+    struct ObjSubmesh
+    {
+        int material = 0; // -1 in the file becomes 0
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec2> texcoords;
+        std::vector<glm::vec3> colors;
+        std::vector<uint32_t> indices;
+
+        size_t getVertexBytes() const
+        {
+            return positions.size() * sizeof(glm::vec3) + normals.size() * sizeof(glm::vec3) +
+                   texcoords.size() * sizeof(glm::vec2) + colors.size() * sizeof(glm::vec3);
+        }
+        size_t getIndexBytes() const { return indices.size() * sizeof(uint32_t); }
+    };
+
+    // Splits the triangulated faces of shape by material, in order of first use. With deduplicate, corners with the
+    // same vertex / normal / texcoord indices share one vertex (an open addressing table per submesh), otherwise
+    // every corner gets its own vertex as tinyobj lays them out.
+    std::vector<ObjSubmesh> buildObjSubmeshes(const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape,
+                                              bool deduplicate = true);
+}
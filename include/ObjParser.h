@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../3rdparty/tinyobjloader/tiny_obj_loader.h"
+
+namespace yocto
+{
+    struct scene_scene;
+}
+
+namespace melo
+{
+    // OBJ loading on all the workers: the mapped file is cut at line boundaries into chunks that are parsed on their
+    // own, then their vertices and triangles are copied to prefix sum offsets. Relative (negative) indices are fixed up
+    // while copying. Polygons are fan triangulated, lines and points are skipped.
+
+    // tinyobj::LoadObj with triangulation: same layout, material ids, smoothing groups and warnings. Vertex colors
+    // default to white like tinyobj's fallback unless defaultColors is false, then they are only filled when the file
+    // has some.
+    bool loadObj(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+                 std::vector<tinyobj::material_t>* materials, std::string* warn, std::string* err,
+                 const std::string& path, const std::string& mtlBaseDir = "", bool defaultColors = true);
+
+    // The scene yocto::load_scene makes of an OBJ: a shape and an instance per material of every group or object,
+    // materials converted the same way, texcoords with v flipped. Shapes are indexed triangles, quads included.
+    // Textures are left empty, texturePaths gets the file of every one of them to load with yocto::load_texture.
+    bool loadObjScene(const std::string& path, yocto::scene_scene& scene, std::string& error,
+                      std::vector<std::string>* texturePaths);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "Node.h"
+
+namespace melo
+{
+    typedef std::shared_ptr<class OcclusionCuller> OcclusionCullerRef;
+    class JobSystem;
+
+    // Software occlusion culling. render() rasterizes the occluders that cover the most of the screen, within a
+    // triangle budget, into a small depth buffer of 1/w (nearer is larger, 0 is empty), in bins of rows over a
+    // JobSystem and four pixels at a time with SSE2. A pyramid of the farthest depth of each 2x2 block follows.
+    // isVisible() projects a box and compares its nearest point with the farthest occluder over the few pyramid
+    // cells its screen rectangle covers, FrustumCuller::cull() takes it to drop the hidden nodes.
+    //
+    // Occluders are meshes copied in and placed by the world transform of a node, like PickingScene instances.
+    // Coverage is sampled at pixel centers, boxes smaller than a pixel may be hidden by an occluder edge crossing it.
+    class OcclusionCuller
+    {
+    public:
+        static constexpr uint32_t INVALID = UINT32_MAX;
+
+        struct Stats
+        {
+            size_t occluderCount = 0; // rasterized in the last render()
+            size_t triangleCount = 0; // after clipping
+            double milliseconds = 0;
+        };
+
+        // width is rounded up to a multiple of 4
+        static OcclusionCullerRef create(uint32_t width = 256, uint32_t height = 128);
+
+        // indices are triangles, INVALID for an empty shape
+        uint32_t addShape(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+        // shape drawn with the world transform of node, which is only weakly referenced
+        uint32_t addOccluder(uint32_t shape, NodeRef node);
+        void clear();
+
+        // most triangles render() rasterizes, 0 for no limit
+        void setTriangleBudget(size_t triangleCount) { mTriangleBudget = triangleCount; }
+
+        // viewProjection maps world space to OpenGL clip space, the world transforms must be up to date
+        void render(const glm::mat4& viewProjection, JobSystem* jobs = nullptr);
+
+        // false when the world space box is entirely behind the occluders of the last render()
+        bool isVisible(const glm::vec3& worldMin, const glm::vec3& worldMax) const;
+
+        uint32_t getWidth() const { return mWidth; }
+        uint32_t getHeight() const { return mHeight; }
+        // 1/w of the nearest occluder at the pixel, rows from the bottom of the screen
+        float getDepth(uint32_t x, uint32_t y) const { return mLevels[0][y * mWidth + x]; }
+
+        const Stats& getStats() const { return mStats; }
+
+    private:
+        OcclusionCuller(uint32_t width, uint32_t height);
+        OcclusionCuller(const OcclusionCuller&) = delete;
+        OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+        // rows per job
+        static constexpr uint32_t BIN_HEIGHT = 16;
+        // pyramid cells a box is tested against along each axis, at most
+        static constexpr uint32_t TEST_CELLS = 4;
+        // occluders covering fewer pixels are left out
+        static constexpr float MIN_OCCLUDER_AREA = 16.0f;
+        // scales the nearest 1/w of a tested box
+        static constexpr float DEPTH_SLACK = 1.001f;
+
+        struct Shape
+        {
+            std::vector<glm::vec3> positions;
+            std::vector<uint32_t> indices;
+            glm::vec3 boundsMin, boundsMax;
+        };
+
+        // in pixels, edge functions and 1/w are planes a * x + b * y + c over the pixel centers
+        struct Triangle
+        {
+            float edgeA[3], edgeB[3], edgeC[3];
+            float depthA, depthB, depthC;
+            int minX, maxX, minY, maxY; // pixels whose center may be covered
+        };
+
+        // clips a clip space triangle and adds what is left as screen space triangles
+        void setupTriangle(const glm::vec4* clip, std::vector<Triangle>* triangles) const;
+        void addScreenTriangle(const glm::vec3* screen, std::vector<Triangle>* triangles) const;
+        void rasterize(const Triangle& triangle, int binMinY, int binMaxY);
+        void buildPyramid();
+
+        uint32_t mWidth, mHeight;
+        size_t mTriangleBudget = 100000;
+
+        std::vector<Shape> mShapes;
+        std::vector<uint32_t> mOccluderShapes;
+        std::vector<NodeWeakRef> mOccluderNodes;
+
+        glm::mat4 mViewProjection;
+        // level 0 is the depth buffer, then the farthest depth of each 2x2 block of the level below
+        std::vector<std::vector<float>> mLevels;
+        std::vector<uint32_t> mLevelWidths, mLevelHeights;
+        bool mEmpty = true;
+
+        // per setup job
+        std::vector<std::vector<Triangle>> mTriangles;
+
+        Stats mStats;
+    };
+}
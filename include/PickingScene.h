@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "Node.h"
+
+namespace melo
+{
+    typedef std::shared_ptr<class PickingScene> PickingSceneRef;
+
+    struct PickResult
+    {
+        NodeRef node;              // null when nothing was hit
+        uint32_t shape = 0;
+        uint32_t triangle = 0;
+        glm::vec2 barycentrics;    // of the second and third vertex of the triangle
+        float distance = FLT_MAX;  // along the ray, in units of its direction
+        glm::vec3 position;        // world space
+
+        explicit operator bool() const { return node != nullptr; }
+    };
+
+    // Ray queries against the triangles of a scene, in two levels of yocto BVHs: one per shape in its local space,
+    // built once, and one over the instances, placed by the world transform of their node. refit() follows the
+    // nodes as they move and pick() returns the nearest triangle hit.
+    //
+    // Shapes are copied in. Instances only keep a weak reference to their node, expired ones are never hit.
+    class PickingScene
+    {
+    public:
+        static constexpr uint32_t INVALID = UINT32_MAX;
+
+        static PickingSceneRef create();
+        ~PickingScene();
+
+        // indices are triangles, INVALID for an empty shape
+        uint32_t addShape(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+        // positions of a deforming shape, same count as in addShape(). Its BVH is refit by the next refit().
+        void updateShape(uint32_t shape, const glm::vec3* positions);
+        // shape drawn with the world transform of node
+        uint32_t addInstance(uint32_t shape, NodeRef node);
+        void clear();
+
+        // reads the world transform of every instance, builds the BVHs after shapes or instances were added and
+        // refits the ones that moved otherwise
+        void refit();
+
+        // nearest triangle hit by the ray of an instance whose node rayCategory matches rayMask, as of the last
+        // refit()
+        PickResult pick(const glm::vec3& origin, const glm::vec3& direction, uint32_t rayMask = 0xFFFFFF,
+            float maxDistance = FLT_MAX) const;
+
+        size_t getShapeCount() const;
+        size_t getInstanceCount() const { return mNodes.size(); }
+        size_t getTriangleCount() const { return mTriangleCount; }
+
+        // copies of what addShape() / addInstance() were given, to feed other consumers such as OcclusionCuller
+        void getShape(uint32_t shape, std::vector<glm::vec3>* positions, std::vector<uint32_t>* indices) const;
+        uint32_t getInstanceShape(uint32_t instance) const;
+        // null once the node expired
+        NodeRef getInstanceNode(uint32_t instance) const { return mNodes[instance].lock(); }
+
+    private:
+        PickingScene();
+        PickingScene(const PickingScene&) = delete;
+        PickingScene& operator=(const PickingScene&) = delete;
+
+        // the yocto scene and BVHs, kept out of this header
+        std::unique_ptr<struct PickingBvh> mBvh;
+
+        std::vector<NodeWeakRef> mNodes;        // per instance
+        std::vector<glm::mat4> mTransforms;     // per instance, world transform of the last refit()
+        std::vector<uint32_t> mUpdatedShapes;
+        size_t mTriangleCount = 0;
+        bool mBuilt = false;
+    };
+}
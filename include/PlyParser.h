@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+namespace yocto
+{
+    struct shape_data;
+}
+
+namespace melo
+{
+    // yocto::load_shape of a binary PLY without flipping texcoords, the way load_scene reads it, in one pass over the
+    // mapped file instead of a ply_model of per-property vectors that is then copied into the shape: positions,
+    // normals, texcoords, colors and radius go straight from the vertex records into the shape, faces into triangles
+    // (or quads when some face has 4 corners). Dense native float streams are copied, big endian 32 bit ones go
+    // through SSE2 / AVX2 byte swaps, anything else is converted value by value. Vertex and fixed size face records
+    // are split over the workers. Values are cast like yocto does, uchar colors stay in 0 - 255.
+    //
+    // Files it doesn't handle return false with an empty error, for yocto::load_shape to read: ascii files, list
+    // properties other than the faces' vertex_indices, elements other than vertex and face, faces before vertices
+    // and files without faces.
+    bool loadPlyShape(const std::string& path, yocto::shape_data& shape, std::string& error);
+}
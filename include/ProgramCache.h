@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef CINDER_LESS
+#include <unordered_map>
+
+#include <cinder/gl/GlslProg.h>
+#endif
+
+namespace melo
+{
+    // Key of a program variant: the stage sources in order (null for a missing stage), the defines as a set and the
+    // bindings (attribute / uniform / output names with their semantics or locations) as a set, so that the order
+    // and repetitions of define() and attrib() calls don't make another variant.
+    uint64_t hashProgramVariant(const std::vector<const std::string*>& sources,
+                                std::vector<std::pair<std::string, std::string>> defines,
+                                std::vector<std::string> bindings);
+
+#ifndef CINDER_LESS
+    typedef std::shared_ptr<class ProgramCache> ProgramCacheRef;
+
+    // Process-wide cache of linked programs: materials asking for the same variant share one GlslProg instead of
+    // compiling their own, and rebuilding materials (another debug view, another model with the same features)
+    // compiles nothing new. Shared programs keep no per-material state, materials set their uniforms on bind.
+    // GL thread only, the programs live until clear().
+    class ProgramCache
+    {
+    public:
+        struct Stats
+        {
+            size_t requestCount = 0;
+            size_t compileCount = 0; // programs compiled and linked, failures included
+            size_t failureCount = 0;
+            double compileMilliseconds = 0;
+        };
+
+        // shared cache, created on first use
+        static ProgramCacheRef getDefault();
+
+        static uint64_t getKey(const ci::gl::GlslProg::Format& format);
+
+        // the program of format's variant, compiled on the first request. Throws what GlslProg::create throws, a
+        // variant that failed is compiled again on its next request.
+        ci::gl::GlslProgRef get(const ci::gl::GlslProg::Format& format);
+
+        size_t getProgramCount() const { return mPrograms.size(); }
+        const Stats& getStats() const { return mStats; }
+
+        // releases the programs, while the GL context is still alive
+        void clear();
+
+    private:
+        ProgramCache() = default;
+        ProgramCache(const ProgramCache&) = delete;
+        ProgramCache& operator=(const ProgramCache&) = delete;
+
+        std::unordered_map<uint64_t, ci::gl::GlslProgRef> mPrograms;
+        Stats mStats;
+    };
+#endif
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+#include "Node.h"
+
+namespace melo
+{
+    typedef std::shared_ptr<class RenderQueue> RenderQueueRef;
+    class FrustumCuller;
+
+    // one draw of a node, node->drawPacket(pass, item) draws it
+    struct DrawPacket
+    {
+        uint64_t key;
+        Node* node;
+        uint32_t item;
+        uint32_t instanceKey; // 0 unless the packet may be instanced, the same for packets of the same state
+    };
+
+    // receives the packets of one pass from RenderQueue::draw(), in order
+    class RenderBackend
+    {
+    public:
+        enum Change : uint32_t
+        {
+            CHANGE_SHADER = 1,
+            CHANGE_MATERIAL = 2,
+            CHANGE_MESH = 4,
+        };
+
+        virtual ~RenderBackend() = default;
+
+        virtual void beginPass(DrawOrder /*order*/) {}
+        // changes holds the Change bits that differ from the previous packet of the pass, all of them for the first
+        virtual void drawPacket(DrawOrder order, const DrawPacket& packet, uint32_t changes) = 0;
+        // count packets of the same state as one draw, transforms are the world transforms of their nodes. Draws them
+        // one by one unless overridden.
+        virtual void drawInstances(DrawOrder order, const DrawPacket* packets, uint32_t count,
+                                   const glm::mat4* transforms, uint32_t changes);
+        virtual void endPass(DrawOrder /*order*/) {}
+    };
+
+#ifndef CINDER_LESS
+    // sets the model matrix to the world transform of the node and calls its drawPacket()
+    class GlRenderBackend : public RenderBackend
+    {
+    public:
+        void beginPass(DrawOrder order) override;
+        void drawPacket(DrawOrder order, const DrawPacket& packet, uint32_t changes) override;
+        // the model matrix is that of the first packet, Node::drawInstances() draws them all
+        void drawInstances(DrawOrder order, const DrawPacket* packets, uint32_t count, const glm::mat4* transforms,
+                           uint32_t changes) override;
+        void endPass(DrawOrder order) override;
+    };
+#endif
+
+    // draws nothing, counts the draw calls and state changes of every pass and keeps the packets in order
+    class RecordingRenderBackend : public RenderBackend
+    {
+    public:
+        struct Counters
+        {
+            size_t drawCalls = 0;
+            size_t shaderChanges = 0;
+            size_t materialChanges = 0;
+            size_t meshChanges = 0;
+            size_t instancedDraws = 0; // of the draw calls
+            size_t instances = 0;      // packets drawn by them
+        };
+
+        void drawPacket(DrawOrder order, const DrawPacket& packet, uint32_t changes) override;
+        void drawInstances(DrawOrder order, const DrawPacket* packets, uint32_t count, const glm::mat4* transforms,
+                           uint32_t changes) override;
+        void reset();
+
+        Counters counters[DRAW_ORDER_COUNT];
+        std::vector<DrawPacket> packets[DRAW_ORDER_COUNT];
+    };
+
+    // Draw packets of a node tree for every pass, gathered by a single walk per frame and sorted by a 64-bit key.
+    // Opaque passes sort by shader, material, mesh and then front-to-back, DRAW_TRANSPARENCY back-to-front first
+    // and by state among packets at the same depth. DRAW_POST_PROCESSING and DRAW_GUI keep the tree order.
+    //
+    // Nodes add their packets from Node::submitDraws(), the GL state they bind is told by identity: shader, material
+    // and mesh pointers become small ids that stay the same from frame to frame. Once there are more ids than a key
+    // field holds, those of objects the last build() didn't draw are reused. Ids that still don't fit share the
+    // largest value of the field: they sort together and draw() reports a state change for each of their packets.
+    //
+    // Instancing: runs of consecutive packets that nodes marked as instanced and that share shader, material, mesh
+    // and item become one batch, drawn by a single RenderBackend::drawInstances(). Their world transforms are
+    // gathered into one buffer per frame. The sort puts packets of the same state next to each other, so grouping
+    // never changes the draw order.
+    class RenderQueue
+    {
+    public:
+        static RenderQueueRef create();
+
+        // view is the camera's view matrix, for the depth. Packets of nodes that culler culled are left out, except
+        // for DRAW_SHADOW which the light sees from elsewhere.
+        void build(const NodeRef& root, const glm::mat4& view, const FrustumCuller* culler = nullptr);
+
+        // called by Node::submitDraws() during build(), nullptr for state the packet doesn't bind. instanced tells
+        // that the node implements Node::drawInstances() for item.
+        void add(Node& node, DrawOrder order, const void* shader = nullptr, const void* material = nullptr,
+                 const void* mesh = nullptr, uint32_t item = 0, bool instanced = false);
+
+        // runs of fewer than minInstances instanced packets are drawn packet by packet, 0 turns instancing off.
+        // Applies from the next build().
+        void setInstancing(uint32_t minInstances) { mMinInstances = minInstances; }
+
+        // the packets of order, in key order
+        void draw(DrawOrder order, RenderBackend& backend) const;
+
+        size_t getPacketCount(DrawOrder order) const { return mPassEnd[order] - mPassBegin[order]; }
+        const DrawPacket* getPackets(DrawOrder order) const { return mPackets.data() + mPassBegin[order]; }
+        // draw calls of order, instanced batches count once
+        size_t getDrawCount(DrawOrder order) const { return mBatchEnd[order] - mBatchBegin[order]; }
+        size_t getInstancedDrawCount(DrawOrder order) const { return mInstancedDraws[order]; }
+
+        // shader, material and mesh ids of key, as far as the layout of order keeps them
+        static void decodeState(DrawOrder order, uint64_t key, uint32_t* shader, uint32_t* material, uint32_t* mesh);
+
+    private:
+        RenderQueue() = default;
+        RenderQueue(const RenderQueue&) = delete;
+        RenderQueue& operator=(const RenderQueue&) = delete;
+
+        // consecutive packets drawn by one call, a single packet unless instanced
+        struct DrawBatch
+        {
+            uint32_t packet;
+            uint32_t count;
+            uint32_t transform; // first of mInstanceTransforms for count > 1
+        };
+
+        // ids of one kind of state
+        struct IdTable
+        {
+            struct Entry
+            {
+                uint32_t id;
+                uint32_t build; // the last build() that used it
+            };
+            std::unordered_map<const void*, Entry> ids;
+            std::vector<uint32_t> freeIds; // largest first
+        };
+
+        // small id for pointer, 0 for nullptr
+        uint32_t getId(IdTable& table, const void* pointer);
+        // frees the ids the last build() didn't use once table holds limit of them
+        void pruneIds(IdTable& table, uint32_t limit);
+        // distance along the view direction, as an unsigned value of bits that grows with it
+        uint32_t getDepth(Node& node, uint32_t bits);
+        void buildBatches();
+
+        std::vector<DrawPacket> mPackets;
+        size_t mPassBegin[DRAW_ORDER_COUNT] = {};
+        size_t mPassEnd[DRAW_ORDER_COUNT] = {};
+
+        std::vector<DrawBatch> mBatches;
+        std::vector<glm::mat4> mInstanceTransforms;
+        size_t mBatchBegin[DRAW_ORDER_COUNT] = {};
+        size_t mBatchEnd[DRAW_ORDER_COUNT] = {};
+        size_t mInstancedDraws[DRAW_ORDER_COUNT] = {};
+        uint32_t mMinInstances = 2;
+
+        IdTable mShaderIds, mMaterialIds, mMeshIds;
+        uint32_t mBuild = 0;
+        // of the shader, material and mesh ids of the instanced packets of the current build(), packed in 64 bits
+        // while they all fit 21 bits
+        std::unordered_map<uint64_t, uint32_t> mInstanceKeys;
+        std::map<std::tuple<uint32_t, uint32_t, uint32_t>, uint32_t> mWideInstanceKeys;
+
+        // state of the current build()
+        glm::mat4 mView;
+        const FrustumCuller* mCuller = nullptr;
+        uint32_t mSequence = 0;
+        Node* mDepthNode = nullptr; // the depth of consecutive packets of a node is computed once
+        float mDepth = 0;
+    };
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace melo
+{
+    typedef std::shared_ptr<class SceneCache> SceneCacheRef;
+
+    // XXH64 of a byte range
+    uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+    // Splits a .glb into its JSON and BIN chunks (bin is null if there is none), false if the header is invalid
+    bool parseGlb(const uint8_t* data, size_t size, const char** json, size_t* jsonSize, const uint8_t** bin,
+                  size_t* binSize);
+
+    // percent-decodes the uri of an external glTF file
+    std::string decodeUri(const std::string& uri);
+
+    // Source key of an asset: the json of a .gltf / .glb (its JSON chunk) or the whole file for other formats.
+    // Fills dependencies with the asset and the external buffers / images its json references, or the material
+    // libraries of an .obj and their textures; null skips that parsing. Other formats only list the asset, see
+    // isCacheableScene(). Returns 0 if the file can't be read.
+    uint64_t hashSceneSource(const std::string& path, std::vector<std::string>* dependencies = nullptr);
+
+    // true if hashSceneSource() lists every file the asset is loaded from: .gltf, .glb, .obj and the self-contained
+    // .ply and .stl, not the yocto .json scenes or .pbrt files that reference others
+    bool isCacheableScene(const std::string& path);
+
+    // Versioned, mmap'ed cache of a loaded scene: header | section table | payloads.
+    // Every payload is 64 byte aligned so it can be used in place. Sections are identified by a kind defined
+    // by the loader that writes them and an index (buffer, image, shape number...).
+    // A cache is only valid for the source hash it was written with and as long as the recorded dependencies
+    // keep their size and modification time.
+    class SceneCache
+    {
+    public:
+        static const uint32_t VERSION = 1;
+
+        // "dir/model.glb" -> "dir/model.glb.melocache", or a file named after the hash of the source path in cacheDir
+        static std::string getCachePath(const std::string& sourcePath, const std::string& cacheDir = {});
+
+        // null if the file is missing, truncated, of another VERSION / sourceHash or a dependency changed
+        static SceneCacheRef open(const std::string& path, uint64_t sourceHash);
+
+        // null if the section is missing
+        const uint8_t* getSection(uint32_t kind, uint32_t index = 0, size_t* size = nullptr) const;
+        bool hasSection(uint32_t kind, uint32_t index = 0) const { return getSection(kind, index) != nullptr; }
+
+        // copies a section written by SceneCacheWriter::addArray()
+        template <typename T>
+        bool getArray(uint32_t kind, uint32_t index, std::vector<T>* items) const
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "cache arrays are copied as bytes");
+            size_t size = 0;
+            auto data = getSection(kind, index, &size);
+            if (!data || size % sizeof(T) != 0)
+                return false;
+            items->resize(size / sizeof(T));
+            if (size > 0)
+                memcpy((void*)items->data(), data, size);
+            return true;
+        }
+
+        const MappedFileRef& getFile() const { return mFile; }
+
+    private:
+        SceneCache() = default;
+
+        struct Section
+        {
+            uint32_t kind;
+            uint32_t index;
+            uint64_t offset;
+            uint64_t size;
+        };
+        friend class SceneCacheWriter;
+
+        MappedFileRef mFile;
+        const Section* mSections = nullptr; // sorted by kind, index
+        size_t mSectionCount = 0;
+    };
+
+    class SceneCacheWriter
+    {
+    public:
+        explicit SceneCacheWriter(uint64_t sourceHash) : mSourceHash(sourceHash) {}
+
+        // the size and modification time of path are checked by SceneCache::open()
+        void addDependency(const std::string& path);
+
+        // data is copied, adding a kind / index pair twice replaces the first one
+        void addSection(uint32_t kind, uint32_t index, const void* data, size_t size);
+        void addSection(uint32_t kind, uint32_t index, std::vector<uint8_t>&& bytes);
+        // same without the copy, data must stay alive until write()
+        void addSectionRef(uint32_t kind, uint32_t index, const void* data, size_t size);
+
+        template <typename T>
+        void addArray(uint32_t kind, uint32_t index, const std::vector<T>& items)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "cache arrays are copied as bytes");
+            addSection(kind, index, items.data(), items.size() * sizeof(T));
+        }
+
+        // writes path.tmp and renames it, readers never see a partial file
+        bool write(const std::string& path) const;
+
+    private:
+        struct Entry
+        {
+            uint32_t kind;
+            uint32_t index;
+            const void* data;
+            size_t size;
+            std::shared_ptr<std::vector<uint8_t>> bytes; // owns data for addSection()
+        };
+
+        uint64_t mSourceHash;
+        std::vector<Entry> mEntries;
+        std::vector<std::string> mDependencies;
+    };
+
+    // Decoded 8 bit image with its mip chain down to 1x1, level 0 first.
+    // The levels point into the cache.
+    struct CachedImage
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t components = 0;
+        std::vector<const uint8_t*> levels;
+
+        uint32_t getLevelWidth(size_t level) const { return std::max(width >> level, 1u); }
+        uint32_t getLevelHeight(size_t level) const { return std::max(height >> level, 1u); }
+    };
+
+    // builds the mip chain of pixels (2x2 box filter) and adds it as one section
+    void addCachedImage(SceneCacheWriter& writer, uint32_t kind, uint32_t index, const uint8_t* pixels,
+                        uint32_t width, uint32_t height, uint32_t components);
+    bool getCachedImage(const SceneCache& cache, uint32_t kind, uint32_t index, CachedImage* image);
+}
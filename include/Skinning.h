@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+
+namespace melo
+{
+    enum SkinningMethod
+    {
+        SKINNING_LINEAR,          // blended joint matrices, what glTF specifies
+        SKINNING_DUAL_QUATERNION, // no candy wrapper on twists, joints must be rigid (scale is dropped)
+    };
+
+    // unit rotation quaternion and translation, both as (x, y, z, w)
+    struct DualQuat
+    {
+        glm::vec4 real;
+        glm::vec4 dual;
+    };
+
+    // Per frame joint transforms of one skinned mesh
+    struct SkinningPalette
+    {
+        std::vector<glm::mat4> matrices; // inverse(mesh world) * joint world * inverse bind matrix
+        std::vector<DualQuat> dualQuats; // only filled for SKINNING_DUAL_QUATERNION
+
+        // inverseBindMatrices may be null (identity)
+        void update(const glm::mat4* jointWorldTransforms, const glm::mat4* inverseBindMatrices, size_t jointCount,
+                    const glm::mat4& meshWorldTransform, SkinningMethod method);
+    };
+
+    DualQuat toDualQuat(const glm::mat4& rigid);
+
+    // Vertex streams of one primitive, 4 influences per vertex
+    struct SkinningInput
+    {
+        const glm::vec3* positions = nullptr;
+        const glm::vec3* normals = nullptr; // optional
+        const glm::uvec4* joints = nullptr; // JOINTS_0, indices into the palette
+        const glm::vec4* weights = nullptr; // WEIGHTS_0
+        size_t vertexCount = 0;
+    };
+
+    // Skins vertices [first, first + count), normals are renormalized. Vectorized with SSE2 / AVX2.
+    void skinVertices(const SkinningInput& input, const SkinningPalette& palette, SkinningMethod method, size_t first,
+                      size_t count, glm::vec3* positions, glm::vec3* normals);
+
+    // same over all the vertices, split in chunks of chunkSize vertices across jobs (null runs on the caller)
+    void skinVertices(const SkinningInput& input, const SkinningPalette& palette, SkinningMethod method,
+                      glm::vec3* positions, glm::vec3* normals, JobSystem* jobs, size_t chunkSize = 8192);
+}
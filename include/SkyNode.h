@@ -13,6 +13,8 @@ namespace melo
 
         void predraw(DrawOrder order) override;
         void draw(DrawOrder order) override;
+        void submitDraws(RenderQueue& queue) override;
+        void drawPacket(DrawOrder order, uint32_t item) override;
 
         ci::gl::TextureCubeMapRef mSkyTex;
         ci::gl::BatchRef mSkyBoxBatch;
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+namespace melo
+{
+    typedef std::shared_ptr<class TransformSystem> TransformSystemRef;
+    class JobSystem;
+
+    // Local and world matrices of a forest of transforms in flat arrays, the storage behind melo::Node.
+    // Setting a local transform only flags it, world transforms are brought up to date either one at a time by
+    // getWorld() (walking up to the first ancestor verified since the last change) or for a whole subtree by
+    // update(): one linear pass over the transforms in parent-first order, split over a JobSystem across
+    // independent subtrees.
+    //
+    // Slots live in fixed size chunks that never move: allocate() / release() / setParent() / update() lock,
+    // setLocal() / getLocal() / getWorld() don't and may run on other threads for transforms of other trees.
+    // getWorld() writes the world transforms of stale ancestors, so it must not run concurrently for transforms
+    // sharing an ancestor.
+    class TransformSystem
+    {
+    public:
+        static constexpr uint32_t INVALID = UINT32_MAX;
+
+        static TransformSystemRef create();
+        // shared system of every melo::Node, created on first use
+        static TransformSystemRef getDefault();
+        ~TransformSystem();
+
+        // identity local transform, no parent
+        uint32_t allocate();
+        // detaches index from its parent and its children, which become roots
+        void release(uint32_t index);
+
+        // INVALID makes index a root
+        void setParent(uint32_t index, uint32_t parent);
+        uint32_t getParent(uint32_t index) const { return getChunk(index).parent[index % CHUNK_SIZE]; }
+
+        void setLocal(uint32_t index, const glm::mat4& local)
+        {
+            Chunk& chunk = getChunk(index);
+            chunk.local[index % CHUNK_SIZE] = local;
+            chunk.dirty[index % CHUNK_SIZE] = 1;
+            mChangeCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        const glm::mat4& getLocal(uint32_t index) const { return getChunk(index).local[index % CHUNK_SIZE]; }
+        // world transform of index, recomputed along with its stale ancestors first. Not thread safe for
+        // transforms sharing an ancestor, see above.
+        const glm::mat4& getWorld(uint32_t index);
+        // world transform of index as of the last update() or getWorld() reaching it. Nothing is recomputed, so
+        // any number of threads may read it once the subtree was updated.
+        const glm::mat4& getUpdatedWorld(uint32_t index) const { return getChunk(index).world[index % CHUNK_SIZE]; }
+        // changes whenever getUpdatedWorld(index) does
+        uint32_t getUpdatedWorldVersion(uint32_t index) const { return getChunk(index).worldVersion[index % CHUNK_SIZE]; }
+
+        // brings every world transform of the subtree of root up to date. jobs splits large subtrees, null
+        // updates on the calling thread.
+        void update(uint32_t root, JobSystem* jobs = nullptr);
+        // every tree
+        void update(JobSystem* jobs = nullptr);
+
+        // allocated slots
+        size_t getCount() const { return mCount; }
+        // bumped by allocate(), release() and setParent()
+        uint32_t getHierarchyVersion() const { return mHierarchyVersion.load(std::memory_order_relaxed); }
+
+    private:
+        TransformSystem() = default;
+        TransformSystem(const TransformSystem&) = delete;
+        TransformSystem& operator=(const TransformSystem&) = delete;
+
+        static constexpr uint32_t CHUNK_SIZE = 1024;
+        static constexpr uint32_t MAX_CHUNKS = 16384;
+        // subtrees smaller than this are updated on the calling thread
+        static constexpr size_t PARALLEL_MIN_COUNT = 8192;
+
+        struct Chunk
+        {
+            glm::mat4 local[CHUNK_SIZE];
+            glm::mat4 world[CHUNK_SIZE];
+            uint32_t parent[CHUNK_SIZE];
+            // children as an intrusive list, only used to rebuild mOrder
+            uint32_t firstChild[CHUNK_SIZE];
+            uint32_t prevSibling[CHUNK_SIZE];
+            uint32_t nextSibling[CHUNK_SIZE];
+            // world is stale when dirty or when parentVersion differs from the parent's worldVersion
+            uint32_t worldVersion[CHUNK_SIZE];
+            uint32_t parentVersion[CHUNK_SIZE];
+            // mChangeCount when world was last known to be up to date, nothing needs checking while it matches
+            uint32_t verified[CHUNK_SIZE];
+            uint8_t dirty[CHUNK_SIZE];
+            uint8_t allocated[CHUNK_SIZE];
+        };
+
+        Chunk& getChunk(uint32_t index) const { return *mChunks[index / CHUNK_SIZE]; }
+
+        // recomputes the world transform of index if stale, its parent must be up to date
+        void updateWorld(uint32_t index, uint32_t changeCount);
+        // called with mMutex locked
+        void unlink(uint32_t index);
+        void rebuildOrder();
+
+        std::unique_ptr<Chunk> mChunks[MAX_CHUNKS];
+        uint32_t mChunkCount = 0;
+        uint32_t mSlotCount = 0; // slots handed out so far, released ones included
+        size_t mCount = 0;
+        std::vector<uint32_t> mFreeSlots;
+        std::mutex mMutex;
+        // bumped by every change of a local transform or of the hierarchy
+        std::atomic<uint32_t> mChangeCount{1};
+        std::atomic<uint32_t> mHierarchyVersion{1};
+
+        // every allocated slot, parents before their children and each subtree contiguous
+        std::vector<uint32_t> mOrder;
+        std::vector<uint32_t> mOrderPosition; // per slot, into mOrder
+        std::vector<uint32_t> mSubtreeSize;   // per mOrder position, the node itself included
+        bool mOrderChanged = true;
+    };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace melo
+{
+    // entries of the post-transform cache the optimizations aim for, GPUs since the FIFO era hold at least as many
+    constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+    struct VertexCacheStats
+    {
+        size_t vertexTransforms = 0; // cache misses of a FIFO cache
+        float acmr = 0;              // misses per triangle, 0.5 at best on a regular grid, 3 at worst
+        float atvr = 0;              // misses per referenced vertex, 1 at best
+    };
+
+    VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                        uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // Tipsify (Sander et al. 2007): fans out of the last vertices that went through the cache, linear time.
+    // destination may be indices.
+    void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                             uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // Splits triangles in vertex cache order into clusters where the cache starts over, or where the ACMR so far is
+    // within threshold of that of the whole run, then draws the clusters facing away from the mesh center first so
+    // that they hide the rest. Costs at most threshold times the ACMR. destination may be indices.
+    void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const glm::vec3* positions,
+                          size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE, float threshold = 1.05f);
+
+    // both of the above, in place
+    void optimizeTriangleOrder(uint32_t* indices, size_t indexCount, const glm::vec3* positions, size_t vertexCount);
+
+    // Numbers the vertices in the order the indices first use them so that fetches move forward through memory.
+    // remap[vertex] is the new index, UINT32_MAX for vertices no triangle uses. Returns the new vertex count.
+    size_t optimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+    // destination may be indices
+    void remapIndices(uint32_t* destination, const uint32_t* indices, size_t indexCount, const uint32_t* remap);
+
+    // moves every vertex of a stream to remap[vertex], dropping those remapped to UINT32_MAX. Streams of another
+    // size than remap (absent attributes) are left alone.
+    template <typename T>
+    void remapVertices(std::vector<T>* vertices, const uint32_t* remap, size_t remapSize, size_t newVertexCount)
+    {
+        if (vertices->size() != remapSize)
+            return;
+        std::vector<T> result(newVertexCount);
+        for (size_t i = 0; i < remapSize; i++)
+        {
+            if (remap[i] != UINT32_MAX)
+                result[remap[i]] = (*vertices)[i];
+        }
+        vertices->swap(result);
+    }
+}
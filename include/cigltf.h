@@ -11,11 +11,22 @@ namespace fs = ci::fs;
 #endif
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "../3rdparty/tinygltf/tiny_gltf.h"
 
 #include "Node.h"
+#include "MappedFile.h"
+#include "JobSystem.h"
+#include "AccessorReader.h"
+#include "SceneCache.h"
+#include "AnimationTracks.h"
+#include "CompressedTrack.h"
+#include "MorphTargets.h"
+#include "Skinning.h"
+#include "MeshLod.h"
+#include "VertexCache.h"
 
 typedef std::shared_ptr<struct ModelGLTF> ModelGLTFRef;
 typedef std::shared_ptr<struct WeakBuffer> WeakBufferRef;
@@ -97,6 +108,18 @@ struct WeakBuffer
     {
         return std::make_shared<WeakBuffer>(buffer, size);
     }
+    // except for this one, the returned ref keeps a zero initialized block of its own alive
+    static WeakBufferRef createStorage(size_t size)
+    {
+        struct Storage
+        {
+            Storage(size_t size) : bytes(size), buffer(bytes.data(), size) {}
+            std::vector<uint8_t> bytes;
+            WeakBuffer buffer;
+        };
+        auto storage = std::make_shared<Storage>(size);
+        return WeakBufferRef(storage, &storage->buffer);
+    }
     size_t getSize() const { return mDataSize; }
     void* getData() { return mData; }
     const void* getData() const { return mData; }
@@ -111,22 +134,43 @@ struct WeakBuffer
 
 struct AnimationChannel
 {
-    tinygltf::AnimationChannel property;
+    const tinygltf::AnimationChannel* property = nullptr;
 
-    enum PathType { TRANSLATION, ROTATION, SCALE };
+    enum PathType { TRANSLATION, ROTATION, SCALE, WEIGHTS };
     PathType path;
     int node;
     uint32_t samplerIndex;
+    size_t cursor = 0; // key found by the last lookup, playback usually moves forward from it
 };
 
 struct AnimationSampler
 {
-    tinygltf::AnimationSampler property;
+    const tinygltf::AnimationSampler* property = nullptr;
 
     enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
     InterpolationType interpolation;
     std::vector<float> inputs;
-    std::vector<glm::vec4> outputsVec4;
+    std::vector<glm::vec4> outputsVec4; // CUBICSPLINE: in-tangent, value, out-tangent per key
+    // "weights" channels: weightCount floats per output instead of outputsVec4, same key layout
+    std::vector<float> outputsWeights;
+    uint32_t weightCount = 0;
+    // set by AnimationGLTF::compress(), which releases inputs / outputsVec4. sample() decodes it instead.
+    melo::CompressedTrackRef compressed;
+
+    // false if there are no keys or fewer outputs than the interpolation needs
+    bool isValid() const;
+
+    // last key at or before time (0 before the first key). The interval at *cursor and the next one are
+    // tried first, then a binary search; *cursor is updated.
+    size_t findKey(float time, size_t* cursor) const;
+
+    // value at time, clamped to the first / last key. rotation: (x, y, z, w) quaternions, slerped and normalized
+    glm::vec4 sample(float time, size_t* cursor, bool rotation) const;
+
+    // morph weights at time into weights[weightCount], same clamping and interpolation as sample()
+    void sampleWeights(float time, size_t* cursor, float* weights) const;
+
+    size_t getMemorySize() const;
 };
 
 struct AnimatedValues
@@ -137,12 +181,14 @@ struct AnimatedValues
     bool T_animated = false;
     bool R_animated = false;
     bool S_animated = false;
+    std::vector<float> W; // morph target weights
+    bool W_animated = false;
 };
 
 struct AnimationGLTF
 {
     typedef std::shared_ptr<AnimationGLTF> Ref;
-    tinygltf::Animation property;
+    const tinygltf::Animation* property = nullptr;
 
     std::string name;
     std::vector<AnimationSampler> samplers;
@@ -157,7 +203,22 @@ struct AnimationGLTF
 #endif
 
     void startAnimation();
+    // at animTime
     void getAnimatedValues(AnimatedValues* values);
+    void getAnimatedValues(float time, AnimatedValues* values);
+    // writes the "weights" channels at time into NodeGLTF::weights of their nodes
+    void applyWeights(float time, ModelGLTF* modelGLTF);
+
+    // resamples every channel at sampleRate for melo::AnimationBatch, the value of channels[i] lands in
+    // slot getSlot(i). Channels with an invalid sampler bake to zero / identity, "weights" channels to zero.
+    melo::BakedClipRef bake(float sampleRate) const;
+
+    // Replaces the keys of the LINEAR / STEP translation, rotation and scale samplers with melo::CompressedTrack.
+    // tolerance bounds the error of translations / scales, rotationTolerance the error of quaternion components.
+    // CUBICSPLINE and "weights" samplers are kept as they are.
+    void compress(float tolerance, float rotationTolerance);
+    // bytes held by the keys of every sampler
+    size_t getMemorySize() const;
 
     static Ref create(ModelGLTFRef modelGLTF, const tinygltf::Animation& property);
 };
@@ -165,7 +226,7 @@ struct AnimationGLTF
 struct BufferGLTF
 {
     typedef std::shared_ptr<BufferGLTF> Ref;
-    tinygltf::Buffer property;
+    const tinygltf::Buffer* property = nullptr;
     WeakBufferRef cpuBuffer;
     static Ref create(ModelGLTFRef modelGLTF, const tinygltf::Buffer& property);
 };
@@ -173,7 +234,7 @@ struct BufferGLTF
 struct BufferViewGLTF
 {
     typedef std::shared_ptr<BufferViewGLTF> Ref;
-    tinygltf::BufferView property;
+    const tinygltf::BufferView* property = nullptr;
     GltfTarget target;
     WeakBufferRef cpuBuffer; // points to BufferGLTF::cpuBuffer + offset
 #ifndef CINDER_LESS
@@ -185,10 +246,11 @@ struct BufferViewGLTF
 struct AccessorGLTF
 {
     typedef std::shared_ptr<AccessorGLTF> Ref;
-    tinygltf::Accessor property;
+    const tinygltf::Accessor* property = nullptr;
 
     int byteStride;          // from tinygltf::BufferView
-    WeakBufferRef cpuBuffer; // points to BufferViewGLTF::cpuBuffer + offset
+    WeakBufferRef cpuBuffer; // points to BufferViewGLTF::cpuBuffer + offset, null for sparse only accessors
+    melo::AccessorLayout layout; // for melo::readAccessor()
 #ifndef CINDER_LESS
     ci::gl::VboRef gpuBuffer; // points to BufferViewGLTF::gpuBuffer
     // or re-create in case of offseted IBO
@@ -199,7 +261,7 @@ struct AccessorGLTF
 struct CameraGLTF
 {
     typedef std::shared_ptr<CameraGLTF> Ref;
-    tinygltf::Camera property;
+    const tinygltf::Camera* property = nullptr;
     tinygltf::PerspectiveCamera perspective;
 
 #ifndef CINDER_LESS
@@ -211,9 +273,10 @@ struct CameraGLTF
 struct ImageGLTF
 {
     typedef std::shared_ptr<ImageGLTF> Ref;
-    tinygltf::Image property;
+    const tinygltf::Image* property = nullptr;
 
     // BufferViewGLTF::Ref bufferView;
+    melo::CachedImage cachedImage; // decoded mip chain from ModelGLTF::cache, no levels on cold loads
 #ifndef CINDER_LESS
     ci::SurfaceRef surface;
     ci::DataSourceRef compressedSurface;
@@ -224,7 +287,7 @@ struct ImageGLTF
 struct SamplerGLTF
 {
     typedef std::shared_ptr<SamplerGLTF> Ref;
-    tinygltf::Sampler property;
+    const tinygltf::Sampler* property = nullptr;
 #ifndef CINDER_LESS
     ci::gl::SamplerRef ciSampler;
 #endif
@@ -234,7 +297,7 @@ struct SamplerGLTF
 struct TextureGLTF
 {
     typedef std::shared_ptr<TextureGLTF> Ref;
-    tinygltf::Texture property;
+    const tinygltf::Texture* property = nullptr;
     ImageGLTF::Ref imageSource;
 #ifndef CINDER_LESS
     ci::gl::Texture2dRef ciTexture;
@@ -251,7 +314,7 @@ struct TextureGLTF
 struct MaterialGLTF
 {
     typedef std::shared_ptr<MaterialGLTF> Ref;
-    tinygltf::Material property;
+    const tinygltf::Material* property = nullptr;
     ModelGLTFRef modelGLTF;
 
 #ifndef CINDER_LESS
@@ -304,10 +367,17 @@ struct MaterialGLTF
     void postdraw();
 };
 
+// index work of a primitive done ahead of PrimitiveGLTF::create, see ModelGLTF::preparedIndices
+struct PreparedIndicesGLTF
+{
+    std::vector<uint32_t> indices; // of every level
+    std::vector<melo::LodLevel> lods;
+};
+
 struct PrimitiveGLTF
 {
     typedef std::shared_ptr<PrimitiveGLTF> Ref;
-    tinygltf::Primitive property;
+    const tinygltf::Primitive* property = nullptr;
     GltfMode primitiveMode;
 
     MaterialGLTF::Ref material;
@@ -320,25 +390,61 @@ struct PrimitiveGLTF
     //WeakBufferRef tangents;  // vec4[]
     WeakBufferRef uvs;       // vec2[]
 
+    // skinned primitives keep these on the cpu in both builds
+    WeakBufferRef joints;    // uvec4[], JOINTS_0
+    WeakBufferRef weights;   // vec4[], WEIGHTS_0
+    uint32_t jointLimit = 0; // largest JOINTS_0 index + 1
+    // written by skin(), same layout as positions / normals
+    WeakBufferRef skinnedPositions;
+    WeakBufferRef skinnedNormals;
+
+    // POSITION / NORMAL targets as sparse deltas, morph() writes the blended streams that skin() then reads
+    melo::MorphTargetsRef morphTargets;
+    WeakBufferRef morphedPositions;
+    WeakBufferRef morphedNormals;
+    std::vector<float> morphedWeights; // of the last morph(), unchanged weights skip the blending
+
+    // levels of detail of indexed triangle primitives with ModelGLTF::Option::lodLevels > 1, level 0 is the source.
+    // A single level when only ModelGLTF::Option::optimizeIndices is set.
+    std::vector<melo::LodLevel> lods;
+    // uint32_t[] of every level, on the cpu with CINDER_LESS, the index vbo of ciVboMesh otherwise
+    WeakBufferRef lodIndices;
+
 #ifndef CINDER_LESS
     ci::gl::VboMeshRef ciVboMesh;
+    // dynamic vbos bound as POSITION / NORMAL of skinned or morphed primitives, rewritten every update
+    ci::gl::VboRef ciDynamicPositions;
+    ci::gl::VboRef ciDynamicNormals;
 #endif
     static Ref create(ModelGLTFRef modelGLTF, const tinygltf::Primitive& property);
 
+    bool isSkinned() const { return positions && joints && weights; }
+    bool isMorphed() const { return positions && morphTargets; }
+    // CPU skinning, a mesh shared by several skinned nodes ends up with the pose of the last one
+    void skin(const melo::SkinningPalette& palette, melo::SkinningMethod method, melo::JobSystem* jobs);
+    // CPU morphing, targets whose weight is zero are skipped. Same sharing caveat as skin().
+    void morph(const float* targetWeights, size_t weightCount);
+
     void update();
 
-    void draw(melo::DrawOrder order);
+    void draw(melo::DrawOrder order, uint32_t lodLevel = 0);
 };
 
 struct MeshGLTF
 {
     typedef std::shared_ptr<MeshGLTF> Ref;
-    tinygltf::Mesh property;
+    const tinygltf::Mesh* property = nullptr;
 
     std::vector<PrimitiveGLTF::Ref> primitives;
+    std::vector<float> weights; // default morph target weights
 
     static Ref create(ModelGLTFRef modelGLTF, const tinygltf::Mesh& property);
 
+    bool isMorphed() const;
+
+    void skin(const melo::SkinningPalette& palette, melo::SkinningMethod method, melo::JobSystem* jobs);
+    void morph(const float* targetWeights, size_t weightCount);
+
     void update();
 
     void draw(melo::DrawOrder order);
@@ -347,7 +453,14 @@ struct MeshGLTF
 struct SkinGLTF
 {
     typedef std::shared_ptr<SkinGLTF> Ref;
-    tinygltf::Skin property;
+    const tinygltf::Skin* property = nullptr;
+
+    std::vector<int> joints;                    // into ModelGLTF::nodes
+    std::vector<glm::mat4> inverseBindMatrices; // empty means identity
+
+    // joint palette of a mesh drawn with meshWorldTransform, from the current world transforms of the joints
+    void updatePalette(const ModelGLTF& modelGLTF, const glm::mat4& meshWorldTransform, melo::SkinningMethod method,
+                       melo::SkinningPalette* palette) const;
 
     static Ref create(ModelGLTFRef modelGLTF, const tinygltf::Skin& property);
 };
@@ -355,11 +468,14 @@ struct SkinGLTF
 struct NodeGLTF : public melo::Node
 {
     typedef std::shared_ptr<NodeGLTF> Ref;
-    tinygltf::Node property;
+    const tinygltf::Node* property = nullptr;
 
     CameraGLTF::Ref camera;
     MeshGLTF::Ref mesh;
     SkinGLTF::Ref skin;
+    melo::SkinningPalette skinningPalette;
+    std::vector<float> weights; // morph target weights of mesh, from the node, else the mesh
+    std::vector<uint32_t> lodLevels; // per primitive, as selected by the last draw outside of the shadow pass
 
     static Ref create(ModelGLTFRef modelGLTF, const tinygltf::Node& property);
 
@@ -372,35 +488,299 @@ struct NodeGLTF : public melo::Node
     void predraw(melo::DrawOrder order) override;
     void draw(melo::DrawOrder order) override;
     void postdraw(melo::DrawOrder order) override;
+    // one packet per primitive
+    void submitDraws(melo::RenderQueue& queue) override;
+    void drawPacket(melo::DrawOrder order, uint32_t item) override;
+
+    // level of detail of a primitive for the current GL matrices, the shadow pass keeps that of the camera
+    uint32_t selectLod(melo::DrawOrder order, uint32_t item);
 };
 
 struct SceneGLTF : public NodeGLTF
 {
     typedef std::shared_ptr<SceneGLTF> Ref;
-    tinygltf::Scene sceneProperty;
+    const tinygltf::Scene* sceneProperty = nullptr;
 
     static Ref create(ModelGLTFRef modelGLTF, const tinygltf::Scene& property);
 };
 
+// Compact runtime model
+// Every glTF object kind lives in one contiguous array of POD records. Records refer to each other
+// through 32 bit handles (array indices) and names / uris are interned into one StringTable.
+typedef uint32_t HandleGLTF;
+const HandleGLTF INVALID_HANDLE = 0xFFFFFFFF;
+
+// Strings are stored back to back with their terminating zero, id 0 is the empty string.
+class StringTable
+{
+  public:
+    StringTable();
+
+    uint32_t intern(const std::string& str);
+    // returns 0 if str was never interned
+    uint32_t find(const std::string& str) const;
+    const char* get(uint32_t id) const { return mChars.data() + mOffsets[id]; }
+    size_t size() const { return mOffsets.size(); }
+    size_t getMemorySize() const;
+
+    // every string back to back, assign() rebuilds the same table from them
+    const std::vector<char>& getChars() const { return mChars; }
+    void assign(const char* chars, size_t size);
+
+  private:
+    void rehash(size_t slotCount);
+
+    std::vector<char> mChars;
+    std::vector<uint32_t> mOffsets;
+    std::vector<uint32_t> mSlots; // open addressing, 0 is a free slot
+};
+
+struct CompactGLTF
+{
+    typedef std::shared_ptr<CompactGLTF> Ref;
+
+    struct BufferRecord
+    {
+        uint32_t name;
+        uint32_t uri;
+        uint64_t byteLength;
+    };
+
+    struct BufferViewRecord
+    {
+        uint32_t name;
+        HandleGLTF buffer;
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint32_t byteStride;
+        uint32_t target;
+    };
+
+    struct AccessorRecord
+    {
+        uint32_t name;
+        HandleGLTF bufferView;
+        uint64_t byteOffset;
+        uint32_t count;
+        uint16_t componentType; // GltfComponentType
+        uint8_t type;           // GltfType
+        uint8_t normalized;
+        uint32_t sparseCount;
+        uint8_t hasBounds;      // VEC3 accessors with min / max
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+    };
+
+    struct ImageRecord
+    {
+        uint32_t name;
+        uint32_t uri;
+        uint32_t mimeType;
+        HandleGLTF bufferView;
+    };
+
+    struct SamplerRecord
+    {
+        int32_t minFilter;
+        int32_t magFilter;
+        int32_t wrapS;
+        int32_t wrapT;
+    };
+
+    struct TextureRecord
+    {
+        HandleGLTF image;
+        HandleGLTF sampler;
+    };
+
+    struct MaterialRecord
+    {
+        uint32_t name;
+        uint8_t materialType; // MaterialType
+        uint8_t alphaMode;    // MaterialGLTF::AlphaMode
+        uint8_t doubleSided;
+        float alphaCutoff;
+        glm::vec4 baseColorFactor;
+        glm::vec3 emissiveFactor;
+        float metallicFactor;
+        float roughnessFactor;
+        float normalScale;
+        float occlusionStrength;
+        HandleGLTF baseColorTexture;
+        HandleGLTF metallicRoughnessTexture;
+        HandleGLTF normalTexture;
+        HandleGLTF occlusionTexture;
+        HandleGLTF emissiveTexture;
+    };
+
+    struct PrimitiveRecord
+    {
+        HandleGLTF attributes[NUM_ATTRIBS]; // accessors indexed by AttribGLTF
+        HandleGLTF indices;
+        HandleGLTF material;
+        uint32_t mode; // GltfMode
+    };
+
+    struct MeshRecord
+    {
+        uint32_t name;
+        uint32_t firstPrimitive;
+        uint32_t primitiveCount;
+    };
+
+    struct SkinRecord
+    {
+        uint32_t name;
+        HandleGLTF skeleton;
+        HandleGLTF inverseBindMatrices;
+        uint32_t firstJoint; // into skinJoints
+        uint32_t jointCount;
+    };
+
+    struct CameraRecord
+    {
+        uint32_t name;
+        uint8_t perspective;
+        float yfovOrXmag;
+        float aspectOrYmag;
+        float znear;
+        float zfar;
+    };
+
+    struct NodeRecord
+    {
+        uint32_t name;
+        HandleGLTF parent;
+        HandleGLTF firstChild;
+        HandleGLTF nextSibling;
+        HandleGLTF mesh;
+        HandleGLTF skin;
+        HandleGLTF camera;
+        HandleGLTF matrix; // into nodeMatrices, INVALID_HANDLE if the TRS is used
+        glm::vec3 translation;
+        glm::quat rotation;
+        glm::vec3 scale;
+    };
+
+    struct SceneRecord
+    {
+        uint32_t name;
+        uint32_t firstNode; // into sceneNodes
+        uint32_t nodeCount;
+    };
+
+    struct AnimationRecord
+    {
+        uint32_t name;
+        uint32_t firstChannel;
+        uint32_t channelCount;
+        uint32_t firstSampler;
+        uint32_t samplerCount;
+    };
+
+    struct ChannelRecord
+    {
+        HandleGLTF sampler; // into animationSamplers, already offset by AnimationRecord::firstSampler
+        HandleGLTF node;
+        uint8_t path; // AnimationChannel::PathType, WEIGHTS_PATH for morph weights
+    };
+    static const uint8_t WEIGHTS_PATH = 3;
+
+    struct AnimationSamplerRecord
+    {
+        HandleGLTF input;
+        HandleGLTF output;
+        uint8_t interpolation; // AnimationSampler::InterpolationType
+    };
+
+    // mappedBuffers are the ModelGLTF ones, Option::mapBuffers leaves only placeholders in model.buffers
+    static Ref create(const tinygltf::Model& model, const std::vector<WeakBufferRef>& mappedBuffers = {});
+    // from the sections written by writeCache(), null if one is missing
+    static Ref create(const melo::SceneCache& cache);
+
+    // the records are stored as they are in memory
+    void writeCache(melo::SceneCacheWriter& writer) const;
+
+    // bytes used by the records and the string table
+    size_t getMemorySize() const;
+
+    StringTable strings;
+
+    std::vector<BufferRecord> buffers;
+    std::vector<BufferViewRecord> bufferViews;
+    std::vector<AccessorRecord> accessors;
+    std::vector<ImageRecord> images;
+    std::vector<SamplerRecord> samplers;
+    std::vector<TextureRecord> textures;
+    std::vector<MaterialRecord> materials;
+    std::vector<PrimitiveRecord> primitives;
+    std::vector<MeshRecord> meshes;
+    std::vector<SkinRecord> skins;
+    std::vector<HandleGLTF> skinJoints;
+    std::vector<CameraRecord> cameras;
+    std::vector<NodeRecord> nodes;
+    std::vector<glm::mat4> nodeMatrices;
+    std::vector<SceneRecord> scenes;
+    std::vector<HandleGLTF> sceneNodes;
+    std::vector<AnimationRecord> animations;
+    std::vector<ChannelRecord> animationChannels;
+    std::vector<AnimationSamplerRecord> animationSamplers;
+    HandleGLTF defaultScene = 0;
+};
+
 struct ModelGLTF : public melo::Node
 {
+    // the only copy of the source model, the *GLTF objects point into it
     tinygltf::Model property;
 
     struct Option
     {
         bool loadAnimationOnly = false;
         bool loadTextures = true;
+        // mmap the GLB BIN chunk and external .bin files, cpuBuffers become views into the mappings
+        bool mapBuffers = false;
+        // only build ModelGLTF::compact, no *GLTF objects / scene graph and
+        // the source model is released except for the buffer bytes
+        bool compactOnly = false;
+        // decode images, prepare meshes and animations on a worker pool,
+        // only the GL work stays on the calling thread
+        bool parallel = true;
+        melo::JobSystemRef jobSystem; // null uses JobSystem::getDefault()
+        // Warm loads come from a melo::SceneCache written by the first load: buffers after meshopt decoding,
+        // decoded images with their mip chains and ModelGLTF::compact. The cache is rewritten when the source
+        // changed or when it lacks the images this load asks for.
+        bool useCache = false;
+        fs::path cacheDir; // empty puts the cache next to the asset
+        // skinned meshes are skinned on the cpu in NodeGLTF::update(), on the worker pool when parallel is set
+        melo::SkinningMethod skinning = melo::SKINNING_LINEAR;
+        // AnimationGLTF::compress() every animation after loading it
+        bool compressAnimations = false;
+        float animationTolerance = 1e-4f;
+        float rotationTolerance = 1e-4f;
+        // levels of detail per indexed triangle primitive, each with lodRatio of the triangles of the one before,
+        // drawn by screen space error (melo::getLodSettings()). 1 draws the source triangles only.
+        uint32_t lodLevels = 1;
+        float lodRatio = 0.5f;
+        // reorders the triangles of every level for the post-transform cache then for overdraw
+        // (melo::optimizeTriangleOrder). Vertex streams may be shared between primitives, so they keep their order.
+        bool optimizeIndices = false;
     };
 
-    static ModelGLTFRef create(const fs::path& meshPath, const Option& option = {}, std::string* loadingError = nullptr);
+    static ModelGLTFRef create(const fs::path& meshPath, const Option& option, std::string* loadingError = nullptr);
+    // gcc and clang reject "const Option& option = {}" while Option is still incomplete
+    static ModelGLTFRef create(const fs::path& meshPath) { return create(meshPath, Option()); }
 
-    //void update(double elapsed = 0.0) override;
+    // starts animation and makes it the one update() plays, null stops playing
+    void playAnimation(const AnimationGLTF::Ref& animation);
+    // applies the "weights" channels of the playing animation at its animTime, the nodes morph after it
+    void update(double elapsed = 0.0) override;
 
     void predraw(melo::DrawOrder order) override;
     void postdraw(melo::DrawOrder order) override;
 
     std::vector<AccessorGLTF::Ref> accessors;
     std::vector<AnimationGLTF::Ref> animations;
+    AnimationGLTF::Ref playingAnimation;
     std::vector<BufferViewGLTF::Ref> bufferViews;
     std::vector<BufferGLTF::Ref> buffers;
     std::vector<CameraGLTF::Ref> cameras;
@@ -416,8 +796,22 @@ struct ModelGLTF : public melo::Node
     fs::path meshPath;
     Option option;
 
+    // only filled with Option::mapBuffers, indexed by buffer (null if tinygltf owns the bytes)
+    std::vector<melo::MappedFileRef> mappedFiles;
+    std::vector<WeakBufferRef> mappedBuffers;
+
+    CompactGLTF::Ref compact;
+
+    // the cache a warm load came from, buffers and images point into it
+    melo::SceneCacheRef cache;
+
+    // LOD chains and triangle orders computed on the worker pool while the meshes are created, keys are the
+    // primitives of property. Emptied once the meshes exist.
+    std::unordered_map<const tinygltf::Primitive*, PreparedIndicesGLTF> preparedIndices;
+
     bool flipV = true;
 
+    tinygltf::Material fallbackMaterialProperty;
     MaterialGLTF::Ref fallbackMaterial; // if (material == -1)
 
     SceneGLTF::Ref currentScene;
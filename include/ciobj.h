@@ -57,10 +57,17 @@ struct MeshObj : public melo::Node
         // these are scratch data, keep them here for easier life...
         std::vector<glm::vec3> positions;
         std::vector<glm::vec3> normals;
+        std::vector<glm::vec4> tangents;
         std::vector<glm::vec2> texcoords;
         std::vector<Color> colors;
         std::vector<uint32_t> indexArray;
 
+        // triangle order for the vertex cache and overdraw, then the vertices in the order it fetches them.
+        // Touches the scratch data only, so it runs on any thread before setup().
+        void optimize();
+        // normals when the file has none, tangents and bounds, on any thread after optimize()
+        void computeGeometry(bool flipV);
+        // uploads the scratch data and releases it, GL thread only
         void setup();
         void draw();
     };
@@ -72,6 +79,9 @@ struct MeshObj : public melo::Node
     void draw(melo::DrawOrder order) override;
     void predraw(melo::DrawOrder order) override;
     void postdraw(melo::DrawOrder order) override;
+    // one packet per submesh, item is its key in submeshes
+    void submitDraws(melo::RenderQueue& queue) override;
+    void drawPacket(melo::DrawOrder order, uint32_t item) override;
 };
 
 struct ModelObj : public MeshObj
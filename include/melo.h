@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../include/Node.h"
+#include "../include/PickingScene.h"
 #include <cinder/Filesystem.h>
 #include <cinder/Camera.h>
 
@@ -19,6 +20,9 @@ namespace melo
 
     void drawBoundingBox(NodeRef node, const ci::Color& color = { 1, 1, 0 });
 
+    // bounding boxes only, returns the first child whose subtree box is crossed
     NodeRef pick(NodeRef parentNode, const ci::CameraPersp& camera, const glm::ivec2& screenPos, uint32_t rayMask = 0xFFFFFF);
     NodeRef pick(NodeRef parentNode, const ci::Ray& ray, uint32_t rayMask = 0xFFFFFF);
+    // nearest triangle under screenPos, as of the last picking.refit()
+    PickResult pick(const PickingScene& picking, const ci::CameraPersp& camera, const glm::ivec2& screenPos, uint32_t rayMask = 0xFFFFFF);
 };
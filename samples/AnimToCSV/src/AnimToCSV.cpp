@@ -0,0 +1,464 @@
+// Headless batch exporter of glTF animations.
+//
+// AnimToCSV [options] <model.gltf | model.glb | directory>...
+//   --rate f      samples per second, 30 by default
+//   --binary      writes .anim files instead of .csv, see writeBinaryHeader()
+//   --euler       adds pitch, yaw, roll columns (degrees) after every rotation
+//   --threads n   files exported at once, 0 (default) uses every hardware thread
+//   --out dir     output directory, next to each input by default. Files found in a directory argument keep
+//                 their folder relative to it.
+//
+// Directories are searched recursively for .gltf / .glb files. Every animation of a model is resampled at the
+// same times for all its channels and written to <model>.<animation index>.csv, <model> without its extension: a
+// time column then one column per channel component, named <node>.<t|r|s|w>.<component>. Inputs that would write
+// the same files are reported and nothing is exported.
+//
+// Build with CINDER_LESS defined, glm in the include path and these sources:
+//   ../../src/cigltf.cpp ../../src/Node.cpp ../../src/MappedFile.cpp ../../src/JobSystem.cpp
+//   ../../src/AccessorReader.cpp ../../src/MeshoptDecoder.cpp ../../src/SceneCache.cpp ../../src/AnimationTracks.cpp
+//   ../../src/Skinning.cpp ../../src/MorphTargets.cpp ../../src/CompressedTrack.cpp ../../src/TransformSystem.cpp
+//   ../../src/FrustumCuller.cpp ../../src/RenderQueue.cpp ../../src/OcclusionCuller.cpp
+//   ../../src/MeshLod.cpp ../../src/VertexCache.cpp
+//   ../../3rdparty/tinygltf/tiny_gltf.cc src/AnimToCSV.cpp -o AnimToCSV -lpthread
+// with STB_IMAGE_IMPLEMENTATION and STB_IMAGE_WRITE_IMPLEMENTATION defined for tiny_gltf.cc, Cinder provides them
+// otherwise. vc2019/AnimToCSV.vcxproj builds the same console program.
+
+#ifndef CINDER_LESS
+#define CINDER_LESS
+#endif
+
+#include "cigltf.h"
+#include "JobSystem.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Appends to a memory block flushed with a single fwrite when full, no formatting or locking per value
+class BufferedWriter
+{
+  public:
+    BufferedWriter(const fs::path& path, size_t capacity = 1 << 20)
+    {
+        mFile = fopen(path.string().c_str(), "wb");
+        mBuffer.resize(capacity);
+    }
+    ~BufferedWriter() { close(); }
+
+    bool isOpen() const { return mFile != nullptr; }
+
+    void write(const void* data, size_t size)
+    {
+        if (mSize + size > mBuffer.size())
+        {
+            flush();
+            if (size > mBuffer.size())
+            {
+                mFailed |= mFile && fwrite(data, 1, size, mFile) != size;
+                mWritten += size;
+                return;
+            }
+        }
+        memcpy(&mBuffer[mSize], data, size);
+        mSize += size;
+    }
+
+    void put(char c)
+    {
+        if (mSize == mBuffer.size())
+            flush();
+        mBuffer[mSize++] = c;
+    }
+
+    void write(const string& text) { write(text.data(), text.size()); }
+
+    // shortest text that reads back as the same float
+    void writeText(float value)
+    {
+        if (mSize + 32 > mBuffer.size())
+            flush();
+        char* first = &mBuffer[mSize];
+        auto result = to_chars(first, first + 32, value);
+        mSize += result.ptr - first;
+    }
+
+    template <typename T>
+    void writeBinary(const T& value)
+    {
+        write(&value, sizeof(T));
+    }
+
+    void flush()
+    {
+        mFailed |= mFile && mSize > 0 && fwrite(mBuffer.data(), 1, mSize, mFile) != mSize;
+        mWritten += mSize;
+        mSize = 0;
+    }
+
+    // false if any write failed
+    bool close()
+    {
+        if (mFile)
+        {
+            flush();
+            mFailed |= fclose(mFile) != 0;
+            mFile = nullptr;
+        }
+        return !mFailed;
+    }
+
+    size_t getWrittenSize() const { return mWritten + mSize; }
+
+  private:
+    FILE* mFile = nullptr;
+    vector<char> mBuffer;
+    size_t mSize = 0;
+    size_t mWritten = 0;
+    bool mFailed = false;
+};
+
+struct ExportOption
+{
+    float rate = 30.0f;
+    bool binary = false;
+    bool euler = false;
+    fs::path outputDir;
+};
+
+struct ExportResult
+{
+    fs::path path;
+    string error;
+    size_t animationCount = 0;
+    size_t sampleCount = 0;
+    size_t byteCount = 0;
+};
+
+// channel of an animation that is written, with its own lookup cursor
+struct ExportChannel
+{
+    const AnimationChannel* channel;
+    const AnimationSampler* sampler;
+    size_t cursor = 0;
+};
+
+static const char* getPathLetter(AnimationChannel::PathType path)
+{
+    switch (path)
+    {
+    case AnimationChannel::TRANSLATION: return "t";
+    case AnimationChannel::ROTATION: return "r";
+    case AnimationChannel::SCALE: return "s";
+    default: return "w";
+    }
+}
+
+// node name usable as a column name, "node<index>" when it has none
+static string getColumnPrefix(const ModelGLTF& model, int node)
+{
+    string name = model.property.nodes[node].name;
+    if (name.empty())
+        name = "node" + to_string(node);
+    replace_if(name.begin(), name.end(), [](char c) { return c == ',' || c == '"' || c == '\n' || c == '\r'; }, '_');
+    return name;
+}
+
+static void addColumns(const ModelGLTF& model, const ExportChannel& exported, bool euler, vector<string>* columns)
+{
+    string prefix = getColumnPrefix(model, exported.channel->node) + "." + getPathLetter(exported.channel->path) + ".";
+    switch (exported.channel->path)
+    {
+    case AnimationChannel::ROTATION:
+        for (const char* component : {"x", "y", "z", "w"})
+            columns->push_back(prefix + component);
+        if (euler)
+        {
+            for (const char* component : {"pitch", "yaw", "roll"})
+                columns->push_back(prefix + component);
+        }
+        break;
+    case AnimationChannel::WEIGHTS:
+        for (uint32_t i = 0; i < exported.sampler->weightCount; i++)
+            columns->push_back(prefix + to_string(i));
+        break;
+    default:
+        for (const char* component : {"x", "y", "z"})
+            columns->push_back(prefix + component);
+        break;
+    }
+}
+
+// the values of every channel at time, in column order
+static void sampleRow(vector<ExportChannel>& channels, float time, bool euler, vector<float>* row)
+{
+    row->clear();
+    row->push_back(time);
+    for (auto& exported : channels)
+    {
+        auto path = exported.channel->path;
+        if (path == AnimationChannel::WEIGHTS)
+        {
+            size_t first = row->size();
+            row->resize(first + exported.sampler->weightCount);
+            exported.sampler->sampleWeights(time, &exported.cursor, &(*row)[first]);
+            continue;
+        }
+
+        bool rotation = path == AnimationChannel::ROTATION;
+        glm::vec4 value = exported.sampler->sample(time, &exported.cursor, rotation);
+        row->insert(row->end(), {value.x, value.y, value.z});
+        if (!rotation)
+            continue;
+        row->push_back(value.w);
+        if (euler)
+        {
+            auto angles = glm::degrees(glm::eulerAngles(glm::quat(value.w, value.x, value.y, value.z)));
+            row->insert(row->end(), {angles.x, angles.y, angles.z});
+        }
+    }
+}
+
+// .anim layout, little endian: "MELOANIM", uint32 version (1), uint32 column count, uint32 sample count,
+// float rate, every column name as uint32 length + chars, then sample count rows of column count floats
+static void writeBinaryHeader(BufferedWriter& writer, const vector<string>& columns, size_t sampleCount, float rate)
+{
+    writer.write("MELOANIM", 8);
+    writer.writeBinary<uint32_t>(1);
+    writer.writeBinary<uint32_t>((uint32_t)columns.size());
+    writer.writeBinary<uint32_t>((uint32_t)sampleCount);
+    writer.writeBinary<float>(rate);
+    for (const auto& column : columns)
+    {
+        writer.writeBinary<uint32_t>((uint32_t)column.size());
+        writer.write(column);
+    }
+}
+
+static bool exportAnimation(const ModelGLTF& model, const AnimationGLTF& animation, const fs::path& outputPath,
+                            const ExportOption& option, ExportResult* result)
+{
+    vector<ExportChannel> channels;
+    for (const auto& channel : animation.channels)
+    {
+        const auto& sampler = animation.samplers[channel.samplerIndex];
+        if (channel.node < 0 || !sampler.isValid())
+            continue;
+        channels.push_back({&channel, &sampler});
+    }
+    if (channels.empty())
+        return true;
+
+    vector<string> columns = {"time"};
+    for (const auto& exported : channels)
+        addColumns(model, exported, option.euler, &columns);
+
+    // start, start + 1 / rate, ... and the last key, even when it falls between two samples
+    float duration = max(animation.end - animation.start, 0.0f);
+    size_t sampleCount = (size_t)floor(duration * option.rate + 1e-3f) + 1;
+    if ((sampleCount - 1) / option.rate < duration - 1e-6f)
+        sampleCount++;
+
+    BufferedWriter writer(outputPath);
+    if (!writer.isOpen())
+    {
+        result->error = "failed to open " + outputPath.string();
+        return false;
+    }
+
+    if (option.binary)
+    {
+        writeBinaryHeader(writer, columns, sampleCount, option.rate);
+    }
+    else
+    {
+        for (size_t i = 0; i < columns.size(); i++)
+        {
+            if (i > 0)
+                writer.put(',');
+            writer.write(columns[i]);
+        }
+        writer.put('\n');
+    }
+
+    vector<float> row;
+    for (size_t i = 0; i < sampleCount; i++)
+    {
+        float time = min(animation.start + i / option.rate, animation.start + duration);
+        sampleRow(channels, time, option.euler, &row);
+        if (option.binary)
+        {
+            writer.write(row.data(), row.size() * sizeof(float));
+            continue;
+        }
+        for (size_t c = 0; c < row.size(); c++)
+        {
+            if (c > 0)
+                writer.put(',');
+            writer.writeText(row[c]);
+        }
+        writer.put('\n');
+    }
+
+    result->sampleCount += sampleCount;
+    result->byteCount += writer.getWrittenSize();
+    if (!writer.close())
+    {
+        result->error = "failed to write " + outputPath.string();
+        return false;
+    }
+    return true;
+}
+
+struct ExportInput
+{
+    fs::path path;
+    fs::path outputDir;
+};
+
+static void exportFile(const ExportInput& input, const ExportOption& option, ExportResult* result)
+{
+    const auto& path = input.path;
+    result->path = path;
+
+    ModelGLTF::Option loadOption;
+    loadOption.loadAnimationOnly = true;
+    loadOption.loadTextures = false;
+    // files are already spread over the workers
+    loadOption.parallel = false;
+    // also receives the tinygltf warnings of files that do load
+    string loadingError;
+    auto model = ModelGLTF::create(path, loadOption, &loadingError);
+    if (!model)
+    {
+        result->error = loadingError.empty() ? "failed to load" : loadingError;
+        return;
+    }
+
+    for (size_t i = 0; i < model->animations.size(); i++)
+    {
+        auto outputPath =
+            input.outputDir / (path.stem().string() + "." + to_string(i) + (option.binary ? ".anim" : ".csv"));
+        if (!exportAnimation(*model, *model->animations[i], outputPath, option, result))
+            return;
+        result->animationCount++;
+    }
+}
+
+static bool isModelFile(const fs::path& path)
+{
+    auto ext = path.extension().string();
+    transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower(c); });
+    return ext == ".gltf" || ext == ".glb";
+}
+
+static const char* getArg(int argc, char** argv, const char* name, const char* defaultValue)
+{
+    for (int i = 1; i + 1 < argc; i++)
+        if (string(argv[i]) == name) return argv[i + 1];
+    return defaultValue;
+}
+
+int main(int argc, char** argv)
+{
+    ExportOption option;
+    option.rate = (float)atof(getArg(argc, argv, "--rate", "30"));
+    option.outputDir = getArg(argc, argv, "--out", "");
+    size_t threadCount = (size_t)atoll(getArg(argc, argv, "--threads", "0"));
+
+    vector<ExportInput> inputs;
+    auto addInput = [&](const fs::path& path, const fs::path& relativeDir) {
+        fs::path outputDir = option.outputDir.empty() ? path.parent_path() : option.outputDir / relativeDir;
+        inputs.push_back({path, outputDir.lexically_normal()});
+    };
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--binary")
+            option.binary = true;
+        else if (arg == "--euler")
+            option.euler = true;
+        else if (arg == "--rate" || arg == "--out" || arg == "--threads")
+            i++;
+        else if (fs::is_directory(arg))
+        {
+            for (const auto& entry : fs::recursive_directory_iterator(arg))
+                if (entry.is_regular_file() && isModelFile(entry.path()))
+                    addInput(entry.path(), entry.path().parent_path().lexically_relative(arg));
+        }
+        else
+            addInput(arg, {});
+    }
+
+    if (inputs.empty() || !(option.rate > 0))
+    {
+        printf("Usage: AnimToCSV [--rate f] [--binary] [--euler] [--threads n] [--out dir] <model.gltf | dir>...\n");
+        return 1;
+    }
+
+    // the exports run at once, two inputs writing the same files would overwrite each other
+    unordered_map<string, size_t> outputStems;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        auto stem = (inputs[i].outputDir / inputs[i].path.stem()).string();
+        auto found = outputStems.emplace(stem, i);
+        if (!found.second)
+        {
+            printf("%s and %s both write %s.*\n", inputs[found.first->second].path.string().c_str(),
+                   inputs[i].path.string().c_str(), stem.c_str());
+            return 1;
+        }
+    }
+    if (!option.outputDir.empty())
+    {
+        for (const auto& input : inputs)
+            fs::create_directories(input.outputDir);
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+
+    vector<ExportResult> results(inputs.size());
+    if (threadCount == 1)
+    {
+        for (size_t i = 0; i < inputs.size(); i++)
+            exportFile(inputs[i], option, &results[i]);
+    }
+    else
+    {
+        // the calling thread works too while it waits
+        auto jobs = melo::JobSystem::create(threadCount > 1 ? threadCount - 1 : 0);
+        threadCount = jobs->getThreadCount() + 1;
+        vector<melo::JobRef> pending;
+        for (size_t i = 0; i < inputs.size(); i++)
+            pending.push_back(jobs->add([&, i] { exportFile(inputs[i], option, &results[i]); }));
+        jobs->wait(pending);
+    }
+
+    double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+    size_t animationCount = 0, sampleCount = 0, byteCount = 0, failedCount = 0;
+    for (const auto& result : results)
+    {
+        animationCount += result.animationCount;
+        sampleCount += result.sampleCount;
+        byteCount += result.byteCount;
+        if (!result.error.empty())
+        {
+            printf("%s: %s\n", result.path.string().c_str(), result.error.c_str());
+            failedCount++;
+        }
+    }
+    printf("%zu files (%zu failed), %zu animations, %zu samples, %.2f MB in %.1f ms on %zu threads\n",
+           results.size(), failedCount, animationCount, sampleCount, byteCount / (1024.0 * 1024.0), ms, threadCount);
+    return failedCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+#include "BenchUtils.h"
+#include "AccessorReader.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace melo;
+
+// best of a few runs, in GB/s of source bytes
+template <typename Func>
+static double measureGBs(size_t bytes, Func func)
+{
+    double best = 1e30;
+    for (int run = 0; run < 5; run++)
+    {
+        BenchTimer timer;
+        func();
+        best = std::min(best, timer.getMilliseconds());
+    }
+    return bytes / (best * 1e-3) / 1e9;
+}
+
+// Throughput of the accessor conversion kernels, SIMD against the scalar reference,
+// plus readAccessor() on interleaved layouts.
+int benchAccessorRead(int argc, char** argv)
+{
+    size_t count = (size_t)atoll(getArg(argc, argv, "--count", "16000000"));
+
+    std::vector<uint8_t> source(count * 8 + 64);
+    std::mt19937 rng(1);
+    for (auto& byte : source)
+        byte = (uint8_t)rng();
+    // keep the float source finite
+    for (size_t i = 0; i + 4 <= source.size(); i += 4)
+    {
+        float value = (float)(rng() % 100000) * 0.01f;
+        memcpy(&source[i], &value, 4);
+    }
+
+    std::vector<float> floats(count * 2);
+    std::vector<float> reference(count * 2);
+    std::vector<uint32_t> uints(count);
+    std::vector<uint32_t> referenceUints(count);
+
+    struct Kernel
+    {
+        const char* name;
+        uint32_t componentType;
+        bool normalized;
+    };
+    const Kernel kFloatKernels[] = {
+        {"i8 norm", 5120, true},  {"u8 norm", 5121, true},   {"i16 norm", 5122, true},
+        {"u16 norm", 5123, true}, {"u16", 5123, false},      {"u32", 5125, false},
+        {"f32", 5126, false},
+    };
+
+    printf("simd: %s, %zu components\n", getSimdName(), count);
+    printf("%-28s %12s %12s\n", "-> float", "scalar GB/s", "simd GB/s");
+    for (auto& kernel : kFloatKernels)
+    {
+        size_t bytes = count * getComponentSize(kernel.componentType);
+        double scalar = measureGBs(bytes, [&] {
+            convertToFloatScalar(source.data(), kernel.componentType, kernel.normalized, count, reference.data());
+        });
+        double simd = measureGBs(bytes, [&] {
+            convertToFloat(source.data(), kernel.componentType, kernel.normalized, count, floats.data());
+        });
+        if (memcmp(floats.data(), reference.data(), count * sizeof(float)) != 0)
+        {
+            printf("accessor-read: %s doesn't match the scalar reference\n", kernel.name);
+            return 1;
+        }
+        printf("%-28s %12.2f %12.2f\n", kernel.name, scalar, simd);
+    }
+
+    const Kernel kUintKernels[] = {{"u8", 5121, false}, {"u16", 5123, false}, {"u32", 5125, false}};
+    printf("%-28s %12s %12s\n", "-> uint32", "scalar GB/s", "simd GB/s");
+    for (auto& kernel : kUintKernels)
+    {
+        size_t bytes = count * getComponentSize(kernel.componentType);
+        double scalar = measureGBs(bytes, [&] {
+            convertToUintScalar(source.data(), kernel.componentType, count, referenceUints.data());
+        });
+        double simd = measureGBs(bytes, [&] {
+            convertToUint(source.data(), kernel.componentType, count, uints.data());
+        });
+        if (uints != referenceUints)
+        {
+            printf("accessor-read: %s doesn't match the scalar reference\n", kernel.name);
+            return 1;
+        }
+        printf("%-28s %12.2f %12.2f\n", kernel.name, scalar, simd);
+    }
+
+    struct Layout
+    {
+        const char* name;
+        uint32_t componentType;
+        uint32_t componentCount;
+        size_t byteStride;
+        bool normalized;
+    };
+    const Layout kLayouts[] = {
+        {"f32 vec3 packed", 5126, 3, 0, false},     {"f32 vec3 stride 32", 5126, 3, 32, false},
+        {"u16 vec2 norm stride 32", 5123, 2, 32, true}, {"i16 vec3 norm stride 8", 5122, 3, 8, true},
+        {"i8 vec4 norm packed", 5120, 4, 0, true},
+    };
+    printf("%-28s %12s %12s\n", "readAccessor", "", "GB/s");
+    for (auto& item : kLayouts)
+    {
+        AccessorLayout layout;
+        layout.componentType = item.componentType;
+        layout.componentCount = item.componentCount;
+        layout.normalized = item.normalized;
+        layout.byteStride = item.byteStride;
+        size_t elementSize = getComponentSize(item.componentType) * item.componentCount;
+        size_t stride = item.byteStride ? item.byteStride : elementSize;
+        layout.data = source.data();
+        layout.count = std::min(count / item.componentCount, (source.size() - elementSize) / stride);
+        size_t valueCount = layout.count * item.componentCount;
+
+        // every element converted on its own by the scalar kernel
+        for (size_t i = 0; i < layout.count; i++)
+        {
+            convertToFloatScalar(layout.data + i * stride, item.componentType, item.normalized, item.componentCount,
+                                 reference.data() + i * item.componentCount);
+        }
+        double simd = measureGBs(layout.count * elementSize, [&] { readAccessor(layout, floats.data()); });
+        if (memcmp(floats.data(), reference.data(), valueCount * sizeof(float)) != 0)
+        {
+            printf("accessor-read: %s doesn't match the scalar reference\n", item.name);
+            return 1;
+        }
+        printf("%-28s %12s %12.2f\n", item.name, "", simd);
+    }
+
+    // sparse substitution on top of a zero initialized accessor
+    {
+        uint16_t indices[] = {1, 5};
+        float values[] = {1, 2, 3, 4, 5, 6};
+        AccessorLayout layout;
+        layout.count = 8;
+        layout.componentType = 5126;
+        layout.componentCount = 3;
+        layout.sparseCount = 2;
+        layout.sparseIndexType = 5123;
+        layout.sparseIndices = (const uint8_t*)indices;
+        layout.sparseValues = (const uint8_t*)values;
+        float result[24];
+        readAccessor(layout, result);
+        if (result[3] != 1 || result[5] != 3 || result[15] != 4 || result[17] != 6 || result[0] != 0)
+        {
+            printf("accessor-read: sparse substitution failed\n");
+            return 1;
+        }
+    }
+    return 0;
+}
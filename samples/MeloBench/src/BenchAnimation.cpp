@@ -0,0 +1,475 @@
+#include "BenchUtils.h"
+#include "cigltf.h"
+#include "AccessorReader.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+// the lookup AnimationGLTF::getAnimatedValues() used to do: every interval of the channel, LINEAR only
+static bool sampleLinearScan(const AnimationSampler& sampler, float time, bool rotation, glm::vec4* value)
+{
+    bool found = false;
+    for (size_t i = 0; i < sampler.inputs.size() - 1; i++)
+    {
+        if (time >= sampler.inputs[i] && time <= sampler.inputs[i + 1])
+        {
+            float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
+            const glm::vec4& a = sampler.outputsVec4[i];
+            const glm::vec4& b = sampler.outputsVec4[i + 1];
+            if (rotation)
+            {
+                glm::quat q = glm::normalize(glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), u));
+                *value = glm::vec4(q.x, q.y, q.z, q.w);
+            }
+            else
+            {
+                *value = glm::mix(a, b, u);
+            }
+            found = true;
+        }
+    }
+    return found;
+}
+
+// keeps the scan results alive
+static volatile float sSink;
+
+// keyCount keys at 30 fps on every channel, translation / rotation / scale in turn.
+// Random walks, like captured motion: consecutive keys stay close.
+static AnimationGLTF::Ref createAnimation(size_t keyCount, size_t channelCount, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> step(-0.1f, 0.1f);
+    auto anim = std::make_shared<AnimationGLTF>();
+    for (size_t c = 0; c < channelCount; c++)
+    {
+        AnimationSampler sampler{};
+        sampler.interpolation = AnimationSampler::LINEAR;
+        sampler.inputs.resize(keyCount);
+        sampler.outputsVec4.resize(keyCount);
+        glm::vec4 value(dist(rng), dist(rng), dist(rng), dist(rng));
+        for (size_t k = 0; k < keyCount; k++)
+        {
+            sampler.inputs[k] = k / 30.0f;
+            value += glm::vec4(step(rng), step(rng), step(rng), step(rng));
+            sampler.outputsVec4[k] = (c % 3 == 1) ? glm::normalize(value) : value;
+        }
+        anim->samplers.push_back(sampler);
+
+        AnimationChannel channel{};
+        channel.path = (AnimationChannel::PathType)(c % 3);
+        channel.node = (int)c;
+        channel.samplerIndex = (uint32_t)c;
+        anim->channels.push_back(channel);
+    }
+    anim->start = 0;
+    anim->end = (keyCount - 1) / 30.0f;
+    return anim;
+}
+
+static bool near(const glm::vec4& a, const glm::vec4& b, float epsilon = 1e-5f)
+{
+    return std::abs(a.x - b.x) <= epsilon && std::abs(a.y - b.y) <= epsilon && std::abs(a.z - b.z) <= epsilon &&
+           std::abs(a.w - b.w) <= epsilon;
+}
+
+// STEP and CUBICSPLINE on hand made keys
+static bool checkInterpolation()
+{
+    size_t cursor = 0;
+    AnimationSampler step{};
+    step.interpolation = AnimationSampler::STEP;
+    step.inputs = {0, 1, 2};
+    step.outputsVec4 = {glm::vec4(0), glm::vec4(1), glm::vec4(2)};
+    if (!near(step.sample(0.9f, &cursor, false), glm::vec4(0)) || !near(step.sample(1.5f, &cursor, false), glm::vec4(1)) ||
+        !near(step.sample(5.0f, &cursor, false), glm::vec4(2)) || !near(step.sample(-1.0f, &cursor, false), glm::vec4(0)))
+        return false;
+
+    // zero tangents: smoothstep between the values, exact on the keys
+    AnimationSampler cubic{};
+    cubic.interpolation = AnimationSampler::CUBICSPLINE;
+    cubic.inputs = {0, 2};
+    cubic.outputsVec4 = {glm::vec4(0), glm::vec4(0), glm::vec4(0), glm::vec4(0), glm::vec4(4), glm::vec4(0)};
+    if (!near(cubic.sample(0, &cursor, false), glm::vec4(0)) || !near(cubic.sample(2, &cursor, false), glm::vec4(4)) ||
+        !near(cubic.sample(0.5f, &cursor, false), glm::vec4(4 * 0.15625f)) ||
+        !near(cubic.sample(1.0f, &cursor, false), glm::vec4(2)))
+        return false;
+
+    // a straight line through the keys: tangents are the slope, the spline is the line
+    cubic.outputsVec4 = {glm::vec4(2), glm::vec4(0), glm::vec4(2), glm::vec4(2), glm::vec4(4), glm::vec4(2)};
+    return near(cubic.sample(0.5f, &cursor, false), glm::vec4(1)) && near(cubic.sample(1.5f, &cursor, false), glm::vec4(3));
+}
+
+// AnimationGLTF::getAnimatedValues(): cursor + binary search against the old linear scan,
+// sweeping the number of keys and channels
+int benchAnimation(int argc, char** argv)
+{
+    int frames = atoi(getArg(argc, argv, "--frames", "600"));
+
+    if (!checkInterpolation())
+    {
+        printf("anim-sample: STEP / CUBICSPLINE don't match the expected values\n");
+        return 1;
+    }
+
+    const size_t kKeyCounts[] = {16, 256, 4096, 65536};
+    const size_t kChannelCounts[] = {16, 256};
+
+    std::mt19937 rng(1);
+    printf("%8s %9s %16s %16s %16s\n", "keys", "channels", "scan (ns/ch)", "random (ns/ch)", "playback (ns/ch)");
+    for (auto channelCount : kChannelCounts)
+    {
+        for (auto keyCount : kKeyCounts)
+        {
+            auto anim = createAnimation(keyCount, channelCount, rng);
+            float duration = anim->end - anim->start;
+
+            std::vector<float> randomTimes(frames);
+            std::uniform_real_distribution<float> timeDist(anim->start, anim->end);
+            for (auto& time : randomTimes)
+                time = timeDist(rng);
+
+            // every new lookup matches the old one
+            for (int f = 0; f < 64; f++)
+            {
+                float time = randomTimes[f % frames];
+                for (auto& channel : anim->channels)
+                {
+                    const auto& sampler = anim->samplers[channel.samplerIndex];
+                    bool rotation = channel.path == AnimationChannel::ROTATION;
+                    glm::vec4 expected;
+                    if (!sampleLinearScan(sampler, time, rotation, &expected) ||
+                        !near(sampler.sample(time, &channel.cursor, rotation), expected, 1e-4f))
+                    {
+                        printf("anim-sample: sample at %f doesn't match the linear scan\n", time);
+                        return 1;
+                    }
+                }
+            }
+
+            // the scan is quadratic in the clip length, keep its total work bounded
+            int scanFrames = (int)std::max<size_t>(1, std::min<size_t>(frames, (size_t)2e8 / (keyCount * channelCount)));
+            glm::vec4 sink(0);
+            BenchTimer timer;
+            for (int f = 0; f < scanFrames; f++)
+            {
+                for (auto& channel : anim->channels)
+                {
+                    glm::vec4 value;
+                    sampleLinearScan(anim->samplers[channel.samplerIndex], randomTimes[f], channel.path == AnimationChannel::ROTATION, &value);
+                    sink += value;
+                }
+            }
+            double scanNs = timer.getMilliseconds() * 1e6 / (scanFrames * channelCount);
+            sSink = sink.x;
+
+            AnimatedValues values;
+            timer.reset();
+            for (int f = 0; f < frames; f++)
+                anim->getAnimatedValues(randomTimes[f], &values);
+            double randomNs = timer.getMilliseconds() * 1e6 / (frames * channelCount);
+
+            // 60 fps playback of the whole clip, looping
+            timer.reset();
+            for (int f = 0; f < frames; f++)
+                anim->getAnimatedValues(anim->start + std::fmod(f / 60.0f, duration), &values);
+            double playbackNs = timer.getMilliseconds() * 1e6 / (frames * channelCount);
+
+            printf("%8zu %9zu %16.1f %16.1f %16.1f\n", keyCount, channelCount, scanNs, randomNs, playbackNs);
+        }
+    }
+    return 0;
+}
+
+// AnimationGLTF::bake() + melo::AnimationBatch against sampling every channel of every clip,
+// a crowd of clipCount characters playing at different times
+int benchAnimationBatch(int argc, char** argv)
+{
+    int clipCount = atoi(getArg(argc, argv, "--clips", "200"));
+    int channelCount = atoi(getArg(argc, argv, "--channels", "60"));
+    int keyCount = atoi(getArg(argc, argv, "--keys", "300"));
+    float sampleRate = (float)atof(getArg(argc, argv, "--rate", "30"));
+    int frames = atoi(getArg(argc, argv, "--frames", "600"));
+
+    std::mt19937 rng(1);
+    std::vector<AnimationGLTF::Ref> anims;
+    size_t sourceBytes = 0;
+    for (int i = 0; i < clipCount; i++)
+    {
+        anims.push_back(createAnimation(keyCount, channelCount, rng));
+        for (auto& sampler : anims.back()->samplers)
+            sourceBytes += sampler.inputs.size() * sizeof(float) + sampler.outputsVec4.size() * sizeof(glm::vec4);
+    }
+
+    BenchTimer timer;
+    auto batch = melo::AnimationBatch::create();
+    std::vector<melo::BakedClipRef> clips;
+    std::vector<uint32_t> firstSlots;
+    size_t bakedBytes = 0;
+    for (auto& anim : anims)
+    {
+        clips.push_back(anim->bake(sampleRate));
+        bakedBytes += clips.back()->getMemorySize();
+        firstSlots.push_back(batch->addClip(clips.back()));
+    }
+    double bakeMs = timer.getMilliseconds();
+
+    // each character plays its clip from its own offset
+    std::vector<float> offsets(clipCount);
+    std::uniform_real_distribution<float> offsetDist(0, anims[0]->end);
+    for (auto& offset : offsets)
+        offset = offsetDist(rng);
+    auto getTime = [&](int frame, int clip) { return std::fmod(offsets[clip] + frame / 60.0f, anims[clip]->end); };
+
+    // the per channel path, one value per channel
+    std::vector<glm::vec4> values(clipCount * channelCount);
+    auto sampleAll = [&](int frame) {
+        for (int i = 0; i < clipCount; i++)
+        {
+            float time = getTime(frame, i);
+            auto& anim = *anims[i];
+            for (int c = 0; c < channelCount; c++)
+            {
+                auto& channel = anim.channels[c];
+                values[i * channelCount + c] = anim.samplers[channel.samplerIndex].sample(
+                    time, &channel.cursor, channel.path == AnimationChannel::ROTATION);
+            }
+        }
+    };
+
+    std::vector<float> times(clipCount);
+    std::vector<glm::vec4> outputs(batch->getSlotCount());
+    auto evaluateAll = [&](int frame) {
+        for (int i = 0; i < clipCount; i++)
+            times[i] = getTime(frame, i);
+        batch->evaluate(times.data(), outputs.data());
+    };
+
+    // quaternions may come out negated, both signs are the same rotation
+    float maxError = 0;
+    for (int frame = 0; frame < frames; frame += 7)
+    {
+        sampleAll(frame);
+        evaluateAll(frame);
+        for (int i = 0; i < clipCount; i++)
+        {
+            for (int c = 0; c < channelCount; c++)
+            {
+                glm::vec4 expected = values[i * channelCount + c];
+                glm::vec4 baked = outputs[firstSlots[i] + clips[i]->getSlot(c)];
+                if (anims[i]->channels[c].path == AnimationChannel::ROTATION && glm::dot(expected, baked) < 0)
+                    baked = -baked;
+                glm::vec4 delta = glm::abs(expected - baked);
+                maxError = std::max(maxError, std::max(std::max(delta.x, delta.y), std::max(delta.z, delta.w)));
+            }
+        }
+    }
+
+    timer.reset();
+    for (int frame = 0; frame < frames; frame++)
+        sampleAll(frame);
+    double sampleNs = timer.getMilliseconds() * 1e6 / ((double)frames * clipCount * channelCount);
+
+    timer.reset();
+    for (int frame = 0; frame < frames; frame++)
+        evaluateAll(frame);
+    double batchNs = timer.getMilliseconds() * 1e6 / ((double)frames * clipCount * channelCount);
+
+    printf("simd: %s, %d clips x %d channels, %d keys, baked at %.1f fps in %.2f ms\n", melo::getSimdName(), clipCount,
+           channelCount, keyCount, clips[0]->sampleRate, bakeMs);
+    printf("%-10s %12s %14s\n", "path", "ns/channel", "memory (MB)");
+    printf("%-10s %12.2f %14.2f\n", "sample", sampleNs, toMB(sourceBytes));
+    printf("%-10s %12.2f %14.2f  (max error %g)\n", "batch", batchNs, toMB(bakedBytes), maxError);
+    return 0;
+}
+
+// channelCount smooth channels at fps, like retargeted motion capture: translations and rotations are a few
+// low frequency waves plus sensor noise, scales stay at 1
+static AnimationGLTF::Ref createMocap(size_t keyCount, size_t channelCount, float fps, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> frequency(0.1f, 2.0f);
+    std::normal_distribution<float> noise(0.0f, 1e-5f);
+    auto anim = std::make_shared<AnimationGLTF>();
+    for (size_t c = 0; c < channelCount; c++)
+    {
+        auto path = (AnimationChannel::PathType)(c % 3);
+        AnimationSampler sampler{};
+        sampler.interpolation = AnimationSampler::LINEAR;
+        glm::vec4 amplitude(dist(rng), dist(rng), dist(rng), 0), phase(dist(rng), dist(rng), dist(rng), 0);
+        glm::vec4 omega = 6.2831853f * glm::vec4(frequency(rng), frequency(rng), frequency(rng), 0);
+        glm::vec3 axis = glm::normalize(glm::vec3(dist(rng), dist(rng), dist(rng)));
+        for (size_t k = 0; k < keyCount; k++)
+        {
+            float time = k / fps;
+            sampler.inputs.push_back(time);
+            glm::vec4 wave(0);
+            for (int i = 0; i < 3; i++)
+                wave[i] = amplitude[i] * std::sin(omega[i] * time + phase[i] * 3.0f);
+            if (path == AnimationChannel::TRANSLATION)
+            {
+                sampler.outputsVec4.push_back(wave + glm::vec4(noise(rng), noise(rng), noise(rng), 0));
+            }
+            else if (path == AnimationChannel::ROTATION)
+            {
+                glm::vec3 twisted = glm::normalize(axis + 0.3f * glm::vec3(wave));
+                float angle = 1.5f * wave.x + noise(rng);
+                glm::quat q = glm::angleAxis(angle, twisted);
+                sampler.outputsVec4.push_back(glm::vec4(q.x, q.y, q.z, q.w));
+            }
+            else
+            {
+                sampler.outputsVec4.push_back(glm::vec4(1, 1, 1, 0));
+            }
+        }
+        anim->samplers.push_back(sampler);
+
+        AnimationChannel channel{};
+        channel.path = path;
+        channel.node = (int)c;
+        channel.samplerIndex = (uint32_t)c;
+        anim->channels.push_back(channel);
+    }
+    anim->start = 0;
+    anim->end = (keyCount - 1) / fps;
+    return anim;
+}
+
+struct CompressionStats
+{
+    size_t sourceKeys = 0;
+    size_t keptKeys = 0;
+    float maxError = 0;         // translations / scales
+    float maxRotationError = 0; // quaternion components
+    float maxAngle = 0;         // degrees
+};
+
+// samples both clips on their keys and halfway between them
+static void compareCompressed(AnimationGLTF& source, AnimationGLTF& compressed, CompressionStats* stats)
+{
+    for (size_t c = 0; c < source.channels.size(); c++)
+    {
+        auto& channel = source.channels[c];
+        const auto& sampler = source.samplers[channel.samplerIndex];
+        const auto& track = compressed.samplers[channel.samplerIndex].compressed;
+        if (!track || !sampler.isValid())
+            continue;
+        stats->sourceKeys += track->getSourceKeyCount();
+        stats->keptKeys += track->getKeyCount();
+        bool rotation = channel.path == AnimationChannel::ROTATION;
+        size_t cursor = 0;
+        for (size_t k = 0; k < sampler.inputs.size() * 2 - 1; k++)
+        {
+            const float* keys = &sampler.inputs[k / 2];
+            float time = (k % 2 == 0) ? keys[0] : (keys[0] + keys[1]) * 0.5f;
+            glm::vec4 expected = sampler.sample(time, &channel.cursor, rotation);
+            glm::vec4 value = track->sample(time, &cursor);
+            if (rotation && glm::dot(expected, value) < 0)
+                value = -value;
+            glm::vec4 delta = glm::abs(expected - value);
+            float error = std::max(std::max(delta.x, delta.y), std::max(delta.z, delta.w));
+            if (rotation)
+            {
+                stats->maxRotationError = std::max(stats->maxRotationError, error);
+                // acos() of a dot close to 1 is mostly rounding noise
+                float angle = 4.0f * std::atan2(glm::length(expected - value), glm::length(expected + value));
+                stats->maxAngle = std::max(stats->maxAngle, glm::degrees(angle));
+            }
+            else
+            {
+                stats->maxError = std::max(stats->maxError, error);
+            }
+        }
+    }
+}
+
+// ns per channel of getAnimatedValues(), random times then 60 fps playback, best of 5 runs
+static void measureSampling(AnimationGLTF& anim, int frames, std::mt19937& rng, double* randomNs, double* playbackNs)
+{
+    std::vector<float> randomTimes(frames);
+    std::uniform_real_distribution<float> timeDist(anim.start, anim.end);
+    for (auto& time : randomTimes)
+        time = timeDist(rng);
+    size_t channelCount = std::max<size_t>(1, anim.channels.size());
+    float duration = std::max(anim.end - anim.start, 1e-3f);
+
+    AnimatedValues values;
+    *randomNs = *playbackNs = 1e30;
+    for (int run = 0; run < 5; run++)
+    {
+        BenchTimer timer;
+        for (int f = 0; f < frames; f++)
+            anim.getAnimatedValues(randomTimes[f], &values);
+        *randomNs = std::min(*randomNs, timer.getMilliseconds() * 1e6 / (frames * channelCount));
+
+        timer.reset();
+        for (int f = 0; f < frames; f++)
+            anim.getAnimatedValues(anim.start + std::fmod(f / 60.0f, duration), &values);
+        *playbackNs = std::min(*playbackNs, timer.getMilliseconds() * 1e6 / (frames * channelCount));
+    }
+}
+
+// AnimationGLTF::compress(): key reduction + smallest-three / 16 bit quantization against the source keys,
+// on synthetic mocap or on the animations of a model
+int benchAnimationCompress(int argc, char** argv)
+{
+    int channelCount = atoi(getArg(argc, argv, "--channels", "180"));
+    int keyCount = atoi(getArg(argc, argv, "--keys", "3600"));
+    float fps = (float)atof(getArg(argc, argv, "--fps", "120"));
+    float tolerance = (float)atof(getArg(argc, argv, "--tolerance", "1e-4"));
+    float rotationTolerance = (float)atof(getArg(argc, argv, "--rotation-tolerance", "1e-4"));
+    int frames = atoi(getArg(argc, argv, "--frames", "2000"));
+
+    std::mt19937 rng(1);
+    std::vector<AnimationGLTF::Ref> sources;
+    ModelGLTFRef model;
+    if (argc >= 1 && argv[0][0] != '-')
+    {
+        ModelGLTF::Option option;
+        option.loadTextures = false;
+        option.loadAnimationOnly = true;
+        model = ModelGLTF::create(argv[0], option);
+        if (!model)
+        {
+            printf("anim-compress: failed to load %s\n", argv[0]);
+            return 1;
+        }
+        sources = model->animations;
+    }
+    else
+    {
+        sources.push_back(createMocap(keyCount, channelCount, fps, rng));
+    }
+
+    printf("tolerance %g, rotation tolerance %g\n", tolerance, rotationTolerance);
+    printf("%-20s %10s %10s %8s %12s %12s %10s %12s %12s\n", "animation", "keys", "kept", "ratio", "max error",
+           "max rot err", "max deg", "random ns", "playback ns");
+    size_t sourceBytes = 0, compressedBytes = 0;
+    double compressMs = 0;
+    for (auto& source : sources)
+    {
+        auto compressed = std::make_shared<AnimationGLTF>(*source);
+        BenchTimer timer;
+        compressed->compress(tolerance, rotationTolerance);
+        compressMs += timer.getMilliseconds();
+        sourceBytes += source->getMemorySize();
+        compressedBytes += compressed->getMemorySize();
+
+        CompressionStats stats;
+        compareCompressed(*source, *compressed, &stats);
+        double sourceRandom, sourcePlayback, compressedRandom, compressedPlayback;
+        measureSampling(*source, frames, rng, &sourceRandom, &sourcePlayback);
+        measureSampling(*compressed, frames, rng, &compressedRandom, &compressedPlayback);
+
+        std::string name = source->name.empty() ? "(unnamed)" : source->name;
+        printf("%-20s %10zu %10zu %8.2f %12s %12s %10s %12.1f %12.1f\n", name.c_str(), stats.sourceKeys, stats.keptKeys,
+               (double)source->getMemorySize() / std::max<size_t>(1, compressed->getMemorySize()), "", "", "",
+               sourceRandom, sourcePlayback);
+        printf("%-20s %10s %10s %8s %12g %12g %10.4f %12.1f %12.1f\n", "  compressed", "", "", "", stats.maxError,
+               stats.maxRotationError, stats.maxAngle, compressedRandom, compressedPlayback);
+    }
+    printf("memory: %.2f MB -> %.2f MB (%.2fx), compressed in %.1f ms\n", toMB(sourceBytes), toMB(compressedBytes),
+           (double)sourceBytes / std::max<size_t>(1, compressedBytes), compressMs);
+    return 0;
+}
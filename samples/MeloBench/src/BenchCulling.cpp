@@ -0,0 +1,155 @@
+#include "BenchUtils.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "Node.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtx/transform.hpp>
+
+using namespace melo;
+
+// Node::isInsideFrustrum: the eight corners of the local box to world space, then every plane in turn
+static bool isInsideReference(const Node& node, const glm::mat4& viewProjection)
+{
+    const auto& world = node.getWorldTransform();
+    glm::vec3 boxMin(FLT_MAX), boxMax(-FLT_MAX);
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 p((corner & 1) ? node.mBoundBoxMax.x : node.mBoundBoxMin.x,
+                    (corner & 2) ? node.mBoundBoxMax.y : node.mBoundBoxMin.y,
+                    (corner & 4) ? node.mBoundBoxMax.z : node.mBoundBoxMin.z);
+        p = glm::vec3(world * glm::vec4(p, 1));
+        boxMin = glm::min(boxMin, p);
+        boxMax = glm::max(boxMax, p);
+    }
+
+    for (int plane = 0; plane < 6; plane++)
+    {
+        int row = plane / 2;
+        float sign = (plane & 1) ? -1.0f : 1.0f;
+        glm::vec4 equation(viewProjection[0][3] + sign * viewProjection[0][row],
+                           viewProjection[1][3] + sign * viewProjection[1][row],
+                           viewProjection[2][3] + sign * viewProjection[2][row],
+                           viewProjection[3][3] + sign * viewProjection[3][row]);
+        glm::vec3 corner(equation.x >= 0 ? boxMax.x : boxMin.x, equation.y >= 0 ? boxMax.y : boxMin.y,
+                         equation.z >= 0 ? boxMax.z : boxMin.z);
+        if (equation.x * corner.x + equation.y * corner.y + equation.z * corner.z + equation.w < 0)
+            return false;
+    }
+    return true;
+}
+
+// groups of unit boxes scattered over a plane, seen by a camera turning around its middle. Checks FrustumCuller
+// against the per node test it replaces.
+int benchCulling(int argc, char** argv)
+{
+    size_t count = (size_t)atoll(getArg(argc, argv, "--nodes", "100000"));
+    size_t groupSize = std::max<size_t>(1, (size_t)atoll(getArg(argc, argv, "--group", "64")));
+    int frames = atoi(getArg(argc, argv, "--frames", "10"));
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    auto root = Node::create();
+    std::vector<NodeRef> leaves;
+    for (size_t i = 0; i < count; i += groupSize)
+    {
+        auto group = Node::create();
+        group->setTransform(glm::translate(glm::vec3(dist(rng) * 500.0f, dist(rng) * 20.0f, dist(rng) * 500.0f)));
+        root->addChild(group);
+        for (size_t j = i; j < std::min(count, i + groupSize); j++)
+        {
+            auto leaf = Node::create();
+            leaf->mBoundBoxMin = glm::vec3(-0.5f);
+            leaf->mBoundBoxMax = glm::vec3(0.5f);
+            leaf->setTransform(
+                glm::translate(glm::vec3(dist(rng), dist(rng), dist(rng)) * 10.0f) *
+                glm::toMat4(glm::angleAxis(dist(rng) * 3.0f, glm::normalize(glm::vec3(dist(rng), dist(rng), 1.0f)))) *
+                glm::scale(glm::vec3(1.0f + dist(rng) * 0.5f)));
+            group->addChild(leaf);
+            leaves.push_back(leaf);
+        }
+    }
+    root->treeUpdate();
+
+    auto jobs = JobSystem::getDefault();
+    auto serial = FrustumCuller::create();
+    auto parallel = FrustumCuller::create();
+    auto projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+
+    printf("%zu boxes in groups of %zu, %zu + 1 threads, %d frames\n", leaves.size(), groupSize,
+           jobs->getThreadCount(), frames);
+
+    BenchTimer timer;
+    serial->cull(root, projection, nullptr);
+    printf("%-28s %12.3f\n", "first cull ms (flattening)", timer.getMilliseconds());
+
+    double ms[3] = {1e30, 1e30, 1e30};
+    size_t mismatches = 0, visibleCount = 0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        float angle = frame * 6.2831853f / std::max(frames, 1);
+        auto view = glm::lookAt(glm::vec3(0, 30, 0), glm::vec3(std::cos(angle), 29.8f, std::sin(angle)),
+                                glm::vec3(0, 1, 0));
+        auto viewProjection = projection * view;
+
+        std::vector<uint8_t> reference(leaves.size());
+        timer.reset();
+        for (size_t i = 0; i < leaves.size(); i++)
+            reference[i] = isInsideReference(*leaves[i], viewProjection) ? 1 : 0;
+        ms[0] = std::min(ms[0], timer.getMilliseconds());
+
+        timer.reset();
+        serial->cull(root, viewProjection, nullptr);
+        ms[1] = std::min(ms[1], timer.getMilliseconds());
+
+        timer.reset();
+        parallel->cull(root, viewProjection, jobs.get());
+        ms[2] = std::min(ms[2], timer.getMilliseconds());
+
+        for (size_t i = 0; i < leaves.size(); i++)
+        {
+            bool visible = reference[i] != 0;
+            if (serial->isVisible(*leaves[i]) != visible || parallel->isVisible(*leaves[i]) != visible)
+                mismatches++;
+            visibleCount += reference[i];
+        }
+    }
+
+    // every group moves: all the world boxes are recomputed
+    for (const auto& group : root->getChildren())
+        group->setTransform(glm::translate(glm::vec3(0, 1, 0)) * group->getTransform());
+    root->treeUpdate();
+    timer.reset();
+    serial->cull(root, projection, nullptr);
+    double movedMs = timer.getMilliseconds();
+    for (const auto& leaf : leaves)
+    {
+        if (serial->isVisible(*leaf) != isInsideReference(*leaf, projection))
+            mismatches++;
+    }
+
+    const auto& stats = parallel->getStats();
+    printf("%-28s %12.3f\n", "per node test ms", ms[0]);
+    printf("%-28s %12.3f\n", "FrustumCuller serial ms", ms[1]);
+    printf("%-28s %12.3f\n", "FrustumCuller parallel ms", ms[2]);
+    printf("%-28s %12.3f\n", "  after every node moved", movedMs);
+    printf("last frame: %zu visible, %zu culled of %zu nodes (groups and root included)\n", stats.visibleCount,
+           stats.culledCount, stats.nodeCount);
+    printf("%.1f%% of the boxes visible on average, %zu mismatches\n",
+           visibleCount * 100.0 / std::max<size_t>(1, leaves.size() * frames), mismatches);
+
+    // corners on a plane may round either way between the two box transforms
+    if (mismatches > leaves.size() * (frames + 1) / 10000)
+    {
+        printf("cull: FrustumCuller doesn't match the per node test\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include "BenchUtils.h"
+#include "cigltf.h"
+#include "../../../3rdparty/tinygltf/json.hpp"
+
+#include <fstream>
+
+// byteLength of every buffer as the json of a .gltf / .glb states it, empty if the file can't be read.
+// EXT_meshopt_compression fallback buffers have no bytes in the file and get UINT64_MAX.
+static std::vector<uint64_t> readBufferLengths(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    uint32_t chunkLength = 0;
+    if (json.size() >= 20 && json.compare(0, 4, "glTF") == 0)
+    {
+        memcpy(&chunkLength, json.data() + 12, 4);
+        json = json.substr(20, chunkLength);
+    }
+    std::vector<uint64_t> lengths;
+    auto doc = nlohmann::json::parse(json, nullptr, false);
+    if (doc.is_discarded() || !doc.is_object() || !doc["buffers"].is_array())
+        return lengths;
+    for (auto& buffer : doc["buffers"])
+    {
+        bool fallback = false;
+        auto extensions = buffer.find("extensions");
+        if (extensions != buffer.end() && extensions->is_object() && extensions->count("EXT_meshopt_compression"))
+            fallback = (*extensions)["EXT_meshopt_compression"].value("fallback", false);
+        lengths.push_back(fallback ? UINT64_MAX : buffer.value("byteLength", uint64_t(0)));
+    }
+    return lengths;
+}
+
+// Heap usage and load time of the *GLTF object graph versus the compact runtime model.
+// Buffers are mapped, so the numbers only cover the scene description.
+int benchGltfCompact(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        printf("gltf-compact: missing model path\n");
+        return 1;
+    }
+    std::string path = argv[0];
+    std::string mode = getArg(argc, argv, "--mode", "");
+
+    if (mode.empty())
+    {
+        printf("%-8s %12s %12s %12s %14s\n", "mode", "load (ms)", "heap (MB)", "allocs", "compact (MB)");
+        runBenchProcess("gltf-compact \"" + path + "\" --mode source");
+        runBenchProcess("gltf-compact \"" + path + "\" --mode objects");
+        runBenchProcess("gltf-compact \"" + path + "\" --mode compact");
+        return 0;
+    }
+
+    size_t heapBase = gHeapBytes;
+    size_t allocBase = gHeapAllocations;
+    size_t bufferBytes = 0;
+    size_t compactBytes = 0;
+    size_t nodeCount = 0;
+    BenchTimer timer;
+    double ms = 0;
+
+    tinygltf::Model source;
+    double buildMs = 0;
+    size_t buildHeap = 0;
+    size_t buildAllocs = 0;
+    ModelGLTFRef model;
+    if (mode == "source")
+    {
+        // what tinygltf alone costs, every *GLTF object used to carry a copy of its part of it
+        tinygltf::TinyGLTF loader;
+        std::string err, warn;
+        bool ret = path.find(".glb") != std::string::npos
+                       ? loader.LoadBinaryFromFile(&source, &err, &warn, path)
+                       : loader.LoadASCIIFromFile(&source, &err, &warn, path);
+        ms = timer.getMilliseconds();
+        if (!ret)
+        {
+            printf("gltf-compact: failed to load %s\n%s\n", path.c_str(), err.c_str());
+            return 1;
+        }
+        for (auto& buffer : source.buffers)
+            bufferBytes += buffer.data.capacity();
+        nodeCount = source.nodes.size();
+
+        size_t heap = gHeapBytes;
+        size_t allocs = gHeapAllocations;
+        BenchTimer buildTimer;
+        auto compact = CompactGLTF::create(source);
+        buildMs = buildTimer.getMilliseconds();
+        buildHeap = gHeapBytes - heap;
+        buildAllocs = gHeapAllocations - allocs;
+        compactBytes = compact->getMemorySize();
+        compact.reset();
+
+    }
+    else
+    {
+        ModelGLTF::Option option;
+        option.loadTextures = false;
+        option.mapBuffers = true;
+        option.compactOnly = (mode == "compact");
+        model = ModelGLTF::create(path, option);
+        ms = timer.getMilliseconds();
+        if (!model)
+        {
+            printf("gltf-compact: failed to load %s\n", path.c_str());
+            return 1;
+        }
+        compactBytes = model->compact->getMemorySize();
+        nodeCount = model->compact->nodes.size();
+
+        // mapped buffers only leave a placeholder behind, the records need the real length
+        auto lengths = readBufferLengths(path);
+        bool ok = lengths.size() == model->compact->buffers.size();
+        for (size_t i = 0; ok && i < lengths.size(); i++)
+            ok = lengths[i] == UINT64_MAX || model->compact->buffers[i].byteLength == lengths[i];
+        if (!ok)
+        {
+            printf("gltf-compact: the buffer lengths don't match the source json\n");
+            return 1;
+        }
+
+        // the compact model has to describe the same scene
+        if (!option.compactOnly)
+        {
+            const auto& compact = *model->compact;
+            for (size_t i = 0; i < model->nodes.size(); i++)
+            {
+                const auto& node = model->nodes[i];
+                const auto& record = compact.nodes[i];
+                bool ok = node->property->name == compact.strings.get(record.name);
+                ok &= (record.mesh == INVALID_HANDLE) == !node->mesh;
+                size_t childCount = 0;
+                for (auto child = record.firstChild; child != INVALID_HANDLE; child = compact.nodes[child].nextSibling)
+                {
+                    ok &= compact.nodes[child].parent == i;
+                    ok &= node->property->children[childCount++] == (int)child;
+                }
+                ok &= childCount == node->property->children.size();
+                if (!ok)
+                {
+                    printf("gltf-compact: node %d doesn't match the source model\n", (int)i);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    double heapMB = toMB(gHeapBytes - heapBase - bufferBytes);
+    printf("%-8s %12.2f %12.2f %12zu %14.2f  (%zu nodes)\n", mode.c_str(), ms, heapMB,
+           (size_t)(gHeapAllocations - allocBase), mode == "source" ? 0.0 : toMB(compactBytes), nodeCount);
+    if (mode == "source")
+    {
+        printf("%-8s %12.2f %12.2f %12zu %14.2f  (compact model built from the parsed source)\n", "build", buildMs,
+               toMB(buildHeap), buildAllocs, toMB(compactBytes));
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "BenchUtils.h"
+#include "cigltf.h"
+
+// Load time and peak memory of ModelGLTF::create, with and without Option::mapBuffers
+int benchGltfLoad(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        printf("gltf-load: missing model path\n");
+        return 1;
+    }
+    std::string path = argv[0];
+    std::string mode = getArg(argc, argv, "--mode", "");
+
+    if (mode.empty())
+    {
+        printf("%-8s %12s %14s %14s\n", "mode", "load (ms)", "peak (MB)", "buffers (MB)");
+        runBenchProcess("gltf-load \"" + path + "\" --mode copy");
+        runBenchProcess("gltf-load \"" + path + "\" --mode mapped");
+        return 0;
+    }
+
+    ModelGLTF::Option option;
+    option.loadTextures = false;
+    option.mapBuffers = (mode == "mapped");
+
+    size_t baseline = getPeakMemory();
+    BenchTimer timer;
+    auto model = ModelGLTF::create(path, option);
+    double ms = timer.getMilliseconds();
+    if (!model)
+    {
+        printf("gltf-load: failed to load %s\n", path.c_str());
+        return 1;
+    }
+
+    // touch every byte once, like a GPU upload would
+    uint64_t checksum = 0;
+    size_t bufferSize = 0;
+    for (auto& buffer : model->buffers)
+    {
+        bufferSize += buffer->cpuBuffer->getSize();
+        auto data = (const uint8_t*)buffer->cpuBuffer->getData();
+        for (size_t i = 0; i < buffer->cpuBuffer->getSize(); i += 4096)
+            checksum += data[i];
+    }
+
+    printf("%-8s %12.2f %14.2f %14.2f  (checksum %llu)\n", mode.c_str(), ms, toMB(getPeakMemory() - baseline),
+           toMB(bufferSize), (unsigned long long)checksum);
+    return 0;
+}
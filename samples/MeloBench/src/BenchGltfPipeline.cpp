@@ -0,0 +1,53 @@
+#include "BenchUtils.h"
+#include "cigltf.h"
+
+// ModelGLTF::create with everything on the calling thread versus the job pipeline.
+// Use a texture heavy model, image decoding is the bulk of the work.
+int benchGltfPipeline(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        printf("gltf-pipeline: missing model path\n");
+        return 1;
+    }
+    std::string path = argv[0];
+    std::string mode = getArg(argc, argv, "--mode", "");
+    std::string threads = getArg(argc, argv, "--threads", "0");
+    std::string mapped = hasArg(argc, argv, "--mapped") ? " --mapped" : "";
+
+    if (mode.empty())
+    {
+        printf("%-8s %8s %12s %10s %20s\n", "mode", "threads", "load (ms)", "images", "pixel checksum");
+        runBenchProcess("gltf-pipeline \"" + path + "\" --mode serial" + mapped);
+        runBenchProcess("gltf-pipeline \"" + path + "\" --mode parallel --threads " + threads + mapped);
+        return 0;
+    }
+
+    ModelGLTF::Option option;
+    option.parallel = (mode == "parallel");
+    option.mapBuffers = !mapped.empty();
+    if (option.parallel)
+        option.jobSystem = melo::JobSystem::create(atoi(threads.c_str()));
+
+    BenchTimer timer;
+    auto model = ModelGLTF::create(path, option);
+    double ms = timer.getMilliseconds();
+    if (!model)
+    {
+        printf("gltf-pipeline: failed to load %s\n", path.c_str());
+        return 1;
+    }
+
+    // both modes have to decode the same pixels
+    uint64_t checksum = 0;
+    for (auto& image : model->property.images)
+    {
+        for (size_t i = 0; i < image.image.size(); i += 61)
+            checksum = checksum * 31 + image.image[i];
+    }
+
+    printf("%-8s %8zu %12.2f %10zu %20llu\n", mode.c_str(),
+           option.jobSystem ? option.jobSystem->getThreadCount() + 1 : 1, ms, model->images.size(),
+           (unsigned long long)checksum);
+    return 0;
+}
@@ -0,0 +1,292 @@
+#include "BenchUtils.h"
+#include "MeshLod.h"
+#include "cigltf.h"
+
+#undef near
+#undef far
+#include "../../../3rdparty/yocto/yocto_bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace melo;
+
+struct LodMesh
+{
+    const char* name;
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+// a closed sphere with a texture seam: the first column of vertices is repeated at u = 1 and every pole triangle
+// has a pole vertex of its own
+static LodMesh makeSphere(uint32_t rings, uint32_t segments)
+{
+    LodMesh mesh = {"uv sphere", {}, {}};
+    for (uint32_t ring = 0; ring <= rings; ring++)
+    {
+        float theta = 3.1415926f * ring / rings;
+        for (uint32_t segment = 0; segment <= segments; segment++)
+        {
+            float phi = 6.2831853f * (segment % segments) / segments;
+            float y = ring == 0 ? 1.0f : ring == rings ? -1.0f : std::cos(theta);
+            float r = ring == 0 || ring == rings ? 0.0f : std::sin(theta);
+            mesh.positions.emplace_back(r * std::cos(phi), y, r * std::sin(phi));
+        }
+    }
+    for (uint32_t ring = 0; ring < rings; ring++)
+    {
+        for (uint32_t segment = 0; segment < segments; segment++)
+        {
+            uint32_t a = ring * (segments + 1) + segment, b = a + segments + 1;
+            if (ring > 0)
+                mesh.indices.insert(mesh.indices.end(), {a, a + 1, b});
+            if (ring + 1 < rings)
+                mesh.indices.insert(mesh.indices.end(), {a + 1, b + 1, b});
+        }
+    }
+    return mesh;
+}
+
+// a closed cube of six grids with vertices of their own, the hard normals split every edge of the cube
+static LodMesh makeCube(uint32_t cells)
+{
+    LodMesh mesh = {"split normal cube", {}, {}};
+    for (int face = 0; face < 6; face++)
+    {
+        int axis = face / 2;
+        float side = face % 2 ? 1.0f : -1.0f;
+        uint32_t base = (uint32_t)mesh.positions.size();
+        for (uint32_t v = 0; v <= cells; v++)
+        {
+            for (uint32_t u = 0; u <= cells; u++)
+            {
+                glm::vec3 p;
+                p[axis] = side;
+                p[(axis + 1) % 3] = u * 2.0f / cells - 1.0f;
+                p[(axis + 2) % 3] = v * 2.0f / cells - 1.0f;
+                mesh.positions.push_back(p);
+            }
+        }
+        for (uint32_t v = 0; v < cells; v++)
+        {
+            for (uint32_t u = 0; u < cells; u++)
+            {
+                uint32_t a = base + v * (cells + 1) + u, b = a + cells + 1;
+                if (side > 0)
+                    mesh.indices.insert(mesh.indices.end(), {a, a + 1, b + 1, a, b + 1, b});
+                else
+                    mesh.indices.insert(mesh.indices.end(), {a, b + 1, a + 1, a, b, b + 1});
+            }
+        }
+    }
+    return mesh;
+}
+
+// edges with a single triangle once the vertices are welded by position, any on a closed mesh is a crack
+static size_t countOpenEdges(const std::vector<glm::vec3>& positions, const uint32_t* indices, size_t indexCount)
+{
+    std::map<std::tuple<float, float, float>, uint32_t> welded;
+    std::vector<uint32_t> remap(positions.size());
+    for (size_t i = 0; i < positions.size(); i++)
+        remap[i] = welded.emplace(std::make_tuple(positions[i].x, positions[i].y, positions[i].z), (uint32_t)i).first->second;
+
+    std::map<std::pair<uint32_t, uint32_t>, int> edges;
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t a = remap[indices[i + k]], b = remap[indices[i + (k + 1) % 3]];
+            edges[{std::min(a, b), std::max(a, b)}] += a < b ? 1 : -1;
+        }
+    }
+    size_t open = 0;
+    for (const auto& edge : edges)
+        open += edge.second != 0 ? 1 : 0;
+    return open;
+}
+
+// a scene of a single instance, yocto only exposes the nearest point queries of whole scenes
+struct SurfaceBvh
+{
+    yocto::scene_scene scene;
+    yocto::bvh_scene bvh;
+
+    SurfaceBvh(const std::vector<glm::vec3>& positions, const uint32_t* indices, size_t indexCount)
+    {
+        yocto::scene_shape shape;
+        for (const auto& p : positions)
+            shape.positions.push_back({p.x, p.y, p.z});
+        shape.radius.assign(positions.size(), 0.0f);
+        for (size_t i = 0; i < indexCount; i += 3)
+            shape.triangles.push_back({(int)indices[i], (int)indices[i + 1], (int)indices[i + 2]});
+        scene.shapes.push_back(std::move(shape));
+        yocto::scene_instance instance;
+        instance.shape = 0;
+        scene.instances.push_back(instance);
+        bvh = yocto::make_bvh(scene, {});
+    }
+
+    float distance(const glm::vec3& p) const
+    {
+        auto hit = yocto::overlap_bvh(bvh, scene, {p.x, p.y, p.z}, FLT_MAX);
+        return hit.hit ? hit.distance : FLT_MAX;
+    }
+};
+
+// farthest distance from the vertices, edge midpoints and centroids of a to the surface of b
+static float getOneSidedDistance(const std::vector<glm::vec3>& positions, const uint32_t* a, size_t aCount,
+                                 const SurfaceBvh& b)
+{
+    float distance = 0;
+    for (size_t i = 0; i < aCount; i += 3)
+    {
+        const glm::vec3 &p0 = positions[a[i]], &p1 = positions[a[i + 1]], &p2 = positions[a[i + 2]];
+        const glm::vec3 samples[] = {p0, (p0 + p1) * 0.5f, (p1 + p2) * 0.5f, (p2 + p0) * 0.5f, (p0 + p1 + p2) / 3.0f};
+        for (const auto& sample : samples)
+            distance = std::max(distance, b.distance(sample));
+    }
+    return distance;
+}
+
+// builds the chain of every mesh and compares each level with the source, then draws a field of spheres at
+// growing distances, selecting levels by screen space error, and counts the triangles sent each frame
+int benchLod(int argc, char** argv)
+{
+    const char* path = argc > 0 && argv[0][0] != '-' ? argv[0] : nullptr;
+    uint32_t levelCount = (uint32_t)atoi(getArg(argc, argv, "--levels", "8"));
+    float ratio = (float)atof(getArg(argc, argv, "--ratio", "0.5"));
+    size_t instanceCount = (size_t)atoll(getArg(argc, argv, "--instances", "2000"));
+    int frames = std::max(2, atoi(getArg(argc, argv, "--frames", "64")));
+
+    std::vector<LodMesh> meshes;
+    meshes.push_back(makeSphere(128, 256));
+    meshes.push_back(makeCube(64));
+
+    int failures = 0;
+    std::vector<std::vector<uint32_t>> chainIndices(meshes.size());
+    std::vector<std::vector<LodLevel>> chainLevels(meshes.size());
+    for (size_t m = 0; m < meshes.size(); m++)
+    {
+        const auto& mesh = meshes[m];
+        BenchTimer timer;
+        buildLodChain(mesh.indices.data(), mesh.indices.size(), mesh.positions.data(), mesh.positions.size(),
+                      levelCount, ratio, &chainIndices[m], &chainLevels[m]);
+        double ms = timer.getMilliseconds();
+        printf("%s: %zu triangles, %zu levels built in %.1f ms (%.2f M source triangles/s)\n", mesh.name,
+               mesh.indices.size() / 3, chainLevels[m].size(), ms, mesh.indices.size() / 3 / ms / 1000.0);
+        printf("  %-6s %10s %12s %12s %10s\n", "level", "triangles", "error", "hausdorff", "cracks");
+
+        SurfaceBvh source(mesh.positions, mesh.indices.data(), mesh.indices.size());
+        for (size_t l = 0; l < chainLevels[m].size(); l++)
+        {
+            const auto& level = chainLevels[m][l];
+            const uint32_t* indices = chainIndices[m].data() + level.indexOffset;
+            SurfaceBvh simplified(mesh.positions, indices, level.indexCount);
+            float hausdorff = std::max(getOneSidedDistance(mesh.positions, indices, level.indexCount, source),
+                                       getOneSidedDistance(mesh.positions, mesh.indices.data(), mesh.indices.size(),
+                                                           simplified));
+            size_t cracks = countOpenEdges(mesh.positions, indices, level.indexCount);
+            printf("  %-6zu %10u %12.5f %12.5f %10zu\n", l, level.indexCount / 3, level.error, hausdorff, cracks);
+            // the estimate bounds the error through the quadrics, a far larger measured one means a broken level
+            if (cracks > 0 || hausdorff > level.error * 4.0f + 1e-3f)
+                failures++;
+        }
+    }
+
+    if (path)
+    {
+        ModelGLTF::Option option;
+        option.loadTextures = false;
+        option.lodLevels = levelCount;
+        option.lodRatio = ratio;
+        BenchTimer timer;
+        auto model = ModelGLTF::create(path, option);
+        if (!model)
+            return 1;
+        size_t source = 0, coarsest = 0, primitives = 0;
+        for (const auto& mesh : model->meshes)
+        {
+            for (const auto& primitive : mesh->primitives)
+            {
+                if (primitive->lods.empty())
+                    continue;
+                primitives++;
+                source += primitive->lods.front().indexCount / 3;
+                coarsest += primitive->lods.back().indexCount / 3;
+            }
+        }
+        printf("%s: loaded with %u levels in %.1f ms, %zu primitives with levels, %zu -> %zu triangles\n", path,
+               levelCount, timer.getMilliseconds(), primitives, source, coarsest);
+    }
+
+    // spheres of radius 1 in front of the camera, from 2 to 400 units away, seen by a 1080 pixels high viewport
+    const auto& levels = chainLevels[0];
+    auto projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<glm::vec3> centers(instanceCount);
+    for (auto& center : centers)
+        center = glm::vec3((dist(rng) - 0.5f) * 40.0f, (dist(rng) - 0.5f) * 20.0f, -2.0f - dist(rng) * 398.0f);
+
+    // the camera zooms in and out by 10%, so that the instances keep crossing the scales where the levels swap
+    auto run = [&](const LodSettings& settings, size_t* switches, std::vector<size_t>* histogram) {
+        std::vector<uint32_t> current(instanceCount, 0);
+        double selectMs = 1e30;
+        *switches = 0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            auto frameProjection = projection;
+            float zoom = 1.0f + 0.1f * std::sin(frame * 0.7f);
+            frameProjection[0][0] *= zoom;
+            frameProjection[1][1] *= zoom;
+            BenchTimer timer;
+            for (size_t i = 0; i < instanceCount; i++)
+            {
+                auto modelView = glm::translate(glm::mat4(1.0f), centers[i]);
+                float scale = getLodPixelScale(modelView, frameProjection, 1080.0f, glm::vec3(-1.0f), glm::vec3(1.0f));
+                uint32_t level = selectLod(levels.data(), levels.size(), current[i], scale, settings);
+                *switches += frame > 0 && level != current[i] ? 1 : 0;
+                current[i] = level;
+            }
+            selectMs = std::min(selectMs, timer.getMilliseconds());
+        }
+        histogram->assign(levels.size(), 0);
+        for (uint32_t level : current)
+            (*histogram)[level]++;
+        return selectMs;
+    };
+
+    LodSettings settings;
+    size_t switches, flickers;
+    std::vector<size_t> histogram, unused;
+    double selectMs = run(settings, &switches, &histogram);
+    settings.hysteresis = 0;
+    run(settings, &flickers, &unused);
+
+    size_t lodTriangles = 0;
+    printf("%zu spheres per level:", instanceCount);
+    for (size_t l = 0; l < levels.size(); l++)
+    {
+        printf(" %zu", histogram[l]);
+        lodTriangles += histogram[l] * (levels[l].indexCount / 3);
+    }
+    size_t fullTriangles = instanceCount * (levels[0].indexCount / 3);
+    printf("\n%zu triangles per frame with levels of detail, %zu without (%.1fx fewer)\n", lodTriangles, fullTriangles,
+           (double)fullTriangles / std::max<size_t>(1, lodTriangles));
+    printf("selection %.3f ms per frame, %zu level switches over %d zooming frames, %zu without hysteresis\n",
+           selectMs, switches, frames, flickers);
+
+    if (failures)
+    {
+        printf("lod: %d levels with cracks or an error beyond their estimate\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "BenchUtils.h"
+#include "MeshoptDecoder.h"
+#include "cigltf.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace melo;
+
+// Decoding throughput of every EXT_meshopt_compression bufferView in a model, SIMD against the scalar reference.
+// Compare the load times with gltf-load on the uncompressed file.
+int benchMeshopt(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        printf("gltf-meshopt: missing model path\n");
+        return 1;
+    }
+    std::string path = argv[0];
+
+    ModelGLTF::Option option;
+    option.loadTextures = false;
+    option.mapBuffers = true;
+    BenchTimer loadTimer;
+    auto model = ModelGLTF::create(path, option);
+    double loadMs = loadTimer.getMilliseconds();
+    if (!model)
+    {
+        printf("gltf-meshopt: failed to load %s\n", path.c_str());
+        return 1;
+    }
+    printf("ModelGLTF::create %.2f ms (mapped, decoding included)\n", loadMs);
+
+    struct View
+    {
+        MeshoptBufferView meshopt;
+        std::string name;
+    };
+    std::vector<View> views;
+    size_t maxSize = 0;
+    for (auto& bufferView : model->property.bufferViews)
+    {
+        auto it = bufferView.extensions.find("EXT_meshopt_compression");
+        if (it == bufferView.extensions.end())
+            continue;
+        const auto& extension = it->second;
+        View view;
+        auto mode = extension.Get("mode").Get<std::string>();
+        auto filter = extension.Get("filter").IsString() ? extension.Get("filter").Get<std::string>() : "NONE";
+        view.meshopt.mode = getMeshoptMode(mode.c_str());
+        view.meshopt.filter = getMeshoptFilter(filter.c_str());
+        view.meshopt.count = (size_t)extension.Get("count").GetNumberAsDouble();
+        view.meshopt.byteStride = (size_t)extension.Get("byteStride").GetNumberAsDouble();
+        view.meshopt.byteLength = (size_t)extension.Get("byteLength").GetNumberAsDouble();
+        size_t byteOffset = extension.Has("byteOffset") ? (size_t)extension.Get("byteOffset").GetNumberAsDouble() : 0;
+        auto& source = model->buffers[extension.Get("buffer").GetNumberAsInt()]->cpuBuffer;
+        view.meshopt.data = (const uint8_t*)source->getData() + byteOffset;
+        view.name = mode + " " + filter + " stride " + std::to_string(view.meshopt.byteStride);
+        maxSize = std::max(maxSize, view.meshopt.count * view.meshopt.byteStride);
+        views.push_back(view);
+    }
+    if (views.empty())
+    {
+        printf("gltf-meshopt: %s has no EXT_meshopt_compression bufferViews\n", path.c_str());
+        return 1;
+    }
+
+    std::vector<uint8_t> decoded(maxSize);
+    std::vector<uint8_t> reference(maxSize);
+    auto bestOf = [](auto func) {
+        double best = 1e30;
+        for (int run = 0; run < 5; run++)
+        {
+            BenchTimer timer;
+            func();
+            best = std::min(best, timer.getMilliseconds());
+        }
+        return best;
+    };
+
+    printf("%-36s %10s %10s %12s %12s %12s\n", "bufferView", "MB in", "MB out", "scalar GB/s", "simd GB/s",
+           "memcpy GB/s");
+    double totalScalar = 0, totalSimd = 0;
+    size_t totalOut = 0;
+    for (auto& view : views)
+    {
+        const auto& meshopt = view.meshopt;
+        size_t size = meshopt.count * meshopt.byteStride;
+        bool ok = true;
+        double scalarMs = bestOf([&] {
+            if (meshopt.mode == MESHOPT_MODE_ATTRIBUTES)
+            {
+                ok &= decodeVertexBufferScalar(reference.data(), meshopt.count, meshopt.byteStride, meshopt.data,
+                                               meshopt.byteLength);
+                decodeFilterScalar(meshopt.filter, reference.data(), meshopt.count, meshopt.byteStride);
+            }
+            else
+            {
+                // the index codecs are sequential, there is a single implementation
+                ok &= decodeMeshopt(meshopt, reference.data());
+            }
+        });
+        double simdMs = bestOf([&] { ok &= decodeMeshopt(meshopt, decoded.data()); });
+        double copyMs = bestOf([&] { memcpy(decoded.data(), reference.data(), size); });
+        // the memcpy above clobbered it
+        decodeMeshopt(meshopt, decoded.data());
+
+        if (!ok || memcmp(decoded.data(), reference.data(), size) != 0)
+        {
+            printf("gltf-meshopt: %s doesn't match the scalar reference\n", view.name.c_str());
+            return 1;
+        }
+        printf("%-36s %10.2f %10.2f %12.2f %12.2f %12.2f\n", view.name.c_str(), toMB(meshopt.byteLength), toMB(size),
+               size / (scalarMs * 1e-3) / 1e9, size / (simdMs * 1e-3) / 1e9, size / (copyMs * 1e-3) / 1e9);
+        totalScalar += scalarMs;
+        totalSimd += simdMs;
+        totalOut += size;
+    }
+    printf("%-36s %10s %10.2f %12.2f %12.2f\n", "total", "", toMB(totalOut), totalOut / (totalScalar * 1e-3) / 1e9,
+           totalOut / (totalSimd * 1e-3) / 1e9);
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include "BenchUtils.h"
+#include "cigltf.h"
+#include "AccessorReader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace melo;
+
+// every target kept as vertexCount deltas, blended over every vertex
+struct DenseTargets
+{
+    std::vector<std::vector<glm::vec3>> positionDeltas;
+    std::vector<std::vector<glm::vec3>> normalDeltas;
+
+    void apply(const float* weights, const std::vector<glm::vec3>& basePositions,
+               const std::vector<glm::vec3>& baseNormals, std::vector<glm::vec3>* positions,
+               std::vector<glm::vec3>* normals, bool skipZeroWeights) const
+    {
+        *positions = basePositions;
+        *normals = baseNormals;
+        for (size_t t = 0; t < positionDeltas.size(); t++)
+        {
+            float weight = weights[t];
+            if (skipZeroWeights && weight == 0)
+                continue;
+            const glm::vec3* dp = positionDeltas[t].data();
+            const glm::vec3* dn = normalDeltas[t].data();
+            glm::vec3* p = positions->data();
+            glm::vec3* n = normals->data();
+            for (size_t v = 0; v < basePositions.size(); v++)
+            {
+                p[v] += weight * dp[v];
+                n[v] += weight * dn[v];
+            }
+        }
+    }
+
+    size_t getMemorySize() const
+    {
+        size_t vertexCount = positionDeltas.empty() ? 0 : positionDeltas[0].size();
+        return positionDeltas.size() * 2 * vertexCount * sizeof(glm::vec3);
+    }
+};
+
+static float getMaxError(const std::vector<glm::vec3>& values, const std::vector<glm::vec3>& reference)
+{
+    float maxError = 0;
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        glm::vec3 d = glm::abs(values[i] - reference[i]);
+        maxError = std::max(maxError, std::max(d.x, std::max(d.y, d.z)));
+    }
+    return maxError;
+}
+
+// blends every morphed primitive of a model with all of its weights at 0.5
+static int benchModelMorph(const std::string& path)
+{
+    ModelGLTF::Option option;
+    option.loadTextures = false;
+    auto model = ModelGLTF::create(path, option);
+    if (!model)
+    {
+        printf("morph: failed to load %s\n", path.c_str());
+        return 1;
+    }
+
+    int morphedCount = 0;
+    for (auto& mesh : model->meshes)
+    {
+        for (auto& primitive : mesh->primitives)
+        {
+            if (!primitive->isMorphed())
+                continue;
+            const auto& targets = primitive->morphTargets;
+            std::vector<float> weights(targets->getTargetCount(), 0.5f);
+            primitive->morph(weights.data(), weights.size());
+            double best = 1e30;
+            for (int i = 0; i < 5; i++)
+            {
+                primitive->morphedWeights.clear();
+                BenchTimer timer;
+                primitive->morph(weights.data(), weights.size());
+                best = std::min(best, timer.getMilliseconds());
+            }
+            size_t denseBytes = targets->getTargetCount() * targets->getVertexCount() * 2 * sizeof(glm::vec3);
+            printf("%-24s %8zu vertices %4zu targets %10zu deltas %8.2f / %8.2f MB %8.3f ms\n",
+                   mesh->property->name.c_str(), targets->getVertexCount(), targets->getTargetCount(),
+                   targets->getDeltaCount(), toMB(targets->getMemorySize()), toMB(denseBytes), best);
+            morphedCount++;
+        }
+    }
+    if (morphedCount == 0)
+        printf("morph: %s has no morph target\n", path.c_str());
+
+    // a playing animation has to reach the node weights through the scene update
+    for (auto& animation : model->animations)
+    {
+        model->playAnimation(animation);
+        model->playingAnimation->animTime = (animation->start + animation->end) * 0.5f;
+        model->treeUpdate(0.0);
+        for (auto& channel : animation->channels)
+        {
+            const auto& sampler = animation->samplers[channel.samplerIndex];
+            if (channel.path != AnimationChannel::PathType::WEIGHTS || !sampler.isValid())
+                continue;
+            std::vector<float> expected(sampler.weightCount);
+            size_t cursor = 0;
+            sampler.sampleWeights(animation->animTime, &cursor, expected.data());
+            if (model->nodes[channel.node]->weights != expected)
+            {
+                printf("morph: %s doesn't update the weights of node %d\n", animation->name.c_str(), channel.node);
+                return 1;
+            }
+        }
+    }
+    model->playAnimation({});
+    return 0;
+}
+
+// melo::MorphTargets (sparse spans, zero weights skipped) against dense per vertex blending
+int benchMorph(int argc, char** argv)
+{
+    if (argc >= 1 && argv[0][0] != '-')
+        return benchModelMorph(argv[0]);
+
+    size_t vertexCount = (size_t)atoll(getArg(argc, argv, "--vertices", "50000"));
+    size_t targetCount = (size_t)atoll(getArg(argc, argv, "--targets", "64"));
+    size_t activeCount = std::min(targetCount, (size_t)atoll(getArg(argc, argv, "--active", "8")));
+    float coverage = (float)atof(getArg(argc, argv, "--coverage", "0.05"));
+
+    // every target moves ~70% of the vertices of a region covering `coverage` of the mesh, like facial blend
+    // shapes moving a brow or a lip
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<glm::vec3> basePositions(vertexCount), baseNormals(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        basePositions[v] = glm::vec3(dist(rng), dist(rng), dist(rng));
+        baseNormals[v] = glm::normalize(glm::vec3(dist(rng), dist(rng), dist(rng)));
+    }
+
+    DenseTargets dense;
+    auto sparse = MorphTargets::create(vertexCount);
+    size_t regionSize = std::max<size_t>(1, (size_t)(vertexCount * coverage));
+    std::uniform_int_distribution<size_t> regionStart(0, vertexCount - regionSize);
+    for (size_t t = 0; t < targetCount; t++)
+    {
+        std::vector<glm::vec3> positionDeltas(vertexCount), normalDeltas(vertexCount);
+        size_t first = regionStart(rng);
+        for (size_t v = first; v < first + regionSize; v++)
+        {
+            if (unit(rng) > 0.7f)
+                continue;
+            positionDeltas[v] = 0.05f * glm::vec3(dist(rng), dist(rng), dist(rng));
+            normalDeltas[v] = 0.1f * glm::vec3(dist(rng), dist(rng), dist(rng));
+        }
+        sparse->addTarget(positionDeltas.data(), normalDeltas.data());
+        dense.positionDeltas.push_back(std::move(positionDeltas));
+        dense.normalDeltas.push_back(std::move(normalDeltas));
+    }
+
+    std::vector<float> weights(targetCount, 0.0f), allWeights(targetCount);
+    for (size_t t = 0; t < targetCount; t++)
+        allWeights[t] = unit(rng);
+    for (size_t i = 0; i < activeCount; i++)
+        weights[(i * targetCount) / activeCount] = allWeights[i];
+
+    size_t spanCount = 0;
+    for (size_t t = 0; t < targetCount; t++)
+        spanCount += sparse->getTarget(t).spans.size();
+    printf("simd: %s, %zu vertices, %zu targets (%zu active), %zu deltas in %zu spans\n", getSimdName(), vertexCount,
+           targetCount, activeCount, sparse->getDeltaCount(), spanCount);
+    printf("memory: dense %.2f MB, sparse %.2f MB\n", toMB(dense.getMemorySize()), toMB(sparse->getMemorySize()));
+
+    std::vector<glm::vec3> referencePositions, referenceNormals, positions(vertexCount), normals(vertexCount);
+    auto best = [](const std::function<void()>& func) {
+        double ms = 1e30;
+        for (int i = 0; i < 5; i++)
+        {
+            BenchTimer timer;
+            func();
+            ms = std::min(ms, timer.getMilliseconds());
+        }
+        return ms;
+    };
+
+    printf("%-24s %12s %14s\n", "", "ms", "max error");
+    int result = 0;
+    for (const auto* w : {&weights, &allWeights})
+    {
+        const char* label = (w == &weights) ? "active" : "all";
+        double denseMs = best([&] {
+            dense.apply(w->data(), basePositions, baseNormals, &referencePositions, &referenceNormals, false);
+        });
+        double denseSkipMs = best([&] {
+            dense.apply(w->data(), basePositions, baseNormals, &referencePositions, &referenceNormals, true);
+        });
+        double sparseMs = best([&] {
+            sparse->apply(w->data(), w->size(), basePositions.data(), baseNormals.data(), positions.data(),
+                          normals.data());
+        });
+        float error = std::max(getMaxError(positions, referencePositions), getMaxError(normals, referenceNormals));
+        printf("%-24s %12.3f\n", (std::string("dense, ") + label).c_str(), denseMs);
+        printf("%-24s %12.3f\n", (std::string("dense skip zero, ") + label).c_str(), denseSkipMs);
+        printf("%-24s %12.3f %14g\n", (std::string("sparse, ") + label).c_str(), sparseMs, error);
+        if (error > 1e-5f)
+        {
+            printf("morph: sparse blending doesn't match dense\n");
+            result = 1;
+        }
+    }
+    return result;
+}
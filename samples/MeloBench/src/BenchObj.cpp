@@ -0,0 +1,466 @@
+#include "BenchUtils.h"
+#include "JobSystem.h"
+#include "MeshGeometry.h"
+#include "ObjMesh.h"
+#include "ObjParser.h"
+#include "VertexCache.h"
+#include "../../../3rdparty/yocto/yocto_modelio.h"
+#include "../../../3rdparty/yocto/yocto_scene.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+using namespace melo;
+
+// a height field scan as photogrammetry tools write it: every vertex with its own texcoord and normal, the
+// texture atlas cut into charts whose border vertices get one texcoord per chart. With mtllib the lower and upper
+// halves use two materials of that library, with relative the faces count back from the last vertex.
+static std::string makeScanObj(uint32_t size, uint32_t chart, const char* mtllib = nullptr, bool relative = false)
+{
+    std::ostringstream obj;
+    obj.precision(6);
+    if (mtllib)
+        obj << "mtllib " << mtllib << "\ng scan\n";
+    auto height = [](float x, float y) { return 0.05f * std::sin(x * 17.0f) * std::cos(y * 13.0f); };
+    for (uint32_t y = 0; y <= size; y++)
+    {
+        for (uint32_t x = 0; x <= size; x++)
+        {
+            float fx = (float)x / size, fy = (float)y / size;
+            obj << "v " << fx << ' ' << height(fx, fy) << ' ' << fy << '\n';
+        }
+    }
+    for (uint32_t y = 0; y <= size; y++)
+    {
+        for (uint32_t x = 0; x <= size; x++)
+            obj << "vn 0 1 0\n";
+    }
+    // texcoords of the grid within each chart, (chart + 1)^2 per chart
+    uint32_t charts = (size + chart - 1) / chart;
+    for (uint32_t c = 0; c < charts * charts; c++)
+    {
+        for (uint32_t y = 0; y <= chart; y++)
+        {
+            for (uint32_t x = 0; x <= chart; x++)
+                obj << "vt " << (float)((c % charts) * chart + x) / size << ' ' << (float)((c / charts) * chart + y) / size << '\n';
+        }
+    }
+
+    int64_t vertexCount = (int64_t)(size + 1) * (size + 1);
+    int64_t texcoordCount = (int64_t)charts * charts * (chart + 1) * (chart + 1);
+    auto corner = [&](uint32_t x, uint32_t y, uint32_t cx, uint32_t cy) {
+        int64_t vertex = y * (size + 1) + x + 1;
+        int64_t texcoord = (cy * charts + cx) * (chart + 1) * (chart + 1) + (y - cy * chart) * (chart + 1) + (x - cx * chart) + 1;
+        if (relative)
+            obj << ' ' << vertex - vertexCount - 1 << '/' << texcoord - texcoordCount - 1 << '/' << vertex - vertexCount - 1;
+        else
+            obj << ' ' << vertex << '/' << texcoord << '/' << vertex;
+    };
+    for (uint32_t y = 0; y < size; y++)
+    {
+        if (mtllib && (y == 0 || y == size / 2))
+            obj << "usemtl " << (y == 0 ? "lower" : "upper") << '\n';
+        for (uint32_t x = 0; x < size; x++)
+        {
+            uint32_t cx = x / chart, cy = y / chart;
+            obj << 'f';
+            corner(x, y, cx, cy);
+            corner(x, y + 1, cx, cy);
+            corner(x + 1, y + 1, cx, cy);
+            obj << "\nf";
+            corner(x, y, cx, cy);
+            corner(x + 1, y + 1, cx, cy);
+            corner(x + 1, y, cx, cy);
+            obj << '\n';
+        }
+    }
+    return obj.str();
+}
+
+static std::string getScanObjPath()
+{
+    return (std::filesystem::temp_directory_path() / "melobench_scan.obj").string();
+}
+
+// makeScanObj with its two materials as files in the temp directory, returns the path of the obj
+static std::string writeScanObj(uint32_t size, bool relative)
+{
+    std::string path = getScanObjPath();
+    std::ofstream((std::filesystem::temp_directory_path() / "melobench_scan.mtl").string())
+        << "newmtl lower\nKd 0.8 0.6 0.4\nnewmtl upper\nKd 0.4 0.6 0.8\n";
+    std::ofstream(path, std::ios::binary) << makeScanObj(size, 64, "melobench_scan.mtl", relative);
+    return path;
+}
+
+static size_t getVertexCount(const std::vector<ObjSubmesh>& submeshes)
+{
+    size_t count = 0;
+    for (const auto& submesh : submeshes)
+        count += submesh.positions.size();
+    return count;
+}
+
+static size_t getBytes(const std::vector<ObjSubmesh>& submeshes)
+{
+    size_t bytes = 0;
+    for (const auto& submesh : submeshes)
+        bytes += submesh.getVertexBytes() + submesh.getIndexBytes();
+    return bytes;
+}
+
+static float getAcmr(const std::vector<ObjSubmesh>& submeshes)
+{
+    size_t misses = 0, triangles = 0;
+    for (const auto& submesh : submeshes)
+    {
+        misses += analyzeVertexCache(submesh.indices.data(), submesh.indices.size(), submesh.positions.size())
+                      .vertexTransforms;
+        triangles += submesh.indices.size() / 3;
+    }
+    return triangles ? (float)misses / triangles : 0.0f;
+}
+
+// every corner of the indexed submeshes reads what it read before deduplication
+static bool sameCorners(const std::vector<ObjSubmesh>& a, const std::vector<ObjSubmesh>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t s = 0; s < a.size(); s++)
+    {
+        const auto &x = a[s], &y = b[s];
+        if (x.material != y.material || x.indices.size() != y.indices.size() ||
+            x.normals.empty() != y.normals.empty() || x.texcoords.empty() != y.texcoords.empty() ||
+            x.colors.empty() != y.colors.empty())
+            return false;
+        for (size_t i = 0; i < x.indices.size(); i++)
+        {
+            uint32_t u = x.indices[i], v = y.indices[i];
+            if (memcmp(&x.positions[u], &y.positions[v], sizeof(glm::vec3)) != 0 ||
+                (!x.normals.empty() && memcmp(&x.normals[u], &y.normals[v], sizeof(glm::vec3)) != 0) ||
+                (!x.texcoords.empty() && memcmp(&x.texcoords[u], &y.texcoords[v], sizeof(glm::vec2)) != 0) ||
+                (!x.colors.empty() && memcmp(&x.colors[u], &y.colors[v], sizeof(glm::vec3)) != 0))
+                return false;
+        }
+    }
+    return true;
+}
+
+// MeshObj::create's submeshes with a vertex per corner and with deduplicated corners: vertex counts, bytes, ACMR
+// and time, for model.obj or a synthetic scan. Checks that every corner keeps its attributes.
+int benchObjIndex(int argc, char** argv)
+{
+    const char* path = argc > 0 && argv[0][0] != '-' ? argv[0] : nullptr;
+    uint32_t size = (uint32_t)atoi(getArg(argc, argv, "--size", "512"));
+
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    BenchTimer timer;
+    bool loaded;
+    if (path)
+    {
+        std::string baseDir = path;
+        baseDir = baseDir.substr(0, baseDir.find_last_of("/\\") + 1);
+        loaded = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path, baseDir.c_str());
+    }
+    else
+    {
+        std::istringstream stream(makeScanObj(size, 64));
+        loaded = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream);
+    }
+    if (!loaded)
+    {
+        printf("obj-index: %s\n", err.c_str());
+        return 1;
+    }
+    printf("%s: %zu shapes, %zu positions, %zu normals, %zu texcoords, parsed in %.1f ms\n",
+           path ? path : "synthetic scan", shapes.size(), attrib.vertices.size() / 3, attrib.normals.size() / 3,
+           attrib.texcoords.size() / 2, timer.getMilliseconds());
+
+    size_t corners = 0, vertices[2] = {}, bytes[2] = {};
+    double ms[2] = {};
+    float acmr[2] = {};
+    size_t triangles = 0;
+    int errors = 0;
+    for (const auto& shape : shapes)
+    {
+        std::vector<ObjSubmesh> results[2];
+        for (int dedup = 0; dedup < 2; dedup++)
+        {
+            timer.reset();
+            results[dedup] = buildObjSubmeshes(attrib, shape, dedup == 1);
+            ms[dedup] += timer.getMilliseconds();
+            vertices[dedup] += getVertexCount(results[dedup]);
+            bytes[dedup] += getBytes(results[dedup]);
+            acmr[dedup] += getAcmr(results[dedup]) * (shape.mesh.indices.size() / 3);
+        }
+        corners += shape.mesh.indices.size();
+        triangles += shape.mesh.indices.size() / 3;
+        if (!sameCorners(results[0], results[1]))
+        {
+            printf("obj-index: the corners of shape %s changed\n", shape.name.c_str());
+            errors++;
+        }
+    }
+
+    printf("%zu corners                vertices       MB     ACMR       ms\n", corners);
+    const char* names[2] = {"a vertex per corner", "deduplicated"};
+    for (int i = 0; i < 2; i++)
+    {
+        printf("  %-22s %10zu %8.1f %8.3f %8.1f\n", names[i], vertices[i], toMB(bytes[i]),
+               triangles ? acmr[i] / triangles : 0.0f, ms[i]);
+    }
+    printf("%.2fx fewer vertices, %.2fx less memory\n", vertices[1] ? (double)vertices[0] / vertices[1] : 0.0,
+           bytes[1] ? (double)bytes[0] / bytes[1] : 0.0);
+    printf("%d errors\n", errors);
+    return errors ? 1 : 0;
+}
+
+static bool sameFloats(const std::vector<float>& a, const std::vector<float>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        // tinyobj's own float parser may be an ulp off the correctly rounded value
+        if (std::abs(a[i] - b[i]) > 1e-6f * std::max(1.0f, std::abs(a[i])))
+            return false;
+    }
+    return true;
+}
+
+// melo::loadObj against tinyobj::LoadObj: the same arrays, shapes and material ids
+static int compareObj(const std::string& path)
+{
+    std::string baseDir = path.substr(0, path.find_last_of("/\\") + 1);
+    tinyobj::attrib_t attribs[2];
+    std::vector<tinyobj::shape_t> shapes[2];
+    std::vector<tinyobj::material_t> materials[2];
+    std::string warn, err;
+    if (!tinyobj::LoadObj(&attribs[0], &shapes[0], &materials[0], &warn, &err, path.c_str(), baseDir.c_str()) ||
+        !loadObj(&attribs[1], &shapes[1], &materials[1], &warn, &err, path, baseDir))
+    {
+        printf("obj-parse: %s\n", err.c_str());
+        return 1;
+    }
+
+    int errors = 0;
+    auto check = [&](bool same, const char* what) {
+        if (!same)
+        {
+            printf("obj-parse: different %s\n", what);
+            errors++;
+        }
+    };
+    check(sameFloats(attribs[0].vertices, attribs[1].vertices), "positions");
+    check(sameFloats(attribs[0].normals, attribs[1].normals), "normals");
+    check(sameFloats(attribs[0].texcoords, attribs[1].texcoords), "texcoords");
+    check(sameFloats(attribs[0].colors, attribs[1].colors), "colors");
+    check(materials[0].size() == materials[1].size(), "materials");
+    check(shapes[0].size() == shapes[1].size(), "shape counts");
+    for (size_t s = 0; s < std::min(shapes[0].size(), shapes[1].size()); s++)
+    {
+        const auto &a = shapes[0][s].mesh, &b = shapes[1][s].mesh;
+        check(shapes[0][s].name == shapes[1][s].name, "shape names");
+        check(a.material_ids == b.material_ids, "material ids");
+        check(a.smoothing_group_ids == b.smoothing_group_ids, "smoothing groups");
+        // tinyobj clips ears off polygons where melo makes fans, only triangles match corner for corner
+        bool triangles = a.num_face_vertices == b.num_face_vertices;
+        check(a.indices.size() == b.indices.size(), "corner counts");
+        if (triangles && a.indices.size() == b.indices.size())
+        {
+            check(memcmp(a.indices.data(), b.indices.data(), a.indices.size() * sizeof(tinyobj::index_t)) == 0,
+                  "corners");
+        }
+    }
+    printf("%d errors\n", errors);
+    return errors ? 1 : 0;
+}
+
+// Load time, throughput and peak memory of the OBJ loaders, for model.obj or a synthetic scan of --size^2 quads:
+// tinyobj::LoadObj as ModelObj::create used it, yocto::load_obj as load_scene uses it, melo::loadObj and
+// melo::loadObjScene. Then checks melo::loadObj against tinyobj.
+int benchObjParse(int argc, char** argv)
+{
+    const char* model = argc > 0 && argv[0][0] != '-' ? argv[0] : nullptr;
+    std::string mode = getArg(argc, argv, "--mode", "");
+    std::string path;
+    if (model)
+    {
+        path = model;
+    }
+    else if (mode.empty())
+    {
+        uint32_t size = (uint32_t)atoi(getArg(argc, argv, "--size", "1024"));
+        path = writeScanObj(size, hasArg(argc, argv, "--relative"));
+    }
+    else
+    {
+        path = getScanObjPath();
+    }
+
+    if (mode.empty())
+    {
+        printf("%s: %.1f MB\n", path.c_str(), toMB(std::filesystem::file_size(path)));
+        printf("%-12s %12s %10s %12s\n", "mode", "load (ms)", "MB/s", "peak (MB)");
+        for (const char* each : {"tinyobj", "yocto", "melo", "melo-scene"})
+            runBenchProcess("obj-parse \"" + path + "\" --mode " + each);
+        return compareObj(path);
+    }
+
+    std::string baseDir = path.substr(0, path.find_last_of("/\\") + 1);
+    size_t baseline = getPeakMemory();
+    BenchTimer timer;
+    size_t vertices = 0;
+    bool loaded = false;
+    std::string error;
+    if (mode == "tinyobj" || mode == "melo")
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn;
+        if (mode == "tinyobj")
+            loaded = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &error, path.c_str(), baseDir.c_str());
+        else
+            loaded = loadObj(&attrib, &shapes, &materials, &warn, &error, path, baseDir);
+        vertices = attrib.vertices.size() / 3;
+    }
+    else if (mode == "yocto")
+    {
+        yocto::obj_model obj;
+        loaded = yocto::load_obj(path, obj, error, false, true);
+        for (const auto& shape : obj.shapes)
+            vertices += shape.positions.size();
+    }
+    else if (mode == "melo-scene")
+    {
+        yocto::scene_scene scene;
+        std::vector<std::string> texturePaths;
+        loaded = loadObjScene(path, scene, error, &texturePaths);
+        for (const auto& shape : scene.shapes)
+            vertices += shape.positions.size();
+    }
+    double ms = timer.getMilliseconds();
+    if (!loaded)
+    {
+        printf("obj-parse: %s\n", error.c_str());
+        return 1;
+    }
+    printf("%-12s %12.1f %10.1f %12.1f  (%zu vertices)\n", mode.c_str(), ms,
+           toMB(std::filesystem::file_size(path)) / (ms / 1000.0), toMB(getPeakMemory() - baseline), vertices);
+    return 0;
+}
+
+// MeshObj::create's geometry jobs on the synthetic scan with its normals dropped: computeMeshGeometry on every
+// submesh serially and as one job per submesh. Checks unit normals and tangents, tangents orthogonal to the normals
+// and along dP/du, w = -1 (u along x and v along z make cross(n, t) point at -v), the normals against the height
+// field's and the bounds.
+int benchObjGeometry(int argc, char** argv)
+{
+    uint32_t size = (uint32_t)atoi(getArg(argc, argv, "--size", "1024"));
+    std::string path = writeScanObj(size, false);
+    std::string baseDir = path.substr(0, path.find_last_of("/\\") + 1);
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    if (!loadObj(&attrib, &shapes, &materials, &warn, &err, path, baseDir))
+    {
+        printf("obj-geometry: %s\n", err.c_str());
+        return 1;
+    }
+    std::vector<ObjSubmesh> submeshes;
+    for (const auto& shape : shapes)
+    {
+        for (auto& submesh : buildObjSubmeshes(attrib, shape))
+            submeshes.push_back(std::move(submesh));
+    }
+    size_t vertices = getVertexCount(submeshes), triangles = 0;
+    for (const auto& submesh : submeshes)
+        triangles += submesh.indices.size() / 3;
+    auto jobs = JobSystem::getDefault();
+    printf("synthetic scan: %zu submeshes, %zu vertices, %zu triangles, %zu threads\n", submeshes.size(), vertices,
+           triangles, jobs->getThreadCount());
+
+    struct Geometry
+    {
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec4> tangents;
+        glm::vec3 boundsMin, boundsMax;
+    };
+    std::vector<Geometry> geometries(submeshes.size());
+    auto compute = [&](size_t i) {
+        const auto& submesh = submeshes[i];
+        auto& geometry = geometries[i];
+        geometry.normals.clear();
+        computeMeshGeometry(submesh.positions.data(), submesh.positions.size(), submesh.indices.data(),
+                            submesh.indices.size(), submesh.texcoords.data(), &geometry.normals, &geometry.tangents,
+                            &geometry.boundsMin, &geometry.boundsMax);
+    };
+
+    printf("%-10s %10s %14s\n", "mode", "ms", "Mvertices/s");
+    for (const char* mode : {"serial", "parallel"})
+    {
+        BenchTimer timer;
+        if (strcmp(mode, "serial") == 0)
+        {
+            for (size_t i = 0; i < submeshes.size(); i++)
+                compute(i);
+        }
+        else
+        {
+            std::vector<JobRef> geometryJobs;
+            for (size_t i = 0; i < submeshes.size(); i++)
+                geometryJobs.push_back(jobs->add([&compute, i] { compute(i); }));
+            jobs->wait(geometryJobs);
+        }
+        double ms = timer.getMilliseconds();
+        printf("%-10s %10.1f %14.1f\n", mode, ms, vertices / 1000.0 / ms);
+    }
+
+    int errors = 0;
+    auto check = [&](bool ok, const char* what, size_t vertex) {
+        if (!ok && errors++ < 8)
+            printf("obj-geometry: %s at vertex %zu\n", what, vertex);
+    };
+    for (size_t i = 0; i < submeshes.size(); i++)
+    {
+        const auto& submesh = submeshes[i];
+        const auto& geometry = geometries[i];
+        for (size_t v = 0; v < submesh.positions.size(); v++)
+        {
+            // the scan is (x, h(x, y), y), its normal is along (-dh/dx, 1, -dh/dy)
+            const glm::vec3& p = submesh.positions[v];
+            float dx = 0.05f * 17.0f * std::cos(p.x * 17.0f) * std::cos(p.z * 13.0f);
+            float dy = -0.05f * 13.0f * std::sin(p.x * 17.0f) * std::sin(p.z * 13.0f);
+            glm::vec3 expected = glm::normalize(glm::vec3(-dx, 1.0f, -dy));
+            glm::vec3 alongU = glm::normalize(glm::vec3(1.0f, dx, 0.0f));
+            glm::vec3 n = geometry.normals[v];
+            glm::vec3 t(geometry.tangents[v].x, geometry.tangents[v].y, geometry.tangents[v].z);
+            check(std::abs(glm::length(n) - 1) < 1e-3f, "normal not unit length", v);
+            check(std::abs(glm::length(t) - 1) < 1e-3f, "tangent not unit length", v);
+            check(std::abs(glm::dot(n, t)) < 1e-3f, "tangent not orthogonal to the normal", v);
+            check(std::abs(glm::dot(n, expected)) > 0.99f, "normal off the height field's", v);
+            check(glm::dot(t, alongU) > 0.99f, "tangent not along u", v);
+            check(geometry.tangents[v].w == -1.0f, "wrong bitangent sign", v);
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float lower = submesh.positions[0][axis], upper = lower;
+            for (const auto& p : submesh.positions)
+            {
+                lower = std::min(lower, p[axis]);
+                upper = std::max(upper, p[axis]);
+            }
+            check(geometry.boundsMin[axis] == lower && geometry.boundsMax[axis] == upper, "wrong bounds", 0);
+        }
+    }
+    printf("%d errors\n", errors);
+    return errors ? 1 : 0;
+}
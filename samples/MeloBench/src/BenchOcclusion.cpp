@@ -0,0 +1,237 @@
+#include "BenchUtils.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "Node.h"
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtx/transform.hpp>
+
+using namespace melo;
+
+// the unit box around the origin
+static const glm::vec3 kBoxPositions[] = {
+    {-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}, {-0.5f, 0.5f, -0.5f}, {0.5f, 0.5f, -0.5f},
+    {-0.5f, -0.5f, 0.5f},  {0.5f, -0.5f, 0.5f},  {-0.5f, 0.5f, 0.5f},  {0.5f, 0.5f, 0.5f},
+};
+static const uint32_t kBoxIndices[] = {
+    0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5,
+};
+
+// 1/w of the nearest wall at every pixel center, 0 where there is none: a ray per pixel against every triangle
+static std::vector<float> renderReference(const std::vector<NodeRef>& walls, const glm::mat4& viewProjection,
+                                          uint32_t width, uint32_t height)
+{
+    std::vector<glm::vec3> triangles;
+    for (const auto& wall : walls)
+    {
+        for (uint32_t index : kBoxIndices)
+            triangles.push_back(glm::vec3(wall->getWorldTransform() * glm::vec4(kBoxPositions[index], 1.0f)));
+    }
+
+    auto inverse = glm::inverse(viewProjection);
+    std::vector<float> depth((size_t)width * height, 0.0f);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            glm::vec2 ndc((x + 0.5f) / width * 2.0f - 1.0f, (y + 0.5f) / height * 2.0f - 1.0f);
+            glm::vec4 nearPoint = inverse * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+            glm::vec4 farPoint = inverse * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+            glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+            glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+            float nearest = FLT_MAX;
+            for (size_t i = 0; i < triangles.size(); i += 3)
+            {
+                // Moller-Trumbore, both sides
+                glm::vec3 edge1 = triangles[i + 1] - triangles[i], edge2 = triangles[i + 2] - triangles[i];
+                glm::vec3 p = glm::cross(direction, edge2);
+                float determinant = glm::dot(edge1, p);
+                if (std::abs(determinant) < 1e-12f)
+                    continue;
+                glm::vec3 s = origin - triangles[i];
+                float u = glm::dot(s, p) / determinant;
+                glm::vec3 q = glm::cross(s, edge1);
+                float v = glm::dot(direction, q) / determinant;
+                float t = glm::dot(edge2, q) / determinant;
+                if (u >= 0 && v >= 0 && u + v <= 1 && t >= 0 && t <= 1)
+                    nearest = std::min(nearest, t);
+            }
+            if (nearest < FLT_MAX)
+                depth[y * width + x] = 1.0f / (viewProjection * glm::vec4(origin + direction * nearest, 1.0f)).w;
+        }
+    }
+    return depth;
+}
+
+// nearest 1/w of a world box and the pixels its screen rectangle touches, false when it reaches the near plane
+static bool projectBox(const glm::mat4& viewProjection, const glm::vec3& boxMin, const glm::vec3& boxMax,
+                       uint32_t width, uint32_t height, float* nearest, int* rect)
+{
+    glm::vec2 rectMin(FLT_MAX), rectMax(-FLT_MAX);
+    *nearest = 0;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 clip = viewProjection * glm::vec4((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y,
+                                                    (corner & 4) ? boxMax.z : boxMin.z, 1.0f);
+        if (!(clip.w > 0) || clip.z < -clip.w)
+            return false;
+        glm::vec2 pixel((clip.x / clip.w * 0.5f + 0.5f) * width, (clip.y / clip.w * 0.5f + 0.5f) * height);
+        rectMin = glm::min(rectMin, pixel);
+        rectMax = glm::max(rectMax, pixel);
+        *nearest = std::max(*nearest, 1.0f / clip.w);
+    }
+    rect[0] = std::max(0, (int)std::floor(rectMin.x));
+    rect[1] = std::max(0, (int)std::floor(rectMin.y));
+    rect[2] = std::min((int)width - 1, (int)std::floor(rectMax.x));
+    rect[3] = std::min((int)height - 1, (int)std::floor(rectMax.y));
+    return true;
+}
+
+// walls standing around a camera that turns in place, among many small boxes. Compares the SSE2 depth buffer with
+// a ray traced one and checks that no box the occlusion culler hid can be seen between the walls.
+int benchOcclusion(int argc, char** argv)
+{
+    size_t count = (size_t)atoll(getArg(argc, argv, "--nodes", "20000"));
+    size_t wallCount = (size_t)atoll(getArg(argc, argv, "--walls", "48"));
+    uint32_t width = (uint32_t)atoi(getArg(argc, argv, "--width", "256"));
+    uint32_t height = (uint32_t)atoi(getArg(argc, argv, "--height", "128"));
+    int frames = std::max(1, atoi(getArg(argc, argv, "--frames", "8")));
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    auto root = Node::create();
+    auto occlusion = OcclusionCuller::create(width, height);
+    uint32_t wallShape = occlusion->addShape(kBoxPositions, 8, kBoxIndices, 36);
+    std::vector<NodeRef> walls;
+    for (size_t i = 0; i < wallCount; i++)
+    {
+        float angle = dist(rng) * 3.1415926f, distance = 12.0f + (dist(rng) + 1.0f) * 30.0f;
+        auto wall = Node::create();
+        wall->mBoundBoxMin = glm::vec3(-0.5f);
+        wall->mBoundBoxMax = glm::vec3(0.5f);
+        wall->setTransform(glm::translate(glm::vec3(std::cos(angle) * distance, 3.0f, std::sin(angle) * distance)) *
+                           glm::toMat4(glm::angleAxis(dist(rng) * 3.1415926f, glm::vec3(0, 1, 0))) *
+                           glm::scale(glm::vec3(16.0f, 6.0f, 0.5f)));
+        root->addChild(wall);
+        walls.push_back(wall);
+        occlusion->addOccluder(wallShape, wall);
+    }
+    std::vector<NodeRef> boxes;
+    for (size_t i = 0; i < count; i += 16)
+    {
+        float angle = dist(rng) * 3.1415926f, distance = 6.0f + (dist(rng) + 1.0f) * 90.0f;
+        auto group = Node::create();
+        group->setTransform(glm::translate(glm::vec3(std::cos(angle) * distance, 0, std::sin(angle) * distance)));
+        root->addChild(group);
+        for (size_t j = i; j < std::min(count, i + 16); j++)
+        {
+            auto box = Node::create();
+            box->mBoundBoxMin = glm::vec3(-0.5f);
+            box->mBoundBoxMax = glm::vec3(0.5f);
+            box->setTransform(glm::translate(glm::vec3(dist(rng) * 3.0f, 0.5f + (dist(rng) + 1.0f) * 2.0f, dist(rng) * 3.0f)));
+            group->addChild(box);
+            boxes.push_back(box);
+        }
+    }
+    root->treeUpdate();
+
+    auto jobs = JobSystem::getDefault();
+    auto frustum = FrustumCuller::create();
+    auto culler = FrustumCuller::create();
+    auto projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 300.0f);
+
+    printf("%zu boxes, %zu walls, %ux%u depth buffer, %zu + 1 threads, %d frames\n", boxes.size(), walls.size(),
+           occlusion->getWidth(), occlusion->getHeight(), jobs->getThreadCount(), frames);
+
+    double ms[4] = {1e30, 1e30, 1e30, 1e30};
+    size_t pixelCount = (size_t)occlusion->getWidth() * occlusion->getHeight();
+    size_t nearerPixels = 0, missedPixels = 0, falseHidden = 0, frustumVisible = 0, occluded = 0;
+    double depthError = 0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        float angle = frame * 6.2831853f / frames;
+        auto view = glm::lookAt(glm::vec3(0, 2, 0), glm::vec3(std::cos(angle), 1.95f, std::sin(angle)),
+                                glm::vec3(0, 1, 0));
+        auto viewProjection = projection * view;
+
+        BenchTimer timer;
+        occlusion->render(viewProjection, nullptr);
+        ms[0] = std::min(ms[0], timer.getMilliseconds());
+        timer.reset();
+        occlusion->render(viewProjection, jobs.get());
+        ms[1] = std::min(ms[1], timer.getMilliseconds());
+
+        timer.reset();
+        frustum->cull(root, viewProjection, jobs.get());
+        ms[2] = std::min(ms[2], timer.getMilliseconds());
+        timer.reset();
+        culler->cull(root, viewProjection, jobs.get(), occlusion.get());
+        ms[3] = std::min(ms[3], timer.getMilliseconds());
+
+        // pixel centers on a wall edge may fall either way, what matters is that the buffer is never nearer
+        auto reference = renderReference(walls, viewProjection, occlusion->getWidth(), occlusion->getHeight());
+        for (uint32_t y = 0; y < occlusion->getHeight(); y++)
+        {
+            for (uint32_t x = 0; x < occlusion->getWidth(); x++)
+            {
+                float depth = occlusion->getDepth(x, y), expected = reference[y * occlusion->getWidth() + x];
+                if (depth > expected * 1.001f + 1e-7f)
+                    nearerPixels++;
+                else if (depth < expected * 0.999f)
+                    missedPixels++;
+                else if (expected > 0)
+                    depthError = std::max(depthError, (double)std::abs(depth - expected) / expected);
+            }
+        }
+
+        // a hidden box must be behind the walls at every pixel center of its screen rectangle
+        for (const auto& box : boxes)
+        {
+            if (!frustum->isVisible(*box))
+                continue;
+            frustumVisible++;
+            if (culler->isVisible(*box))
+                continue;
+            occluded++;
+            glm::vec3 boxMin, boxMax;
+            transformBounds(box->getWorldTransform(), box->mBoundBoxMin, box->mBoundBoxMax, &boxMin, &boxMax);
+            float nearest;
+            int rect[4];
+            bool hidden = projectBox(viewProjection, boxMin, boxMax, occlusion->getWidth(), occlusion->getHeight(),
+                                     &nearest, rect);
+            for (int y = rect[1]; hidden && y <= rect[3]; y++)
+            {
+                for (int x = rect[0]; hidden && x <= rect[2]; x++)
+                    hidden = reference[y * occlusion->getWidth() + x] > nearest;
+            }
+            falseHidden += hidden ? 0 : 1;
+        }
+    }
+
+    const auto& stats = occlusion->getStats();
+    printf("%-28s %12.3f\n", "render() serial ms", ms[0]);
+    printf("%-28s %12.3f\n", "render() parallel ms", ms[1]);
+    printf("%-28s %12.3f\n", "frustum cull ms", ms[2]);
+    printf("%-28s %12.3f\n", "frustum + occlusion cull ms", ms[3]);
+    printf("last frame: %zu occluders, %zu triangles, %zu nodes occluded\n", stats.occluderCount, stats.triangleCount,
+           culler->getStats().occludedCount);
+    printf("%.1f%% of the boxes in the frustum occluded, %zu falsely\n", occluded * 100.0 / std::max<size_t>(1, frustumVisible),
+           falseHidden);
+    printf("pixels: %zu nearer, %zu farther than the reference of %zu, max depth error %.2e\n", nearerPixels,
+           missedPixels, pixelCount * frames, depthError);
+
+    if (falseHidden || nearerPixels > pixelCount * frames / 1000)
+    {
+        printf("occlusion: the depth buffer hides boxes the walls don't\n");
+        return 1;
+    }
+    return 0;
+}
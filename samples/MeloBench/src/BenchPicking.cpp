@@ -0,0 +1,264 @@
+#include "BenchUtils.h"
+#include "Node.h"
+#include "PickingScene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtx/transform.hpp>
+
+using namespace melo;
+
+struct BenchShape
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    glm::vec3 boundMin, boundMax;
+};
+
+// wavy grid patch of size x size quads over [-1, 1]
+static BenchShape createPatch(uint32_t size, float phase)
+{
+    BenchShape shape;
+    for (uint32_t y = 0; y <= size; y++)
+    {
+        for (uint32_t x = 0; x <= size; x++)
+        {
+            float u = x * 2.0f / size - 1.0f, v = y * 2.0f / size - 1.0f;
+            shape.positions.emplace_back(u, 0.2f * std::sin(u * 6.0f + phase) * std::cos(v * 5.0f - phase), v);
+        }
+    }
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            uint32_t i = y * (size + 1) + x;
+            shape.indices.insert(shape.indices.end(), {i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2});
+        }
+    }
+    shape.boundMin = shape.boundMax = shape.positions[0];
+    for (const auto& p : shape.positions)
+    {
+        shape.boundMin = glm::min(shape.boundMin, p);
+        shape.boundMax = glm::max(shape.boundMax, p);
+    }
+    return shape;
+}
+
+static bool intersectTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& p0,
+    const glm::vec3& p1, const glm::vec3& p2, float* distance)
+{
+    glm::vec3 edge1 = p1 - p0, edge2 = p2 - p0;
+    glm::vec3 pvec = glm::cross(direction, edge2);
+    float det = glm::dot(edge1, pvec);
+    if (det == 0)
+        return false;
+    float inverseDet = 1.0f / det;
+    glm::vec3 tvec = origin - p0;
+    float u = glm::dot(tvec, pvec) * inverseDet;
+    if (u < 0 || u > 1)
+        return false;
+    glm::vec3 qvec = glm::cross(tvec, edge1);
+    float v = glm::dot(direction, qvec) * inverseDet;
+    if (v < 0 || u + v > 1)
+        return false;
+    *distance = glm::dot(edge2, qvec) * inverseDet;
+    return *distance >= 0;
+}
+
+static bool intersectBox(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& boxMin,
+    const glm::vec3& boxMax)
+{
+    float tmin = 0, tmax = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float inverse = 1.0f / direction[axis];
+        float t0 = (boxMin[axis] - origin[axis]) * inverse, t1 = (boxMax[axis] - origin[axis]) * inverse;
+        tmin = std::max(tmin, std::min(t0, t1));
+        tmax = std::min(tmax, std::max(t0, t1));
+    }
+    return tmin <= tmax;
+}
+
+// melo::pick before PickingScene: the first child whose world AABB the ray crosses
+static NodeRef pickBounds(const NodeRef& parent, const glm::vec3& origin, const glm::vec3& direction)
+{
+    for (const auto& child : parent->getChildren())
+    {
+        const auto& world = child->getWorldTransform();
+        glm::vec3 boxMin(FLT_MAX), boxMax(-FLT_MAX);
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 p((corner & 1) ? child->mBoundBoxMax.x : child->mBoundBoxMin.x,
+                (corner & 2) ? child->mBoundBoxMax.y : child->mBoundBoxMin.y,
+                (corner & 4) ? child->mBoundBoxMax.z : child->mBoundBoxMin.z);
+            p = glm::vec3(world * glm::vec4(p, 1));
+            boxMin = glm::min(boxMin, p);
+            boxMax = glm::max(boxMax, p);
+        }
+        if (intersectBox(origin, direction, boxMin, boxMax))
+            return child;
+    }
+    return {};
+}
+
+static glm::mat4 createInstanceTransform(std::mt19937& rng, int gridSize, int index)
+{
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    glm::vec3 position((index % gridSize) * 2.5f, dist(rng) * 0.5f, (index / gridSize) * 2.5f);
+    return glm::translate(position + glm::vec3(dist(rng), 0, dist(rng)) * 0.3f) *
+           glm::toMat4(glm::angleAxis(dist(rng) * 0.5f, glm::normalize(glm::vec3(dist(rng), 4.0f, dist(rng))))) *
+           glm::scale(glm::vec3(1.0f + 0.2f * dist(rng)));
+}
+
+// instances of wavy patches on a grid, picked by rays from above. Checks PickingScene against every triangle and
+// times it against the bounding box pick it replaces.
+int benchPicking(int argc, char** argv)
+{
+    size_t triangles = (size_t)atoll(getArg(argc, argv, "--triangles", "1000000"));
+    int instanceCount = std::max(1, atoi(getArg(argc, argv, "--instances", "64")));
+    int shapeCount = std::max(1, std::min(instanceCount, atoi(getArg(argc, argv, "--shapes", "16"))));
+    int rayCount = atoi(getArg(argc, argv, "--rays", "100000"));
+    int verifyCount = atoi(getArg(argc, argv, "--verify", "200"));
+
+    uint32_t patchSize = std::max<uint32_t>(1, (uint32_t)std::sqrt(triangles / 2.0 / instanceCount));
+    std::vector<BenchShape> shapes;
+    for (int i = 0; i < shapeCount; i++)
+        shapes.push_back(createPatch(patchSize, i * 0.7f));
+
+    int gridSize = (int)std::ceil(std::sqrt((double)instanceCount));
+    std::mt19937 rng(1);
+    auto root = Node::create();
+    std::vector<NodeRef> nodes;
+    std::vector<int> nodeShapes;
+    for (int i = 0; i < instanceCount; i++)
+    {
+        auto node = Node::create();
+        node->rayCategory = 0xFF;
+        node->setTransform(createInstanceTransform(rng, gridSize, i));
+        node->mBoundBoxMin = shapes[i % shapeCount].boundMin;
+        node->mBoundBoxMax = shapes[i % shapeCount].boundMax;
+        root->addChild(node);
+        nodes.push_back(node);
+        nodeShapes.push_back(i % shapeCount);
+    }
+    root->treeUpdate();
+
+    auto picking = PickingScene::create();
+    BenchTimer timer;
+    std::vector<uint32_t> shapeIndices;
+    for (const auto& shape : shapes)
+        shapeIndices.push_back(picking->addShape(shape.positions.data(), shape.positions.size(), shape.indices.data(),
+            shape.indices.size()));
+    for (int i = 0; i < instanceCount; i++)
+        picking->addInstance(shapeIndices[nodeShapes[i]], nodes[i]);
+    picking->refit();
+    double buildMs = timer.getMilliseconds();
+    printf("%zu triangles (%zu unique) in %d instances of %d shapes\n", picking->getTriangleCount() / shapeCount *
+        instanceCount, picking->getTriangleCount(), instanceCount, shapeCount);
+    printf("%-32s %12.3f\n", "build ms", buildMs);
+
+    // rays from above the grid, towards random points of it
+    float extent = gridSize * 2.5f;
+    auto createRay = [&](std::mt19937& rayRng, glm::vec3* origin, glm::vec3* direction) {
+        std::uniform_real_distribution<float> dist(-1.0f, extent);
+        *origin = glm::vec3(extent * 0.5f, 10.0f, -5.0f);
+        *direction = glm::normalize(glm::vec3(dist(rayRng), 0, dist(rayRng)) - *origin);
+    };
+
+    int result = 0;
+    for (int frame = 0; frame < 2; frame++)
+    {
+        if (frame == 1)
+        {
+            // every instance moves, refit only
+            for (int i = 0; i < instanceCount; i++)
+                nodes[i]->setTransform(createInstanceTransform(rng, gridSize, i));
+            root->treeUpdate();
+            timer.reset();
+            picking->refit();
+            printf("%-32s %12.3f\n", "refit ms (every instance moved)", timer.getMilliseconds());
+        }
+
+        std::mt19937 rayRng(frame);
+        glm::vec3 origin, direction;
+        size_t hits = 0;
+        timer.reset();
+        for (int i = 0; i < rayCount; i++)
+        {
+            createRay(rayRng, &origin, &direction);
+            hits += picking->pick(origin, direction) ? 1 : 0;
+        }
+        double pickUs = timer.getMilliseconds() * 1000.0 / std::max(1, rayCount);
+
+        rayRng.seed(frame);
+        size_t boundHits = 0;
+        timer.reset();
+        for (int i = 0; i < rayCount; i++)
+        {
+            createRay(rayRng, &origin, &direction);
+            boundHits += pickBounds(root, origin, direction) ? 1 : 0;
+        }
+        double boundUs = timer.getMilliseconds() * 1000.0 / std::max(1, rayCount);
+
+        printf("frame %d\n", frame);
+        printf("%-32s %12.3f %8.1f%% hits\n", "  PickingScene us / ray", pickUs, hits * 100.0 / std::max(1, rayCount));
+        printf("%-32s %12.3f %8.1f%% hits\n", "  bounding box pick us / ray", boundUs,
+            boundHits * 100.0 / std::max(1, rayCount));
+
+        // against every triangle in world space
+        std::vector<std::vector<glm::vec3>> worldPositions(instanceCount);
+        for (int i = 0; i < instanceCount; i++)
+        {
+            const auto& world = nodes[i]->getWorldTransform();
+            for (const auto& p : shapes[nodeShapes[i]].positions)
+                worldPositions[i].push_back(glm::vec3(world * glm::vec4(p, 1)));
+        }
+        int mismatches = 0, boundMismatches = 0;
+        float maxError = 0;
+        for (int i = 0; i < verifyCount; i++)
+        {
+            createRay(rayRng, &origin, &direction);
+            int nearest = -1;
+            float nearestDistance = FLT_MAX;
+            for (int instance = 0; instance < instanceCount; instance++)
+            {
+                const auto& indices = shapes[nodeShapes[instance]].indices;
+                const auto& positions = worldPositions[instance];
+                for (size_t t = 0; t < indices.size(); t += 3)
+                {
+                    float distance;
+                    if (intersectTriangle(origin, direction, positions[indices[t]], positions[indices[t + 1]],
+                            positions[indices[t + 2]], &distance) &&
+                        distance < nearestDistance)
+                    {
+                        nearestDistance = distance;
+                        nearest = instance;
+                    }
+                }
+            }
+
+            auto hit = picking->pick(origin, direction);
+            NodeRef expected = nearest >= 0 ? nodes[nearest] : NodeRef();
+            if (hit.node != expected)
+                mismatches++;
+            else if (hit)
+                maxError = std::max(maxError, std::abs(hit.distance - nearestDistance));
+            if (pickBounds(root, origin, direction) != expected)
+                boundMismatches++;
+        }
+        printf("%-32s %12d / %d (max distance error %g)\n", "  PickingScene wrong node", mismatches, verifyCount,
+            maxError);
+        printf("%-32s %12d / %d\n", "  bounding box pick wrong node", boundMismatches, verifyCount);
+        // ties between coincident triangles of neighbouring instances may go either way
+        if (mismatches > verifyCount / 100 || maxError > 1e-3f)
+        {
+            printf("picking: PickingScene doesn't match the brute force nearest hit\n");
+            result = 1;
+        }
+    }
+    return result;
+}
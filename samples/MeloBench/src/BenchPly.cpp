@@ -0,0 +1,272 @@
+#include "BenchUtils.h"
+#include "PlyParser.h"
+#include "../../../3rdparty/yocto/yocto_modelio.h"
+#include "../../../3rdparty/yocto/yocto_scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+using namespace melo;
+
+struct PlyLayout
+{
+    bool bigEndian = false;
+    bool normals = false;
+    bool colors = true; // uchar red, green, blue
+    bool alpha = false;
+    bool texcoords = false; // double s, t
+    bool uintIndices = false;
+    bool faceFlags = false; // a uchar after the indices of every face
+    int polygons = 3;       // 3 or 4 corners per face, 0 for a mix of triangles, quads and pentagons
+};
+
+// buffered binary writer in the file's byte order
+struct PlyWriter
+{
+    std::ofstream file;
+    std::vector<char> buffer;
+    bool swap = false;
+
+    template <typename T>
+    void put(T value)
+    {
+        char bytes[sizeof(T)];
+        memcpy(bytes, &value, sizeof(T));
+        if (swap)
+            std::reverse(bytes, bytes + sizeof(T));
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+        if (buffer.size() >= (1 << 20))
+            flush();
+    }
+    void flush()
+    {
+        file.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+};
+
+// a height field scan of (size + 1)^2 vertices like a scanner writes it, written as it goes so that 50M+ vertex
+// files don't need the memory
+static void writeScanPly(const std::string& path, uint32_t size, const PlyLayout& layout)
+{
+    PlyWriter writer;
+    writer.file.open(path, std::ios::binary);
+    writer.swap = layout.bigEndian;
+    uint64_t vertexCount = (uint64_t)(size + 1) * (size + 1);
+    uint64_t faceCount = 0;
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+            faceCount += layout.polygons == 3 ? 2 : layout.polygons == 4 ? 1 : (x % 3 == 0 ? 2 : 1);
+    }
+
+    std::string header = "ply\nformat ";
+    header += layout.bigEndian ? "binary_big_endian" : "binary_little_endian";
+    header += " 1.0\ncomment melobench scan\nelement vertex " + std::to_string(vertexCount) + "\n";
+    header += "property float x\nproperty float y\nproperty float z\n";
+    if (layout.normals)
+        header += "property float nx\nproperty float ny\nproperty float nz\n";
+    if (layout.texcoords)
+        header += "property double s\nproperty double t\n";
+    if (layout.colors)
+        header += "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+    if (layout.alpha)
+        header += "property uchar alpha\n";
+    header += "element face " + std::to_string(faceCount) + "\n";
+    header += layout.uintIndices ? "property list uchar uint vertex_indices\n" : "property list uchar int vertex_indices\n";
+    if (layout.faceFlags)
+        header += "property uchar flags\n";
+    header += "end_header\n";
+    writer.file << header;
+
+    for (uint32_t y = 0; y <= size; y++)
+    {
+        for (uint32_t x = 0; x <= size; x++)
+        {
+            float fx = (float)x / size, fy = (float)y / size;
+            float h = 0.05f * std::sin(fx * 17.0f) * std::cos(fy * 13.0f);
+            writer.put(fx);
+            writer.put(h);
+            writer.put(fy);
+            if (layout.normals)
+            {
+                writer.put(-0.85f * std::cos(fx * 17.0f) * std::cos(fy * 13.0f));
+                writer.put(1.0f);
+                writer.put(0.65f * std::sin(fx * 17.0f) * std::sin(fy * 13.0f));
+            }
+            if (layout.texcoords)
+            {
+                writer.put((double)fx);
+                writer.put((double)fy);
+            }
+            if (layout.colors)
+            {
+                writer.put((uint8_t)(x * 255 / size));
+                writer.put((uint8_t)(y * 255 / size));
+                writer.put((uint8_t)(h * 2550 + 128));
+            }
+            if (layout.alpha)
+                writer.put((uint8_t)((x + y) & 255));
+        }
+    }
+
+    auto putFace = [&](std::initializer_list<uint64_t> corners) {
+        writer.put((uint8_t)corners.size());
+        for (auto corner : corners)
+        {
+            if (layout.uintIndices)
+                writer.put((uint32_t)corner);
+            else
+                writer.put((int32_t)corner);
+        }
+        if (layout.faceFlags)
+            writer.put((uint8_t)7);
+    };
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            uint64_t v = (uint64_t)y * (size + 1) + x, w = v + size + 1;
+            bool quad = layout.polygons == 4 || (layout.polygons == 0 && x % 3 != 0);
+            if (layout.polygons == 0 && x % 3 == 1 && x + 1 < size)
+                putFace({v, v + 1, v + 2, w + 1, w}); // a pentagon over the next cell too
+            else if (quad)
+                putFace({v, v + 1, w + 1, w});
+            else
+            {
+                putFace({v, w, w + 1});
+                putFace({v, w + 1, v + 1});
+            }
+        }
+    }
+    writer.flush();
+}
+
+// yocto::load_shape's PLY branch, without flipping texcoords as load_scene does
+static bool loadYoctoShape(const std::string& path, yocto::shape_data& shape, std::string& error)
+{
+    yocto::ply_model ply;
+    if (!yocto::load_ply(path, ply, error))
+        return false;
+    yocto::get_positions(ply, shape.positions);
+    yocto::get_normals(ply, shape.normals);
+    yocto::get_texcoords(ply, shape.texcoords, false);
+    yocto::get_colors(ply, shape.colors);
+    yocto::get_radius(ply, shape.radius);
+    yocto::get_faces(ply, shape.triangles, shape.quads);
+    return true;
+}
+
+template <typename T>
+static bool sameItems(const std::vector<T>& a, const std::vector<T>& b)
+{
+    return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+// melo::loadPlyShape against yocto on small files of every layout it reads
+static int comparePly()
+{
+    struct Case
+    {
+        const char* name;
+        PlyLayout layout;
+    };
+    std::vector<Case> cases(8);
+    cases[0].name = "little endian";
+    cases[1] = {"big endian", {}};
+    cases[1].layout.bigEndian = true;
+    cases[2] = {"normals, texcoords, alpha", {}};
+    cases[2].layout.normals = cases[2].layout.texcoords = cases[2].layout.alpha = true;
+    cases[3] = {"big endian normals, texcoords, alpha", cases[2].layout};
+    cases[3].layout.bigEndian = true;
+    cases[4] = {"positions only, big endian", {}};
+    cases[4].layout.colors = false;
+    cases[4].layout.bigEndian = true;
+    cases[5] = {"quads, uint indices", {}};
+    cases[5].layout.polygons = 4;
+    cases[5].layout.uintIndices = true;
+    cases[6] = {"mixed polygons, face flags", {}};
+    cases[6].layout.polygons = 0;
+    cases[6].layout.faceFlags = true;
+    cases[7] = {"big endian mixed polygons", cases[6].layout};
+    cases[7].layout.bigEndian = true;
+
+    std::string path = (std::filesystem::temp_directory_path() / "melobench_check.ply").string();
+    int errors = 0;
+    for (const auto& test : cases)
+    {
+        writeScanPly(path, 97, test.layout);
+        yocto::shape_data expected, shape;
+        std::string error;
+        if (!loadYoctoShape(path, expected, error) || !loadPlyShape(path, shape, error))
+        {
+            printf("ply-load: %s: %s\n", test.name, error.empty() ? "not read by the fast path" : error.c_str());
+            errors++;
+            continue;
+        }
+        bool same = sameItems(shape.positions, expected.positions) && sameItems(shape.normals, expected.normals) &&
+                    sameItems(shape.texcoords, expected.texcoords) && sameItems(shape.colors, expected.colors) &&
+                    sameItems(shape.radius, expected.radius) && sameItems(shape.triangles, expected.triangles) &&
+                    sameItems(shape.quads, expected.quads);
+        if (!same)
+        {
+            printf("ply-load: %s: different shapes\n", test.name);
+            errors++;
+        }
+    }
+    std::filesystem::remove(path);
+    printf("%zu layouts checked against yocto, %d errors\n", cases.size(), errors);
+    return errors ? 1 : 0;
+}
+
+// Load time, throughput and peak memory of yocto's PLY loading (load_ply, then get_positions and the others) and
+// melo::loadPlyShape, for model.ply or a synthetic scan of --vertices vertices. Then checks melo against yocto on
+// small files of every layout.
+int benchPlyLoad(int argc, char** argv)
+{
+    const char* model = argc > 0 && argv[0][0] != '-' ? argv[0] : nullptr;
+    std::string mode = getArg(argc, argv, "--mode", "");
+    std::string path = model ? model : (std::filesystem::temp_directory_path() / "melobench_scan.ply").string();
+    if (mode.empty())
+    {
+        if (!model)
+        {
+            double vertices = atof(getArg(argc, argv, "--vertices", "50000000"));
+            PlyLayout layout;
+            layout.bigEndian = hasArg(argc, argv, "--big-endian");
+            layout.normals = hasArg(argc, argv, "--normals");
+            BenchTimer timer;
+            writeScanPly(path, (uint32_t)std::sqrt(vertices), layout);
+            printf("wrote %s in %.1f s\n", path.c_str(), timer.getMilliseconds() / 1000);
+        }
+        printf("%s: %.1f MB\n", path.c_str(), toMB(std::filesystem::file_size(path)));
+        printf("%-8s %12s %10s %12s\n", "mode", "load (ms)", "MB/s", "peak (MB)");
+        for (const char* each : {"yocto", "melo"})
+        {
+            if (hasArg(argc, argv, "--skip-yocto") && strcmp(each, "yocto") == 0)
+                continue;
+            runBenchProcess("ply-load \"" + path + "\" --mode " + each);
+        }
+        return comparePly();
+    }
+
+    size_t baseline = getPeakMemory();
+    BenchTimer timer;
+    yocto::shape_data shape;
+    std::string error;
+    bool loaded = mode == "yocto" ? loadYoctoShape(path, shape, error) : loadPlyShape(path, shape, error);
+    double ms = timer.getMilliseconds();
+    if (!loaded)
+    {
+        printf("ply-load: %s\n", error.empty() ? "not read by the fast path" : error.c_str());
+        return 1;
+    }
+    printf("%-8s %12.1f %10.1f %12.1f  (%zu vertices, %zu triangles, %zu quads)\n", mode.c_str(), ms,
+           toMB(std::filesystem::file_size(path)) / (ms / 1000.0), toMB(getPeakMemory() - baseline),
+           shape.positions.size(), shape.triangles.size(), shape.quads.size());
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include "BenchUtils.h"
+#include "ProgramCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+using namespace melo;
+
+typedef std::vector<std::pair<std::string, std::string>> Defines;
+
+static std::string readText(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+// the defines GltfMaterial::create picks for a random material of a typical scene: mostly metallic, a few maps each
+static Defines makeMaterialDefines(std::mt19937& random, int debugView)
+{
+    Defines defines = {{"HAS_NORMALS", ""}, {"HAS_UV_SET1", ""}, {"USE_PUNCTUAL", ""}, {"LIGHT_COUNT", "1"},
+                       {"USE_IBL", ""}};
+    auto chance = [&](int percent) { return (int)(random() % 100) < percent; };
+    int type = random() % 100;
+    if (type < 80)
+        defines.push_back({"MATERIAL_METALLICROUGHNESS", ""});
+    else if (type < 85)
+        defines.insert(defines.end(), {{"MATERIAL_METALLICROUGHNESS", ""}, {"MATERIAL_SUBSURFACE", ""}});
+    else if (type < 90)
+        defines.insert(defines.end(), {{"MATERIAL_METALLICROUGHNESS", ""}, {"MATERIAL_CLEARCOAT", ""}});
+    else if (type < 95)
+        defines.insert(defines.end(), {{"MATERIAL_METALLICROUGHNESS", ""}, {"MATERIAL_SHEEN", ""}});
+    else
+        defines.push_back({"MATERIAL_UNLIT", ""});
+    if (chance(90))
+        defines.push_back({"HAS_BASE_COLOR_MAP", ""});
+    if (chance(60))
+        defines.push_back({"HAS_METALLIC_ROUGHNESS_MAP", ""});
+    if (chance(15))
+        defines.push_back({"HAS_EMISSIVE_MAP", ""});
+    if (chance(70))
+        defines.push_back({"HAS_NORMAL_MAP", ""});
+    if (chance(40))
+        defines.push_back({"HAS_OCCLUSION_MAP", ""});
+    defines.push_back({chance(85) ? "ALPHAMODE_OPAQUE" : "ALPHAMODE_MASK", ""});
+    if (debugView > 0)
+        defines.insert(defines.end(), {{"DEBUG_OUTPUT", ""}, {"DEBUG_VIEW_" + std::to_string(debugView), ""}});
+    return defines;
+}
+
+// Keys of the program variants GltfScene::createMaterials asks for when a scene of --materials materials goes through
+// every debug view: programs compiled without the cache and with it, and the time to key a request. Checks that the
+// keys tell apart exactly the different define sets, that define order and repetitions don't matter and that any
+// change of source, define or binding makes another key.
+int benchProgramCache(int argc, char** argv)
+{
+    int materialCount = atoi(getArg(argc, argv, "--materials", "500"));
+    std::string assets = getArg(argc, argv, "--assets", "assets");
+    std::string vertex = readText(assets + "/pbr/primitive.vert");
+    std::string fragment = readText(assets + "/pbr/pbr.frag");
+    if (vertex.empty() || fragment.empty())
+    {
+        printf("program-cache: no shaders in %s/pbr, using synthetic ones\n", assets.c_str());
+        vertex.assign(8 * 1024, 'v');
+        fragment.assign(48 * 1024, 'f');
+    }
+    std::vector<const std::string*> sources = {&vertex, &fragment};
+    std::vector<std::string> bindings = {"attrib a_Position 0 -1", "attrib a_Normal 1 -1", "attrib a_Tangent 2 -1",
+                                         "attrib a_UV1 4 -1", "attrib a_UV2 5 -1", "attrib a_Color 3 -1",
+                                         "uniform u_ViewProjectionMatrix 9", "uniform u_ModelMatrix 0",
+                                         "uniform u_NormalMatrix 13", "output g_finalColor 0", "version 150"};
+    printf("%zu + %zu bytes of shader sources, %d materials, 18 debug views\n", vertex.size(), fragment.size(),
+           materialCount);
+
+    std::mt19937 random(1);
+    std::unordered_map<uint64_t, Defines> programs;
+    std::set<Defines> defineSets;
+    size_t requests = 0;
+    int errors = 0;
+    double ms = 0;
+    for (int debugView = 0; debugView < 18; debugView++)
+    {
+        std::mt19937 materials(7); // the same scene for every view
+        for (int m = 0; m < materialCount; m++)
+        {
+            Defines defines = makeMaterialDefines(materials, debugView);
+            BenchTimer timer;
+            uint64_t key = hashProgramVariant(sources, defines, bindings);
+            ms += timer.getMilliseconds();
+            requests++;
+
+            std::sort(defines.begin(), defines.end());
+            defineSets.insert(defines);
+            auto it = programs.emplace(key, defines).first;
+            if (it->second != defines)
+            {
+                printf("program-cache: two define sets share key %016llx\n", (unsigned long long)key);
+                errors++;
+            }
+
+            // shuffled and partly repeated defines, and shuffled bindings, are the same variant
+            Defines shuffled = defines;
+            shuffled.insert(shuffled.end(), defines.begin(), defines.begin() + random() % defines.size());
+            std::shuffle(shuffled.begin(), shuffled.end(), random);
+            std::vector<std::string> shuffledBindings = bindings;
+            std::shuffle(shuffledBindings.begin(), shuffledBindings.end(), random);
+            if (hashProgramVariant(sources, shuffled, shuffledBindings) != key)
+            {
+                printf("program-cache: define or binding order changed the key\n");
+                errors++;
+            }
+        }
+    }
+    if (programs.size() != defineSets.size())
+    {
+        printf("program-cache: %zu keys for %zu define sets\n", programs.size(), defineSets.size());
+        errors++;
+    }
+
+    // every single change is another variant
+    Defines defines = makeMaterialDefines(random, 0);
+    uint64_t key = hashProgramVariant(sources, defines, bindings);
+    std::string edited = fragment;
+    edited[edited.size() / 2] ^= 1;
+    Defines valued = defines, added = defines;
+    valued[3].second = "2";
+    added.push_back({"HAS_TANGENTS", ""});
+    std::vector<std::string> rebound = bindings, located = bindings;
+    rebound[0] = "attrib a_Position 1 -1";
+    located[0] = "attrib a_Position 0 3";
+    std::vector<std::pair<const char*, uint64_t>> changes = {
+        {"fragment source", hashProgramVariant({&vertex, &edited}, defines, bindings)},
+        {"swapped stages", hashProgramVariant({&fragment, &vertex}, defines, bindings)},
+        {"missing stage", hashProgramVariant({&vertex, &fragment, nullptr}, defines, bindings)},
+        {"define value", hashProgramVariant(sources, valued, bindings)},
+        {"added define", hashProgramVariant(sources, added, bindings)},
+        {"attribute semantic", hashProgramVariant(sources, defines, rebound)},
+        {"attribute location", hashProgramVariant(sources, defines, located)},
+    };
+    for (const auto& change : changes)
+    {
+        if (change.second == key)
+        {
+            printf("program-cache: a different %s kept the key\n", change.first);
+            errors++;
+        }
+    }
+
+    printf("%zu requests: %zu compiles without the cache, %zu with it (%.1fx fewer)\n", requests, requests,
+           programs.size(), programs.empty() ? 0.0 : (double)requests / programs.size());
+    printf("keying: %.2f us per request, %.1f ms in total\n", ms * 1000 / requests, ms);
+    printf("%d errors\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,319 @@
+#include "BenchUtils.h"
+#include "FrustumCuller.h"
+#include "Node.h"
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/transform.hpp>
+
+using namespace melo;
+
+// draws nothing, shader / material / mesh stand in for the GL objects a node binds, only their addresses matter
+struct BenchDrawNode : Node
+{
+    const int* shader = nullptr;
+    const int* material = nullptr;
+    const int* mesh = nullptr;
+
+    DrawOrder getDrawOrder() const { return mDrawOrder; }
+
+    void submitDraws(RenderQueue& queue) override { queue.add(*this, mDrawOrder, shader, material, mesh, 0, true); }
+};
+
+// records like RecordingRenderBackend and checks that every instanced batch holds one state and the transforms of
+// its nodes
+struct CheckingRenderBackend : RecordingRenderBackend
+{
+    int errors = 0;
+
+    void drawInstances(DrawOrder order, const DrawPacket* packets, uint32_t count, const glm::mat4* transforms,
+                       uint32_t changes) override
+    {
+        auto first = static_cast<const BenchDrawNode*>(packets[0].node);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            auto node = static_cast<const BenchDrawNode*>(packets[i].node);
+            bool sameState = std::tie(node->shader, node->material, node->mesh) ==
+                             std::tie(first->shader, first->material, first->mesh);
+            if ((!sameState || memcmp(&transforms[i], &node->getWorldTransform(), sizeof(glm::mat4)) != 0) && errors++ < 10)
+                printf("render-queue: instance %u of a batch of %u doesn't belong to it\n", i, count);
+        }
+        RecordingRenderBackend::drawInstances(order, packets, count, transforms, changes);
+    }
+};
+
+// shader, material and mesh changes of draws in the given order
+static RecordingRenderBackend::Counters countChanges(const std::vector<BenchDrawNode*>& draws)
+{
+    RecordingRenderBackend::Counters counters;
+    const BenchDrawNode* previous = nullptr;
+    for (auto draw : draws)
+    {
+        counters.drawCalls++;
+        counters.shaderChanges += (!previous || previous->shader != draw->shader) ? 1 : 0;
+        counters.materialChanges += (!previous || previous->material != draw->material) ? 1 : 0;
+        counters.meshChanges += (!previous || previous->mesh != draw->mesh) ? 1 : 0;
+        previous = draw;
+    }
+    return counters;
+}
+
+static void printCounters(const char* name, const RecordingRenderBackend::Counters& counters)
+{
+    printf("%-28s %10zu %10zu %10zu %10zu %10zu %10zu\n", name, counters.drawCalls, counters.shaderChanges,
+           counters.materialChanges, counters.meshChanges, counters.instancedDraws, counters.instances);
+}
+
+// frames drawing fresh shaders, materials and meshes next to a lasting one, far more over time than the key fields
+// hold: the ids of the released ones must be reused without two states of a frame sharing one
+static int checkIdReuse(int frames)
+{
+    auto queue = RenderQueue::create();
+    auto root = Node::create();
+    std::vector<std::shared_ptr<BenchDrawNode>> nodes;
+    for (int i = 0; i < 7; i++)
+    {
+        nodes.push_back(std::make_shared<BenchDrawNode>());
+        root->addChild(nodes.back());
+    }
+    root->treeUpdate();
+
+    int errors = 0;
+    CheckingRenderBackend recorder;
+    std::vector<std::unique_ptr<int>> states; // kept alive, every address is another state
+    for (int frame = 0; frame < frames; frame++)
+    {
+        // two pairs of instances and two single draws of fresh states, one draw of the lasting one
+        const size_t groups[] = {0, 0, 1, 1, 2, 3};
+        for (int i = 0; i < 4; i++)
+            states.push_back(std::make_unique<int>());
+        for (size_t i = 0; i < 6; i++)
+        {
+            const int* state = states[states.size() - 4 + groups[i]].get();
+            nodes[i]->shader = nodes[i]->material = nodes[i]->mesh = state;
+        }
+        nodes[6]->shader = nodes[6]->material = nodes[6]->mesh = &frames;
+
+        queue->build(root, glm::mat4(1.0f));
+        recorder.reset();
+        queue->draw(DRAW_SOLID, recorder);
+        const auto& counters = recorder.counters[DRAW_SOLID];
+        if ((counters.drawCalls != 5 || counters.instancedDraws != 2 || counters.shaderChanges != 5) && errors++ < 10)
+        {
+            printf("render-queue: frame %d of fresh states: %zu draws, %zu instanced, %zu shader changes\n", frame,
+                   counters.drawCalls, counters.instancedDraws, counters.shaderChanges);
+        }
+    }
+    return errors + recorder.errors;
+}
+
+// one node drawing one shader and material with meshes past every id limit: a key field and the 21 bits of the
+// packed instance keys. The first meshes are drawn once, the last ones twice in a row and instanced in pairs.
+static int checkIdOverflow()
+{
+    struct ManyMeshesNode : Node
+    {
+        std::vector<char> meshes = std::vector<char>((1u << 21) + 1000); // every address is another mesh
+        size_t pairsBegin = 1u << 21;
+
+        void submitDraws(RenderQueue& queue) override
+        {
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                for (int j = i < pairsBegin ? 1 : 2; j > 0; j--)
+                    queue.add(*this, DRAW_SOLID, &pairsBegin, this, &meshes[i], 0, true);
+            }
+        }
+    };
+
+    struct PairsRenderBackend : RecordingRenderBackend
+    {
+        int errors = 0;
+
+        void drawInstances(DrawOrder order, const DrawPacket* packets, uint32_t count, const glm::mat4* transforms,
+                           uint32_t changes) override
+        {
+            if (count != 2 && errors++ < 10)
+                printf("render-queue: batch of %u instances past the id limits\n", count);
+            RecordingRenderBackend::drawInstances(order, packets, count, transforms, changes);
+        }
+    };
+
+    auto node = std::make_shared<ManyMeshesNode>();
+    node->treeUpdate();
+    auto queue = RenderQueue::create();
+    queue->build(node, glm::mat4(1.0f));
+    PairsRenderBackend recorder;
+    queue->draw(DRAW_SOLID, recorder);
+
+    // ids past a field look alike in the keys, draw() reports a mesh change for each of them
+    const auto& counters = recorder.counters[DRAW_SOLID];
+    size_t pairs = node->meshes.size() - node->pairsBegin;
+    if (counters.drawCalls != node->meshes.size() || counters.instancedDraws != pairs ||
+        counters.meshChanges != counters.drawCalls || counters.shaderChanges != 1 || counters.materialChanges != 1)
+    {
+        printf("render-queue: meshes past the id limits: %zu draws, %zu instanced, %zu shader, %zu material and %zu "
+               "mesh changes\n", counters.drawCalls, counters.instancedDraws, counters.shaderChanges,
+               counters.materialChanges, counters.meshChanges);
+        recorder.errors++;
+    }
+    return recorder.errors;
+}
+
+// groups of nodes drawing random shader / material / mesh combinations, a tenth of them transparent. With --pairs
+// the nodes draw one of that many material / mesh pairs, as repeated props do. Compares the state changes of the
+// tree order with those of the sorted and instanced queue, checks the sort order, the instanced batches and that
+// every node the culler kept is drawn once.
+int benchRenderQueue(int argc, char** argv)
+{
+    size_t count = (size_t)atoll(getArg(argc, argv, "--nodes", "20000"));
+    int shaderCount = std::max(1, atoi(getArg(argc, argv, "--shaders", "8")));
+    int materialCount = std::max(1, atoi(getArg(argc, argv, "--materials", "64")));
+    int meshCount = std::max(1, atoi(getArg(argc, argv, "--meshes", "256")));
+    int frames = std::max(1, atoi(getArg(argc, argv, "--frames", "10")));
+    int pairCount = atoi(getArg(argc, argv, "--pairs", "0"));
+    uint32_t minInstances = (uint32_t)atoi(getArg(argc, argv, "--min-instances", "2"));
+
+    std::vector<int> shaders(shaderCount), materials(materialCount), meshes(meshCount);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<std::pair<int, int>> pairs(std::max(0, pairCount));
+    for (auto& pair : pairs)
+        pair = {(int)(rng() % materialCount), (int)(rng() % meshCount)};
+    auto root = Node::create();
+    std::vector<std::shared_ptr<BenchDrawNode>> nodes;
+    for (size_t i = 0; i < count; i += 32)
+    {
+        auto group = Node::create();
+        group->setTransform(glm::translate(glm::vec3(dist(rng) * 200.0f, 0, dist(rng) * 200.0f)));
+        root->addChild(group);
+        for (size_t j = i; j < std::min(count, i + 32); j++)
+        {
+            auto node = std::make_shared<BenchDrawNode>();
+            node->mBoundBoxMin = glm::vec3(-0.5f);
+            node->mBoundBoxMax = glm::vec3(0.5f);
+            node->setTransform(glm::translate(glm::vec3(dist(rng), dist(rng), dist(rng)) * 8.0f));
+            // materials belong to one shader, as they do in a real scene
+            int material = (int)(rng() % materialCount);
+            int mesh = (int)(rng() % meshCount);
+            if (!pairs.empty())
+                std::tie(material, mesh) = pairs[rng() % pairs.size()];
+            node->material = &materials[material];
+            node->shader = &shaders[material % shaderCount];
+            node->mesh = &meshes[mesh];
+            node->setDrawOrder(rng() % 10 == 0 ? DRAW_TRANSPARENCY : DRAW_SOLID);
+            group->addChild(node);
+            nodes.push_back(node);
+        }
+    }
+    root->treeUpdate();
+
+    auto queue = RenderQueue::create();
+    queue->setInstancing(minInstances);
+    auto culler = FrustumCuller::create();
+    auto projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+    const DrawOrder passes[] = {DRAW_SHADOW, DRAW_SOLID, DRAW_TRANSPARENCY};
+
+    printf("%zu nodes, %d shaders, %d materials, %d meshes, %d frames\n", nodes.size(), shaderCount, materialCount,
+           meshCount, frames);
+
+    double buildMs = 1e30;
+    int errors = 0;
+    CheckingRenderBackend recorder;
+    std::vector<BenchDrawNode*> treeOrder[DRAW_ORDER_COUNT];
+    for (int frame = 0; frame < frames; frame++)
+    {
+        float angle = frame * 6.2831853f / frames;
+        auto view = glm::lookAt(glm::vec3(0, 20, 0), glm::vec3(std::cos(angle), 19.7f, std::sin(angle)),
+                                glm::vec3(0, 1, 0));
+        culler->cull(root, projection * view);
+
+        // treeDraw() only walks the tree with Cinder, there is nothing to time it against here
+        BenchTimer timer;
+        queue->build(root, view, culler.get());
+        buildMs = std::min(buildMs, timer.getMilliseconds());
+
+        recorder.reset();
+        for (auto pass : passes)
+        {
+            queue->draw(pass, recorder);
+            if (recorder.counters[pass].drawCalls != queue->getDrawCount(pass) ||
+                recorder.counters[pass].instancedDraws != queue->getInstancedDrawCount(pass))
+            {
+                printf("render-queue: pass %d made %zu draw calls instead of %zu\n", (int)pass,
+                       recorder.counters[pass].drawCalls, queue->getDrawCount(pass));
+                errors++;
+            }
+        }
+
+        // what the tree walks would have drawn, in their order
+        for (auto& draws : treeOrder)
+            draws.clear();
+        for (const auto& node : nodes)
+        {
+            if (culler->isVisible(*node))
+                treeOrder[node->getDrawOrder()].push_back(node.get());
+        }
+
+        for (auto pass : passes)
+        {
+            const auto& packets = recorder.packets[pass];
+            std::multiset<const Node*> drawn, expected(treeOrder[pass].begin(), treeOrder[pass].end());
+            for (const auto& packet : packets)
+                drawn.insert(packet.node);
+            if (drawn != expected)
+            {
+                printf("render-queue: pass %d draws %zu packets instead of %zu\n", (int)pass, packets.size(),
+                       expected.size());
+                errors++;
+            }
+
+            // opaque: depth grows within a run of equal state, transparent: depth never grows
+            for (size_t i = 1; i < packets.size(); i++)
+            {
+                auto a = static_cast<BenchDrawNode*>(packets[i - 1].node);
+                auto b = static_cast<BenchDrawNode*>(packets[i].node);
+                float depthA = -(view * a->getWorldTransform()[3]).z;
+                float depthB = -(view * b->getWorldTransform()[3]).z;
+                bool sameState = std::tie(a->shader, a->material, a->mesh) == std::tie(b->shader, b->material, b->mesh);
+                bool ordered = pass == DRAW_TRANSPARENCY ? depthA >= depthB * 0.998f
+                                                         : !sameState || depthA <= depthB * 1.002f;
+                if (!ordered && errors++ < 10)
+                    printf("render-queue: pass %d packet %zu out of order, depth %g then %g\n", (int)pass, i, depthA,
+                           depthB);
+            }
+        }
+
+        // a shader is one run of the opaque pass, whatever the number of its draws
+        std::set<const int*> solidShaders;
+        for (auto draw : treeOrder[DRAW_SOLID])
+            solidShaders.insert(draw->shader);
+        if (recorder.counters[DRAW_SOLID].shaderChanges != solidShaders.size())
+        {
+            printf("render-queue: %zu shader changes for %zu shaders\n", recorder.counters[DRAW_SOLID].shaderChanges,
+                   solidShaders.size());
+            errors++;
+        }
+    }
+
+    errors += recorder.errors + checkIdReuse(5000) + checkIdOverflow();
+    printf("%-28s %12.3f\n", "RenderQueue::build() ms", buildMs);
+    printf("last frame                       draws    shaders  materials     meshes  instanced  instances\n");
+    printCounters("  solid, tree order", countChanges(treeOrder[DRAW_SOLID]));
+    printCounters("  solid, queue", recorder.counters[DRAW_SOLID]);
+    printCounters("  transparent, tree order", countChanges(treeOrder[DRAW_TRANSPARENCY]));
+    printCounters("  transparent, queue", recorder.counters[DRAW_TRANSPARENCY]);
+    size_t solidPackets = queue->getPacketCount(DRAW_SOLID), solidDraws = queue->getDrawCount(DRAW_SOLID);
+    printf("solid: %zu packets in %zu draw calls, %.2fx fewer\n", solidPackets, solidDraws,
+           solidDraws ? (double)solidPackets / solidDraws : 0.0);
+    printf("%d errors\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+#include "BenchUtils.h"
+#include "cigltf.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using namespace melo;
+
+// compares what a warm load serves from the cache with a load that doesn't use it
+static bool checkWarmLoad(const ModelGLTFRef& warm, const ModelGLTFRef& reference)
+{
+    const auto& a = *warm->compact;
+    const auto& b = *reference->compact;
+    bool ok = a.strings.getChars() == b.strings.getChars() && a.defaultScene == b.defaultScene &&
+              a.buffers.size() == b.buffers.size() && a.accessors.size() == b.accessors.size() &&
+              a.nodes.size() == b.nodes.size() && a.materials.size() == b.materials.size() &&
+              a.primitives.size() == b.primitives.size() && a.animations.size() == b.animations.size();
+    for (size_t i = 0; ok && i < a.nodes.size(); i++)
+    {
+        ok = a.nodes[i].name == b.nodes[i].name && a.nodes[i].parent == b.nodes[i].parent &&
+             a.nodes[i].mesh == b.nodes[i].mesh && a.nodes[i].translation == b.nodes[i].translation &&
+             memcmp(&a.nodes[i].rotation, &b.nodes[i].rotation, sizeof(glm::quat)) == 0;
+    }
+    for (size_t i = 0; ok && i < a.accessors.size(); i++)
+    {
+        ok = a.accessors[i].count == b.accessors[i].count && a.accessors[i].bufferView == b.accessors[i].bufferView &&
+             a.accessors[i].boundsMin == b.accessors[i].boundsMin && a.accessors[i].boundsMax == b.accessors[i].boundsMax;
+    }
+    for (size_t i = 0; ok && i < a.materials.size(); i++)
+        ok = a.materials[i].baseColorFactor == b.materials[i].baseColorFactor;
+
+    for (size_t i = 0; ok && i < warm->buffers.size(); i++)
+    {
+        const auto& x = warm->buffers[i]->cpuBuffer;
+        const auto& y = reference->buffers[i]->cpuBuffer;
+        ok = x->getSize() == y->getSize() && memcmp(x->getData(), y->getData(), x->getSize()) == 0;
+    }
+
+    for (size_t i = 0; ok && i < warm->images.size(); i++)
+    {
+        const auto& cached = warm->images[i]->cachedImage;
+        const auto& image = reference->property.images[i];
+        if (image.image.empty())
+            continue;
+        ok = cached.width == (uint32_t)image.width && cached.height == (uint32_t)image.height &&
+             !cached.levels.empty() && memcmp(cached.levels[0], image.image.data(), image.image.size()) == 0;
+    }
+    return ok;
+}
+
+// the source keys: uri decoding, malformed escapes included, and the dependencies of an .obj
+static int checkSourceKeys()
+{
+    int errors = 0;
+    std::pair<const char*, const char*> uris[] = {
+        {"a%20b.bin", "a b.bin"}, {"%41%62", "Ab"}, {"100%.png", "100%.png"}, {"a%zz.bin", "a%zz.bin"},
+        {"a%2", "a%2"},           {"%", "%"},       {"%4g%41", "%4gA"},
+    };
+    for (const auto& uri : uris)
+    {
+        if (decodeUri(uri.first) != uri.second)
+        {
+            printf("gltf-cache: decodeUri(\"%s\") is \"%s\"\n", uri.first, decodeUri(uri.first).c_str());
+            errors++;
+        }
+    }
+
+    auto folder = fs::temp_directory_path() / "melobench_deps";
+    std::error_code ec;
+    fs::create_directories(folder, ec);
+    auto writeText = [&](const char* name, const char* text) { std::ofstream(folder / name, std::ios::binary) << text; };
+    writeText("scan.obj", "# mtllib commented.mtl\nmtllib a.mtl\r\nv 0 0 0\nusemtl a\n  mtllib b.mtl c.mtl\nf 1 1 1\n");
+    writeText("a.mtl", "newmtl a\nKd 1 1 1\nmap_Kd albedo.png\n\tmap_Bump -bm 0.5 normal.png\n");
+    writeText("b.mtl", "newmtl b\nbump bump.png\n");
+    std::vector<std::string> dependencies, expected;
+    for (auto name : {"scan.obj", "a.mtl", "albedo.png", "normal.png", "b.mtl", "bump.png", "c.mtl"})
+        expected.push_back((folder / name).string());
+    hashSceneSource((folder / "scan.obj").string(), &dependencies);
+    std::sort(dependencies.begin(), dependencies.end());
+    std::sort(expected.begin(), expected.end());
+    if (dependencies != expected)
+    {
+        printf("gltf-cache: %zu dependencies of the .obj instead of %zu\n", dependencies.size(), expected.size());
+        errors++;
+    }
+    fs::remove_all(folder, ec);
+    return errors;
+}
+
+// ModelGLTF::create with Option::useCache: the first (cold) load writes the cache, the warm one reads it
+int benchSceneCache(int argc, char** argv)
+{
+    if (checkSourceKeys() > 0)
+        return 1;
+    if (argc < 1)
+    {
+        printf("gltf-cache: missing model path\n");
+        return 1;
+    }
+    std::string path = argv[0];
+    std::string mode = getArg(argc, argv, "--mode", "");
+    bool textures = hasArg(argc, argv, "--textures");
+    auto flags = std::string(textures ? " --textures" : "");
+
+    if (mode.empty())
+    {
+        std::error_code ec;
+        fs::remove(SceneCache::getCachePath(path), ec);
+        printf("%-8s %12s %14s\n", "mode", "load (ms)", "peak (MB)");
+        runBenchProcess("gltf-cache \"" + path + "\" --mode nocache" + flags);
+        runBenchProcess("gltf-cache \"" + path + "\" --mode cold" + flags);
+        runBenchProcess("gltf-cache \"" + path + "\" --mode warm" + flags);
+        return 0;
+    }
+
+    ModelGLTF::Option option;
+    option.loadTextures = textures;
+    option.mapBuffers = true;
+    option.useCache = (mode != "nocache");
+
+    size_t baseline = getPeakMemory();
+    BenchTimer timer;
+    auto model = ModelGLTF::create(path, option);
+    double ms = timer.getMilliseconds();
+    if (!model)
+    {
+        printf("gltf-cache: failed to load %s\n", path.c_str());
+        return 1;
+    }
+    size_t peak = getPeakMemory() - baseline;
+
+    std::string note;
+    if (mode == "cold")
+    {
+        note = fs::exists(SceneCache::getCachePath(path)) ? "(cache written)" : "(no cache written)";
+    }
+    else if (mode == "warm")
+    {
+        if (!model->cache)
+        {
+            printf("gltf-cache: the warm load didn't use the cache\n");
+            return 1;
+        }
+        option.useCache = false;
+        auto reference = ModelGLTF::create(path, option);
+        if (!reference || !checkWarmLoad(model, reference))
+        {
+            printf("gltf-cache: the warm load doesn't match the source\n");
+            return 1;
+        }
+        note = "(matches the source, cache " + std::to_string((int)toMB(model->cache->getFile()->getSize())) + " MB)";
+    }
+    printf("%-8s %12.2f %14.2f  %s\n", mode.c_str(), ms, toMB(peak), note.c_str());
+    return 0;
+}
@@ -0,0 +1,214 @@
+#include "BenchUtils.h"
+#include "cigltf.h"
+#include "AccessorReader.h"
+#include "../../../3rdparty/yocto/yocto_shape.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace melo;
+
+// yocto::skin_matrices() over the same streams, the scalar reference
+static void skinReference(const SkinningInput& input, const std::vector<glm::mat4>& matrices,
+                          std::vector<yocto::vec3f>* positions, std::vector<yocto::vec3f>* normals)
+{
+    std::vector<yocto::vec3f> sourcePositions(input.vertexCount), sourceNormals(input.vertexCount);
+    std::vector<yocto::vec4f> weights(input.vertexCount);
+    std::vector<yocto::vec4i> joints(input.vertexCount);
+    std::vector<yocto::mat4f> xforms(matrices.size());
+    for (size_t i = 0; i < input.vertexCount; i++)
+    {
+        const auto& position = input.positions[i];
+        const auto& weight = input.weights[i];
+        const auto& joint = input.joints[i];
+        sourcePositions[i] = {position.x, position.y, position.z};
+        if (input.normals)
+            sourceNormals[i] = {input.normals[i].x, input.normals[i].y, input.normals[i].z};
+        weights[i] = {weight.x, weight.y, weight.z, weight.w};
+        joints[i] = {(int)joint.x, (int)joint.y, (int)joint.z, (int)joint.w};
+    }
+    for (size_t i = 0; i < matrices.size(); i++)
+    {
+        const auto& m = matrices[i];
+        xforms[i] = {{m[0][0], m[0][1], m[0][2], m[0][3]},
+                     {m[1][0], m[1][1], m[1][2], m[1][3]},
+                     {m[2][0], m[2][1], m[2][2], m[2][3]},
+                     {m[3][0], m[3][1], m[3][2], m[3][3]}};
+    }
+    positions->resize(input.vertexCount);
+    normals->resize(input.vertexCount);
+    yocto::skin_matrices(*positions, *normals, sourcePositions, sourceNormals, weights, joints, xforms);
+}
+
+static float getMaxError(const glm::vec3* values, const std::vector<yocto::vec3f>& reference)
+{
+    float maxError = 0;
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        maxError = std::max(maxError, std::abs(values[i].x - reference[i].x));
+        maxError = std::max(maxError, std::abs(values[i].y - reference[i].y));
+        maxError = std::max(maxError, std::abs(values[i].z - reference[i].z));
+    }
+    return maxError;
+}
+
+// a random rotation and translation
+static glm::mat4 createRigidTransform(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    glm::vec4 q = glm::normalize(glm::vec4(dist(rng), dist(rng), dist(rng), dist(rng)));
+    float x = q.x, y = q.y, z = q.z, w = q.w;
+    glm::mat4 m(1.0f);
+    m[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y), 0);
+    m[1] = glm::vec4(2 * (x * y - w * z), 1 - 2 * (x * x + z * z), 2 * (y * z + w * x), 0);
+    m[2] = glm::vec4(2 * (x * z + w * y), 2 * (y * z - w * x), 1 - 2 * (x * x + y * y), 0);
+    m[3] = glm::vec4(dist(rng), dist(rng), dist(rng), 1);
+    return m;
+}
+
+// skins every skinned primitive of a model and checks it against yocto
+static int benchModelSkinning(const std::string& path)
+{
+    ModelGLTF::Option option;
+    option.loadTextures = false;
+    auto model = ModelGLTF::create(path, option);
+    if (!model)
+    {
+        printf("skin: failed to load %s\n", path.c_str());
+        return 1;
+    }
+
+    auto jobs = JobSystem::getDefault();
+    int skinnedCount = 0;
+    for (auto& node : model->nodes)
+    {
+        if (!node->skin || !node->mesh)
+            continue;
+        for (auto method : {SKINNING_LINEAR, SKINNING_DUAL_QUATERNION})
+        {
+            node->skin->updatePalette(*model, node->getWorldTransform(), method, &node->skinningPalette);
+            BenchTimer timer;
+            node->mesh->skin(node->skinningPalette, method, jobs.get());
+            double ms = timer.getMilliseconds();
+            for (auto& primitive : node->mesh->primitives)
+            {
+                if (!primitive->isSkinned() || !primitive->skinnedPositions)
+                    continue;
+                SkinningInput input;
+                input.positions = (const glm::vec3*)primitive->positions->getData();
+                input.normals = primitive->normals ? (const glm::vec3*)primitive->normals->getData() : nullptr;
+                input.joints = (const glm::uvec4*)primitive->joints->getData();
+                input.weights = (const glm::vec4*)primitive->weights->getData();
+                input.vertexCount = primitive->vertexCount;
+                std::vector<yocto::vec3f> positions, normals;
+                skinReference(input, node->skinningPalette.matrices, &positions, &normals);
+                printf("%-24s %-5s %8u vertices %8.3f ms, max error %g\n", node->getName().c_str(),
+                       method == SKINNING_LINEAR ? "lbs" : "dq", primitive->vertexCount, ms,
+                       getMaxError((const glm::vec3*)primitive->skinnedPositions->getData(), positions));
+                skinnedCount++;
+            }
+        }
+    }
+    if (skinnedCount == 0)
+        printf("skin: %s has no skinned primitive\n", path.c_str());
+    return 0;
+}
+
+// melo::skinVertices() LBS / DQ, single threaded and on the worker pool, against yocto::skin_matrices()
+int benchSkinning(int argc, char** argv)
+{
+    if (argc >= 1 && argv[0][0] != '-')
+        return benchModelSkinning(argv[0]);
+
+    size_t vertexCount = (size_t)atoll(getArg(argc, argv, "--vertices", "500000"));
+    int jointCount = atoi(getArg(argc, argv, "--joints", "64"));
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> jointDist(0, jointCount - 1);
+    std::vector<glm::vec3> sourcePositions(vertexCount), sourceNormals(vertexCount);
+    std::vector<glm::uvec4> joints(vertexCount), rigidJoints(vertexCount);
+    std::vector<glm::vec4> weights(vertexCount), rigidWeights(vertexCount, glm::vec4(1, 0, 0, 0));
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        sourcePositions[i] = glm::vec3(dist(rng), dist(rng), dist(rng));
+        sourceNormals[i] = glm::normalize(glm::vec3(dist(rng), dist(rng), dist(rng)));
+        joints[i] = glm::uvec4(jointDist(rng), jointDist(rng), jointDist(rng), jointDist(rng));
+        glm::vec4 w(dist(rng) + 1, dist(rng) + 1, dist(rng) + 1, dist(rng) + 1);
+        weights[i] = w / (w.x + w.y + w.z + w.w);
+        rigidJoints[i] = glm::uvec4(joints[i].x, 0, 0, 0);
+    }
+
+    std::vector<glm::mat4> jointTransforms(jointCount);
+    for (auto& transform : jointTransforms)
+        transform = createRigidTransform(rng);
+
+    SkinningPalette palette;
+    palette.update(jointTransforms.data(), nullptr, jointCount, glm::mat4(1.0f), SKINNING_DUAL_QUATERNION);
+
+    SkinningInput input;
+    input.positions = sourcePositions.data();
+    input.normals = sourceNormals.data();
+    input.joints = joints.data();
+    input.weights = weights.data();
+    input.vertexCount = vertexCount;
+
+    std::vector<yocto::vec3f> referencePositions, referenceNormals;
+    BenchTimer timer;
+    skinReference(input, palette.matrices, &referencePositions, &referenceNormals);
+    double referenceMs = timer.getMilliseconds();
+
+    std::vector<glm::vec3> positions(vertexCount), normals(vertexCount);
+    auto jobs = JobSystem::getDefault();
+    printf("simd: %s, %zu vertices, %d joints, %zu threads\n", getSimdName(), vertexCount, jointCount,
+           jobs->getThreadCount() + 1);
+    printf("%-16s %12s %12s %14s\n", "", "ms", "Mverts/s", "max error");
+    auto report = [&](const char* name, double ms, float error) {
+        printf("%-16s %12.2f %12.1f %14g\n", name, ms, vertexCount / (ms * 1e3), error);
+    };
+    report("yocto", referenceMs, 0);
+
+    auto run = [&](const SkinningInput& in, SkinningMethod method, JobSystem* pool) {
+        double best = 1e30;
+        for (int i = 0; i < 5; i++)
+        {
+            BenchTimer runTimer;
+            skinVertices(in, palette, method, positions.data(), normals.data(), pool);
+            best = std::min(best, runTimer.getMilliseconds());
+        }
+        return best;
+    };
+
+    double ms = run(input, SKINNING_LINEAR, nullptr);
+    float error = std::max(getMaxError(positions.data(), referencePositions), getMaxError(normals.data(), referenceNormals));
+    report("lbs", ms, error);
+    ms = run(input, SKINNING_LINEAR, jobs.get());
+    report("lbs jobs", ms, getMaxError(positions.data(), referencePositions));
+    if (error > 1e-4f)
+    {
+        printf("skin: LBS doesn't match yocto\n");
+        return 1;
+    }
+
+    // DQ blends differently, it only has to match LBS on rigidly bound vertices
+    ms = run(input, SKINNING_DUAL_QUATERNION, nullptr);
+    report("dq", ms, getMaxError(positions.data(), referencePositions));
+    ms = run(input, SKINNING_DUAL_QUATERNION, jobs.get());
+    report("dq jobs", ms, getMaxError(positions.data(), referencePositions));
+
+    SkinningInput rigid = input;
+    rigid.joints = rigidJoints.data();
+    rigid.weights = rigidWeights.data();
+    skinReference(rigid, palette.matrices, &referencePositions, &referenceNormals);
+    run(rigid, SKINNING_DUAL_QUATERNION, jobs.get());
+    error = std::max(getMaxError(positions.data(), referencePositions), getMaxError(normals.data(), referenceNormals));
+    printf("dq on rigidly bound vertices: max error %g\n", error);
+    if (error > 1e-4f)
+    {
+        printf("skin: DQ doesn't match yocto on rigid vertices\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include "BenchUtils.h"
+#include "Node.h"
+#include "JobSystem.h"
+#include "TransformSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtx/transform.hpp>
+
+using namespace melo;
+
+// the hierarchy melo::Node had before TransformSystem: every setter invalidates the whole subtree, world
+// transforms are recomputed on demand through the parents
+struct PointerNode
+{
+    virtual ~PointerNode() = default;
+
+    PointerNode* parent = nullptr;
+    std::vector<std::unique_ptr<PointerNode>> children;
+    glm::mat4 local = glm::mat4(1);
+    mutable glm::mat4 world = glm::mat4(1);
+    mutable bool invalidated = true;
+
+    void setTransform(const glm::mat4& transform)
+    {
+        local = transform;
+        invalidate();
+    }
+
+    void invalidate()
+    {
+        invalidated = true;
+        for (auto& child : children)
+            child->invalidate();
+    }
+
+    // Node::treeUpdate() visits every node
+    virtual void update() {}
+    void treeUpdate()
+    {
+        update();
+        for (auto& child : children)
+            child->treeUpdate();
+    }
+
+    const glm::mat4& getWorldTransform() const
+    {
+        if (invalidated)
+        {
+            world = parent ? parent->getWorldTransform() * local : local;
+            invalidated = false;
+        }
+        return world;
+    }
+};
+
+static glm::mat4 createTransform(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    return glm::translate(glm::vec3(dist(rng), dist(rng), dist(rng))) *
+           glm::toMat4(glm::angleAxis(dist(rng), glm::normalize(glm::vec3(dist(rng), dist(rng), dist(rng) + 2.0f))));
+}
+
+static float getMaxError(const glm::mat4& a, const glm::mat4& b)
+{
+    float maxError = 0;
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            maxError = std::max(maxError, std::abs(a[c][r] - b[c][r]));
+    return maxError;
+}
+
+// one tree of count transforms, node i > 0 is a child of parents[i] < i. Every frame moves the root or every
+// 10th node, then reads every world transform.
+int benchTransforms(int argc, char** argv)
+{
+    size_t count = (size_t)atoll(getArg(argc, argv, "--nodes", "100000"));
+    size_t fanout = std::max<size_t>(1, (size_t)atoll(getArg(argc, argv, "--fanout", "4")));
+    int frames = atoi(getArg(argc, argv, "--frames", "10"));
+
+    std::vector<size_t> parents(count, 0);
+    for (size_t i = 1; i < count; i++)
+        parents[i] = (i - 1) / fanout;
+
+    std::mt19937 rng(1);
+    std::vector<glm::mat4> locals(count);
+    for (auto& local : locals)
+        local = createTransform(rng);
+
+    // the three hierarchies hold the same transforms
+    std::vector<PointerNode*> pointerNodes(count);
+    auto pointerRoot = std::make_unique<PointerNode>();
+    pointerNodes[0] = pointerRoot.get();
+    std::vector<NodeRef> nodes(count);
+    nodes[0] = Node::create();
+    auto flat = TransformSystem::create();
+    std::vector<uint32_t> slots(count);
+    slots[0] = flat->allocate();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i > 0)
+        {
+            PointerNode* parent = pointerNodes[parents[i]];
+            parent->children.emplace_back(new PointerNode());
+            pointerNodes[i] = parent->children.back().get();
+            pointerNodes[i]->parent = parent;
+
+            nodes[i] = Node::create();
+            nodes[parents[i]]->addChild(nodes[i]);
+
+            slots[i] = flat->allocate();
+            flat->setParent(slots[i], slots[parents[i]]);
+        }
+        pointerNodes[i]->setTransform(locals[i]);
+        nodes[i]->setTransform(locals[i]);
+        flat->setLocal(slots[i], locals[i]);
+    }
+
+    auto jobs = JobSystem::getDefault();
+    printf("%zu nodes, fanout %zu, %zu + 1 threads, %d frames\n", count, fanout, jobs->getThreadCount(), frames);
+    printf("%-28s %12s %12s %14s\n", "", "root ms", "10% ms", "max error");
+
+    struct Mode
+    {
+        const char* name;
+        std::function<void(size_t, const glm::mat4&)> setLocal;
+        std::function<void()> update;
+        std::function<const glm::mat4&(size_t)> getWorld;
+    };
+    const Mode modes[] = {
+        {"pointer tree (old Node)", [&](size_t i, const glm::mat4& m) { pointerNodes[i]->setTransform(m); },
+         [&] { pointerRoot->treeUpdate(); },
+         [&](size_t i) -> const glm::mat4& { return pointerNodes[i]->getWorldTransform(); }},
+        {"melo::Node", [&](size_t i, const glm::mat4& m) { nodes[i]->setTransform(m); },
+         [&] { nodes[0]->treeUpdate(); },
+         [&](size_t i) -> const glm::mat4& { return nodes[i]->getWorldTransform(); }},
+        // invalidateTransform() only flags the node, treeUpdate() computes the local transform
+        {"melo::Node invalidated", [&](size_t i, const glm::mat4& m) { nodes[i]->setConstantTransform(m); },
+         [&] { nodes[0]->treeUpdate(); },
+         [&](size_t i) -> const glm::mat4& { return nodes[i]->getWorldTransform(); }},
+        {"TransformSystem serial", [&](size_t i, const glm::mat4& m) { flat->setLocal(slots[i], m); },
+         [&] { flat->update(slots[0]); }, [&](size_t i) -> const glm::mat4& { return flat->getWorld(slots[i]); }},
+        {"TransformSystem parallel", [&](size_t i, const glm::mat4& m) { flat->setLocal(slots[i], m); },
+         [&] { flat->update(slots[0], jobs.get()); },
+         [&](size_t i) -> const glm::mat4& { return flat->getWorld(slots[i]); }},
+    };
+
+    int result = 0;
+    std::vector<glm::mat4> reference(count);
+    for (const auto& mode : modes)
+    {
+        double ms[2] = {1e30, 1e30};
+        float maxError = 0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int pattern = 0; pattern < 2; pattern++)
+            {
+                // same sequence of transforms for every mode
+                std::mt19937 frameRng(frame * 2 + pattern);
+                BenchTimer timer;
+                if (pattern == 0)
+                {
+                    mode.setLocal(0, createTransform(frameRng));
+                }
+                else
+                {
+                    for (size_t i = frame % 10; i < count; i += 10)
+                        mode.setLocal(i, createTransform(frameRng));
+                }
+                mode.update();
+                glm::vec4 sum(0);
+                for (size_t i = 0; i < count; i++)
+                    sum += mode.getWorld(i)[3];
+                ms[pattern] = std::min(ms[pattern], timer.getMilliseconds());
+                if (sum.w != (float)count)
+                    printf("unexpected world transforms\n");
+            }
+        }
+
+        // every mode went through the same frames
+        for (size_t i = 0; i < count; i++)
+        {
+            if (&mode == &modes[0])
+                reference[i] = mode.getWorld(i);
+            else
+                maxError = std::max(maxError, getMaxError(mode.getWorld(i), reference[i]));
+        }
+        if (&mode == &modes[0])
+            printf("%-28s %12.3f %12.3f\n", mode.name, ms[0], ms[1]);
+        else
+            printf("%-28s %12.3f %12.3f %14g\n", mode.name, ms[0], ms[1], maxError);
+        if (maxError > 1e-3f)
+        {
+            printf("transforms: %s doesn't match the pointer tree\n", mode.name);
+            result = 1;
+        }
+    }
+    return result;
+}
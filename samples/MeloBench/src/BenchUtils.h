@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// path of MeloBench itself, benches re-launch it to measure each mode in a fresh process
+extern std::string gBenchExe;
+
+// live heap bytes and number of allocations so far, counted by the operator new replacement in MeloBench.cpp
+extern std::atomic<size_t> gHeapBytes;
+extern std::atomic<size_t> gHeapAllocations;
+
+struct BenchTimer
+{
+    BenchTimer() { reset(); }
+    void reset() { mStart = std::chrono::high_resolution_clock::now(); }
+    double getMilliseconds() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - mStart).count();
+    }
+
+  private:
+    std::chrono::high_resolution_clock::time_point mStart;
+};
+
+// peak resident set size of the process in bytes
+inline size_t getPeakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc = {};
+    GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+    return pmc.PeakWorkingSetSize;
+#else
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+inline double toMB(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+// runs "MeloBench <args>" in a child process so peak memory isn't polluted by the other modes
+inline int runBenchProcess(const std::string& args)
+{
+    std::string cmd = "\"" + gBenchExe + "\" " + args;
+    fflush(stdout);
+    return std::system(cmd.c_str());
+}
+
+inline bool hasArg(int argc, char** argv, const char* name)
+{
+    for (int i = 0; i < argc; i++)
+        if (std::string(argv[i]) == name) return true;
+    return false;
+}
+
+inline const char* getArg(int argc, char** argv, const char* name, const char* defaultValue)
+{
+    for (int i = 0; i + 1 < argc; i++)
+        if (std::string(argv[i]) == name) return argv[i + 1];
+    return defaultValue;
+}
@@ -0,0 +1,279 @@
+#include "BenchUtils.h"
+#include "VertexCache.h"
+#include "cigltf.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace melo;
+
+struct CacheMesh
+{
+    const char* name;
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+// a closed bumpy sphere, the bumps hide each other at grazing angles. Triangles in row order.
+static CacheMesh makeBumpySphere(uint32_t rings, uint32_t segments)
+{
+    CacheMesh mesh = {"bumpy sphere", {}, {}};
+    for (uint32_t ring = 0; ring <= rings; ring++)
+    {
+        float theta = 3.1415926f * ring / rings;
+        for (uint32_t segment = 0; segment < segments; segment++)
+        {
+            float phi = 6.2831853f * segment / segments;
+            float r = 1.0f + 0.3f * std::sin(theta * 8.0f) * std::sin(phi * 8.0f);
+            mesh.positions.emplace_back(r * std::sin(theta) * std::cos(phi), r * std::cos(theta),
+                                        r * std::sin(theta) * std::sin(phi));
+        }
+    }
+    for (uint32_t ring = 0; ring < rings; ring++)
+    {
+        for (uint32_t segment = 0; segment < segments; segment++)
+        {
+            uint32_t a = ring * segments + segment, b = ring * segments + (segment + 1) % segments;
+            uint32_t c = a + segments, d = b + segments;
+            mesh.indices.insert(mesh.indices.end(), {a, b, c, b, d, c});
+        }
+    }
+    return mesh;
+}
+
+// the same with its triangles and vertices shuffled, as exporters that sort by something else leave them
+static CacheMesh shuffleMesh(CacheMesh mesh)
+{
+    mesh.name = "shuffled bumpy sphere";
+    std::mt19937 rng(1);
+    std::vector<uint32_t> remap(mesh.positions.size());
+    for (uint32_t i = 0; i < remap.size(); i++)
+        remap[i] = i;
+    std::shuffle(remap.begin(), remap.end(), rng);
+    std::vector<glm::vec3> positions(mesh.positions.size());
+    for (size_t i = 0; i < remap.size(); i++)
+        positions[remap[i]] = mesh.positions[i];
+    mesh.positions = positions;
+    std::vector<std::array<uint32_t, 3>> triangles(mesh.indices.size() / 3);
+    for (size_t i = 0; i < triangles.size(); i++)
+        triangles[i] = {remap[mesh.indices[i * 3]], remap[mesh.indices[i * 3 + 1]], remap[mesh.indices[i * 3 + 2]]};
+    std::shuffle(triangles.begin(), triangles.end(), rng);
+    for (size_t i = 0; i < triangles.size(); i++)
+        std::copy(triangles[i].begin(), triangles[i].end(), mesh.indices.begin() + i * 3);
+    return mesh;
+}
+
+// the triangles as sorted rotations, equal for any order of the triangles and of their corners
+static std::vector<std::array<glm::vec3, 3>> getTriangleSet(const std::vector<glm::vec3>& positions,
+                                                            const std::vector<uint32_t>& indices)
+{
+    auto less = [](const glm::vec3& a, const glm::vec3& b) {
+        return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+    };
+    std::vector<std::array<glm::vec3, 3>> triangles;
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        std::array<glm::vec3, 3> t = {positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]]};
+        int first = less(t[1], t[0]) ? (less(t[2], t[1]) ? 2 : 1) : (less(t[2], t[0]) ? 2 : 0);
+        std::rotate(t.begin(), t.begin() + first, t.end());
+        triangles.push_back(t);
+    }
+    std::sort(triangles.begin(), triangles.end(), [&](const std::array<glm::vec3, 3>& a, const std::array<glm::vec3, 3>& b) {
+        for (int k = 0; k < 3; k++)
+        {
+            if (less(a[k], b[k]))
+                return true;
+            if (less(b[k], a[k]))
+                return false;
+        }
+        return false;
+    });
+    return triangles;
+}
+
+// fragments passing the depth test per covered pixel, averaged over orthographic views from around the mesh,
+// back faces culled
+static double measureOverdraw(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+{
+    const int size = 256;
+    const int viewCount = 16;
+    std::vector<float> depth(size * size);
+    size_t fragments = 0, covered = 0;
+    for (int view = 0; view < viewCount; view++)
+    {
+        // directions spread over the sphere
+        float y = 1.0f - (view + 0.5f) * 2.0f / viewCount, r = std::sqrt(1.0f - y * y);
+        float phi = view * 2.3999632f;
+        glm::vec3 forward(r * std::cos(phi), y, r * std::sin(phi));
+        glm::vec3 right = glm::normalize(glm::cross(forward, std::abs(y) < 0.9f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0)));
+        glm::vec3 up = glm::cross(right, forward);
+
+        std::fill(depth.begin(), depth.end(), FLT_MAX);
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            glm::vec3 s[3];
+            for (int k = 0; k < 3; k++)
+            {
+                const glm::vec3& p = positions[indices[i + k]];
+                s[k] = glm::vec3((glm::dot(p, right) * 0.35f + 0.5f) * size, (glm::dot(p, up) * 0.35f + 0.5f) * size,
+                                 glm::dot(p, forward));
+            }
+            float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[2].x - s[0].x) * (s[1].y - s[0].y);
+            if (!(area > 0))
+                continue;
+            int minX = std::max(0, (int)std::floor(std::min(s[0].x, std::min(s[1].x, s[2].x))));
+            int maxX = std::min(size - 1, (int)std::ceil(std::max(s[0].x, std::max(s[1].x, s[2].x))));
+            int minY = std::max(0, (int)std::floor(std::min(s[0].y, std::min(s[1].y, s[2].y))));
+            int maxY = std::min(size - 1, (int)std::ceil(std::max(s[0].y, std::max(s[1].y, s[2].y))));
+            for (int py = minY; py <= maxY; py++)
+            {
+                for (int px = minX; px <= maxX; px++)
+                {
+                    float x = px + 0.5f, y = py + 0.5f;
+                    float w0 = (s[2].x - s[1].x) * (y - s[1].y) - (s[2].y - s[1].y) * (x - s[1].x);
+                    float w1 = (s[0].x - s[2].x) * (y - s[2].y) - (s[0].y - s[2].y) * (x - s[2].x);
+                    float w2 = area - w0 - w1;
+                    if (w0 < 0 || w1 < 0 || w2 < 0)
+                        continue;
+                    float z = (w0 * s[0].z + w1 * s[1].z + w2 * s[2].z) / area;
+                    float& d = depth[py * size + px];
+                    if (z < d)
+                    {
+                        covered += d == FLT_MAX ? 1 : 0;
+                        d = z;
+                        fragments++;
+                    }
+                }
+            }
+        }
+    }
+    return (double)fragments / std::max<size_t>(1, covered);
+}
+
+// 64 byte lines the 12 byte vertices are read from through a direct mapped cache of 4 KB, per triangle
+static double getFetchMisses(const std::vector<uint32_t>& indices)
+{
+    const size_t LINE = 64, LINES = 64;
+    std::vector<size_t> tags(LINES, SIZE_MAX);
+    size_t misses = 0;
+    for (uint32_t index : indices)
+    {
+        size_t line = index * sizeof(glm::vec3) / LINE;
+        if (tags[line % LINES] != line)
+        {
+            tags[line % LINES] = line;
+            misses++;
+        }
+    }
+    return (double)misses / (indices.size() / 3);
+}
+
+// ACMR / ATVR of a FIFO cache before and after each stage, the overdraw of a software z-buffer, and checks that
+// the optimized meshes keep their triangles
+int benchVertexCache(int argc, char** argv)
+{
+    const char* path = argc > 0 && argv[0][0] != '-' ? argv[0] : nullptr;
+    uint32_t cacheSize = (uint32_t)atoi(getArg(argc, argv, "--cache", "16"));
+
+    std::vector<CacheMesh> meshes;
+    meshes.push_back(makeBumpySphere(256, 512));
+    meshes.push_back(shuffleMesh(meshes.back()));
+
+    int failures = 0;
+    for (auto& mesh : meshes)
+    {
+        auto before = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.positions.size(), cacheSize);
+        double overdrawBefore = measureOverdraw(mesh.positions, mesh.indices);
+        auto triangles = getTriangleSet(mesh.positions, mesh.indices);
+
+        std::vector<uint32_t> indices = mesh.indices;
+        BenchTimer timer;
+        optimizeVertexCache(indices.data(), indices.data(), indices.size(), mesh.positions.size(), cacheSize);
+        double cacheMs = timer.getMilliseconds();
+        auto afterCache = analyzeVertexCache(indices.data(), indices.size(), mesh.positions.size(), cacheSize);
+
+        timer.reset();
+        optimizeOverdraw(indices.data(), indices.data(), indices.size(), mesh.positions.data(), mesh.positions.size(),
+                         cacheSize);
+        double overdrawMs = timer.getMilliseconds();
+        auto afterOverdraw = analyzeVertexCache(indices.data(), indices.size(), mesh.positions.size(), cacheSize);
+        double overdrawAfter = measureOverdraw(mesh.positions, indices);
+        double orderedFetchMisses = getFetchMisses(indices);
+
+        timer.reset();
+        std::vector<uint32_t> remap(mesh.positions.size());
+        size_t vertexCount = optimizeVertexFetchRemap(remap.data(), indices.data(), indices.size(), mesh.positions.size());
+        remapIndices(indices.data(), indices.data(), indices.size(), remap.data());
+        std::vector<glm::vec3> positions = mesh.positions;
+        remapVertices(&positions, remap.data(), remap.size(), vertexCount);
+        double fetchMs = timer.getMilliseconds();
+
+        printf("%s: %zu triangles, %zu vertices, cache of %u\n", mesh.name, mesh.indices.size() / 3,
+               mesh.positions.size(), cacheSize);
+        printf("  %-22s %8s %8s %10s %14s %10s\n", "", "ACMR", "ATVR", "overdraw", "fetch misses", "ms");
+        printf("  %-22s %8.3f %8.3f %10.3f %14.3f\n", "source", before.acmr, before.atvr, overdrawBefore,
+               getFetchMisses(mesh.indices));
+        printf("  %-22s %8.3f %8.3f %10s %14s %10.2f\n", "vertex cache", afterCache.acmr, afterCache.atvr, "", "", cacheMs);
+        printf("  %-22s %8.3f %8.3f %10.3f %14.3f %10.2f\n", "overdraw clusters", afterOverdraw.acmr, afterOverdraw.atvr,
+               overdrawAfter, orderedFetchMisses, overdrawMs);
+        printf("  %-22s %8s %8s %10s %14.3f %10.2f\n", "vertex fetch remap", "", "", "", getFetchMisses(indices), fetchMs);
+
+        if (getTriangleSet(positions, indices) != triangles)
+        {
+            printf("  the optimized triangles differ from the source ones\n");
+            failures++;
+        }
+        if (afterOverdraw.acmr > afterCache.acmr * 1.05f + 0.01f || afterCache.acmr > before.acmr + 0.01f)
+        {
+            printf("  the ACMR got worse\n");
+            failures++;
+        }
+    }
+
+    if (path)
+    {
+        // the index buffers of every triangle primitive as loaded, then with ModelGLTF::Option::optimizeIndices
+        size_t transforms[2] = {}, triangles[2] = {}, vertices[2] = {};
+        double ms[2];
+        for (int optimized = 0; optimized < 2; optimized++)
+        {
+            ModelGLTF::Option option;
+            option.loadTextures = false;
+            option.optimizeIndices = optimized != 0;
+            BenchTimer timer;
+            auto model = ModelGLTF::create(path, option);
+            ms[optimized] = timer.getMilliseconds();
+            if (!model)
+                return 1;
+            for (const auto& mesh : model->meshes)
+            {
+                for (const auto& primitive : mesh->primitives)
+                {
+                    if (!primitive->indices || !primitive->positions || primitive->primitiveMode != MODE_TRIANGLES)
+                        continue;
+                    size_t indexCount = primitive->indices->getSize() / sizeof(uint32_t);
+                    auto stats = analyzeVertexCache((const uint32_t*)primitive->indices->getData(), indexCount,
+                                                    primitive->positions->getSize() / sizeof(glm::vec3), cacheSize);
+                    transforms[optimized] += stats.vertexTransforms;
+                    triangles[optimized] += indexCount / 3;
+                    vertices[optimized] += stats.atvr > 0 ? (size_t)std::lround(stats.vertexTransforms / stats.atvr) : 0;
+                }
+            }
+        }
+        printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, loaded in %.1f ms, %.1f ms with optimizeIndices\n", path,
+               (double)transforms[0] / std::max<size_t>(1, triangles[0]),
+               (double)transforms[1] / std::max<size_t>(1, triangles[1]),
+               (double)transforms[0] / std::max<size_t>(1, vertices[0]),
+               (double)transforms[1] / std::max<size_t>(1, vertices[1]), ms[0], ms[1]);
+    }
+
+    if (failures)
+    {
+        printf("vertex-cache: %d meshes lost triangles or cache efficiency\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Command line benchmarks for the CINDER_LESS parts of melo.
+//
+// Build with CMakeLists.txt next to src, e.g.
+//   cmake -S . -B build -DGLM_INCLUDE_DIR=/path/to/glm/parent -DMELO_BENCH_AVX2=ON
+//   cmake --build build --config Release
+// GLM_INCLUDE_DIR defaults to Cinder's include folder, MELO_BENCH_AVX2 benchmarks the AVX2 kernels instead of the
+// SSE2 ones.
+
+#include "BenchUtils.h"
+
+#include <cstring>
+#include <new>
+
+std::string gBenchExe;
+std::atomic<size_t> gHeapBytes(0);
+std::atomic<size_t> gHeapAllocations(0);
+
+// every allocation carries its size in front so the live heap can be tracked
+static const size_t kHeapHeader = 16;
+
+void* operator new(size_t size)
+{
+    auto ptr = (uint8_t*)malloc(size + kHeapHeader);
+    if (!ptr)
+        throw std::bad_alloc();
+    *(size_t*)ptr = size;
+    gHeapBytes += size;
+    gHeapAllocations++;
+    return ptr + kHeapHeader;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (!ptr)
+        return;
+    auto base = (uint8_t*)ptr - kHeapHeader;
+    gHeapBytes -= *(size_t*)base;
+    free(base);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, size_t) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { operator delete(ptr); }
+
+int benchGltfLoad(int argc, char** argv);
+int benchGltfCompact(int argc, char** argv);
+int benchGltfPipeline(int argc, char** argv);
+int benchAccessorRead(int argc, char** argv);
+int benchMeshopt(int argc, char** argv);
+int benchSceneCache(int argc, char** argv);
+int benchAnimation(int argc, char** argv);
+int benchAnimationBatch(int argc, char** argv);
+int benchAnimationCompress(int argc, char** argv);
+int benchSkinning(int argc, char** argv);
+int benchMorph(int argc, char** argv);
+int benchTransforms(int argc, char** argv);
+int benchPicking(int argc, char** argv);
+int benchCulling(int argc, char** argv);
+int benchRenderQueue(int argc, char** argv);
+int benchOcclusion(int argc, char** argv);
+int benchLod(int argc, char** argv);
+int benchVertexCache(int argc, char** argv);
+int benchObjIndex(int argc, char** argv);
+int benchObjParse(int argc, char** argv);
+int benchObjGeometry(int argc, char** argv);
+int benchProgramCache(int argc, char** argv);
+int benchPlyLoad(int argc, char** argv);
+
+struct BenchEntry
+{
+    const char* name;
+    int (*func)(int argc, char** argv);
+    const char* usage;
+};
+
+static const BenchEntry kBenches[] = {
+    {"gltf-load", benchGltfLoad, "gltf-load model.glb [--mode copy|mapped]"},
+    {"gltf-compact", benchGltfCompact, "gltf-compact model.glb [--mode source|objects|compact]"},
+    {"gltf-pipeline", benchGltfPipeline, "gltf-pipeline model.glb [--mode serial|parallel] [--threads n] [--mapped]"},
+    {"accessor-read", benchAccessorRead, "accessor-read [--count n]"},
+    {"gltf-meshopt", benchMeshopt, "gltf-meshopt model.glb"},
+    {"gltf-cache", benchSceneCache, "gltf-cache model.glb [--mode nocache|cold|warm] [--textures]"},
+    {"anim-sample", benchAnimation, "anim-sample [--frames n]"},
+    {"anim-batch", benchAnimationBatch, "anim-batch [--clips n] [--channels n] [--keys n] [--rate fps] [--frames n]"},
+    {"anim-compress", benchAnimationCompress,
+     "anim-compress [model.glb] [--channels n] [--keys n] [--fps f] [--tolerance t] [--rotation-tolerance t]"},
+    {"skin", benchSkinning, "skin [model.glb] [--vertices n] [--joints n]"},
+    {"morph", benchMorph, "morph [model.glb] [--vertices n] [--targets n] [--active n] [--coverage f]"},
+    {"transforms", benchTransforms, "transforms [--nodes n] [--fanout n] [--frames n]"},
+    {"pick", benchPicking, "pick [--triangles n] [--instances n] [--shapes n] [--rays n] [--verify n]"},
+    {"cull", benchCulling, "cull [--nodes n] [--group n] [--frames n]"},
+    {"render-queue", benchRenderQueue,
+     "render-queue [--nodes n] [--shaders n] [--materials n] [--meshes n] [--pairs n] [--min-instances n] [--frames n]"},
+    {"occlusion", benchOcclusion, "occlusion [--nodes n] [--walls n] [--width n] [--height n] [--frames n]"},
+    {"lod", benchLod, "lod [model.glb] [--levels n] [--ratio f] [--instances n] [--frames n]"},
+    {"vertex-cache", benchVertexCache, "vertex-cache [model.glb] [--cache n]"},
+    {"obj-index", benchObjIndex, "obj-index [model.obj] [--size n]"},
+    {"obj-parse", benchObjParse, "obj-parse [model.obj] [--size n] [--relative] [--mode tinyobj|yocto|melo|melo-scene]"},
+    {"obj-geometry", benchObjGeometry, "obj-geometry [--size n]"},
+    {"program-cache", benchProgramCache, "program-cache [--materials n] [--assets dir]"},
+    {"ply-load", benchPlyLoad,
+     "ply-load [model.ply] [--vertices n] [--big-endian] [--normals] [--skip-yocto] [--mode yocto|melo]"},
+};
+
+int main(int argc, char** argv)
+{
+    gBenchExe = argv[0];
+
+    if (argc >= 2)
+    {
+        for (const auto& bench : kBenches)
+        {
+            if (strcmp(argv[1], bench.name) == 0)
+                return bench.func(argc - 2, argv + 2);
+        }
+    }
+
+    printf("Usage: MeloBench <bench> [args]\n");
+    for (const auto& bench : kBenches)
+        printf("    %s\n", bench.usage);
+    return 1;
+}
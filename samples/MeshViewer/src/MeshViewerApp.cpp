@@ -7,6 +7,7 @@
 #include <cinder/ObjLoader.h>
 #include <cinder/FileWatcher.h>
 #include <cinder/Timer.h>
+#include <cinder/Utilities.h>
 
 #include "CZipFileSystem.h"
 #include "CVirtualFileSystem.h"
@@ -22,6 +23,12 @@
 //#include "GltfNode.h"
 #include "NodeExt.h"
 #include "FirstPersonCamera.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "MeshLod.h"
+#include "OcclusionCuller.h"
+#include "ProgramCache.h"
+#include "RenderQueue.h"
 
 // imgui
 #include "MiniConfigImgui.h"
@@ -172,7 +179,8 @@ struct ShadowMapPass
         });
     }
 
-    const gl::Texture2dRef& draw(melo::NodeRef scene)
+    // queue draws its DRAW_SHADOW packets instead of a treeDraw() of scene
+    const gl::Texture2dRef& draw(melo::NodeRef scene, const melo::RenderQueue* queue = nullptr)
     {
         gl::ScopedDepth enableDepthRW(true);
         ScopedMarker scp("shadowMap", true);
@@ -188,7 +196,15 @@ struct ShadowMapPass
             gl::ScopedFramebuffer bindFbo(mShadowMap->getFbo());
             gl::ScopedGlslProg glsl(mPassthroughShader);
             gl::clear();
-            scene->treeDraw(melo::DRAW_SHADOW);
+            if (queue)
+            {
+                melo::GlRenderBackend backend;
+                queue->draw(melo::DRAW_SHADOW, backend);
+            }
+            else
+            {
+                scene->treeDraw(melo::DRAW_SHADOW);
+            }
         }
 
         return mShadowMap->getTexture();
@@ -225,6 +241,11 @@ struct MeloViewer : public App
     melo::NodeRef mGridNode;
 
     melo::NodeRef mPickedNode, mMouseHitNode;
+    melo::PickingSceneRef mPicking = melo::PickingScene::create();
+    vector<melo::NodeRef> mPickingSources; // the GltfScene and MeshNode nodes in mPicking
+    melo::FrustumCullerRef mCuller = melo::FrustumCuller::create();
+    melo::OcclusionCullerRef mOcclusion = melo::OcclusionCuller::create();
+    melo::RenderQueueRef mRenderQueue = melo::RenderQueue::create();
     //AnimationGLTF::Ref mPickedAnimation;
     mat4 mPickedTransform;
 
@@ -247,6 +268,47 @@ struct MeloViewer : public App
         mScene->addChild(mLightNode);
     }
 
+    // rebuilds mPicking and the occluders when meshes were added or removed, only refits mPicking when they moved
+    void updatePicking(bool refit = true)
+    {
+        vector<melo::NodeRef> sources;
+        mScene->treeVisitor([&](melo::NodeRef node) {
+            if (dynamic_pointer_cast<GltfScene>(node) || dynamic_pointer_cast<melo::MeshNode>(node))
+                sources.push_back(node);
+            });
+
+        if (sources != mPickingSources)
+        {
+            mPicking->clear();
+            for (auto& source : sources)
+            {
+                if (auto gltfScene = dynamic_pointer_cast<GltfScene>(source))
+                    gltfScene->addToPicking(*mPicking);
+                else
+                    dynamic_pointer_cast<melo::MeshNode>(source)->addToPicking(*mPicking);
+            }
+            mPickingSources = move(sources);
+            // addToPicking() sets the bounds of the glTF nodes
+            mCuller->invalidate();
+
+            // the same meshes hide what is behind them, dense ones cost more to rasterize than they hide
+            mOcclusion->clear();
+            vector<uint32_t> occluderShapes(mPicking->getShapeCount(), melo::OcclusionCuller::INVALID);
+            vector<vec3> positions;
+            vector<uint32_t> indices;
+            for (uint32_t shape = 0; shape < (uint32_t)occluderShapes.size(); shape++)
+            {
+                mPicking->getShape(shape, &positions, &indices);
+                if (indices.size() / 3 <= 65536)
+                    occluderShapes[shape] = mOcclusion->addShape(positions.data(), positions.size(), indices.data(), indices.size());
+            }
+            for (uint32_t instance = 0; instance < (uint32_t)mPicking->getInstanceCount(); instance++)
+                mOcclusion->addOccluder(occluderShapes[mPicking->getInstanceShape(instance)], mPicking->getInstanceNode(instance));
+        }
+        if (refit)
+            mPicking->refit();
+    }
+
     void deletePickedNode()
     {
         if (!mPickedNode) return;
@@ -337,6 +399,38 @@ struct MeloViewer : public App
             if (ImGui::BeginTabItem("Settings"))
             {
                 vnm::drawFrameTime();
+                auto programCache = melo::ProgramCache::getDefault();
+                const auto& programStats = programCache->getStats();
+                ImGui::Text("Programs: %zu for %zu requests, %zu compiles (%zu failed), %.1f ms",
+                    programCache->getProgramCount(), programStats.requestCount, programStats.compileCount,
+                    programStats.failureCount, programStats.compileMilliseconds);
+                if (FRUSTUM_CULLING)
+                {
+                    const auto& stats = mCuller->getStats();
+                    ImGui::Text("Culling: %zu visible, %zu culled of %zu nodes, %.3f ms", stats.visibleCount,
+                        stats.culledCount, stats.nodeCount, stats.milliseconds);
+                    if (OCCLUSION_CULLING)
+                    {
+                        const auto& occlusionStats = mOcclusion->getStats();
+                        ImGui::Text("Occlusion: %zu occluded, %zu occluders, %zu triangles, %.3f ms",
+                            stats.occludedCount, occlusionStats.occluderCount, occlusionStats.triangleCount,
+                            occlusionStats.milliseconds);
+                    }
+                }
+                if (RENDER_QUEUE)
+                {
+                    ImGui::Text("Render queue: %zu solid, %zu transparent, %zu shadow packets",
+                        mRenderQueue->getPacketCount(melo::DRAW_SOLID),
+                        mRenderQueue->getPacketCount(melo::DRAW_TRANSPARENCY),
+                        mRenderQueue->getPacketCount(melo::DRAW_SHADOW));
+                    ImGui::Text("Draw calls: %zu solid, %zu transparent, %zu shadow, %zu instanced",
+                        mRenderQueue->getDrawCount(melo::DRAW_SOLID),
+                        mRenderQueue->getDrawCount(melo::DRAW_TRANSPARENCY),
+                        mRenderQueue->getDrawCount(melo::DRAW_SHADOW),
+                        mRenderQueue->getInstancedDrawCount(melo::DRAW_SOLID) +
+                            mRenderQueue->getInstancedDrawCount(melo::DRAW_TRANSPARENCY) +
+                            mRenderQueue->getInstancedDrawCount(melo::DRAW_SHADOW));
+                }
                 if (RENDER_DOC_ENABLED)
                 {
                     if (ImGui::Button("Capture RenderDoc"))
@@ -422,7 +516,7 @@ struct MeloViewer : public App
                         if (ImGui::Button(anim->name.c_str()))
                         {
                             mPickedAnimation = anim;
-                            anim->startAnimation();
+                            gltfNode->playAnimation(anim);
                         }
                     }
 
@@ -611,7 +705,8 @@ struct MeloViewer : public App
             });
 
         getWindow()->getSignalMouseMove().connect([&](MouseEvent& event) {
-            mMouseHitNode = pick(mScene, *mCurrentCam, event.getPos());
+            updatePicking();
+            mMouseHitNode = melo::pick(*mPicking, *mCurrentCam, event.getPos()).node;
             });
 
         getWindow()->getSignalMouseUp().connect([&](MouseEvent& event) {
@@ -737,15 +832,6 @@ struct MeloViewer : public App
 
             mShadowMapPass.mLight.camera.lookAt(mLightNode->getPosition(), { 0,0,0 });
 
-#if 0
-            Frustumf frustrum(*mCurrentCam);
-
-            for (auto& child : mScene->getChildren())
-            {
-                //mModel->flipV = FLIP_V;
-                child->setVisible(child->isInsideFrustrum(frustrum));
-            }
-#endif
             if (GUI_VISIBLE)
             {
                 ScopedMarker scp("drawGUI", false);
@@ -776,7 +862,40 @@ struct MeloViewer : public App
             if (mToCaptureRdc)
                 mRdc.startCapture();
 
-            auto texShadowMap = mShadowMapPass.draw(mScene);
+            auto& lodSettings = melo::getLodSettings();
+            lodSettings.enabled = LOD_ENABLED;
+            lodSettings.pixelError = LOD_PIXEL_ERROR;
+
+            // the shadow pass sees more than the camera, only the main pass is culled
+            melo::FrustumCuller* culler = nullptr;
+            if (FRUSTUM_CULLING)
+            {
+                ScopedMarker scp("cull", false);
+                auto viewProjection = mCurrentCam->getProjectionMatrix() * mCurrentCam->getViewMatrix();
+                auto jobs = melo::JobSystem::getDefault().get();
+                melo::OcclusionCuller* occlusion = nullptr;
+                if (OCCLUSION_CULLING)
+                {
+                    updatePicking(false);
+                    mOcclusion->render(viewProjection, jobs);
+                    occlusion = mOcclusion.get();
+                }
+                mCuller->cull(mScene, viewProjection, jobs, occlusion);
+                culler = mCuller.get();
+            }
+
+            // one walk of the tree for every pass, instead of a treeDraw() per pass
+            melo::RenderQueue* queue = nullptr;
+            melo::GlRenderBackend backend;
+            if (RENDER_QUEUE)
+            {
+                ScopedMarker scp("renderQueue", false);
+                mRenderQueue->setInstancing(INSTANCING ? 2 : 0);
+                mRenderQueue->build(mScene, mCurrentCam->getViewMatrix(), culler);
+                queue = mRenderQueue.get();
+            }
+
+            auto texShadowMap = mShadowMapPass.draw(mScene, queue);
 
             {
                 // main pass
@@ -802,7 +921,15 @@ struct MeloViewer : public App
 
                     gl::enableDepthRead();
                     gl::disableAlphaBlending();
-                    mScene->treeDraw(melo::DRAW_SOLID);
+                    if (queue)
+                    {
+                        GltfScene::bindEnvironment();
+                        queue->draw(melo::DRAW_SOLID, backend);
+                    }
+                    else
+                    {
+                        mScene->treeDraw(melo::DRAW_SOLID, culler);
+                    }
                 }
                 
                 {
@@ -810,7 +937,10 @@ struct MeloViewer : public App
 
                     gl::enableAlphaBlending();
                     gl::disableDepthRead();
-                    mScene->treeDraw(melo::DRAW_TRANSPARENCY);
+                    if (queue)
+                        queue->draw(melo::DRAW_TRANSPARENCY, backend);
+                    else
+                        mScene->treeDraw(melo::DRAW_TRANSPARENCY, culler);
                 }
 
                 gl::disableWireframe();
@@ -862,7 +992,9 @@ struct MeloViewer : public App
     {
         Timer timer(true);
         
-        auto newModel = GltfScene::create(path);
+        // the caches stay out of the asset folders, which may be read-only or under version control
+        auto newModel = GltfScene::create(path, SCENE_CACHE, (uint32_t)LOD_LEVELS, OPTIMIZE_MESHES,
+                                          getTemporaryDirectory() / "MeshViewer");
         if (newModel)
         {
             mScene->addChild(newModel);
@@ -997,6 +1129,48 @@ void GltfScene::update(double elapsed)
     });
 }
 
+// camera, exposure and light uniforms of the pbr programs
+static void setViewUniforms(const gl::GlslProgRef& glsl, const GltfScene* scene)
+{
+    auto app = (MeloViewer*)App::get();
+    mat3 rotMatrix3 = {};
+    glsl->uniform("u_envRotation", rotMatrix3);
+    glsl->uniform("u_Camera", app->mCurrentCam->getEyePoint());
+    glsl->uniform("u_Exposure", EXPOSURE);
+    glsl->uniform("u_MipCount", IBL_MIP);
+    glsl->uniform("u_Lights[0].direction", scene->lights[0].direction);
+    glsl->uniform("u_Lights[0].range", scene->lights[0].range);
+    glsl->uniform("u_Lights[0].color", scene->lights[0].color);
+    glsl->uniform("u_Lights[0].intensity", scene->lights[0].intensity);
+    glsl->uniform("u_Lights[0].position", scene->lights[0].position);
+    glsl->uniform("u_Lights[0].innerConeCos", scene->lights[0].innerConeCos);
+    glsl->uniform("u_Lights[0].outerConeCos", scene->lights[0].outerConeCos);
+    glsl->uniform("u_Lights[0].type", scene->lights[0].type);
+}
+
+void GltfNode::drawInstances(melo::DrawOrder order, uint32_t item, const glm::mat4* transforms, uint32_t count)
+{
+    unique_ptr<ScopedMarker> scp;
+    if (PROFILE_NODE_DRAW)
+    {
+        scp = make_unique<ScopedMarker>("nodeDrawInstances", true);
+    }
+
+    if (scene->isMaterialDirty)
+    {
+        reloadMaterial();
+    }
+    if (!material || !material->getInstancedGlsl())
+    {
+        melo::Node::drawInstances(order, item, transforms, count);
+        return;
+    }
+    setViewUniforms(material->getInstancedGlsl(), scene);
+    material->bind(true);
+    drawMesh(order, transforms, count);
+    material->unbind();
+}
+
 void GltfNode::draw(melo::DrawOrder order)
 {
     unique_ptr<ScopedMarker> scp;
@@ -1005,35 +1179,22 @@ void GltfNode::draw(melo::DrawOrder order)
         scp = make_unique<ScopedMarker>("nodeDraw", true);
     }
 
-    auto app = (MeloViewer*)App::get();
     if (scene->isMaterialDirty)
     {
        reloadMaterial();
     }
     if (material && material->glsl)
     {
-        mat3 rotMatrix3 = {};
-        material->glsl->uniform("u_envRotation", rotMatrix3);
-        material->glsl->uniform("u_Camera", app->mCurrentCam->getEyePoint());
-        material->glsl->uniform("u_Exposure", EXPOSURE);
-        material->glsl->uniform("u_MipCount", IBL_MIP);
-        material->glsl->uniform("u_Lights[0].direction", scene->lights[0].direction);
-        material->glsl->uniform("u_Lights[0].range", scene->lights[0].range);
-        material->glsl->uniform("u_Lights[0].color", scene->lights[0].color);
-        material->glsl->uniform("u_Lights[0].intensity", scene->lights[0].intensity);
-        material->glsl->uniform("u_Lights[0].position", scene->lights[0].position);
-        material->glsl->uniform("u_Lights[0].innerConeCos", scene->lights[0].innerConeCos);
-        material->glsl->uniform("u_Lights[0].outerConeCos", scene->lights[0].outerConeCos);
-        material->glsl->uniform("u_Lights[0].type", scene->lights[0].type);
+        setViewUniforms(material->glsl, scene);
         material->bind();
-        gl::draw(mesh);
+        drawMesh(order);
         material->unbind();
     }
     else
     {
         static auto glsl = am::glslProg("lambert");
         gl::ScopedGlslProg scopedGlsl(glsl);
-        gl::draw(mesh);
+        drawMesh(order);
     }
 }
 
@@ -0,0 +1,401 @@
+#include "../include/AccessorReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MELO_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MELO_SSE2
+#endif
+
+namespace melo
+{
+    // glTF component types
+    enum
+    {
+        BYTE = 5120,
+        UNSIGNED_BYTE = 5121,
+        SHORT = 5122,
+        UNSIGNED_SHORT = 5123,
+        INT = 5124,
+        UNSIGNED_INT = 5125,
+        FLOAT = 5126,
+        DOUBLE = 5130,
+    };
+
+    size_t getComponentSize(uint32_t componentType)
+    {
+        switch (componentType)
+        {
+        case BYTE:
+        case UNSIGNED_BYTE: return 1;
+        case SHORT:
+        case UNSIGNED_SHORT: return 2;
+        case INT:
+        case UNSIGNED_INT:
+        case FLOAT: return 4;
+        case DOUBLE: return 8;
+        default: return 0;
+        }
+    }
+
+    const char* getSimdName()
+    {
+#if defined(MELO_AVX2)
+        return "AVX2";
+#elif defined(MELO_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+    // scale applied after the int -> float conversion, 1 if not normalized
+    static float getNormalizeScale(uint32_t componentType, bool normalized)
+    {
+        if (!normalized)
+            return 1.0f;
+        switch (componentType)
+        {
+        case BYTE: return 1.0f / 127.0f;
+        case UNSIGNED_BYTE: return 1.0f / 255.0f;
+        case SHORT: return 1.0f / 32767.0f;
+        case UNSIGNED_SHORT: return 1.0f / 65535.0f;
+        case UNSIGNED_INT: return 1.0f / 4294967295.0f;
+        default: return 1.0f;
+        }
+    }
+
+    // signed normalized values are clamped to -1, the smallest value has no positive counterpart
+    static bool isClamped(uint32_t componentType, bool normalized)
+    {
+        return normalized && (componentType == BYTE || componentType == SHORT);
+    }
+
+    template <typename T>
+    static void toFloatScalar(const T* src, size_t count, float scale, bool clamp, float* dst)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            float value = (float)src[i] * scale;
+            dst[i] = clamp ? std::max(value, -1.0f) : value;
+        }
+    }
+
+    template <typename T>
+    static void toUintScalar(const T* src, size_t count, uint32_t* dst)
+    {
+        for (size_t i = 0; i < count; i++)
+            dst[i] = (uint32_t)src[i];
+    }
+
+    void convertToFloatScalar(const void* src, uint32_t componentType, bool normalized, size_t count, float* dst)
+    {
+        float scale = getNormalizeScale(componentType, normalized);
+        bool clamp = isClamped(componentType, normalized);
+        switch (componentType)
+        {
+        case BYTE: toFloatScalar((const int8_t*)src, count, scale, clamp, dst); break;
+        case UNSIGNED_BYTE: toFloatScalar((const uint8_t*)src, count, scale, clamp, dst); break;
+        case SHORT: toFloatScalar((const int16_t*)src, count, scale, clamp, dst); break;
+        case UNSIGNED_SHORT: toFloatScalar((const uint16_t*)src, count, scale, clamp, dst); break;
+        case INT: toFloatScalar((const int32_t*)src, count, scale, clamp, dst); break;
+        case UNSIGNED_INT: toFloatScalar((const uint32_t*)src, count, scale, clamp, dst); break;
+        case FLOAT: memcpy(dst, src, count * sizeof(float)); break;
+        case DOUBLE: toFloatScalar((const double*)src, count, scale, clamp, dst); break;
+        }
+    }
+
+    void convertToUintScalar(const void* src, uint32_t componentType, size_t count, uint32_t* dst)
+    {
+        switch (componentType)
+        {
+        case BYTE: toUintScalar((const int8_t*)src, count, dst); break;
+        case UNSIGNED_BYTE: toUintScalar((const uint8_t*)src, count, dst); break;
+        case SHORT: toUintScalar((const int16_t*)src, count, dst); break;
+        case UNSIGNED_SHORT: toUintScalar((const uint16_t*)src, count, dst); break;
+        case INT:
+        case UNSIGNED_INT: memcpy(dst, src, count * sizeof(uint32_t)); break;
+        case FLOAT: toUintScalar((const float*)src, count, dst); break;
+        case DOUBLE: toUintScalar((const double*)src, count, dst); break;
+        }
+    }
+
+#if defined(MELO_AVX2)
+    static inline void storeFloats(float* dst, __m256i ints, __m256 scale, bool clamp)
+    {
+        __m256 value = _mm256_mul_ps(_mm256_cvtepi32_ps(ints), scale);
+        if (clamp)
+            value = _mm256_max_ps(value, _mm256_set1_ps(-1.0f));
+        _mm256_storeu_ps(dst, value);
+    }
+
+    // cvtepi32_ps is signed, the upper and lower halves are converted separately
+    static inline void storeFloatsU32(float* dst, __m256i ints, __m256 scale)
+    {
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_srli_epi32(ints, 16));
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_and_si256(ints, _mm256_set1_epi32(0xFFFF)));
+        __m256 value = _mm256_add_ps(_mm256_mul_ps(hi, _mm256_set1_ps(65536.0f)), lo);
+        _mm256_storeu_ps(dst, _mm256_mul_ps(value, scale));
+    }
+
+    void convertToFloat(const void* src, uint32_t componentType, bool normalized, size_t count, float* dst)
+    {
+        __m256 scale = _mm256_set1_ps(getNormalizeScale(componentType, normalized));
+        bool clamp = isClamped(componentType, normalized);
+        size_t i = 0;
+        switch (componentType)
+        {
+        case BYTE:
+            for (auto p = (const int8_t*)src; i + 8 <= count; i += 8)
+                storeFloats(dst + i, _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(p + i))), scale, clamp);
+            break;
+        case UNSIGNED_BYTE:
+            for (auto p = (const uint8_t*)src; i + 8 <= count; i += 8)
+                storeFloats(dst + i, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p + i))), scale, clamp);
+            break;
+        case SHORT:
+            for (auto p = (const int16_t*)src; i + 8 <= count; i += 8)
+                storeFloats(dst + i, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(p + i))), scale, clamp);
+            break;
+        case UNSIGNED_SHORT:
+            for (auto p = (const uint16_t*)src; i + 8 <= count; i += 8)
+                storeFloats(dst + i, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(p + i))), scale, clamp);
+            break;
+        case UNSIGNED_INT:
+            for (auto p = (const uint32_t*)src; i + 8 <= count; i += 8)
+                storeFloatsU32(dst + i, _mm256_loadu_si256((const __m256i*)(p + i)), scale);
+            break;
+        }
+        size_t componentSize = getComponentSize(componentType);
+        convertToFloatScalar((const uint8_t*)src + i * componentSize, componentType, normalized, count - i, dst + i);
+    }
+
+    void convertToUint(const void* src, uint32_t componentType, size_t count, uint32_t* dst)
+    {
+        size_t i = 0;
+        switch (componentType)
+        {
+        case UNSIGNED_BYTE:
+            for (auto p = (const uint8_t*)src; i + 8 <= count; i += 8)
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p + i))));
+            break;
+        case UNSIGNED_SHORT:
+            for (auto p = (const uint16_t*)src; i + 8 <= count; i += 8)
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(p + i))));
+            break;
+        }
+        size_t componentSize = getComponentSize(componentType);
+        convertToUintScalar((const uint8_t*)src + i * componentSize, componentType, count - i, dst + i);
+    }
+#elif defined(MELO_SSE2)
+    static inline void storeFloats(float* dst, __m128i ints, __m128 scale, bool clamp)
+    {
+        __m128 value = _mm_mul_ps(_mm_cvtepi32_ps(ints), scale);
+        if (clamp)
+            value = _mm_max_ps(value, _mm_set1_ps(-1.0f));
+        _mm_storeu_ps(dst, value);
+    }
+
+    // cvtepi32_ps is signed, the upper and lower halves are converted separately
+    static inline void storeFloatsU32(float* dst, __m128i ints, __m128 scale)
+    {
+        __m128 hi = _mm_cvtepi32_ps(_mm_srli_epi32(ints, 16));
+        __m128 lo = _mm_cvtepi32_ps(_mm_and_si128(ints, _mm_set1_epi32(0xFFFF)));
+        __m128 value = _mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.0f)), lo);
+        _mm_storeu_ps(dst, _mm_mul_ps(value, scale));
+    }
+
+    // SSE2 has no sign / zero extension, values are unpacked into the upper half and shifted back
+    static inline __m128i signExtendLo16(__m128i v) { return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16); }
+    static inline __m128i signExtendHi16(__m128i v) { return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16); }
+
+    void convertToFloat(const void* src, uint32_t componentType, bool normalized, size_t count, float* dst)
+    {
+        __m128 scale = _mm_set1_ps(getNormalizeScale(componentType, normalized));
+        bool clamp = isClamped(componentType, normalized);
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        switch (componentType)
+        {
+        case BYTE:
+            for (auto p = (const int8_t*)src; i + 16 <= count; i += 16)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+                __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+                __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+                storeFloats(dst + i, signExtendLo16(lo), scale, clamp);
+                storeFloats(dst + i + 4, signExtendHi16(lo), scale, clamp);
+                storeFloats(dst + i + 8, signExtendLo16(hi), scale, clamp);
+                storeFloats(dst + i + 12, signExtendHi16(hi), scale, clamp);
+            }
+            break;
+        // UNSIGNED_BYTE is left to the scalar loop: compilers vectorize it with the same unpacks and peel the
+        // stores to an aligned address, which the kernel here lost to in accessor-read
+        case SHORT:
+            for (auto p = (const int16_t*)src; i + 8 <= count; i += 8)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+                storeFloats(dst + i, signExtendLo16(v), scale, clamp);
+                storeFloats(dst + i + 4, signExtendHi16(v), scale, clamp);
+            }
+            break;
+        case UNSIGNED_SHORT:
+            for (auto p = (const uint16_t*)src; i + 8 <= count; i += 8)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+                storeFloats(dst + i, _mm_unpacklo_epi16(v, zero), scale, clamp);
+                storeFloats(dst + i + 4, _mm_unpackhi_epi16(v, zero), scale, clamp);
+            }
+            break;
+        case UNSIGNED_INT:
+            for (auto p = (const uint32_t*)src; i + 4 <= count; i += 4)
+                storeFloatsU32(dst + i, _mm_loadu_si128((const __m128i*)(p + i)), scale);
+            break;
+        }
+        size_t componentSize = getComponentSize(componentType);
+        convertToFloatScalar((const uint8_t*)src + i * componentSize, componentType, normalized, count - i, dst + i);
+    }
+
+    void convertToUint(const void* src, uint32_t componentType, size_t count, uint32_t* dst)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        switch (componentType)
+        {
+        case UNSIGNED_BYTE:
+            for (auto p = (const uint8_t*)src; i + 16 <= count; i += 16)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+                __m128i lo = _mm_unpacklo_epi8(v, zero);
+                __m128i hi = _mm_unpackhi_epi8(v, zero);
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(lo, zero));
+                _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+                _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+                _mm_storeu_si128((__m128i*)(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+            }
+            break;
+        case UNSIGNED_SHORT:
+            for (auto p = (const uint16_t*)src; i + 8 <= count; i += 8)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(v, zero));
+                _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(v, zero));
+            }
+            break;
+        }
+        size_t componentSize = getComponentSize(componentType);
+        convertToUintScalar((const uint8_t*)src + i * componentSize, componentType, count - i, dst + i);
+    }
+#else
+    void convertToFloat(const void* src, uint32_t componentType, bool normalized, size_t count, float* dst)
+    {
+        convertToFloatScalar(src, componentType, normalized, count, dst);
+    }
+
+    void convertToUint(const void* src, uint32_t componentType, size_t count, uint32_t* dst)
+    {
+        convertToUintScalar(src, componentType, count, dst);
+    }
+#endif
+
+    // fixed size copies compile to plain loads / stores
+    template <size_t N>
+    static void copyElements(const uint8_t* src, size_t stride, size_t count, uint8_t* dst)
+    {
+        for (size_t i = 0; i < count; i++)
+            memcpy(dst + i * N, src + i * stride, N);
+    }
+
+    // packs count strided elements back to back
+    static void deinterleave(const uint8_t* src, size_t stride, size_t elementSize, size_t count, uint8_t* dst)
+    {
+        switch (elementSize)
+        {
+        case 2: copyElements<2>(src, stride, count, dst); break;
+        case 4: copyElements<4>(src, stride, count, dst); break;
+        case 6: copyElements<6>(src, stride, count, dst); break;
+        case 8: copyElements<8>(src, stride, count, dst); break;
+        case 12: copyElements<12>(src, stride, count, dst); break;
+        case 16: copyElements<16>(src, stride, count, dst); break;
+        default:
+            for (size_t i = 0; i < count; i++)
+                memcpy(dst + i * elementSize, src + i * stride, elementSize);
+            break;
+        }
+    }
+
+    static uint32_t readIndex(const uint8_t* indices, uint32_t componentType, size_t i)
+    {
+        switch (componentType)
+        {
+        case UNSIGNED_BYTE: return indices[i];
+        case UNSIGNED_SHORT: { uint16_t v; memcpy(&v, indices + i * 2, 2); return v; }
+        default: { uint32_t v; memcpy(&v, indices + i * 4, 4); return v; }
+        }
+    }
+
+    // passthrough: the source components already have the representation of T
+    template <typename T, typename Convert>
+    static bool readAccessorImpl(const AccessorLayout& layout, bool passthrough, T* dst, Convert convert)
+    {
+        size_t componentSize = getComponentSize(layout.componentType);
+        if (componentSize == 0 || layout.componentCount == 0)
+            return false;
+        size_t elementSize = componentSize * layout.componentCount;
+        size_t valueCount = layout.count * layout.componentCount;
+
+        if (!layout.data)
+        {
+            std::fill(dst, dst + valueCount, T(0));
+        }
+        else if (layout.byteStride == 0 || layout.byteStride == elementSize)
+        {
+            convert(layout.data, valueCount, dst);
+        }
+        else if (passthrough)
+        {
+            // the de-interleave is the whole conversion
+            deinterleave(layout.data, layout.byteStride, elementSize, layout.count, (uint8_t*)dst);
+        }
+        else
+        {
+            // de-interleave a block at a time into a packed scratch buffer, then convert it in one go
+            uint8_t scratch[16 * 1024];
+            size_t blockCount = std::max<size_t>(sizeof(scratch) / elementSize, 1);
+            for (size_t first = 0; first < layout.count; first += blockCount)
+            {
+                size_t count = std::min(blockCount, layout.count - first);
+                deinterleave(layout.data + first * layout.byteStride, layout.byteStride, elementSize, count, scratch);
+                convert(scratch, count * layout.componentCount, dst + first * layout.componentCount);
+            }
+        }
+
+        for (size_t i = 0; i < layout.sparseCount; i++)
+        {
+            uint32_t index = readIndex(layout.sparseIndices, layout.sparseIndexType, i);
+            if (index < layout.count)
+                convert(layout.sparseValues + i * elementSize, layout.componentCount, dst + index * layout.componentCount);
+        }
+        return true;
+    }
+
+    bool readAccessor(const AccessorLayout& layout, float* dst)
+    {
+        bool passthrough = layout.componentType == FLOAT;
+        return readAccessorImpl(layout, passthrough, dst, [&](const uint8_t* src, size_t count, float* out) {
+            convertToFloat(src, layout.componentType, layout.normalized, count, out);
+        });
+    }
+
+    bool readAccessor(const AccessorLayout& layout, uint32_t* dst)
+    {
+        bool passthrough = layout.componentType == UNSIGNED_INT || layout.componentType == INT;
+        return readAccessorImpl(layout, passthrough, dst, [&](const uint8_t* src, size_t count, uint32_t* out) {
+            convertToUint(src, layout.componentType, count, out);
+        });
+    }
+}
@@ -0,0 +1,198 @@
+#include "../include/AnimationTracks.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MELO_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MELO_SSE2
+#endif
+
+namespace melo
+{
+    static const uint32_t LANES = BakedClip::LANES;
+    static const uint32_t BLOCK_FLOATS = 4 * LANES;
+
+#if defined(MELO_AVX2) || defined(MELO_SSE2)
+    // x, y, z, w of 4 channels -> 4 vec4
+    static inline void storeTransposed(__m128 x, __m128 y, __m128 z, __m128 w, glm::vec4* outputs)
+    {
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(&outputs[0].x, x);
+        _mm_storeu_ps(&outputs[1].x, y);
+        _mm_storeu_ps(&outputs[2].x, z);
+        _mm_storeu_ps(&outputs[3].x, w);
+    }
+#endif
+
+    // lerps blockCount blocks of frame a toward frame b, then normalizes them as quaternions if nlerp is set
+    static void evaluateBlocks(const float* a, const float* b, float u, uint32_t blockCount, bool nlerp,
+                               glm::vec4* outputs)
+    {
+#if defined(MELO_AVX2)
+        const __m256 vu = _mm256_set1_ps(u);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        for (uint32_t block = 0; block < blockCount; block++, a += BLOCK_FLOATS, b += BLOCK_FLOATS, outputs += LANES)
+        {
+            __m256 c[4];
+            for (int k = 0; k < 4; k++)
+            {
+                __m256 va = _mm256_loadu_ps(a + k * LANES);
+                __m256 vb = _mm256_loadu_ps(b + k * LANES);
+                c[k] = _mm256_add_ps(va, _mm256_mul_ps(_mm256_sub_ps(vb, va), vu));
+            }
+            if (nlerp)
+            {
+                __m256 length2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c[0], c[0]), _mm256_mul_ps(c[1], c[1])),
+                                               _mm256_add_ps(_mm256_mul_ps(c[2], c[2]), _mm256_mul_ps(c[3], c[3])));
+                __m256 scale = _mm256_div_ps(one, _mm256_sqrt_ps(length2));
+                for (int k = 0; k < 4; k++)
+                    c[k] = _mm256_mul_ps(c[k], scale);
+            }
+            storeTransposed(_mm256_castps256_ps128(c[0]), _mm256_castps256_ps128(c[1]), _mm256_castps256_ps128(c[2]),
+                            _mm256_castps256_ps128(c[3]), outputs);
+            storeTransposed(_mm256_extractf128_ps(c[0], 1), _mm256_extractf128_ps(c[1], 1),
+                            _mm256_extractf128_ps(c[2], 1), _mm256_extractf128_ps(c[3], 1), outputs + 4);
+        }
+#elif defined(MELO_SSE2)
+        const __m128 vu = _mm_set1_ps(u);
+        const __m128 one = _mm_set1_ps(1.0f);
+        for (uint32_t block = 0; block < blockCount; block++, a += BLOCK_FLOATS, b += BLOCK_FLOATS)
+        {
+            for (uint32_t half = 0; half < LANES; half += 4, outputs += 4)
+            {
+                __m128 c[4];
+                for (int k = 0; k < 4; k++)
+                {
+                    __m128 va = _mm_loadu_ps(a + k * LANES + half);
+                    __m128 vb = _mm_loadu_ps(b + k * LANES + half);
+                    c[k] = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vu));
+                }
+                if (nlerp)
+                {
+                    __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0], c[0]), _mm_mul_ps(c[1], c[1])),
+                                                _mm_add_ps(_mm_mul_ps(c[2], c[2]), _mm_mul_ps(c[3], c[3])));
+                    __m128 scale = _mm_div_ps(one, _mm_sqrt_ps(length2));
+                    for (int k = 0; k < 4; k++)
+                        c[k] = _mm_mul_ps(c[k], scale);
+                }
+                storeTransposed(c[0], c[1], c[2], c[3], outputs);
+            }
+        }
+#else
+        for (uint32_t block = 0; block < blockCount; block++, a += BLOCK_FLOATS, b += BLOCK_FLOATS)
+        {
+            for (uint32_t lane = 0; lane < LANES; lane++, outputs++)
+            {
+                glm::vec4 value;
+                for (int k = 0; k < 4; k++)
+                {
+                    float va = a[k * LANES + lane];
+                    value[k] = va + (b[k * LANES + lane] - va) * u;
+                }
+                *outputs = nlerp ? value * (1.0f / std::sqrt(glm::dot(value, value))) : value;
+            }
+        }
+#endif
+    }
+
+    BakedClipRef BakedClip::create(float start, float end, float sampleRate, const std::vector<bool>& rotations,
+                                   const std::function<glm::vec4(uint32_t channel, float time)>& sample)
+    {
+        auto ref = std::make_shared<BakedClip>();
+        ref->start = start;
+        ref->end = std::max(start, end);
+        float duration = ref->end - ref->start;
+        ref->frameCount = 1;
+        if (duration > 0 && sampleRate > 0)
+        {
+            // the small bias keeps durations that are a multiple of the period from getting an extra frame
+            ref->frameCount = (uint32_t)std::ceil(duration * sampleRate - 1e-3f) + 1;
+            ref->frameCount = std::max(ref->frameCount, 2u);
+            ref->sampleRate = (ref->frameCount - 1) / duration;
+        }
+
+        auto channelCount = (uint32_t)rotations.size();
+        auto rotationCount = (uint32_t)std::count(rotations.begin(), rotations.end(), true);
+        auto vectorCount = channelCount - rotationCount;
+        ref->vectorBlockCount = (vectorCount + LANES - 1) / LANES;
+        ref->rotationBlockCount = (rotationCount + LANES - 1) / LANES;
+
+        uint32_t nextVector = 0;
+        uint32_t nextRotation = ref->vectorBlockCount * LANES;
+        ref->channelSlots.resize(channelCount);
+        for (uint32_t c = 0; c < channelCount; c++)
+            ref->channelSlots[c] = rotations[c] ? nextRotation++ : nextVector++;
+
+        // padding lanes hold zeros, or identity quaternions so that they normalize
+        uint32_t blockCount = ref->getBlockCount();
+        ref->samples.assign((size_t)ref->frameCount * blockCount * BLOCK_FLOATS, 0.0f);
+        for (uint32_t frame = 0; frame < ref->frameCount; frame++)
+        {
+            for (uint32_t block = ref->vectorBlockCount; block < blockCount; block++)
+            {
+                float* w = &ref->samples[((size_t)frame * blockCount + block) * BLOCK_FLOATS + 3 * LANES];
+                std::fill(w, w + LANES, 1.0f);
+            }
+        }
+
+        for (uint32_t c = 0; c < channelCount; c++)
+        {
+            uint32_t block = ref->channelSlots[c] / LANES;
+            uint32_t lane = ref->channelSlots[c] % LANES;
+            glm::vec4 previous;
+            for (uint32_t frame = 0; frame < ref->frameCount; frame++)
+            {
+                float time = (frame + 1 == ref->frameCount) ? ref->end : ref->start + frame / ref->sampleRate;
+                glm::vec4 value = sample(c, time);
+                // keep consecutive quaternions in the same hemisphere, nlerp then needs no sign test
+                if (rotations[c] && frame > 0 && glm::dot(value, previous) < 0)
+                    value = -value;
+                previous = value;
+
+                float* dst = &ref->samples[((size_t)frame * blockCount + block) * BLOCK_FLOATS + lane];
+                for (int k = 0; k < 4; k++)
+                    dst[k * LANES] = value[k];
+            }
+        }
+        return ref;
+    }
+
+    void BakedClip::evaluate(float time, glm::vec4* outputs) const
+    {
+        uint32_t frame = 0;
+        float u = 0;
+        if (frameCount > 1)
+        {
+            float position = (std::min(std::max(time, start), end) - start) * sampleRate;
+            frame = std::min((uint32_t)position, frameCount - 2);
+            u = std::min(position - frame, 1.0f);
+        }
+
+        size_t frameFloats = (size_t)getBlockCount() * BLOCK_FLOATS;
+        const float* a = samples.data() + frame * frameFloats;
+        const float* b = frameCount > 1 ? a + frameFloats : a;
+        evaluateBlocks(a, b, u, vectorBlockCount, false, outputs);
+        size_t rotationOffset = (size_t)vectorBlockCount * BLOCK_FLOATS;
+        evaluateBlocks(a + rotationOffset, b + rotationOffset, u, rotationBlockCount, true,
+                       outputs + vectorBlockCount * LANES);
+    }
+
+    uint32_t AnimationBatch::addClip(const BakedClipRef& clip)
+    {
+        uint32_t firstSlot = mSlotCount;
+        mClips.push_back(clip);
+        mFirstSlots.push_back(firstSlot);
+        mSlotCount += clip->getSlotCount();
+        return firstSlot;
+    }
+
+    void AnimationBatch::evaluate(const float* times, glm::vec4* outputs) const
+    {
+        for (size_t i = 0; i < mClips.size(); i++)
+            mClips[i]->evaluate(times[i], outputs + mFirstSlots[i]);
+    }
+}
@@ -0,0 +1,249 @@
+#include "../include/CompressedTrack.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace melo
+{
+    static const float SQRT_HALF = 0.70710678f;
+    // longest run of source keys a single interpolated segment may replace, bounds the reduction cost
+    static const size_t MAX_SEGMENT_KEYS = 1024;
+
+    static void encodeRotation(glm::vec4 q, uint16_t* words)
+    {
+        int largest = 0;
+        for (int i = 1; i < 4; i++)
+            if (std::abs(q[i]) > std::abs(q[largest]))
+                largest = i;
+        // q and -q are the same rotation, the dropped component is rebuilt as positive
+        if (q[largest] < 0)
+            q = -q;
+
+        uint64_t bits = (uint64_t)largest << 45;
+        for (int i = 0, slot = 0; i < 4; i++)
+        {
+            if (i == largest)
+                continue;
+            float unit = (q[i] / SQRT_HALF + 1.0f) * 0.5f;
+            auto value = (uint64_t)std::min(std::max(std::lround(unit * 32767.0f), 0L), 32767L);
+            bits |= value << (15 * slot++);
+        }
+        words[0] = (uint16_t)bits;
+        words[1] = (uint16_t)(bits >> 16);
+        words[2] = (uint16_t)(bits >> 32);
+    }
+
+    static glm::vec4 decodeRotation(const uint16_t* words)
+    {
+        uint64_t bits = words[0] | ((uint64_t)words[1] << 16) | ((uint64_t)words[2] << 32);
+        const float scale = SQRT_HALF * 2.0f / 32767.0f;
+        float a = (bits & 0x7FFF) * scale - SQRT_HALF;
+        float b = ((bits >> 15) & 0x7FFF) * scale - SQRT_HALF;
+        float c = ((bits >> 30) & 0x7FFF) * scale - SQRT_HALF;
+        float largest = std::sqrt(std::max(0.0f, 1.0f - a * a - b * b - c * c));
+        switch ((bits >> 45) & 3)
+        {
+        case 0:
+            return glm::vec4(largest, a, b, c);
+        case 1:
+            return glm::vec4(a, largest, b, c);
+        case 2:
+            return glm::vec4(a, b, largest, c);
+        default:
+            return glm::vec4(a, b, c, largest);
+        }
+    }
+
+    static glm::vec4 interpolate(const glm::vec4& a, glm::vec4 b, float u, bool rotation)
+    {
+        if (!rotation)
+            return a + (b - a) * u;
+        if (glm::dot(a, b) < 0)
+            b = -b;
+        glm::vec4 q = a + (b - a) * u;
+        return q * (1.0f / std::sqrt(glm::dot(q, q)));
+    }
+
+    // largest per component difference, up to the sign of quaternions
+    static float getError(glm::vec4 value, const glm::vec4& source, bool rotation)
+    {
+        if (rotation && glm::dot(value, source) < 0)
+            value = -value;
+        glm::vec4 d = glm::abs(value - source);
+        return std::max(std::max(d.x, d.y), std::max(d.z, d.w));
+    }
+
+    // last key at or before value, AnimationSampler::findKey() over frame numbers or times
+    template <typename T>
+    static size_t findKey(const std::vector<T>& keys, size_t count, T value, size_t* cursor)
+    {
+        if (count < 2 || value <= keys[0])
+            return 0;
+        if (value >= keys[count - 1])
+            return count - 1;
+
+        size_t key = *cursor;
+        if (key + 1 < count && keys[key] <= value)
+        {
+            if (value < keys[key + 1])
+                return key;
+            if (key + 2 < count && value < keys[key + 2])
+            {
+                *cursor = key + 1;
+                return key + 1;
+            }
+        }
+
+        key = std::upper_bound(keys.begin(), keys.begin() + count, value) - keys.begin() - 1;
+        *cursor = key;
+        return key;
+    }
+
+    CompressedTrackRef CompressedTrack::create(const float* times, const glm::vec4* values, size_t keyCount,
+                                               bool rotation, bool step, float tolerance)
+    {
+        auto ref = CompressedTrackRef(new CompressedTrack());
+        ref->mRotation = rotation;
+        ref->mStep = step;
+        ref->mSourceKeyCount = keyCount;
+        if (keyCount == 0)
+            return ref;
+
+        std::vector<glm::vec4> source(values, values + keyCount);
+        if (rotation)
+        {
+            for (size_t k = 0; k < keyCount; k++)
+            {
+                source[k] = glm::normalize(source[k]);
+                if (k > 0 && glm::dot(source[k], source[k - 1]) < 0)
+                    source[k] = -source[k];
+            }
+        }
+        else
+        {
+            glm::vec3 rangeMax = glm::vec3(source[0]);
+            ref->mRangeMin = rangeMax;
+            for (auto& value : source)
+            {
+                ref->mRangeMin = glm::min(ref->mRangeMin, glm::vec3(value));
+                rangeMax = glm::max(rangeMax, glm::vec3(value));
+                value.w = 0;
+            }
+            ref->mRangeScale = (rangeMax - ref->mRangeMin) / 65535.0f;
+        }
+
+        // every key quantized first, the reduction then measures the error of what sample() will return
+        ref->mValues.resize(keyCount * 3);
+        for (size_t k = 0; k < keyCount; k++)
+        {
+            uint16_t* words = &ref->mValues[k * 3];
+            if (rotation)
+            {
+                encodeRotation(source[k], words);
+                continue;
+            }
+            for (int i = 0; i < 3; i++)
+            {
+                float scale = ref->mRangeScale[i];
+                float unit = scale > 0 ? (source[k][i] - ref->mRangeMin[i]) / scale : 0.0f;
+                words[i] = (uint16_t)std::min(std::max(std::lround(unit), 0L), 65535L);
+            }
+        }
+        std::vector<glm::vec4> decoded(keyCount);
+        for (size_t k = 0; k < keyCount; k++)
+            decoded[k] = ref->decode(k);
+
+        // evenly spaced source keys, as sampled mocap is, only need their frame number
+        float duration = keyCount > 1 ? times[keyCount - 1] - times[0] : 0.0f;
+        bool even = duration > 0 && keyCount - 1 <= 65535;
+        ref->mStart = times[0];
+        ref->mRate = even ? (keyCount - 1) / duration : 0.0f;
+        for (size_t k = 0; k < keyCount && even; k++)
+            even = std::abs((times[k] - ref->mStart) * ref->mRate - k) <= 1e-3f;
+        // positions as sample() computes them, so that the reduction measures exactly what it returns
+        auto getPosition = [&](float time) { return even ? (time - ref->mStart) * ref->mRate : time; };
+        auto getKeyPosition = [&](size_t key) { return even ? (float)key : times[key]; };
+
+        std::vector<size_t> kept = {0};
+        bool constant = true;
+        for (size_t k = 1; k < keyCount && constant; k++)
+            constant = getError(decoded[0], source[k], rotation) <= tolerance;
+        if (!constant && step)
+        {
+            for (size_t k = 1; k < keyCount; k++)
+                if (getError(decoded[kept.back()], source[k], rotation) > tolerance)
+                    kept.push_back(k);
+        }
+        else if (!constant)
+        {
+            // greedy: extend the segment from the last kept key while it reproduces every key it skips
+            size_t a = 0;
+            for (size_t b = 2; b < keyCount; b++)
+            {
+                bool fits = b - a <= MAX_SEGMENT_KEYS;
+                float start = getKeyPosition(a), length = getKeyPosition(b) - start;
+                for (size_t k = a + 1; fits && k < b; k++)
+                {
+                    float u = length > 0 ? std::min(std::max((getPosition(times[k]) - start) / length, 0.0f), 1.0f)
+                                         : 0.0f;
+                    glm::vec4 value = interpolate(decoded[a], decoded[b], u, rotation);
+                    fits = getError(value, source[k], rotation) <= tolerance;
+                }
+                if (!fits)
+                {
+                    kept.push_back(b - 1);
+                    a = b - 1;
+                }
+            }
+            kept.push_back(keyCount - 1);
+        }
+
+        std::vector<uint16_t> keptValues(kept.size() * 3);
+        for (size_t i = 0; i < kept.size(); i++)
+            std::copy_n(&ref->mValues[kept[i] * 3], 3, &keptValues[i * 3]);
+        ref->mValues.swap(keptValues);
+        ref->mKeyCount = kept.size();
+        ref->mEven = even;
+
+        for (size_t key : kept)
+        {
+            if (even)
+                ref->mFrames.push_back((uint16_t)key);
+            else
+                ref->mTimes.push_back(times[key]);
+        }
+        return ref;
+    }
+
+    glm::vec4 CompressedTrack::decode(size_t key) const
+    {
+        const uint16_t* words = &mValues[key * 3];
+        if (mRotation)
+            return decodeRotation(words);
+        return glm::vec4(mRangeMin + glm::vec3(words[0], words[1], words[2]) * mRangeScale, 0.0f);
+    }
+
+    glm::vec4 CompressedTrack::sample(float time, size_t* cursor) const
+    {
+        if (mKeyCount == 0)
+            return mRotation ? glm::vec4(0, 0, 0, 1) : glm::vec4(0);
+        float position = toPosition(time);
+        // frame numbers are integers, the frame the position is in finds the same key
+        size_t key = mEven ? findKey(mFrames, mKeyCount, (uint16_t)std::min(std::max(position, 0.0f), 65535.0f), cursor)
+                           : findKey(mTimes, mKeyCount, position, cursor);
+        glm::vec4 value = decode(key);
+        if (key + 1 >= mKeyCount || mStep)
+            return value;
+        float start = getKeyPosition(key);
+        if (position <= start)
+            return value;
+        float u = (position - start) / (getKeyPosition(key + 1) - start);
+        return interpolate(value, decode(key + 1), std::min(u, 1.0f), mRotation);
+    }
+
+    size_t CompressedTrack::getMemorySize() const
+    {
+        return sizeof(CompressedTrack) + mFrames.size() * sizeof(uint16_t) + mTimes.size() * sizeof(float) +
+               mValues.size() * sizeof(uint16_t);
+    }
+}
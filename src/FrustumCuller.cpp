@@ -0,0 +1,312 @@
+#include "../include/FrustumCuller.h"
+#include "../include/JobSystem.h"
+#include "../include/OcclusionCuller.h"
+#include "../include/TransformSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <functional>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MELO_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MELO_SSE2
+#endif
+
+namespace melo
+{
+    enum BoundsComponent
+    {
+        MIN_X,
+        MIN_Y,
+        MIN_Z,
+        MAX_X,
+        MAX_Y,
+        MAX_Z,
+    };
+
+    void transformBounds(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                         glm::vec3* worldMin, glm::vec3* worldMax)
+    {
+        // center and half extent, the extent goes through the absolute values of the rotation and scale
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+        glm::vec3 worldCenter = glm::vec3(transform[3]);
+        glm::vec3 worldExtent(0);
+        for (int column = 0; column < 3; column++)
+        {
+            glm::vec3 axis = glm::vec3(transform[column]);
+            worldCenter += axis * center[column];
+            worldExtent += glm::abs(axis) * extent[column];
+        }
+        *worldMin = worldCenter - worldExtent;
+        *worldMax = worldCenter + worldExtent;
+    }
+
+    static bool hasBounds(const Node& node)
+    {
+        const auto& boundsMin = node.mBoundBoxMin;
+        const auto& boundsMax = node.mBoundBoxMax;
+        return boundsMin.x <= boundsMax.x && boundsMin.y <= boundsMax.y && boundsMin.z <= boundsMax.z &&
+               boundsMin != boundsMax;
+    }
+
+    // inside[i] = 1 when box i is not entirely behind one of the planes. Per plane only the corner furthest along
+    // its normal matters, so each plane reads one of the min / max arrays per axis.
+    static void testPlanes(const std::vector<float>* bounds, const glm::vec4* planes, size_t begin, size_t end,
+                           uint8_t* inside)
+    {
+        const float* corners[6][3];
+        for (int plane = 0; plane < 6; plane++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+                corners[plane][axis] = bounds[planes[plane][axis] >= 0 ? MAX_X + axis : MIN_X + axis].data();
+        }
+
+        size_t i = begin;
+#if defined(MELO_AVX2)
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256 outside = _mm256_setzero_ps();
+            for (int plane = 0; plane < 6; plane++)
+            {
+                __m256 distance = _mm256_set1_ps(planes[plane].w);
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes[plane].x),
+                                                                 _mm256_loadu_ps(corners[plane][0] + i)));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes[plane].y),
+                                                                 _mm256_loadu_ps(corners[plane][1] + i)));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes[plane].z),
+                                                                 _mm256_loadu_ps(corners[plane][2] + i)));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+            }
+            int mask = _mm256_movemask_ps(outside);
+            for (int lane = 0; lane < 8; lane++)
+                inside[i - begin + lane] = (mask >> lane & 1) ^ 1;
+        }
+#endif
+#if defined(MELO_AVX2) || defined(MELO_SSE2)
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 outside = _mm_setzero_ps();
+            for (int plane = 0; plane < 6; plane++)
+            {
+                __m128 distance = _mm_set1_ps(planes[plane].w);
+                distance = _mm_add_ps(distance,
+                                      _mm_mul_ps(_mm_set1_ps(planes[plane].x), _mm_loadu_ps(corners[plane][0] + i)));
+                distance = _mm_add_ps(distance,
+                                      _mm_mul_ps(_mm_set1_ps(planes[plane].y), _mm_loadu_ps(corners[plane][1] + i)));
+                distance = _mm_add_ps(distance,
+                                      _mm_mul_ps(_mm_set1_ps(planes[plane].z), _mm_loadu_ps(corners[plane][2] + i)));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+            }
+            int mask = _mm_movemask_ps(outside);
+            for (int lane = 0; lane < 4; lane++)
+                inside[i - begin + lane] = (mask >> lane & 1) ^ 1;
+        }
+#endif
+        for (; i < end; i++)
+        {
+            bool outside = false;
+            for (int plane = 0; plane < 6; plane++)
+            {
+                float distance = planes[plane].w + planes[plane].x * corners[plane][0][i] +
+                                 planes[plane].y * corners[plane][1][i] + planes[plane].z * corners[plane][2][i];
+                outside |= distance < 0;
+            }
+            inside[i - begin] = outside ? 0 : 1;
+        }
+    }
+
+    FrustumCullerRef FrustumCuller::create()
+    {
+        return FrustumCullerRef(new FrustumCuller());
+    }
+
+    void FrustumCuller::rebuild(Node* root)
+    {
+        mRoot = root;
+        mNodes.clear();
+        mTransformIndices.clear();
+        mParents.clear();
+        mHasChildren.clear();
+        mHasBounds.clear();
+        mLocalMin.clear();
+        mLocalMax.clear();
+
+        uint32_t slotCount = 0;
+        std::vector<std::pair<Node*, int32_t>> stack = {{root, -1}};
+        while (!stack.empty())
+        {
+            auto item = stack.back();
+            stack.pop_back();
+            Node& node = *item.first;
+            int32_t position = (int32_t)mNodes.size();
+            mNodes.push_back(&node);
+            mTransformIndices.push_back(node.getTransformIndex());
+            mParents.push_back(item.second);
+            auto& children = node.getChildren();
+            mHasChildren.push_back(children.empty() ? 0 : 1);
+            mHasBounds.push_back(hasBounds(node) ? 1 : 0);
+            mLocalMin.push_back(node.mBoundBoxMin);
+            mLocalMax.push_back(node.mBoundBoxMax);
+            for (auto it = children.rbegin(); it != children.rend(); ++it)
+                stack.push_back({it->get(), position});
+            slotCount = std::max(slotCount, node.getTransformIndex() + 1);
+        }
+
+        for (int component = 0; component < 6; component++)
+        {
+            mBounds[component].resize(mNodes.size());
+            mSubtreeBounds[component].resize(mNodes.size());
+        }
+        mWorldVersions.resize(mNodes.size());
+        mGathered = false;
+        mSlotNodes.assign(slotCount, nullptr);
+        mSlotVisibility.assign(slotCount, VISIBLE_SELF | VISIBLE_SUBTREE);
+        for (size_t i = 0; i < mNodes.size(); i++)
+            mSlotNodes[mTransformIndices[i]] = mNodes[i];
+    }
+
+    void FrustumCuller::gather(const TransformSystem& transforms, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            uint32_t index = mTransformIndices[i];
+            uint32_t version = transforms.getUpdatedWorldVersion(index);
+            if (mGathered && mWorldVersions[i] == version)
+                continue;
+            mWorldVersions[i] = version;
+
+            glm::vec3 boundsMin(-FLT_MAX), boundsMax(FLT_MAX);
+            if (mHasBounds[i])
+                transformBounds(transforms.getUpdatedWorld(index), mLocalMin[i], mLocalMax[i], &boundsMin, &boundsMax);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                mBounds[MIN_X + axis][i] = boundsMin[axis];
+                mBounds[MAX_X + axis][i] = boundsMax[axis];
+            }
+        }
+    }
+
+    size_t FrustumCuller::test(size_t begin, size_t end, const glm::vec4* planes, const OcclusionCuller* occlusion,
+                               size_t* occludedCount)
+    {
+        uint8_t inside[GRAIN], subtreeInside[GRAIN];
+        testPlanes(mBounds, planes, begin, end, inside);
+        testPlanes(mSubtreeBounds, planes, begin, end, subtreeInside);
+
+        // a subtree box holds the boxes below it, so the nodes of a culled subtree are culled as well
+        size_t visibleCount = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            uint8_t subtreeVisible = subtreeInside[i - begin];
+            uint8_t visible = inside[i - begin] & subtreeVisible;
+            // only what the frustum kept is worth projecting, a hidden subtree hides all of its nodes
+            if (occlusion && subtreeVisible && mSubtreeBounds[MIN_X][i] > -FLT_MAX && mSubtreeBounds[MAX_X][i] < FLT_MAX &&
+                !occlusion->isVisible({mSubtreeBounds[MIN_X][i], mSubtreeBounds[MIN_Y][i], mSubtreeBounds[MIN_Z][i]},
+                                      {mSubtreeBounds[MAX_X][i], mSubtreeBounds[MAX_Y][i], mSubtreeBounds[MAX_Z][i]}))
+            {
+                *occludedCount += visible;
+                subtreeVisible = visible = 0;
+            }
+            else if (occlusion && visible && mHasBounds[i] &&
+                     !occlusion->isVisible({mBounds[MIN_X][i], mBounds[MIN_Y][i], mBounds[MIN_Z][i]},
+                                           {mBounds[MAX_X][i], mBounds[MAX_Y][i], mBounds[MAX_Z][i]}))
+            {
+                *occludedCount += 1;
+                visible = 0;
+            }
+            mSlotVisibility[mTransformIndices[i]] = (visible ? VISIBLE_SELF : 0) | (subtreeVisible ? VISIBLE_SUBTREE : 0);
+            visibleCount += visible;
+        }
+        return visibleCount;
+    }
+
+    void FrustumCuller::cull(const NodeRef& root, const glm::mat4& viewProjection, JobSystem* jobs,
+                             const OcclusionCuller* occlusion)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        auto& transforms = *TransformSystem::getDefault();
+        uint32_t hierarchyVersion = transforms.getHierarchyVersion();
+        if (root.get() != mRoot || hierarchyVersion != mHierarchyVersion)
+        {
+            rebuild(root.get());
+            mHierarchyVersion = hierarchyVersion;
+        }
+
+        // left, right, bottom, top, near, far; inside is where dot(plane, (p, 1)) >= 0
+        glm::vec4 rows[4];
+        for (int row = 0; row < 4; row++)
+            rows[row] = {viewProjection[0][row], viewProjection[1][row], viewProjection[2][row],
+                         viewProjection[3][row]};
+        const glm::vec4 planes[6] = {
+            rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+            rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2],
+        };
+
+        // ranges of GRAIN nodes, over the jobs when there is more than one
+        size_t count = mNodes.size();
+        auto forRanges = [&](const std::function<void(size_t, size_t, size_t)>& func) {
+            size_t rangeCount = (count + GRAIN - 1) / GRAIN;
+            if (!jobs || rangeCount < 2)
+            {
+                for (size_t range = 0; range < rangeCount; range++)
+                    func(range, range * GRAIN, std::min(count, (range + 1) * GRAIN));
+                return;
+            }
+            std::vector<JobRef> pending;
+            for (size_t range = 0; range < rangeCount; range++)
+                pending.push_back(jobs->add([&, range] { func(range, range * GRAIN, std::min(count, (range + 1) * GRAIN)); }));
+            jobs->wait(pending);
+        };
+
+        // getWorld() would write stale ancestors from several jobs at once, the gather only reads
+        transforms.update(root->getTransformIndex(), jobs);
+        forRanges([&](size_t, size_t begin, size_t end) { gather(transforms, begin, end); });
+        mGathered = true;
+
+        // subtree boxes start as the node's own box, empty for groups without bounds which are bounded by their
+        // children alone. Children come after their parent, so one backward pass merges them bottom-up.
+        for (size_t i = 0; i < count; i++)
+        {
+            bool empty = !mHasBounds[i] && mHasChildren[i];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                mSubtreeBounds[MIN_X + axis][i] = empty ? FLT_MAX : mBounds[MIN_X + axis][i];
+                mSubtreeBounds[MAX_X + axis][i] = empty ? -FLT_MAX : mBounds[MAX_X + axis][i];
+            }
+        }
+        for (size_t i = count; i-- > 1;)
+        {
+            size_t parent = (size_t)mParents[i];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float& parentMin = mSubtreeBounds[MIN_X + axis][parent];
+                float& parentMax = mSubtreeBounds[MAX_X + axis][parent];
+                parentMin = std::min(parentMin, mSubtreeBounds[MIN_X + axis][i]);
+                parentMax = std::max(parentMax, mSubtreeBounds[MAX_X + axis][i]);
+            }
+        }
+
+        std::vector<size_t> visibleCounts((count + GRAIN - 1) / GRAIN), occludedCounts(visibleCounts.size());
+        forRanges([&](size_t range, size_t begin, size_t end) {
+            visibleCounts[range] = test(begin, end, planes, occlusion, &occludedCounts[range]);
+        });
+
+        mStats.nodeCount = count;
+        mStats.visibleCount = 0;
+        for (size_t visibleCount : visibleCounts)
+            mStats.visibleCount += visibleCount;
+        mStats.culledCount = count - mStats.visibleCount;
+        mStats.occludedCount = 0;
+        for (size_t occludedCount : occludedCounts)
+            mStats.occludedCount += occludedCount;
+        mStats.milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
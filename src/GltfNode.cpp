@@ -1,4 +1,10 @@
 #include "../include/GltfNode.h"
+#include "../include/JobSystem.h"
+#include "../include/ObjParser.h"
+#include "../include/PlyParser.h"
+#include "../include/ProgramCache.h"
+#include "../include/VertexCache.h"
+#include "../include/RenderQueue.h"
 #include <Cinder/app/App.h>
 #include <Cinder/Log.h>
 #include "CinderRemotery.h"
@@ -7,6 +13,57 @@ using namespace ci;
 using namespace app;
 using namespace std;
 
+// The flat arrays a mesh is created from, views into a yocto::scene_shape or into the cache
+struct ShapeStreams
+{
+    enum Stream
+    {
+        INDICES,     // uint32_t[3]
+        POSITIONS,   // vec3
+        NORMALS,     // vec3
+        TANGENTS,    // vec4
+        TEXCOORDS,   // vec2
+        COLORS,      // vec4
+        LOD_INDICES, // uint32_t, the levels of detail after the first one, following INDICES in the index vbo
+        LOD_LEVELS,  // melo::LodLevel, offsets from the start of INDICES
+
+        COUNT,
+    };
+    const void* data[COUNT] = {};
+    size_t size[COUNT] = {}; // bytes
+
+    template <typename T>
+    void set(Stream stream, const std::vector<T>& items)
+    {
+        data[stream] = items.data();
+        size[stream] = items.size() * sizeof(T);
+    }
+};
+
+// Sections of the GltfScene cache
+enum CacheSection
+{
+    CACHE_COUNTS,    // shape and texture counts
+    CACHE_NAME,      // asset name
+    CACHE_MATERIALS, // yocto::scene_material[]
+    CACHE_INSTANCES, // yocto::scene_instance[]
+    CACHE_TEXTURE,   // index: texture, mip chain
+    CACHE_SHAPE,     // index: shape * ShapeStreams::COUNT + stream
+};
+
+// the materials and instances are stored as they are in memory, a layout change invalidates the old caches, as
+// does another count of levels of detail or mesh optimization
+static uint64_t getCacheHash(const fs::path& path, uint32_t lodLevels, bool optimizeMeshes,
+                             vector<string>* dependencies = nullptr)
+{
+    const uint32_t layout[] = {
+        (uint32_t)sizeof(yocto::scene_material), (uint32_t)sizeof(yocto::scene_instance), ShapeStreams::COUNT,
+        (uint32_t)sizeof(melo::LodLevel), lodLevels, optimizeMeshes ? 1u : 0u,
+    };
+    uint64_t hash = melo::hashSceneSource(path.string(), dependencies);
+    return melo::hashBytes(&hash, sizeof(hash), melo::hashBytes(layout, sizeof(layout)));
+}
+
 gl::TextureCubeMapRef GltfScene::radianceTexture;
 gl::TextureCubeMapRef GltfScene::irradianceTexture;
 gl::Texture2dRef GltfScene::brdfLUTTexture;
@@ -17,6 +74,11 @@ void GltfScene::predraw(melo::DrawOrder order)
     auto folderName = folderPath.string();
     rmt_BeginCPUSampleDynamic(folderName.c_str(), 0);
     rmt_BeginOpenGLSampleDynamic(folderName.c_str());
+    bindEnvironment();
+}
+
+void GltfScene::bindEnvironment()
+{
     if (GltfScene::brdfLUTTexture && GltfScene::irradianceTexture && GltfScene::radianceTexture)
     {
         GltfScene::radianceTexture->bind(7);
@@ -122,30 +184,15 @@ GltfMaterial::Ref GltfMaterial::create(GltfScene* scene, yocto::scene_material&
     fmt.fragment(DataSourcePath::create(app::getAssetPath("pbr/pbr.frag")));
     fmt.label("khronos-pbr");
 
+    ref->format = fmt;
     try
     {
 #if 1
-        ref->glsl = gl::GlslProg::create(fmt);
+        ref->glsl = melo::ProgramCache::getDefault()->get(fmt);
 #else
         ref->glsl = am::glslProg("lambert texture");
 #endif
-        if (ref->color_tex)
-            ref->glsl->uniform("u_BaseColorSampler", 0);
-        if (ref->normal_tex)
-            ref->glsl->uniform("u_NormalSampler", 1);
-        if (ref->emission_tex)
-            ref->glsl->uniform("u_EmissiveSampler", 2);
-        if (ref->roughness_tex)
-            ref->glsl->uniform("u_MetallicRoughnessSampler", 3);
-        if (ref->occulusion_tex)
-            ref->glsl->uniform("u_OcclusionSampler", 4);
-
-        if (GltfScene::brdfLUTTexture && GltfScene::irradianceTexture && GltfScene::radianceTexture)
-        {
-            ref->glsl->uniform("u_LambertianEnvSampler", 7);
-            ref->glsl->uniform("u_GGXEnvSampler", 8);
-            ref->glsl->uniform("u_GGXLUT", 9);
-        }
+        ref->setSamplers(ref->glsl);
     }
     catch (Exception& e)
     {
@@ -155,8 +202,52 @@ GltfMaterial::Ref GltfMaterial::create(GltfScene* scene, yocto::scene_material&
     return ref;
 }
 
-void GltfMaterial::bind()
+void GltfMaterial::setSamplers(const gl::GlslProgRef& program)
+{
+    if (color_tex)
+        program->uniform("u_BaseColorSampler", 0);
+    if (normal_tex)
+        program->uniform("u_NormalSampler", 1);
+    if (emission_tex)
+        program->uniform("u_EmissiveSampler", 2);
+    if (roughness_tex)
+        program->uniform("u_MetallicRoughnessSampler", 3);
+    if (occulusion_tex)
+        program->uniform("u_OcclusionSampler", 4);
+
+    if (GltfScene::brdfLUTTexture && GltfScene::irradianceTexture && GltfScene::radianceTexture)
+    {
+        program->uniform("u_LambertianEnvSampler", 7);
+        program->uniform("u_GGXEnvSampler", 8);
+        program->uniform("u_GGXLUT", 9);
+    }
+}
+
+const gl::GlslProgRef& GltfMaterial::getInstancedGlsl()
+{
+    if (!instancedCompiled)
+    {
+        instancedCompiled = true;
+        auto fmt = format;
+        fmt.define("USE_INSTANCING");
+        fmt.attrib(geom::CUSTOM_0, "a_InstanceMatrix");
+        fmt.label("khronos-pbr-instanced");
+        try
+        {
+            instancedGlsl = melo::ProgramCache::getDefault()->get(fmt);
+            setSamplers(instancedGlsl);
+        }
+        catch (Exception& e)
+        {
+            CI_LOG_E("Create instanced shader failed, reason: \n" << e.what());
+        }
+    }
+    return instancedGlsl;
+}
+
+void GltfMaterial::bind(bool instanced)
 {
+    const auto& glsl = instanced ? instancedGlsl : this->glsl;
     glsl->uniform("u_MetallicFactor", property.metallic);
     glsl->uniform("u_RoughnessFactor", property.roughness);
     glsl->uniform("u_BaseColorFactor", glm::vec4{ property.color.x, property.color.y, property.color.z, 1.0f });
@@ -226,6 +317,85 @@ void GltfMaterial::unbind()
         scattering_tex->unbind();
 }
 
+void GltfNode::submitDraws(melo::RenderQueue& queue)
+{
+    if (!mesh)
+        return;
+    // without a material draw() falls back to a lambert shader, which isn't instanced
+    const void* shader = material ? material->glsl.get() : nullptr;
+    queue.add(*this, mDrawOrder, shader, material.get(), mesh.get(), 0, material && material->glsl);
+}
+
+// gl::draw() of a range of mesh, instanceCount times
+static void drawInstanced(const gl::VboMeshRef& mesh, GLint first, GLsizei count, GLsizei instanceCount)
+{
+    auto ctx = gl::context();
+    ctx->pushVao();
+    ctx->getDefaultVao()->replacementBindBegin();
+    mesh->buildVao(ctx->getGlslProg());
+    ctx->getDefaultVao()->replacementBindEnd();
+    ctx->setDefaultShaderVars();
+    if (mesh->getNumIndices())
+        gl::drawElementsInstanced(mesh->getGlPrimitive(), count, mesh->getIndexDataType(),
+            (const GLvoid*)(first * sizeof(uint32_t)), instanceCount);
+    else
+        gl::drawArraysInstanced(mesh->getGlPrimitive(), first, count, instanceCount);
+    ctx->popVao();
+}
+
+void GltfNode::drawMesh(melo::DrawOrder order, const glm::mat4* instanceTransforms, uint32_t instanceCount)
+{
+    // the whole mesh, or the level of detail the current matrices ask for
+    GLint first = 0;
+    GLsizei count = mesh->getNumIndices() ? mesh->getNumIndices() : mesh->getNumVertices();
+    const auto& lods = scene->meshLods[property.shape];
+    if (lods.size() >= 2)
+    {
+        if (order != melo::DRAW_SHADOW)
+        {
+            const auto& projection = gl::getProjectionMatrix();
+            float viewportHeight = (float)gl::getViewport().second.y;
+            float pixelScale = melo::getLodPixelScale(gl::getModelView(), projection, viewportHeight, mBoundBoxMin,
+                mBoundBoxMax);
+            // a batch draws a single level, the one its nearest instance needs: farther instances get more detail
+            // than they need, none gets less
+            auto view = gl::getViewMatrix();
+            for (uint32_t i = 1; i < instanceCount; i++)
+            {
+                pixelScale = std::max(pixelScale, melo::getLodPixelScale(view * instanceTransforms[i], projection,
+                    viewportHeight, mBoundBoxMin, mBoundBoxMax));
+            }
+            lodLevel = melo::selectLod(lods.data(), lods.size(), lodLevel, pixelScale);
+        }
+        first = lods[lodLevel].indexOffset;
+        count = lods[lodLevel].indexCount;
+    }
+
+    if (instanceCount == 0)
+    {
+        gl::draw(mesh, first, count);
+        return;
+    }
+
+    if (scene->instanceVbos.size() != scene->meshes.size())
+        scene->instanceVbos.resize(scene->meshes.size());
+    auto& instanceVbo = scene->instanceVbos[property.shape];
+    if (!instanceVbo)
+    {
+        instanceVbo = gl::Vbo::create(GL_ARRAY_BUFFER, instanceCount * sizeof(glm::mat4), instanceTransforms,
+            GL_STREAM_DRAW);
+        geom::BufferLayout layout;
+        layout.append(geom::CUSTOM_0, 16, sizeof(glm::mat4), 0, 1);
+        mesh->appendVbo(layout, instanceVbo);
+    }
+    else
+    {
+        // orphans the storage of the previous batch
+        instanceVbo->bufferData(instanceCount * sizeof(glm::mat4), instanceTransforms, GL_STREAM_DRAW);
+    }
+    drawInstanced(mesh, first, count, instanceCount);
+}
+
 void GltfNode::reloadMaterial()
 {
     if (property.material != yocto::invalid_handle)
@@ -246,6 +416,7 @@ GltfNode::Ref GltfNode::create(GltfScene* scene, yocto::scene_instance& property
     ref->setConstantTransform(glm::make_mat4((const float*)&transform.x));
 
     ref->mesh = scene->getMesh(property.shape);
+    ref->rayCategory = 0xFF;
 
     ref->reloadMaterial();
 
@@ -257,29 +428,171 @@ void GltfScene::progress_callback(const string& message, int current, int total)
     CI_LOG_V(message << ": " << current << '/' << total);
 }
 
-GltfSceneRef GltfScene::create(const fs::path& path)
+// load_scene of an OBJ with the file parsed on every worker, the textures are loaded in parallel too
+static bool loadObjScene(const fs::path& path, yocto::scene_scene& scene, string& error)
+{
+    vector<string> texturePaths;
+    if (!melo::loadObjScene(path.string(), scene, error, &texturePaths))
+        return false;
+
+    auto jobs = melo::JobSystem::getDefault();
+    vector<melo::JobRef> textureJobs;
+    vector<string> errors(texturePaths.size());
+    for (size_t i = 0; i < texturePaths.size(); i++)
+    {
+        textureJobs.push_back(jobs->add([&, i] {
+            yocto::load_texture(texturePaths[i], scene.textures[i], errors[i]);
+        }));
+    }
+    jobs->wait(textureJobs);
+    for (const auto& textureError : errors)
+    {
+        if (!textureError.empty())
+        {
+            error = textureError;
+            return false;
+        }
+    }
+    return true;
+}
+
+// load_scene of a PLY with binary records read straight into the shape, the other PLYs go through yocto
+static bool loadPlyScene(const fs::path& path, yocto::scene_scene& scene, string& error)
+{
+    yocto::scene_shape shape;
+    if (!melo::loadPlyShape(path.string(), shape, error))
+        return error.empty() && load_scene(path.string(), scene, error, GltfScene::progress_callback);
+
+    scene.shapes.push_back(std::move(shape));
+    auto& instance = scene.instances.emplace_back();
+    instance.shape = (int)scene.shapes.size() - 1;
+    return true;
+}
+
+GltfSceneRef GltfScene::create(const fs::path& path, bool useCache, uint32_t lodLevels, bool optimizeMeshes,
+                              const fs::path& cacheDir)
 {
     auto ref = make_shared<GltfScene>();
     ref->path = path;
-    string error;
+    ref->lodLevels = std::max(1u, lodLevels);
+    ref->optimizeMeshes = optimizeMeshes;
 
-    if (!load_scene(path.string(), ref->property, error, progress_callback))
+    // the formats that load other files hashSceneSource can't list are never cached
+    useCache = useCache && melo::isCacheableScene(path.string());
+    string cachePath;
+    if (useCache)
     {
-        CI_LOG_E(error);
-        return {};
+        cachePath = melo::SceneCache::getCachePath(path.string(), cacheDir.string());
+        if (!ref->loadCache(cachePath, getCacheHash(path, ref->lodLevels, ref->optimizeMeshes)))
+        {
+            ref->cache.reset();
+            ref->property = {};
+            ref->meshes.clear();
+            ref->meshLods.clear();
+            ref->textures.clear();
+        }
     }
 
-    ref->setName(ref->property.asset.name);
-    for (auto& shape : ref->property.shapes)
+    if (!ref->cache)
     {
-        ref->meshes.emplace_back(ref->createMesh(shape));
-    }
+        string error;
+        auto extension = path.extension().string();
+        bool isObj = extension == ".obj" || extension == ".OBJ";
+        bool isPly = extension == ".ply" || extension == ".PLY";
+        if (isObj ? !loadObjScene(path, ref->property, error)
+                  : isPly ? !loadPlyScene(path, ref->property, error)
+                          : !load_scene(path.string(), ref->property, error, progress_callback))
+        {
+            CI_LOG_E(error);
+            return {};
+        }
 
-    for (auto& texture : ref->property.textures)
-    {
-        ref->textures.emplace_back(ref->createTexture(texture));
+        // the levels of detail and the optimizations of every shape in parallel, the uploads stay on this thread
+        auto shapeCount = ref->property.shapes.size();
+        vector<vector<uint32_t>> lodIndices(shapeCount);
+        ref->meshLods.assign(shapeCount, {});
+        if (ref->lodLevels > 1 || ref->optimizeMeshes)
+        {
+            auto jobs = melo::JobSystem::getDefault();
+            vector<melo::JobRef> shapeJobs;
+            for (size_t i = 0; i < shapeCount; i++)
+            {
+                shapeJobs.push_back(jobs->add([&, i] {
+                    auto& shape = ref->property.shapes[i];
+                    auto indices = (uint32_t*)shape.triangles.data();
+                    size_t indexCount = shape.triangles.size() * 3;
+                    auto positions = (const vec3*)shape.positions.data();
+                    size_t vertexCount = shape.positions.size();
+                    if (indexCount == 0)
+                        return;
+                    if (ref->optimizeMeshes)
+                        melo::optimizeTriangleOrder(indices, indexCount, positions, vertexCount);
+                    if (ref->lodLevels > 1)
+                    {
+                        auto& lods = ref->meshLods[i];
+                        melo::buildLodChain(indices, indexCount, positions, vertexCount, ref->lodLevels, 0.5f,
+                            &lodIndices[i], &lods);
+                        // level 0 is already in INDICES
+                        lodIndices[i].erase(lodIndices[i].begin(), lodIndices[i].begin() + indexCount);
+                        if (lods.size() < 2)
+                            lods.clear();
+                        for (size_t level = 1; ref->optimizeMeshes && level < lods.size(); level++)
+                        {
+                            melo::optimizeTriangleOrder(lodIndices[i].data() + lods[level].indexOffset - indexCount,
+                                lods[level].indexCount, positions, vertexCount);
+                        }
+                    }
+                    if (!ref->optimizeMeshes)
+                        return;
+
+                    // the coarser levels only use vertices of level 0, so its first uses number them all
+                    vector<uint32_t> remap(vertexCount);
+                    size_t newVertexCount = melo::optimizeVertexFetchRemap(remap.data(), indices, indexCount, vertexCount);
+                    melo::remapIndices(indices, indices, indexCount, remap.data());
+                    melo::remapIndices(lodIndices[i].data(), lodIndices[i].data(), lodIndices[i].size(), remap.data());
+                    melo::remapVertices(&shape.positions, remap.data(), vertexCount, newVertexCount);
+                    melo::remapVertices(&shape.normals, remap.data(), vertexCount, newVertexCount);
+                    melo::remapVertices(&shape.tangents, remap.data(), vertexCount, newVertexCount);
+                    melo::remapVertices(&shape.texcoords, remap.data(), vertexCount, newVertexCount);
+                    melo::remapVertices(&shape.colors, remap.data(), vertexCount, newVertexCount);
+                    melo::remapVertices(&shape.radius, remap.data(), vertexCount, newVertexCount);
+                }));
+            }
+            jobs->wait(shapeJobs);
+        }
+
+        for (size_t i = 0; i < shapeCount; i++)
+        {
+            const auto& shape = ref->property.shapes[i];
+            ShapeStreams streams;
+            streams.set(ShapeStreams::INDICES, shape.triangles);
+            streams.set(ShapeStreams::POSITIONS, shape.positions);
+            streams.set(ShapeStreams::NORMALS, shape.normals);
+            streams.set(ShapeStreams::TANGENTS, shape.tangents);
+            streams.set(ShapeStreams::TEXCOORDS, shape.texcoords);
+            streams.set(ShapeStreams::COLORS, shape.colors);
+            streams.set(ShapeStreams::LOD_INDICES, lodIndices[i]);
+            ref->meshes.emplace_back(ref->createMesh(streams));
+        }
+
+        for (auto& texture : ref->property.textures)
+        {
+            CI_ASSERT(texture.pixelsf.empty());
+            melo::CachedImage image;
+            image.width = texture.width;
+            image.height = texture.height;
+            image.components = 4;
+            image.levels = { (const uint8_t*)texture.pixelsb.data() };
+            ref->textures.emplace_back(ref->createTexture(image));
+        }
+
+        if (useCache && !ref->writeCache(cachePath, lodIndices))
+        {
+            CI_LOG_W("Failed to write the cache " << cachePath);
+        }
     }
 
+    ref->setName(ref->property.asset.name);
     ref->createMaterials();
 
     for (auto& instance : ref->property.instances)
@@ -292,6 +605,7 @@ GltfSceneRef GltfScene::create(const fs::path& path)
 
 void GltfScene::createMaterials(DebugType debugType)
 {
+    // the programs of earlier debug views stay in the ProgramCache, switching back compiles nothing
     materials.clear();
     for (auto& material : property.materials)
     {
@@ -300,37 +614,185 @@ void GltfScene::createMaterials(DebugType debugType)
     isMaterialDirty = true;
 }
 
-gl::Texture2dRef GltfScene::createTexture(const yocto::scene_texture& texture)
+void GltfScene::addToPicking(melo::PickingScene& picking)
+{
+    vector<uint32_t> shapes;
+    vector<pair<vec3, vec3>> bounds;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        // the triangles are still in property.shapes on cold loads, in the cache on warm ones
+        const void* positions = nullptr;
+        const void* indices = nullptr;
+        size_t positionsSize = 0, indicesSize = 0;
+        if (cache)
+        {
+            positions = cache->getSection(CACHE_SHAPE, i * ShapeStreams::COUNT + ShapeStreams::POSITIONS, &positionsSize);
+            indices = cache->getSection(CACHE_SHAPE, i * ShapeStreams::COUNT + ShapeStreams::INDICES, &indicesSize);
+        }
+        else
+        {
+            const auto& shape = property.shapes[i];
+            positions = shape.positions.data();
+            positionsSize = shape.positions.size() * sizeof(vec3);
+            indices = shape.triangles.data();
+            indicesSize = shape.triangles.size() * sizeof(yocto::vec3i);
+        }
+
+        auto vertexCount = positionsSize / sizeof(vec3);
+        pair<vec3, vec3> bound = { vec3(FLT_MAX), vec3(-FLT_MAX) };
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            bound.first = glm::min(bound.first, ((const vec3*)positions)[v]);
+            bound.second = glm::max(bound.second, ((const vec3*)positions)[v]);
+        }
+        bounds.push_back(bound);
+        shapes.push_back(picking.addShape((const vec3*)positions, vertexCount, (const uint32_t*)indices,
+            indicesSize / sizeof(uint32_t)));
+    }
+
+    for (auto& child : getChildren())
+    {
+        auto node = dynamic_pointer_cast<GltfNode>(child);
+        if (!node || node->property.shape == yocto::invalid_handle)
+            continue;
+        if (shapes[node->property.shape] == melo::PickingScene::INVALID)
+            continue;
+        node->mBoundBoxMin = bounds[node->property.shape].first;
+        node->mBoundBoxMax = bounds[node->property.shape].second;
+        picking.addInstance(shapes[node->property.shape], node);
+    }
+}
+
+// Warm load, false if the cache is missing, stale or incomplete
+bool GltfScene::loadCache(const string& cachePath, uint64_t sourceHash)
+{
+    cache = melo::SceneCache::open(cachePath, sourceHash);
+    if (!cache)
+        return false;
+
+    size_t nameSize = 0;
+    auto name = (const char*)cache->getSection(CACHE_NAME, 0, &nameSize);
+    vector<uint32_t> counts;
+    if (!name || !cache->getArray(CACHE_COUNTS, 0, &counts) || counts.size() != 2 ||
+        !cache->getArray(CACHE_MATERIALS, 0, &property.materials) ||
+        !cache->getArray(CACHE_INSTANCES, 0, &property.instances))
+        return false;
+    property.asset.name.assign(name, nameSize);
+
+    for (uint32_t i = 0; i < counts[0]; i++)
+    {
+        ShapeStreams streams;
+        for (uint32_t stream = 0; stream < ShapeStreams::COUNT; stream++)
+            streams.data[stream] = cache->getSection(CACHE_SHAPE, i * ShapeStreams::COUNT + stream, &streams.size[stream]);
+        meshes.emplace_back(createMesh(streams));
+        auto lods = (const melo::LodLevel*)streams.data[ShapeStreams::LOD_LEVELS];
+        meshLods.emplace_back(lods, lods + streams.size[ShapeStreams::LOD_LEVELS] / sizeof(melo::LodLevel));
+    }
+
+    for (uint32_t i = 0; i < counts[1]; i++)
+    {
+        melo::CachedImage image;
+        if (!melo::getCachedImage(*cache, CACHE_TEXTURE, i, &image))
+            return false;
+        textures.emplace_back(createTexture(image));
+    }
+    return true;
+}
+
+bool GltfScene::writeCache(const string& cachePath, const vector<vector<uint32_t>>& lodIndices) const
+{
+    for (auto& texture : property.textures)
+    {
+        // HDR textures aren't cached
+        if (!texture.pixelsf.empty())
+            return false;
+    }
+
+    vector<string> dependencies;
+    melo::SceneCacheWriter writer(getCacheHash(path, lodLevels, optimizeMeshes, &dependencies));
+    for (auto& dependency : dependencies)
+        writer.addDependency(dependency);
+
+    vector<uint32_t> counts = { (uint32_t)property.shapes.size(), (uint32_t)property.textures.size() };
+    writer.addArray(CACHE_COUNTS, 0, counts);
+    writer.addSectionRef(CACHE_NAME, 0, property.asset.name.data(), property.asset.name.size());
+    writer.addArray(CACHE_MATERIALS, 0, property.materials);
+    writer.addArray(CACHE_INSTANCES, 0, property.instances);
+
+    for (uint32_t i = 0; i < property.shapes.size(); i++)
+    {
+        const auto& shape = property.shapes[i];
+        auto base = i * ShapeStreams::COUNT;
+        writer.addArray(CACHE_SHAPE, base + ShapeStreams::INDICES, shape.triangles);
+        writer.addArray(CACHE_SHAPE, base + ShapeStreams::POSITIONS, shape.positions);
+        writer.addArray(CACHE_SHAPE, base + ShapeStreams::NORMALS, shape.normals);
+        writer.addArray(CACHE_SHAPE, base + ShapeStreams::TANGENTS, shape.tangents);
+        writer.addArray(CACHE_SHAPE, base + ShapeStreams::TEXCOORDS, shape.texcoords);
+        writer.addArray(CACHE_SHAPE, base + ShapeStreams::COLORS, shape.colors);
+        writer.addArray(CACHE_SHAPE, base + ShapeStreams::LOD_INDICES, lodIndices[i]);
+        writer.addArray(CACHE_SHAPE, base + ShapeStreams::LOD_LEVELS, meshLods[i]);
+    }
+
+    for (uint32_t i = 0; i < property.textures.size(); i++)
+    {
+        const auto& texture = property.textures[i];
+        melo::addCachedImage(writer, CACHE_TEXTURE, i, (const uint8_t*)texture.pixelsb.data(), texture.width,
+            texture.height, 4);
+    }
+    return writer.write(cachePath);
+}
+
+gl::Texture2dRef GltfScene::createTexture(const melo::CachedImage& image)
 {
-    CI_ASSERT(texture.pixelsf.empty());
     auto fmt = gl::Texture2d::Format().mipmap(true);
-    return gl::Texture2d::create(texture.pixelsb.data(),
-        GL_RGBA, texture.width, texture.height, fmt);
+    auto texture = gl::Texture2d::create(image.levels[0], GL_RGBA, image.width, image.height, fmt);
+
+    // cached textures come with their mip chain, it replaces the generated levels
+    for (size_t level = 1; level < image.levels.size(); level++)
+    {
+        auto width = image.getLevelWidth(level);
+        texture->update(Surface8u((uint8_t*)image.levels[level], width, image.getLevelHeight(level), width * 4,
+            SurfaceChannelOrder::RGBA), (int)level);
+    }
+    return texture;
 }
 
-gl::VboMeshRef GltfScene::createMesh(const yocto::scene_shape& shape)
+gl::VboMeshRef GltfScene::createMesh(const ShapeStreams& streams)
 {
-    TriMesh::Format fmt;
-    if (!shape.positions.empty()) fmt.positions();
-    if (!shape.normals.empty()) fmt.normals();
-    if (!shape.tangents.empty()) fmt.tangents();
-    if (!shape.texcoords.empty()) fmt.texCoords0();
-    if (!shape.colors.empty()) fmt.colors(4);
-
-    TriMesh triMesh(fmt);
-    if (!shape.triangles.empty())
-        triMesh.appendIndices((uint32_t*)shape.triangles.data(), shape.triangles.size() * 3);
-    if (!shape.positions.empty())
-        triMesh.appendPositions((glm::vec3*)shape.positions.data(), shape.positions.size());
-    if (!shape.tangents.empty())
-        triMesh.appendTangents((glm::vec3*)shape.tangents.data(), shape.tangents.size());
-    if (!shape.normals.empty())
-        triMesh.appendNormals((glm::vec3*)shape.normals.data(), shape.normals.size());
-    if (!shape.texcoords.empty())
-        triMesh.appendTexCoords0((glm::vec2*)shape.texcoords.data(), shape.texcoords.size());
-    if (!shape.colors.empty())
-        triMesh.appendColors((ColorA*)shape.colors.data(), shape.colors.size());
-
-    return gl::VboMesh::create(triMesh);
+    static const pair<geom::Attrib, uint8_t> kAttribs[ShapeStreams::COUNT] = {
+        { geom::NUM_ATTRIBS, 0 },
+        { geom::POSITION, 3 },
+        { geom::NORMAL, 3 },
+        { geom::TANGENT, 4 },
+        { geom::TEX_COORD_0, 2 },
+        { geom::COLOR, 4 },
+        { geom::NUM_ATTRIBS, 0 },
+        { geom::NUM_ATTRIBS, 0 },
+    };
+
+    // one vbo per stream, straight from the arrays
+    vector<pair<geom::BufferLayout, gl::VboRef>> vboLayouts;
+    for (int stream = ShapeStreams::POSITIONS; stream <= ShapeStreams::COLORS; stream++)
+    {
+        if (streams.size[stream] == 0)
+            continue;
+        geom::BufferLayout layout;
+        layout.append(kAttribs[stream].first, kAttribs[stream].second, 0, 0);
+        vboLayouts.emplace_back(layout, gl::Vbo::create(GL_ARRAY_BUFFER, streams.size[stream], streams.data[stream]));
+    }
+
+    auto numVertices = (uint32_t)(streams.size[ShapeStreams::POSITIONS] / sizeof(glm::vec3));
+    auto numIndices = (uint32_t)(streams.size[ShapeStreams::INDICES] / sizeof(uint32_t));
+    if (numIndices == 0)
+        return gl::VboMesh::create(numVertices, GL_TRIANGLES, vboLayouts);
+
+    // the levels of detail follow in the same vbo, numIndices draws the first one
+    auto indexVbo = gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER,
+        streams.size[ShapeStreams::INDICES] + streams.size[ShapeStreams::LOD_INDICES], nullptr, GL_STATIC_DRAW);
+    indexVbo->bufferSubData(0, streams.size[ShapeStreams::INDICES], streams.data[ShapeStreams::INDICES]);
+    if (streams.size[ShapeStreams::LOD_INDICES] > 0)
+        indexVbo->bufferSubData(streams.size[ShapeStreams::INDICES], streams.size[ShapeStreams::LOD_INDICES],
+            streams.data[ShapeStreams::LOD_INDICES]);
+    return gl::VboMesh::create(numVertices, GL_TRIANGLES, vboLayouts, numIndices, GL_UNSIGNED_INT, indexVbo);
 }
 
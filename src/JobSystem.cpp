@@ -0,0 +1,126 @@
+#include "../include/JobSystem.h"
+
+namespace melo
+{
+    struct Job
+    {
+        std::function<void()> func;
+        size_t pendingDependencies = 0;
+        std::vector<JobRef> dependents;
+        bool finished = false;
+    };
+
+    JobSystemRef JobSystem::create(size_t threadCount)
+    {
+        if (threadCount == 0)
+        {
+            size_t hardwareThreads = std::thread::hardware_concurrency();
+            threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        }
+
+        JobSystemRef ref(new JobSystem());
+        for (size_t i = 0; i < threadCount; i++)
+            ref->mThreads.emplace_back(&JobSystem::workerLoop, ref.get());
+        return ref;
+    }
+
+    JobSystemRef JobSystem::getDefault()
+    {
+        static JobSystemRef instance = create();
+        return instance;
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQuit = true;
+        }
+        mJobQueued.notify_all();
+        for (auto& thread : mThreads)
+            thread.join();
+    }
+
+    JobRef JobSystem::add(std::function<void()> func, const std::vector<JobRef>& dependencies)
+    {
+        auto job = std::make_shared<Job>();
+        job->func = std::move(func);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto& dependency : dependencies)
+        {
+            if (dependency && !dependency->finished)
+            {
+                dependency->dependents.push_back(job);
+                job->pendingDependencies++;
+            }
+        }
+        if (job->pendingDependencies == 0)
+        {
+            mQueue.push_back(job);
+            mJobQueued.notify_one();
+        }
+        return job;
+    }
+
+    void JobSystem::run(std::unique_lock<std::mutex>& lock, JobRef job)
+    {
+        lock.unlock();
+        job->func();
+        job->func = nullptr;
+        lock.lock();
+
+        job->finished = true;
+        for (auto& dependent : job->dependents)
+        {
+            if (--dependent->pendingDependencies == 0)
+            {
+                mQueue.push_back(dependent);
+                mJobQueued.notify_one();
+            }
+        }
+        job->dependents.clear();
+        mJobFinished.notify_all();
+    }
+
+    void JobSystem::workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true)
+        {
+            mJobQueued.wait(lock, [this] { return mQuit || !mQueue.empty(); });
+            if (mQuit)
+                return;
+            auto job = mQueue.front();
+            mQueue.pop_front();
+            run(lock, job);
+        }
+    }
+
+    void JobSystem::wait(const JobRef& job)
+    {
+        if (!job)
+            return;
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!job->finished)
+        {
+            if (!mQueue.empty())
+            {
+                auto other = mQueue.front();
+                mQueue.pop_front();
+                run(lock, other);
+            }
+            else
+            {
+                mJobFinished.wait(lock);
+            }
+        }
+    }
+
+    void JobSystem::wait(const std::vector<JobRef>& jobs)
+    {
+        for (auto& job : jobs)
+            wait(job);
+    }
+}
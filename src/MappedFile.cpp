@@ -0,0 +1,99 @@
+#include "../include/MappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace melo
+{
+    // An empty file is a valid mapping with a null data pointer.
+    MappedFileRef MappedFile::create(const std::string& path)
+    {
+        MappedFileRef ref(new MappedFile());
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return {};
+        ref->mFileHandle = file;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+            return {};
+        ref->mSize = (size_t)size.QuadPart;
+        if (ref->mSize == 0)
+            return ref;
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            return {};
+        ref->mMappingHandle = mapping;
+
+        ref->mData = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!ref->mData)
+            return {};
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return {};
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return {};
+        }
+        ref->mSize = (size_t)st.st_size;
+        if (ref->mSize == 0)
+        {
+            close(fd);
+            return ref;
+        }
+
+        void* addr = mmap(nullptr, ref->mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        close(fd);
+        if (addr == MAP_FAILED)
+            return {};
+        ref->mData = (const uint8_t*)addr;
+#endif
+        return ref;
+    }
+
+    void MappedFile::prefetch() const
+    {
+        if (!mData)
+            return;
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+        WIN32_MEMORY_RANGE_ENTRY range = {(void*)mData, mSize};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+        madvise((void*)mData, mSize, MADV_WILLNEED);
+#endif
+    }
+
+    MappedFile::~MappedFile()
+    {
+#ifdef _WIN32
+        if (mData)
+            UnmapViewOfFile(mData);
+        if (mMappingHandle)
+            CloseHandle(mMappingHandle);
+        if (mFileHandle)
+            CloseHandle(mFileHandle);
+#else
+        if (mData)
+            munmap((void*)mData, mSize);
+#endif
+    }
+}
@@ -0,0 +1,121 @@
+#include "../include/MeshGeometry.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace melo
+{
+    namespace
+    {
+        float getAngle(const glm::vec3& a, const glm::vec3& b)
+        {
+            float lengths = glm::length(a) * glm::length(b);
+            if (lengths <= 0)
+                return 0;
+            return std::acos(std::min(1.0f, std::max(-1.0f, glm::dot(a, b) / lengths)));
+        }
+
+        // v without its component along the unit vector n, normalized, 0 when nothing is left
+        glm::vec3 getOrthogonal(const glm::vec3& v, const glm::vec3& n)
+        {
+            glm::vec3 projected = v - n * glm::dot(n, v);
+            float length = glm::length(projected);
+            return length > 1e-20f ? projected * (1 / length) : glm::vec3(0.0f);
+        }
+
+        // any unit vector orthogonal to the unit vector n
+        glm::vec3 getPerpendicular(const glm::vec3& n)
+        {
+            glm::vec3 axis = std::abs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+            glm::vec3 perpendicular = getOrthogonal(axis, n);
+            return glm::dot(perpendicular, perpendicular) > 0 ? perpendicular : axis;
+        }
+    }
+
+    void computeMeshGeometry(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+                             const glm::vec2* texcoords, std::vector<glm::vec3>* normals,
+                             std::vector<glm::vec4>* tangents, glm::vec3* boundsMin, glm::vec3* boundsMax,
+                             bool flipV)
+    {
+        bool generateNormals = normals->size() != vertexCount;
+        if (generateNormals)
+            normals->assign(vertexCount, glm::vec3(0.0f));
+        std::vector<glm::vec3> tangentSums, bitangentSums;
+        if (texcoords)
+        {
+            tangentSums.assign(vertexCount, glm::vec3(0.0f));
+            bitangentSums.assign(vertexCount, glm::vec3(0.0f));
+        }
+
+        for (size_t i = 0; i + 2 < indexCount; i += 3)
+        {
+            uint32_t corners[3] = {indices[i], indices[i + 1], indices[i + 2]};
+            const glm::vec3& p0 = positions[corners[0]];
+            const glm::vec3& p1 = positions[corners[1]];
+            const glm::vec3& p2 = positions[corners[2]];
+            glm::vec3 e1 = p1 - p0, e2 = p2 - p0;
+            glm::vec3 faceNormal = glm::cross(e1, e2);
+            float area = glm::length(faceNormal);
+            if (area <= 0)
+                continue;
+            faceNormal = faceNormal * (1 / area);
+
+            float angles[3];
+            angles[0] = getAngle(e1, e2);
+            angles[1] = getAngle(p2 - p1, p0 - p1);
+            angles[2] = std::max(0.0f, 3.14159265f - angles[0] - angles[1]);
+            if (generateNormals)
+            {
+                for (int k = 0; k < 3; k++)
+                    (*normals)[corners[k]] += faceNormal * angles[k];
+            }
+            if (!texcoords)
+                continue;
+
+            // the face's texture axes, oriented by the sign of its texcoord area like MikkTSpace does
+            glm::vec2 t1 = texcoords[corners[1]] - texcoords[corners[0]];
+            glm::vec2 t2 = texcoords[corners[2]] - texcoords[corners[0]];
+            float signedArea = t1.x * t2.y - t1.y * t2.x;
+            float orientation = signedArea > 0 ? 1.0f : -1.0f;
+            // in the face plane and normalized once per face, the vertex pass projects the sums onto each normal
+            glm::vec3 tangent = getOrthogonal((e1 * t2.y - e2 * t1.y) * orientation, faceNormal);
+            glm::vec3 bitangent = getOrthogonal((e2 * t1.x - e1 * t2.x) * orientation, faceNormal);
+            for (int k = 0; k < 3; k++)
+            {
+                tangentSums[corners[k]] += tangent * angles[k];
+                bitangentSums[corners[k]] += bitangent * angles[k];
+            }
+        }
+
+        tangents->resize(vertexCount);
+        float handedness = flipV ? -1.0f : 1.0f;
+        glm::vec3 lower(0.0f), upper(0.0f);
+        if (vertexCount > 0)
+            lower = upper = positions[0];
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            lower = glm::min(lower, positions[v]);
+            upper = glm::max(upper, positions[v]);
+
+            glm::vec3& n = (*normals)[v];
+            if (generateNormals)
+            {
+                float length = glm::length(n);
+                n = length > 0 ? n * (1 / length) : glm::vec3(0, 0, 1);
+            }
+            if (!texcoords)
+            {
+                (*tangents)[v] = glm::vec4(getPerpendicular(n), 1.0f);
+                continue;
+            }
+
+            glm::vec3 t = getOrthogonal(tangentSums[v], n);
+            if (glm::dot(t, t) == 0)
+                t = getPerpendicular(n);
+            float w = glm::dot(glm::cross(n, t), bitangentSums[v]) < 0 ? -handedness : handedness;
+            (*tangents)[v] = glm::vec4(t, w);
+        }
+        *boundsMin = lower;
+        *boundsMax = upper;
+    }
+}
@@ -0,0 +1,610 @@
+#include "../include/MeshLod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace melo
+{
+    namespace
+    {
+        enum VertexKind : uint8_t
+        {
+            KIND_MANIFOLD, // inside an attribute chart, collapses anywhere
+            KIND_BORDER,   // on an open border, collapses along it
+            KIND_SEAM,     // on a seam between two attribute charts, collapses along it with its twin
+            KIND_LOCKED,
+        };
+
+        // border and seam edges keep their place against the weight of the triangles around them
+        static constexpr double EDGE_WEIGHT = 10.0;
+        // passes removing less than this fraction of the indices end the simplification
+        static constexpr size_t MIN_PASS_REDUCTION = 128;
+
+        // squared distance to a set of weighted planes, p A p + 2 b p + c, over the sum of their weights
+        struct Quadric
+        {
+            double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+            double b0 = 0, b1 = 0, b2 = 0;
+            double c = 0;
+            double weight = 0;
+
+            void addPlane(const glm::vec3& normal, double distance, double planeWeight)
+            {
+                double x = normal.x, y = normal.y, z = normal.z;
+                a00 += planeWeight * x * x;
+                a11 += planeWeight * y * y;
+                a22 += planeWeight * z * z;
+                a01 += planeWeight * x * y;
+                a02 += planeWeight * x * z;
+                a12 += planeWeight * y * z;
+                b0 += planeWeight * x * distance;
+                b1 += planeWeight * y * distance;
+                b2 += planeWeight * z * distance;
+                c += planeWeight * distance * distance;
+                weight += planeWeight;
+            }
+
+            void add(const Quadric& other)
+            {
+                a00 += other.a00;
+                a11 += other.a11;
+                a22 += other.a22;
+                a01 += other.a01;
+                a02 += other.a02;
+                a12 += other.a12;
+                b0 += other.b0;
+                b1 += other.b1;
+                b2 += other.b2;
+                c += other.c;
+                weight += other.weight;
+            }
+
+            // the weighted sum of the squared distances, not yet divided by weight
+            double sum(const glm::vec3& p) const
+            {
+                double x = p.x, y = p.y, z = p.z;
+                return a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                       2 * (b0 * x + b1 * y + b2 * z) + c;
+            }
+
+            double evaluate(const glm::vec3& p) const { return weight > 0 ? std::max(0.0, sum(p) / weight) : 0.0; }
+        };
+
+        // the error of a and b added up, without building their sum
+        static double evaluatePair(const Quadric& a, const Quadric& b, const glm::vec3& p)
+        {
+            double weight = a.weight + b.weight;
+            return weight > 0 ? std::max(0.0, (a.sum(p) + b.sum(p)) / weight) : 0.0;
+        }
+
+        static uint32_t hashPosition(const glm::vec3& position)
+        {
+            uint32_t bits[3];
+            memcpy(bits, &position, sizeof(bits));
+            // grid coordinates leave the low bits zero, the murmur3 finalizer spreads the others over them
+            uint32_t hash = bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u;
+            hash ^= hash >> 16;
+            hash *= 0x85ebca6bu;
+            hash ^= hash >> 13;
+            hash *= 0xc2b2ae35u;
+            return hash ^ (hash >> 16);
+        }
+
+        // lists of uint32_t per item, filled in two passes
+        struct Adjacency
+        {
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> items;
+
+            const uint32_t* begin(uint32_t key) const { return items.data() + offsets[key]; }
+            const uint32_t* end(uint32_t key) const { return items.data() + offsets[key + 1]; }
+        };
+
+        class Simplifier
+        {
+        public:
+            Simplifier(const uint32_t* indices, size_t indexCount, const glm::vec3* positions, size_t vertexCount)
+                : mIndices(indices, indices + indexCount), mVertexCount(vertexCount)
+            {
+                normalize(positions);
+                weld();
+                classify();
+                buildQuadrics();
+            }
+
+            // returns the error reached, in normalized units
+            double simplify(size_t targetIndexCount, double targetError)
+            {
+                double error = 0;
+                while (mIndices.size() > targetIndexCount)
+                {
+                    // the last passes only find a few collapses between the locked neighbourhoods, each costs as much
+                    // as the first ones
+                    size_t indexCount = mIndices.size();
+                    collapsePass(targetIndexCount / 3, targetError * targetError, &error);
+                    if (indexCount - mIndices.size() < indexCount / MIN_PASS_REDUCTION)
+                        break;
+                }
+                return error;
+            }
+
+            const std::vector<uint32_t>& getIndices() const { return mIndices; }
+            float getScale() const { return mScale; }
+
+        private:
+            struct Collapse
+            {
+                uint32_t from, to;
+                double cost;
+            };
+
+            void normalize(const glm::vec3* positions)
+            {
+                // positions in the unit cube keep the quadrics well conditioned
+                glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+                for (uint32_t index : mIndices)
+                {
+                    boundsMin = glm::min(boundsMin, positions[index]);
+                    boundsMax = glm::max(boundsMax, positions[index]);
+                }
+                glm::vec3 extent = boundsMax - boundsMin;
+                mScale = std::max(std::max(extent.x, extent.y), std::max(extent.z, FLT_MIN));
+                mPositions.resize(mVertexCount);
+                for (size_t i = 0; i < mVertexCount; i++)
+                    mPositions[i] = (positions[i] - boundsMin) / mScale;
+            }
+
+            // vertices at the same position form a group, its first vertex stands for it and the others are linked
+            // in a ring
+            void weld()
+            {
+                mRemap.resize(mVertexCount);
+                mWedge.resize(mVertexCount);
+                std::vector<uint8_t> used(mVertexCount, 0);
+                for (uint32_t index : mIndices)
+                    used[index] = 1;
+
+                // open addressing, a power of two at least twice the vertex count
+                size_t tableSize = 1;
+                while (tableSize < mVertexCount * 2)
+                    tableSize *= 2;
+                std::vector<uint32_t> firstVertex(tableSize, UINT32_MAX);
+                for (uint32_t vertex = 0; vertex < (uint32_t)mVertexCount; vertex++)
+                {
+                    mRemap[vertex] = mWedge[vertex] = vertex;
+                    if (!used[vertex])
+                        continue;
+                    size_t slot = hashPosition(mPositions[vertex]) & (tableSize - 1);
+                    while (firstVertex[slot] != UINT32_MAX &&
+                           memcmp(&mPositions[firstVertex[slot]], &mPositions[vertex], sizeof(glm::vec3)) != 0)
+                        slot = (slot + 1) & (tableSize - 1);
+                    if (firstVertex[slot] == UINT32_MAX)
+                        firstVertex[slot] = vertex;
+                    uint32_t first = firstVertex[slot];
+                    if (first != vertex)
+                    {
+                        mRemap[vertex] = first;
+                        mWedge[vertex] = mWedge[first];
+                        mWedge[first] = vertex;
+                    }
+                }
+            }
+
+            // outgoing half-edges of every vertex, and the triangles around every group
+            void buildAdjacency()
+            {
+                mEdges.offsets.assign(mVertexCount + 1, 0);
+                mGroupTriangles.offsets.assign(mVertexCount + 1, 0);
+                for (uint32_t index : mIndices)
+                {
+                    mEdges.offsets[index + 1]++;
+                    mGroupTriangles.offsets[mRemap[index] + 1]++;
+                }
+                for (size_t i = 0; i < mVertexCount; i++)
+                {
+                    mEdges.offsets[i + 1] += mEdges.offsets[i];
+                    mGroupTriangles.offsets[i + 1] += mGroupTriangles.offsets[i];
+                }
+                mEdges.items.resize(mIndices.size());
+                mGroupTriangles.items.resize(mIndices.size());
+                std::vector<uint32_t> edgeFill(mEdges.offsets.begin(), mEdges.offsets.end() - 1);
+                std::vector<uint32_t> triangleFill(mGroupTriangles.offsets.begin(), mGroupTriangles.offsets.end() - 1);
+                for (size_t i = 0; i < mIndices.size(); i++)
+                {
+                    uint32_t triangle = (uint32_t)(i / 3);
+                    uint32_t next = mIndices[triangle * 3 + (i + 1) % 3];
+                    mEdges.items[edgeFill[mIndices[i]]++] = next;
+                    mGroupTriangles.items[triangleFill[mRemap[mIndices[i]]]++] = triangle;
+                }
+            }
+
+            bool hasEdge(uint32_t a, uint32_t b) const
+            {
+                return std::find(mEdges.begin(a), mEdges.end(a), b) != mEdges.end(a);
+            }
+
+            // any wedge of a to any wedge of b
+            bool hasPositionEdge(uint32_t a, uint32_t b) const
+            {
+                uint32_t group = mRemap[b];
+                uint32_t wedge = a;
+                do
+                {
+                    for (auto it = mEdges.begin(wedge); it != mEdges.end(wedge); ++it)
+                    {
+                        if (mRemap[*it] == group)
+                            return true;
+                    }
+                    wedge = mWedge[wedge];
+                } while (wedge != a);
+                return false;
+            }
+
+            void classify()
+            {
+                buildAdjacency();
+
+                // open half-edges have no twin, one way or the other
+                std::vector<uint32_t> openOut(mVertexCount, 0), openIn(mVertexCount, 0);
+                std::vector<uint32_t> openNext(mVertexCount, 0), openPrevious(mVertexCount, 0);
+                for (uint32_t vertex = 0; vertex < (uint32_t)mVertexCount; vertex++)
+                {
+                    for (auto it = mEdges.begin(vertex); it != mEdges.end(vertex); ++it)
+                    {
+                        if (hasEdge(*it, vertex))
+                            continue;
+                        openOut[vertex]++;
+                        openNext[vertex] = *it;
+                        openIn[*it]++;
+                        openPrevious[*it] = vertex;
+                    }
+                }
+
+                mKinds.assign(mVertexCount, KIND_LOCKED);
+                for (uint32_t vertex = 0; vertex < (uint32_t)mVertexCount; vertex++)
+                {
+                    if (mRemap[vertex] != vertex || mEdges.begin(vertex) == mEdges.end(vertex))
+                        continue;
+                    uint32_t twin = mWedge[vertex];
+                    if (twin == vertex)
+                    {
+                        // an open edge whose other side uses another wedge is the tip of a seam, not a border
+                        if (openOut[vertex] == 0 && openIn[vertex] == 0)
+                            mKinds[vertex] = KIND_MANIFOLD;
+                        else if (openOut[vertex] == 1 && openIn[vertex] == 1 &&
+                                 !hasPositionEdge(openNext[vertex], vertex) && !hasPositionEdge(vertex, openPrevious[vertex]))
+                            mKinds[vertex] = KIND_BORDER;
+                    }
+                    else if (mWedge[twin] == vertex)
+                    {
+                        // the open edges of either side run along the same positions, the other way around
+                        bool seam = openOut[vertex] == 1 && openIn[vertex] == 1 && openOut[twin] == 1 && openIn[twin] == 1 &&
+                                    mRemap[openNext[vertex]] == mRemap[openPrevious[twin]] &&
+                                    mRemap[openPrevious[vertex]] == mRemap[openNext[twin]];
+                        if (seam)
+                            mKinds[vertex] = mKinds[twin] = KIND_SEAM;
+                    }
+                }
+                for (uint32_t vertex = 0; vertex < (uint32_t)mVertexCount; vertex++)
+                    mKinds[vertex] = mKinds[mRemap[vertex]];
+            }
+
+            void buildQuadrics()
+            {
+                mQuadrics.assign(mVertexCount, Quadric());
+                for (size_t i = 0; i < mIndices.size(); i += 3)
+                {
+                    const glm::vec3& p0 = mPositions[mIndices[i]];
+                    const glm::vec3& p1 = mPositions[mIndices[i + 1]];
+                    const glm::vec3& p2 = mPositions[mIndices[i + 2]];
+                    glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                    float length = glm::length(normal);
+                    if (!(length > 0))
+                        continue;
+                    normal = normal / length;
+                    // weighted by area
+                    Quadric plane;
+                    plane.addPlane(normal, -glm::dot(normal, p0), length * 0.5);
+                    for (int corner = 0; corner < 3; corner++)
+                        mQuadrics[mRemap[mIndices[i + corner]]].add(plane);
+
+                    // planes through the open edges, across the triangle
+                    for (int corner = 0; corner < 3; corner++)
+                    {
+                        uint32_t a = mIndices[i + corner], b = mIndices[i + (corner + 1) % 3];
+                        if (hasEdge(b, a))
+                            continue;
+                        glm::vec3 edge = mPositions[b] - mPositions[a];
+                        float edgeLength = glm::length(edge);
+                        if (!(edgeLength > 0))
+                            continue;
+                        glm::vec3 across = glm::normalize(glm::cross(edge / edgeLength, normal));
+                        Quadric edgePlane;
+                        edgePlane.addPlane(across, -glm::dot(across, mPositions[a]), edgeLength * edgeLength * EDGE_WEIGHT);
+                        mQuadrics[mRemap[a]].add(edgePlane);
+                        mQuadrics[mRemap[b]].add(edgePlane);
+                    }
+                }
+            }
+
+            bool canCollapse(uint32_t from, uint32_t to, bool open) const
+            {
+                switch (mKinds[from])
+                {
+                case KIND_MANIFOLD:
+                    return true;
+                case KIND_BORDER:
+                    return open && (mKinds[to] == KIND_BORDER || mKinds[to] == KIND_LOCKED);
+                case KIND_SEAM:
+                    return open && mKinds[to] == KIND_SEAM;
+                default:
+                    return false;
+                }
+            }
+
+            // the other wedge of a seam vertex
+            uint32_t getTwin(uint32_t vertex) const { return mWedge[vertex]; }
+
+            // false when moving the group of from to the position of to turns a remaining triangle around
+            bool keepsOrientation(uint32_t from, uint32_t to) const
+            {
+                uint32_t fromGroup = mRemap[from], toGroup = mRemap[to];
+                const glm::vec3& target = mPositions[to];
+                for (auto it = mGroupTriangles.begin(fromGroup); it != mGroupTriangles.end(fromGroup); ++it)
+                {
+                    const uint32_t* corners = &mIndices[*it * 3];
+                    glm::vec3 before[3], after[3];
+                    bool collapses = false;
+                    for (int corner = 0; corner < 3; corner++)
+                    {
+                        uint32_t group = mRemap[corners[corner]];
+                        collapses |= group == toGroup;
+                        before[corner] = mPositions[corners[corner]];
+                        after[corner] = group == fromGroup ? target : before[corner];
+                    }
+                    if (collapses)
+                        continue;
+                    glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                    glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                    if (glm::dot(normalBefore, normalAfter) <= 0)
+                        return false;
+                }
+                return true;
+            }
+
+            // a counting sort on the upper half of the float bits of the costs, which order like the costs as they
+            // aren't negative, close enough for picking the cheap collapses first and far cheaper than std::sort
+            void sortByCost(std::vector<Collapse>* candidates)
+            {
+                auto key = [](const Collapse& collapse) {
+                    float cost = (float)collapse.cost;
+                    uint32_t bits;
+                    memcpy(&bits, &cost, sizeof(bits));
+                    return bits >> 16;
+                };
+                mSortCounts.assign(65536 + 1, 0);
+                for (const auto& collapse : *candidates)
+                    mSortCounts[key(collapse) + 1]++;
+                for (size_t i = 1; i < mSortCounts.size(); i++)
+                    mSortCounts[i] += mSortCounts[i - 1];
+                mSorted.resize(candidates->size());
+                for (const auto& collapse : *candidates)
+                    mSorted[mSortCounts[key(collapse)]++] = collapse;
+                candidates->swap(mSorted);
+            }
+
+            // collapses the cheapest edges whose neighbourhoods don't overlap, returns how many
+            size_t collapsePass(size_t targetTriangleCount, double errorLimit, double* error)
+            {
+                buildAdjacency();
+
+                std::vector<Collapse> candidates;
+                for (size_t i = 0; i < mIndices.size(); i++)
+                {
+                    uint32_t a = mIndices[i], b = mIndices[i / 3 * 3 + (i + 1) % 3];
+                    if (mRemap[a] == mRemap[b] || (mKinds[a] == KIND_LOCKED && mKinds[b] == KIND_LOCKED))
+                        continue;
+                    bool open = !hasEdge(b, a);
+                    // inner edges once
+                    if (!open && mRemap[a] > mRemap[b])
+                        continue;
+
+                    const Quadric& quadricA = mQuadrics[mRemap[a]];
+                    const Quadric& quadricB = mQuadrics[mRemap[b]];
+                    Collapse best = {0, 0, -1};
+                    if (canCollapse(a, b, open))
+                        best = {a, b, evaluatePair(quadricA, quadricB, mPositions[b])};
+                    if (canCollapse(b, a, open))
+                    {
+                        double cost = evaluatePair(quadricA, quadricB, mPositions[a]);
+                        if (best.cost < 0 || cost < best.cost)
+                            best = {b, a, cost};
+                    }
+                    if (best.cost >= 0 && best.cost <= errorLimit)
+                        candidates.push_back(best);
+                }
+                if (candidates.empty())
+                    return 0;
+                sortByCost(&candidates);
+
+                // about two triangles go per collapse, the pass stops at the cost the target would need so that the
+                // next pass still sees the cheap collapses this one had to skip
+                size_t triangleCount = mIndices.size() / 3;
+                size_t removeCount = triangleCount - targetTriangleCount;
+                double passLimit = candidates[std::min(candidates.size() - 1, removeCount / 2)].cost;
+
+                std::vector<uint32_t> collapseTo(mVertexCount);
+                for (uint32_t vertex = 0; vertex < (uint32_t)mVertexCount; vertex++)
+                    collapseTo[vertex] = vertex;
+                std::vector<uint8_t> locked(mVertexCount, 0);
+                size_t collapsed = 0, removed = 0;
+                for (const auto& candidate : candidates)
+                {
+                    if (removed >= removeCount || candidate.cost > passLimit)
+                        break;
+                    uint32_t fromGroup = mRemap[candidate.from], toGroup = mRemap[candidate.to];
+                    if (locked[fromGroup] || locked[toGroup])
+                        continue;
+
+                    // a seam moves both of its sides, the other side must run along the same edge
+                    uint32_t fromTwin = 0, toTwin = 0;
+                    bool seam = mKinds[candidate.from] == KIND_SEAM;
+                    if (seam)
+                    {
+                        fromTwin = getTwin(candidate.from);
+                        toTwin = getTwin(candidate.to);
+                        if (!hasEdge(fromTwin, toTwin) && !hasEdge(toTwin, fromTwin))
+                            continue;
+                    }
+                    if (!keepsOrientation(candidate.from, candidate.to))
+                        continue;
+
+                    collapseTo[candidate.from] = candidate.to;
+                    if (seam)
+                        collapseTo[fromTwin] = toTwin;
+                    mQuadrics[toGroup].add(mQuadrics[fromGroup]);
+                    *error = std::max(*error, std::sqrt(candidate.cost));
+                    collapsed++;
+
+                    // the triangles around the collapsed group now depend on its new position
+                    for (auto it = mGroupTriangles.begin(fromGroup); it != mGroupTriangles.end(fromGroup); ++it)
+                    {
+                        bool degenerate = false;
+                        for (int corner = 0; corner < 3; corner++)
+                        {
+                            uint32_t group = mRemap[mIndices[*it * 3 + corner]];
+                            locked[group] = 1;
+                            degenerate |= group == toGroup;
+                        }
+                        removed += degenerate ? 1 : 0;
+                    }
+                }
+
+                // drop the triangles that lost an edge
+                size_t write = 0;
+                for (size_t i = 0; i < mIndices.size(); i += 3)
+                {
+                    uint32_t a = collapseTo[mIndices[i]], b = collapseTo[mIndices[i + 1]], c = collapseTo[mIndices[i + 2]];
+                    if (mRemap[a] == mRemap[b] || mRemap[b] == mRemap[c] || mRemap[a] == mRemap[c])
+                        continue;
+                    mIndices[write++] = a;
+                    mIndices[write++] = b;
+                    mIndices[write++] = c;
+                }
+                mIndices.resize(write);
+                return collapsed;
+            }
+
+            std::vector<uint32_t> mIndices;
+            size_t mVertexCount;
+            std::vector<glm::vec3> mPositions;
+            float mScale = 1;
+
+            std::vector<uint32_t> mRemap; // first vertex at the same position
+            std::vector<uint32_t> mWedge; // next vertex at the same position
+            std::vector<uint8_t> mKinds;
+            std::vector<Quadric> mQuadrics; // per group
+
+            Adjacency mEdges;          // per vertex, the vertices after it in its triangles
+            Adjacency mGroupTriangles; // per group
+
+            std::vector<uint32_t> mSortCounts;
+            std::vector<Collapse> mSorted;
+        };
+    }
+
+    size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const glm::vec3* positions,
+                        size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError)
+    {
+        indexCount = indexCount / 3 * 3;
+        if (indexCount <= targetIndexCount || vertexCount == 0)
+        {
+            if (destination != indices)
+                std::copy(indices, indices + indexCount, destination);
+            if (resultError)
+                *resultError = 0;
+            return indexCount;
+        }
+
+        Simplifier simplifier(indices, indexCount, positions, vertexCount);
+        double error = simplifier.simplify(targetIndexCount, targetError == FLT_MAX ? DBL_MAX : targetError / simplifier.getScale());
+        const auto& result = simplifier.getIndices();
+        std::copy(result.begin(), result.end(), destination);
+        if (resultError)
+            *resultError = (float)(error * simplifier.getScale());
+        return result.size();
+    }
+
+    void buildLodChain(const uint32_t* indices, size_t indexCount, const glm::vec3* positions, size_t vertexCount,
+                       uint32_t levelCount, float ratio, std::vector<uint32_t>* lodIndices, std::vector<LodLevel>* levels)
+    {
+        indexCount = indexCount / 3 * 3;
+        size_t offset = lodIndices->size();
+        lodIndices->insert(lodIndices->end(), indices, indices + indexCount);
+        levels->push_back({(uint32_t)offset, (uint32_t)indexCount, 0.0f});
+
+        std::vector<uint32_t> level;
+        float error = 0;
+        for (uint32_t i = 1; i < levelCount; i++)
+        {
+            const LodLevel& previous = levels->back();
+            size_t targetIndexCount = (size_t)(previous.indexCount / 3 * ratio) * 3;
+            level.resize(previous.indexCount);
+            float levelError = 0;
+            size_t count = simplifyMesh(level.data(), lodIndices->data() + previous.indexOffset, previous.indexCount,
+                                        positions, vertexCount, targetIndexCount, FLT_MAX, &levelError);
+            // a level saving less than a tenth isn't worth its indices, locked vertices keep the rest
+            if (count == 0 || count > previous.indexCount * 9 / 10)
+                break;
+            error += levelError;
+            offset = lodIndices->size();
+            lodIndices->insert(lodIndices->end(), level.begin(), level.begin() + count);
+            levels->push_back({(uint32_t)offset, (uint32_t)count, error});
+        }
+    }
+
+    LodSettings& getLodSettings()
+    {
+        static LodSettings settings;
+        return settings;
+    }
+
+    float getLodPixelScale(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight,
+                           const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        // mesh units to view units, the largest axis scale
+        float scale = std::max(std::max(glm::length(glm::vec3(modelView[0])), glm::length(glm::vec3(modelView[1]))),
+                               glm::length(glm::vec3(modelView[2])));
+        float pixels = scale * projection[1][1] * viewportHeight * 0.5f;
+        // orthographic projections don't shrink with the distance
+        if (projection[2][3] == 0)
+            return pixels;
+
+        // unbounded nodes are measured at their origin
+        bool bounded = boundsMin.x <= boundsMax.x && boundsMin.y <= boundsMax.y && boundsMin.z <= boundsMax.z;
+        glm::vec3 localCenter = bounded ? (boundsMin + boundsMax) * 0.5f : glm::vec3(0.0f);
+        glm::vec3 center = glm::vec3(modelView * glm::vec4(localCenter, 1.0f));
+        float radius = bounded ? glm::length(boundsMax - boundsMin) * 0.5f * scale : 0.0f;
+        float distance = glm::length(center) - radius;
+        // inside the bounds, the finest level
+        if (!(distance > 0))
+            return FLT_MAX;
+        return pixels / distance;
+    }
+
+    uint32_t selectLod(const LodLevel* levels, size_t levelCount, uint32_t current, float pixelScale,
+                       const LodSettings& settings)
+    {
+        if (levelCount == 0 || !settings.enabled)
+            return 0;
+        uint32_t level = std::min(current, (uint32_t)levelCount - 1);
+        // finer as soon as the error shows, coarser only once the next level is well within it
+        while (level > 0 && levels[level].error * pixelScale > settings.pixelError)
+            level--;
+        while (level + 1 < levelCount &&
+               levels[level + 1].error * pixelScale <= settings.pixelError * (1.0f - settings.hysteresis))
+            level++;
+        return level;
+    }
+}
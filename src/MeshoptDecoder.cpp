@@ -0,0 +1,897 @@
+#include "../include/MeshoptDecoder.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#define MELO_SSE2
+#endif
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define MELO_SSSE3
+#endif
+
+namespace melo
+{
+    // vertex codec
+    const uint8_t VERTEX_HEADER = 0xa0;
+    const size_t VERTEX_BLOCK_BYTES = 8192;
+    const size_t VERTEX_BLOCK_MAX_VERTICES = 256;
+    const size_t BYTE_GROUP_SIZE = 16;
+    // a group never reads more than 8 packed bytes + 16 escaped ones, the tail keeps this much after the last one
+    const size_t BYTE_GROUP_DECODE_LIMIT = 24;
+    const size_t TAIL_MIN_SIZE = 32;
+
+    // index codecs
+    const uint8_t INDEX_HEADER = 0xe0;
+    const uint8_t SEQUENCE_HEADER = 0xd0;
+
+    static size_t getVertexBlockSize(size_t byteStride)
+    {
+        size_t result = (VERTEX_BLOCK_BYTES / byteStride) & ~(BYTE_GROUP_SIZE - 1);
+        return result < VERTEX_BLOCK_MAX_VERTICES ? result : VERTEX_BLOCK_MAX_VERTICES;
+    }
+
+    static inline uint8_t unzigzag8(uint8_t v)
+    {
+        return (uint8_t)(-(v & 1) ^ (v >> 1));
+    }
+
+    // 16 values of 0, 2, 4 or 8 bits, the largest 2 and 4 bit value means the byte follows the packed ones
+    static const uint8_t* decodeBytesGroup(const uint8_t* data, uint8_t* dst, int bitsLog2)
+    {
+        switch (bitsLog2)
+        {
+        case 0:
+            memset(dst, 0, BYTE_GROUP_SIZE);
+            return data;
+        case 1:
+        {
+            const uint8_t* extra = data + 4;
+            for (int i = 0; i < 16; i++)
+            {
+                uint8_t enc = (data[i >> 2] >> (6 - 2 * (i & 3))) & 3;
+                dst[i] = enc == 3 ? *extra : enc;
+                extra += enc == 3;
+            }
+            return extra;
+        }
+        case 2:
+        {
+            const uint8_t* extra = data + 8;
+            for (int i = 0; i < 16; i++)
+            {
+                uint8_t enc = (data[i >> 1] >> (4 - 4 * (i & 1))) & 15;
+                dst[i] = enc == 15 ? *extra : enc;
+                extra += enc == 15;
+            }
+            return extra;
+        }
+        default:
+            memcpy(dst, data, BYTE_GROUP_SIZE);
+            return data + BYTE_GROUP_SIZE;
+        }
+    }
+
+#ifdef MELO_SSE2
+#ifdef MELO_SSSE3
+    // per 8 bit escape mask: where each escaped byte comes from, 0x80 clears the others
+    struct EscapeShuffles
+    {
+        uint8_t shuffle[256][8];
+        uint8_t count[256];
+
+        EscapeShuffles()
+        {
+            for (int mask = 0; mask < 256; mask++)
+            {
+                uint8_t next = 0;
+                for (int i = 0; i < 8; i++)
+                    shuffle[mask][i] = (mask & (1 << i)) ? next++ : 0x80;
+                count[mask] = next;
+            }
+        }
+    };
+    static const EscapeShuffles escapeShuffles;
+#endif
+
+    // the packed values of a group in byte order, the escaped ones still read as the largest value
+    static inline __m128i unpackGroup(const uint8_t* data, int bitsLog2)
+    {
+        if (bitsLog2 == 1)
+        {
+            int32_t packed;
+            memcpy(&packed, data, 4);
+            __m128i sel2 = _mm_cvtsi32_si128(packed);
+            __m128i sel22 = _mm_unpacklo_epi8(_mm_srli_epi16(sel2, 4), sel2);
+            __m128i sel2222 = _mm_unpacklo_epi8(_mm_srli_epi16(sel22, 2), sel22);
+            return _mm_and_si128(sel2222, _mm_set1_epi8(3));
+        }
+        __m128i sel4 = _mm_loadl_epi64((const __m128i*)data);
+        __m128i sel44 = _mm_unpacklo_epi8(_mm_srli_epi16(sel4, 4), sel4);
+        return _mm_and_si128(sel44, _mm_set1_epi8(15));
+    }
+
+    static const uint8_t* decodeBytesGroupSimd(const uint8_t* data, uint8_t* dst, int bitsLog2)
+    {
+        switch (bitsLog2)
+        {
+        case 0:
+            _mm_storeu_si128((__m128i*)dst, _mm_setzero_si128());
+            return data;
+        case 1:
+        case 2:
+        {
+            size_t packedSize = bitsLog2 == 1 ? 4 : 8;
+            __m128i sel = unpackGroup(data, bitsLog2);
+            __m128i escaped = _mm_cmpeq_epi8(sel, _mm_set1_epi8(bitsLog2 == 1 ? 3 : 15));
+            int mask = _mm_movemask_epi8(escaped);
+            const uint8_t* extra = data + packedSize;
+#ifdef MELO_SSSE3
+            int mask0 = mask & 255, mask1 = mask >> 8;
+            __m128i rest = _mm_loadu_si128((const __m128i*)extra);
+            __m128i shuffle0 = _mm_loadl_epi64((const __m128i*)escapeShuffles.shuffle[mask0]);
+            __m128i shuffle1 = _mm_loadl_epi64((const __m128i*)escapeShuffles.shuffle[mask1]);
+            // the upper half continues after the escaped bytes of the lower one, 0x80 + n still clears
+            shuffle1 = _mm_add_epi8(shuffle1, _mm_set1_epi8((char)escapeShuffles.count[mask0]));
+            __m128i shuffle = _mm_unpacklo_epi64(shuffle0, shuffle1);
+            __m128i result = _mm_or_si128(_mm_shuffle_epi8(rest, shuffle), _mm_andnot_si128(escaped, sel));
+            _mm_storeu_si128((__m128i*)dst, result);
+            return extra + escapeShuffles.count[mask0] + escapeShuffles.count[mask1];
+#else
+            _mm_storeu_si128((__m128i*)dst, sel);
+            // escapes are rare, patch them one by one
+            for (int i = 0; mask; i++, mask >>= 1)
+            {
+                if (mask & 1)
+                    dst[i] = *extra++;
+            }
+            return extra;
+#endif
+        }
+        default:
+            _mm_storeu_si128((__m128i*)dst, _mm_loadu_si128((const __m128i*)data));
+            return data + BYTE_GROUP_SIZE;
+        }
+    }
+#endif
+
+    // size is a multiple of BYTE_GROUP_SIZE, returns null when data runs out
+    static const uint8_t* decodeBytes(const uint8_t* data, const uint8_t* end, uint8_t* dst, size_t size, bool simd)
+    {
+        size_t groupCount = size / BYTE_GROUP_SIZE;
+        size_t headerSize = (groupCount + 3) / 4;
+        if (size_t(end - data) < headerSize)
+            return nullptr;
+
+        const uint8_t* header = data;
+        data += headerSize;
+        for (size_t i = 0; i < groupCount; i++)
+        {
+            if (size_t(end - data) < BYTE_GROUP_DECODE_LIMIT)
+                return nullptr;
+            int bitsLog2 = (header[i / 4] >> ((i % 4) * 2)) & 3;
+#ifdef MELO_SSE2
+            if (simd)
+            {
+                data = decodeBytesGroupSimd(data, dst + i * BYTE_GROUP_SIZE, bitsLog2);
+                continue;
+            }
+#endif
+            data = decodeBytesGroup(data, dst + i * BYTE_GROUP_SIZE, bitsLog2);
+        }
+        return data;
+    }
+
+    // streams holds one delta stream per vertex byte, alignedCount apart
+    static void undoDeltasScalar(const uint8_t* streams, size_t alignedCount, uint8_t* vertices, size_t count,
+                                 size_t byteStride, size_t firstByte, const uint8_t* lastVertex)
+    {
+        for (size_t k = firstByte; k < byteStride; k++)
+        {
+            const uint8_t* stream = streams + k * alignedCount;
+            uint8_t p = lastVertex[k];
+            uint8_t* dst = vertices + k;
+            for (size_t i = 0; i < count; i++)
+            {
+                p += unzigzag8(stream[i]);
+                *dst = p;
+                dst += byteStride;
+            }
+        }
+    }
+
+#ifdef MELO_SSE2
+    // four perfect shuffles of the row and column bits transpose a 16x16 byte matrix
+    static inline void transpose16(__m128i* rows)
+    {
+        for (int pass = 0; pass < 4; pass++)
+        {
+            __m128i t[16];
+            for (int i = 0; i < 8; i++)
+            {
+                t[2 * i + 0] = _mm_unpacklo_epi8(rows[i], rows[i + 8]);
+                t[2 * i + 1] = _mm_unpackhi_epi8(rows[i], rows[i + 8]);
+            }
+            for (int i = 0; i < 16; i++)
+                rows[i] = t[i];
+        }
+    }
+
+    static inline __m128i unzigzag8(__m128i v)
+    {
+        __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, _mm_set1_epi8(1)));
+        return _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x7f)), sign);
+    }
+
+    // 16 vertex bytes at a time: 16x16 blocks of the streams are transposed into vertex order
+    static size_t undoDeltas16(const uint8_t* streams, size_t alignedCount, uint8_t* vertices, size_t count,
+                               size_t byteStride, const uint8_t* lastVertex)
+    {
+        size_t k = 0;
+        for (; k + 16 <= byteStride; k += 16)
+        {
+            __m128i p = _mm_loadu_si128((const __m128i*)(lastVertex + k));
+            for (size_t i = 0; i < count; i += 16)
+            {
+                __m128i rows[16];
+                for (int r = 0; r < 16; r++)
+                    rows[r] = _mm_loadu_si128((const __m128i*)(streams + (k + r) * alignedCount + i));
+                transpose16(rows);
+
+                size_t n = count - i < 16 ? count - i : 16;
+                for (size_t j = 0; j < n; j++)
+                {
+                    p = _mm_add_epi8(p, unzigzag8(rows[j]));
+                    _mm_storeu_si128((__m128i*)(vertices + (i + j) * byteStride + k), p);
+                }
+            }
+        }
+        return k;
+    }
+
+    // 4 vertex bytes at a time, each 32 bit lane holds one vertex and 4 of them are prefix summed in a register
+    static void undoDeltas4(const uint8_t* streams, size_t alignedCount, uint8_t* vertices, size_t count,
+                            size_t byteStride, size_t firstByte, const uint8_t* lastVertex)
+    {
+        for (size_t k = firstByte; k < byteStride; k += 4)
+        {
+            int32_t last;
+            memcpy(&last, lastVertex + k, 4);
+            __m128i p = _mm_set1_epi32(last);
+            for (size_t i = 0; i < count; i += 16)
+            {
+                __m128i a0 = _mm_loadu_si128((const __m128i*)(streams + (k + 0) * alignedCount + i));
+                __m128i a1 = _mm_loadu_si128((const __m128i*)(streams + (k + 1) * alignedCount + i));
+                __m128i a2 = _mm_loadu_si128((const __m128i*)(streams + (k + 2) * alignedCount + i));
+                __m128i a3 = _mm_loadu_si128((const __m128i*)(streams + (k + 3) * alignedCount + i));
+                __m128i t0 = _mm_unpacklo_epi8(a0, a1), t1 = _mm_unpackhi_epi8(a0, a1);
+                __m128i t2 = _mm_unpacklo_epi8(a2, a3), t3 = _mm_unpackhi_epi8(a2, a3);
+                __m128i rows[4] = {_mm_unpacklo_epi16(t0, t2), _mm_unpackhi_epi16(t0, t2),
+                                   _mm_unpacklo_epi16(t1, t3), _mm_unpackhi_epi16(t1, t3)};
+
+                size_t n = count - i < 16 ? count - i : 16;
+                for (size_t r = 0; r * 4 < n; r++)
+                {
+                    __m128i v = unzigzag8(rows[r]);
+                    v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+                    v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+                    v = _mm_add_epi8(v, p);
+                    p = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+
+                    uint8_t* dst = vertices + (i + r * 4) * byteStride + k;
+                    size_t lanes = n - r * 4 < 4 ? n - r * 4 : 4;
+                    if (byteStride == 4 && lanes == 4)
+                    {
+                        _mm_storeu_si128((__m128i*)dst, v);
+                        continue;
+                    }
+                    for (size_t j = 0; j < lanes; j++)
+                    {
+                        int32_t value = _mm_cvtsi128_si32(v);
+                        memcpy(dst + j * byteStride, &value, 4);
+                        v = _mm_srli_si128(v, 4);
+                    }
+                }
+            }
+        }
+    }
+
+    // byteStride is a multiple of 4
+    static void undoDeltas(const uint8_t* streams, size_t alignedCount, uint8_t* vertices, size_t count,
+                           size_t byteStride, const uint8_t* lastVertex)
+    {
+        size_t k = undoDeltas16(streams, alignedCount, vertices, count, byteStride, lastVertex);
+        undoDeltas4(streams, alignedCount, vertices, count, byteStride, k, lastVertex);
+    }
+#else
+    static void undoDeltas(const uint8_t* streams, size_t alignedCount, uint8_t* vertices, size_t count,
+                           size_t byteStride, const uint8_t* lastVertex)
+    {
+        undoDeltasScalar(streams, alignedCount, vertices, count, byteStride, 0, lastVertex);
+    }
+#endif
+
+    static bool decodeVertexBufferImpl(uint8_t* dst, size_t count, size_t byteStride, const uint8_t* src, size_t size,
+                                       bool simd)
+    {
+        if (byteStride == 0 || byteStride > 256 || byteStride % 4 != 0)
+            return false;
+        if (size < 1 + byteStride || (src[0] & 0xf0) != VERTEX_HEADER || (src[0] & 0x0f) != 0)
+            return false;
+
+        const uint8_t* data = src + 1;
+        const uint8_t* end = src + size;
+
+        // the first vertex is predicted from the tail
+        uint8_t lastVertex[256];
+        memcpy(lastVertex, end - byteStride, byteStride);
+
+        uint8_t streams[VERTEX_BLOCK_BYTES];
+        size_t blockSize = getVertexBlockSize(byteStride);
+        for (size_t offset = 0; offset < count; offset += blockSize)
+        {
+            size_t blockCount = count - offset < blockSize ? count - offset : blockSize;
+            size_t alignedCount = (blockCount + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+            for (size_t k = 0; k < byteStride; k++)
+            {
+                data = decodeBytes(data, end, streams + k * alignedCount, alignedCount, simd);
+                if (!data)
+                    return false;
+            }
+
+            uint8_t* vertices = dst + offset * byteStride;
+            if (simd)
+                undoDeltas(streams, alignedCount, vertices, blockCount, byteStride, lastVertex);
+            else
+                undoDeltasScalar(streams, alignedCount, vertices, blockCount, byteStride, 0, lastVertex);
+            memcpy(lastVertex, vertices + (blockCount - 1) * byteStride, byteStride);
+        }
+
+        size_t tailSize = byteStride < TAIL_MIN_SIZE ? TAIL_MIN_SIZE : byteStride;
+        return size_t(end - data) == tailSize;
+    }
+
+    bool decodeVertexBuffer(uint8_t* dst, size_t count, size_t byteStride, const uint8_t* src, size_t size)
+    {
+        return decodeVertexBufferImpl(dst, count, byteStride, src, size, true);
+    }
+
+    bool decodeVertexBufferScalar(uint8_t* dst, size_t count, size_t byteStride, const uint8_t* src, size_t size)
+    {
+        return decodeVertexBufferImpl(dst, count, byteStride, src, size, false);
+    }
+
+    static inline uint32_t decodeVByte(const uint8_t*& data)
+    {
+        uint8_t lead = *data++;
+        if (lead < 128)
+            return lead;
+
+        uint32_t result = lead & 127;
+        uint32_t shift = 7;
+        for (int i = 0; i < 4; i++)
+        {
+            uint8_t group = *data++;
+            result |= uint32_t(group & 127) << shift;
+            shift += 7;
+            if (group < 128)
+                break;
+        }
+        return result;
+    }
+
+    static inline uint32_t decodeIndex(const uint8_t*& data, uint32_t last)
+    {
+        uint32_t v = decodeVByte(data);
+        uint32_t d = (v >> 1) ^ -int32_t(v & 1);
+        return last + d;
+    }
+
+    static inline void writeIndex(uint8_t* dst, size_t i, size_t indexSize, uint32_t index)
+    {
+        if (indexSize == 2)
+        {
+            uint16_t value = (uint16_t)index;
+            memcpy(dst + i * 2, &value, 2);
+        }
+        else
+        {
+            memcpy(dst + i * 4, &index, 4);
+        }
+    }
+
+    static inline void writeTriangle(uint8_t* dst, size_t i, size_t indexSize, uint32_t a, uint32_t b, uint32_t c)
+    {
+        writeIndex(dst, i + 0, indexSize, a);
+        writeIndex(dst, i + 1, indexSize, b);
+        writeIndex(dst, i + 2, indexSize, c);
+    }
+
+    // Triangles reference the recent edges and vertices through two 16 entry fifos,
+    // the encoder and the decoder must push to them in the same order.
+    bool decodeIndexBuffer(uint8_t* dst, size_t count, size_t indexSize, const uint8_t* src, size_t size)
+    {
+        if (count % 3 != 0 || (indexSize != 2 && indexSize != 4))
+            return false;
+        if (size < 1 + count / 3 + 16 || (src[0] & 0xf0) != INDEX_HEADER)
+            return false;
+        int version = src[0] & 0x0f;
+        if (version > 1)
+            return false;
+
+        uint32_t edgeFifo[16][2];
+        uint32_t vertexFifo[16];
+        memset(edgeFifo, -1, sizeof(edgeFifo));
+        memset(vertexFifo, -1, sizeof(vertexFifo));
+        size_t edgeOffset = 0;
+        size_t vertexOffset = 0;
+
+        auto pushEdge = [&](uint32_t a, uint32_t b) {
+            edgeFifo[edgeOffset][0] = a;
+            edgeFifo[edgeOffset][1] = b;
+            edgeOffset = (edgeOffset + 1) & 15;
+        };
+        auto pushVertex = [&](uint32_t v, bool cond) {
+            vertexFifo[vertexOffset] = v;
+            vertexOffset = (vertexOffset + cond) & 15;
+        };
+
+        uint32_t next = 0;
+        uint32_t last = 0;
+        // version 1 encodes +-1 deltas of the last free index in the code itself
+        int fecMax = version >= 1 ? 13 : 15;
+
+        const uint8_t* code = src + 1;
+        const uint8_t* data = code + count / 3;
+        // the codeaux table takes the last 16 bytes
+        const uint8_t* dataSafeEnd = src + size - 16;
+        const uint8_t* codeauxTable = dataSafeEnd;
+
+        for (size_t i = 0; i < count; i += 3)
+        {
+            // a triangle reads at most 16 data bytes (codeaux + three 5 byte indices), the table absorbs overreads
+            if (data > dataSafeEnd)
+                return false;
+
+            uint8_t codetri = *code++;
+            if (codetri < 0xf0)
+            {
+                // edge from the fifo + one vertex
+                int fe = codetri >> 4;
+                uint32_t a = edgeFifo[(edgeOffset - 1 - fe) & 15][0];
+                uint32_t b = edgeFifo[(edgeOffset - 1 - fe) & 15][1];
+                int fec = codetri & 15;
+
+                uint32_t c;
+                bool pushed = true;
+                if (fec < fecMax)
+                {
+                    // 0 is a new vertex, 1..14 are vertices from the fifo
+                    c = fec == 0 ? next : vertexFifo[(vertexOffset - 1 - fec) & 15];
+                    next += fec == 0;
+                    pushed = fec == 0;
+                }
+                else
+                {
+                    // 13, 14 are -1, +1 from the last free index, 15 is a delta from it
+                    c = last = fec != 15 ? last + (fec - (fec ^ 3)) : decodeIndex(data, last);
+                }
+                writeTriangle(dst, i, indexSize, a, b, c);
+                pushVertex(c, pushed);
+                pushEdge(c, b);
+                pushEdge(a, c);
+            }
+            else if (codetri < 0xfe)
+            {
+                // three vertices, the codeaux byte is in the table
+                uint8_t codeaux = codeauxTable[codetri & 15];
+                int feb = codeaux >> 4;
+                int fec = codeaux & 15;
+
+                uint32_t a = next++;
+                uint32_t b = feb == 0 ? next : vertexFifo[(vertexOffset - feb) & 15];
+                next += feb == 0;
+                uint32_t c = fec == 0 ? next : vertexFifo[(vertexOffset - fec) & 15];
+                next += fec == 0;
+
+                writeTriangle(dst, i, indexSize, a, b, c);
+                pushVertex(a, true);
+                pushVertex(b, feb == 0);
+                pushVertex(c, fec == 0);
+                pushEdge(b, a);
+                pushEdge(c, b);
+                pushEdge(a, c);
+            }
+            else
+            {
+                // three vertices, the codeaux byte is in the data, 15 means a free index
+                uint8_t codeaux = *data++;
+                int fea = codetri == 0xfe ? 0 : 15;
+                int feb = codeaux >> 4;
+                int fec = codeaux & 15;
+
+                if (codeaux == 0)
+                    next = 0;
+
+                uint32_t a = fea == 0 ? next++ : 0;
+                uint32_t b = feb == 0 ? next++ : vertexFifo[(vertexOffset - feb) & 15];
+                uint32_t c = fec == 0 ? next++ : vertexFifo[(vertexOffset - fec) & 15];
+
+                if (fea == 15)
+                    last = a = decodeIndex(data, last);
+                if (feb == 15)
+                    last = b = decodeIndex(data, last);
+                if (fec == 15)
+                    last = c = decodeIndex(data, last);
+
+                writeTriangle(dst, i, indexSize, a, b, c);
+                pushVertex(a, true);
+                pushVertex(b, feb == 0 || feb == 15);
+                pushVertex(c, fec == 0 || fec == 15);
+                pushEdge(b, a);
+                pushEdge(c, b);
+                pushEdge(a, c);
+            }
+        }
+
+        return data == dataSafeEnd;
+    }
+
+    // Each index is a zigzag delta from one of two baselines, the low bit picks the baseline.
+    bool decodeIndexSequence(uint8_t* dst, size_t count, size_t indexSize, const uint8_t* src, size_t size)
+    {
+        if (indexSize != 2 && indexSize != 4)
+            return false;
+        if (size < 1 + count + 4 || (src[0] & 0xf0) != SEQUENCE_HEADER || (src[0] & 0x0f) > 1)
+            return false;
+
+        const uint8_t* data = src + 1;
+        // a vbyte is at most 5 bytes, the 4 byte tail absorbs the overread
+        const uint8_t* dataSafeEnd = src + size - 4;
+
+        uint32_t last[2] = {};
+        for (size_t i = 0; i < count; i++)
+        {
+            if (data >= dataSafeEnd)
+                return false;
+
+            uint32_t v = decodeVByte(data);
+            uint32_t current = v & 1;
+            v >>= 1;
+            uint32_t d = (v >> 1) ^ -int32_t(v & 1);
+            uint32_t index = last[current] + d;
+            last[current] = index;
+            writeIndex(dst, i, indexSize, index);
+        }
+
+        return data == dataSafeEnd;
+    }
+
+    // filters
+
+    static inline int roundToInt(float v)
+    {
+        return int(v + (v >= 0.0f ? 0.5f : -0.5f));
+    }
+
+    // xy on the octahedron, z holds the scale of 1 and gets the reconstructed value, w is untouched
+    template <typename T>
+    static void decodeOctahedralScalar(T* data, size_t count)
+    {
+        const float max = float((1 << (sizeof(T) * 8 - 1)) - 1);
+        for (size_t i = 0; i < count; i++)
+        {
+            float x = float(data[i * 4 + 0]);
+            float y = float(data[i * 4 + 1]);
+            float z = float(data[i * 4 + 2]) - fabsf(x) - fabsf(y);
+
+            // unfold the lower hemisphere
+            float t = z < 0.0f ? z : 0.0f;
+            x += x >= 0.0f ? t : -t;
+            y += y >= 0.0f ? t : -t;
+
+            float s = max / sqrtf(x * x + y * y + z * z);
+            data[i * 4 + 0] = T(roundToInt(x * s));
+            data[i * 4 + 1] = T(roundToInt(y * s));
+            data[i * 4 + 2] = T(roundToInt(z * s));
+        }
+    }
+
+    // three smallest components, the low 2 bits of w give the index of the largest one and the rest its scale
+    static void decodeQuaternionScalar(int16_t* data, size_t count)
+    {
+        const float scale = 1.0f / sqrtf(2.0f);
+        for (size_t i = 0; i < count; i++)
+        {
+            int16_t* q = data + i * 4;
+            int sf = q[3] | 3;
+            float ss = scale / float(sf);
+
+            float x = float(q[0]) * ss;
+            float y = float(q[1]) * ss;
+            float z = float(q[2]) * ss;
+            float ww = 1.0f - x * x - y * y - z * z;
+            float w = sqrtf(ww >= 0.0f ? ww : 0.0f);
+
+            int qc = q[3] & 3;
+            q[(qc + 1) & 3] = int16_t(roundToInt(x * 32767.0f));
+            q[(qc + 2) & 3] = int16_t(roundToInt(y * 32767.0f));
+            q[(qc + 3) & 3] = int16_t(roundToInt(z * 32767.0f));
+            q[(qc + 0) & 3] = int16_t(int(w * 32767.0f + 0.5f));
+        }
+    }
+
+    // 24 bit signed mantissa, 8 bit signed exponent
+    static void decodeExponentialScalar(uint32_t* data, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t v = data[i];
+            int m = int32_t(v << 8) >> 8;
+            int e = int32_t(v) >> 24;
+
+            union { float f; uint32_t u; } r;
+            r.u = uint32_t(e + 127) << 23;
+            r.f = r.f * float(m);
+            data[i] = r.u;
+        }
+    }
+
+    static bool isValidFilter(MeshoptFilter filter, size_t byteStride)
+    {
+        switch (filter)
+        {
+        case MESHOPT_FILTER_NONE: return true;
+        case MESHOPT_FILTER_OCTAHEDRAL: return byteStride == 4 || byteStride == 8;
+        case MESHOPT_FILTER_QUATERNION: return byteStride == 8;
+        case MESHOPT_FILTER_EXPONENTIAL: return byteStride % 4 == 0;
+        default: return false;
+        }
+    }
+
+    void decodeFilterScalar(MeshoptFilter filter, uint8_t* data, size_t count, size_t byteStride)
+    {
+        if (!isValidFilter(filter, byteStride))
+            return;
+        switch (filter)
+        {
+        case MESHOPT_FILTER_OCTAHEDRAL:
+            if (byteStride == 4)
+                decodeOctahedralScalar((int8_t*)data, count);
+            else
+                decodeOctahedralScalar((int16_t*)data, count);
+            break;
+        case MESHOPT_FILTER_QUATERNION:
+            decodeQuaternionScalar((int16_t*)data, count);
+            break;
+        case MESHOPT_FILTER_EXPONENTIAL:
+            decodeExponentialScalar((uint32_t*)data, count * byteStride / 4);
+            break;
+        default:
+            break;
+        }
+    }
+
+#ifdef MELO_SSE2
+    // int32 of each 16 bit lane
+    static inline __m128i unpackLo16(__m128i v) { return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16); }
+    static inline __m128i unpackHi16(__m128i v) { return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16); }
+
+    static inline __m128 copySign(__m128 magnitude, __m128 sign)
+    {
+        const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+        return _mm_or_ps(_mm_andnot_ps(signMask, magnitude), _mm_and_ps(signMask, sign));
+    }
+
+    static inline __m128i roundToInt(__m128 v)
+    {
+        return _mm_cvttps_epi32(_mm_add_ps(v, copySign(_mm_set1_ps(0.5f), v)));
+    }
+
+    // 4 elements of xyzw as int32 in, the same with xyz replaced out
+    static inline void decodeOctahedral4(__m128i& e0, __m128i& e1, __m128i& e2, __m128i& e3, float maxValue)
+    {
+        __m128 x = _mm_cvtepi32_ps(e0), y = _mm_cvtepi32_ps(e1), z = _mm_cvtepi32_ps(e2), w = _mm_cvtepi32_ps(e3);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+        z = _mm_sub_ps(_mm_sub_ps(z, _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+
+        // x += x >= 0 ? t : -t, x is never -0
+        __m128 t = _mm_min_ps(z, _mm_setzero_ps());
+        x = _mm_add_ps(x, _mm_xor_ps(t, _mm_and_ps(x, signMask)));
+        y = _mm_add_ps(y, _mm_xor_ps(t, _mm_and_ps(y, signMask)));
+
+        __m128 l = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 s = _mm_div_ps(_mm_set1_ps(maxValue), l);
+
+        __m128 rx = _mm_castsi128_ps(roundToInt(_mm_mul_ps(x, s)));
+        __m128 ry = _mm_castsi128_ps(roundToInt(_mm_mul_ps(y, s)));
+        __m128 rz = _mm_castsi128_ps(roundToInt(_mm_mul_ps(z, s)));
+        __m128 rw = _mm_castsi128_ps(_mm_cvttps_epi32(w));
+        _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+        e0 = _mm_castps_si128(rx);
+        e1 = _mm_castps_si128(ry);
+        e2 = _mm_castps_si128(rz);
+        e3 = _mm_castps_si128(rw);
+    }
+
+    static void decodeOctahedral(int8_t* data, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(data + i * 4));
+            __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+            __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+            __m128i e0 = unpackLo16(lo), e1 = unpackHi16(lo), e2 = unpackLo16(hi), e3 = unpackHi16(hi);
+            decodeOctahedral4(e0, e1, e2, e3, 127.0f);
+            __m128i r = _mm_packs_epi16(_mm_packs_epi32(e0, e1), _mm_packs_epi32(e2, e3));
+            _mm_storeu_si128((__m128i*)(data + i * 4), r);
+        }
+        decodeOctahedralScalar(data + i * 4, count - i);
+    }
+
+    static void decodeOctahedral(int16_t* data, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i v0 = _mm_loadu_si128((const __m128i*)(data + i * 4));
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(data + i * 4 + 8));
+            __m128i e0 = unpackLo16(v0), e1 = unpackHi16(v0), e2 = unpackLo16(v1), e3 = unpackHi16(v1);
+            decodeOctahedral4(e0, e1, e2, e3, 32767.0f);
+            _mm_storeu_si128((__m128i*)(data + i * 4), _mm_packs_epi32(e0, e1));
+            _mm_storeu_si128((__m128i*)(data + i * 4 + 8), _mm_packs_epi32(e2, e3));
+        }
+        decodeOctahedralScalar(data + i * 4, count - i);
+    }
+
+    // the math is vectorized, the final swizzle depends on each element and stays scalar
+    static void decodeQuaternion(int16_t* data, size_t count)
+    {
+        const __m128 scale = _mm_set1_ps(1.0f / sqrtf(2.0f));
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 maxValue = _mm_set1_ps(32767.0f);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            int16_t* q = data + i * 4;
+            __m128i v0 = _mm_loadu_si128((const __m128i*)q);
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(q + 8));
+            __m128 x = _mm_castsi128_ps(unpackLo16(v0)), y = _mm_castsi128_ps(unpackHi16(v0));
+            __m128 z = _mm_castsi128_ps(unpackLo16(v1)), w = _mm_castsi128_ps(unpackHi16(v1));
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+
+            __m128i wi = _mm_castps_si128(w);
+            __m128 ss = _mm_div_ps(scale, _mm_cvtepi32_ps(_mm_or_si128(wi, _mm_set1_epi32(3))));
+            __m128 fx = _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(x)), ss);
+            __m128 fy = _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(y)), ss);
+            __m128 fz = _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(z)), ss);
+            __m128 ww = _mm_sub_ps(one, _mm_add_ps(_mm_add_ps(_mm_mul_ps(fx, fx), _mm_mul_ps(fy, fy)), _mm_mul_ps(fz, fz)));
+            __m128 fw = _mm_sqrt_ps(_mm_max_ps(ww, _mm_setzero_ps()));
+
+            alignas(16) int32_t r[4][4];
+            _mm_store_si128((__m128i*)r[0], roundToInt(_mm_mul_ps(fx, maxValue)));
+            _mm_store_si128((__m128i*)r[1], roundToInt(_mm_mul_ps(fy, maxValue)));
+            _mm_store_si128((__m128i*)r[2], roundToInt(_mm_mul_ps(fz, maxValue)));
+            _mm_store_si128((__m128i*)r[3], _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(fw, maxValue), _mm_set1_ps(0.5f))));
+
+            for (int j = 0; j < 4; j++)
+            {
+                int16_t* e = q + j * 4;
+                int qc = e[3] & 3;
+                e[(qc + 1) & 3] = int16_t(r[0][j]);
+                e[(qc + 2) & 3] = int16_t(r[1][j]);
+                e[(qc + 3) & 3] = int16_t(r[2][j]);
+                e[(qc + 0) & 3] = int16_t(r[3][j]);
+            }
+        }
+        decodeQuaternionScalar(data + i * 4, count - i);
+    }
+
+    static void decodeExponential(uint32_t* data, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+            __m128i m = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+            __m128i e = _mm_srai_epi32(v, 24);
+            __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(127)), 23));
+            __m128 r = _mm_mul_ps(scale, _mm_cvtepi32_ps(m));
+            _mm_storeu_si128((__m128i*)(data + i), _mm_castps_si128(r));
+        }
+        decodeExponentialScalar(data + i, count - i);
+    }
+
+    void decodeFilter(MeshoptFilter filter, uint8_t* data, size_t count, size_t byteStride)
+    {
+        if (!isValidFilter(filter, byteStride))
+            return;
+        switch (filter)
+        {
+        case MESHOPT_FILTER_OCTAHEDRAL:
+            if (byteStride == 4)
+                decodeOctahedral((int8_t*)data, count);
+            else
+                decodeOctahedral((int16_t*)data, count);
+            break;
+        case MESHOPT_FILTER_QUATERNION:
+            decodeQuaternion((int16_t*)data, count);
+            break;
+        case MESHOPT_FILTER_EXPONENTIAL:
+            decodeExponential((uint32_t*)data, count * byteStride / 4);
+            break;
+        default:
+            break;
+        }
+    }
+#else
+    void decodeFilter(MeshoptFilter filter, uint8_t* data, size_t count, size_t byteStride)
+    {
+        decodeFilterScalar(filter, data, count, byteStride);
+    }
+#endif
+
+    bool decodeMeshopt(const MeshoptBufferView& view, uint8_t* dst)
+    {
+        if (!view.data)
+            return false;
+
+        switch (view.mode)
+        {
+        case MESHOPT_MODE_ATTRIBUTES:
+            if (!isValidFilter(view.filter, view.byteStride))
+                return false;
+            if (!decodeVertexBuffer(dst, view.count, view.byteStride, view.data, view.byteLength))
+                return false;
+            decodeFilter(view.filter, dst, view.count, view.byteStride);
+            return true;
+        case MESHOPT_MODE_TRIANGLES:
+            return view.filter == MESHOPT_FILTER_NONE &&
+                   decodeIndexBuffer(dst, view.count, view.byteStride, view.data, view.byteLength);
+        case MESHOPT_MODE_INDICES:
+            return view.filter == MESHOPT_FILTER_NONE &&
+                   decodeIndexSequence(dst, view.count, view.byteStride, view.data, view.byteLength);
+        default:
+            return false;
+        }
+    }
+
+    MeshoptMode getMeshoptMode(const char* name, bool* valid)
+    {
+        if (valid)
+            *valid = true;
+        if (strcmp(name, "ATTRIBUTES") == 0)
+            return MESHOPT_MODE_ATTRIBUTES;
+        if (strcmp(name, "TRIANGLES") == 0)
+            return MESHOPT_MODE_TRIANGLES;
+        if (strcmp(name, "INDICES") == 0)
+            return MESHOPT_MODE_INDICES;
+        if (valid)
+            *valid = false;
+        return MESHOPT_MODE_ATTRIBUTES;
+    }
+
+    MeshoptFilter getMeshoptFilter(const char* name, bool* valid)
+    {
+        if (valid)
+            *valid = true;
+        if (name[0] == 0 || strcmp(name, "NONE") == 0)
+            return MESHOPT_FILTER_NONE;
+        if (strcmp(name, "OCTAHEDRAL") == 0)
+            return MESHOPT_FILTER_OCTAHEDRAL;
+        if (strcmp(name, "QUATERNION") == 0)
+            return MESHOPT_FILTER_QUATERNION;
+        if (strcmp(name, "EXPONENTIAL") == 0)
+            return MESHOPT_FILTER_EXPONENTIAL;
+        if (valid)
+            *valid = false;
+        return MESHOPT_FILTER_NONE;
+    }
+}
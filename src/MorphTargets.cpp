@@ -0,0 +1,132 @@
+#include "../include/MorphTargets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MELO_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MELO_SSE2
+#endif
+
+namespace melo
+{
+    // dst[i] += weight * src[i]
+    static void accumulate(float* dst, const float* src, float weight, size_t count)
+    {
+        size_t i = 0;
+#if defined(MELO_AVX2)
+        const __m256 w8 = _mm256_set1_ps(weight);
+        for (; i + 16 <= count; i += 16)
+        {
+            __m256 a = _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), w8));
+            __m256 b = _mm256_add_ps(_mm256_loadu_ps(dst + i + 8), _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), w8));
+            _mm256_storeu_ps(dst + i, a);
+            _mm256_storeu_ps(dst + i + 8, b);
+        }
+        for (; i + 8 <= count; i += 8)
+            _mm256_storeu_ps(dst + i,
+                             _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), w8)));
+#endif
+#if defined(MELO_AVX2) || defined(MELO_SSE2)
+        const __m128 w4 = _mm_set1_ps(weight);
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), w4)));
+#endif
+        for (; i < count; i++)
+            dst[i] += weight * src[i];
+    }
+
+    static bool isMoved(const glm::vec3* deltas, size_t vertex, float epsilon)
+    {
+        if (!deltas)
+            return false;
+        const glm::vec3& d = deltas[vertex];
+        return std::abs(d.x) > epsilon || std::abs(d.y) > epsilon || std::abs(d.z) > epsilon;
+    }
+
+    void MorphTargets::addTarget(const glm::vec3* positionDeltas, const glm::vec3* normalDeltas, float epsilon,
+                                 uint32_t maxGap)
+    {
+        mTargets.emplace_back();
+        Target& target = mTargets.back();
+
+        // spans over the moved vertices, merged across short gaps
+        size_t vertex = 0;
+        while (vertex < mVertexCount)
+        {
+            if (!isMoved(positionDeltas, vertex, epsilon) && !isMoved(normalDeltas, vertex, epsilon))
+            {
+                vertex++;
+                continue;
+            }
+            Span span = {(uint32_t)vertex, 0, (uint32_t)target.positionDeltas.size()};
+            size_t last = vertex;
+            for (size_t next = vertex + 1; next < mVertexCount && next - last <= (size_t)maxGap + 1; next++)
+            {
+                if (isMoved(positionDeltas, next, epsilon) || isMoved(normalDeltas, next, epsilon))
+                    last = next;
+            }
+            span.vertexCount = (uint32_t)(last + 1 - vertex);
+            target.spans.push_back(span);
+            for (size_t v = vertex; v <= last; v++)
+            {
+                target.positionDeltas.push_back(positionDeltas ? positionDeltas[v] : glm::vec3(0));
+                if (normalDeltas)
+                    target.normalDeltas.push_back(normalDeltas[v]);
+            }
+            vertex = last + 1;
+        }
+    }
+
+    size_t MorphTargets::apply(const float* weights, size_t weightCount, const glm::vec3* basePositions,
+                               const glm::vec3* baseNormals, glm::vec3* positions, glm::vec3* normals,
+                               float minWeight) const
+    {
+        if (positions != basePositions)
+            memcpy(positions, basePositions, mVertexCount * sizeof(glm::vec3));
+        if (normals && baseNormals && normals != baseNormals)
+            memcpy(normals, baseNormals, mVertexCount * sizeof(glm::vec3));
+
+        size_t applied = 0;
+        size_t count = std::min(weightCount, mTargets.size());
+        for (size_t t = 0; t < count; t++)
+        {
+            float weight = weights[t];
+            if (std::abs(weight) <= minWeight)
+                continue;
+            const Target& target = mTargets[t];
+            bool hasNormals = normals && !target.normalDeltas.empty();
+            for (const Span& span : target.spans)
+            {
+                accumulate(&positions[span.firstVertex].x, &target.positionDeltas[span.firstDelta].x, weight,
+                           span.vertexCount * 3);
+                if (hasNormals)
+                    accumulate(&normals[span.firstVertex].x, &target.normalDeltas[span.firstDelta].x, weight,
+                               span.vertexCount * 3);
+            }
+            applied++;
+        }
+        return applied;
+    }
+
+    size_t MorphTargets::getDeltaCount() const
+    {
+        size_t count = 0;
+        for (const Target& target : mTargets)
+            count += target.positionDeltas.size();
+        return count;
+    }
+
+    size_t MorphTargets::getMemorySize() const
+    {
+        size_t size = sizeof(MorphTargets) + mTargets.size() * sizeof(Target);
+        for (const Target& target : mTargets)
+            size += target.spans.size() * sizeof(Span) +
+                    (target.positionDeltas.size() + target.normalDeltas.size()) * sizeof(glm::vec3);
+        return size;
+    }
+}
@@ -22,6 +22,8 @@
  */
 
 #include "../include/Node.h"
+#include "../include/FrustumCuller.h"
+#include "../include/JobSystem.h"
 
 #ifndef CINDER_LESS
 #include "cinder/app/App.h"
@@ -35,14 +37,20 @@ using namespace ci::app;
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/transform.hpp>
 
+#include <atomic>
+
 using namespace std;
 
 namespace melo
 {
+    // nodes flagged by invalidateTransform() and not recomputed yet, none most of the time
+    static atomic<uint32_t> sInvalidatedCount{0};
+
     Node::Node()
         : mIsVisible(true),
-        mIsSetup(false), mIsTransformInvalidated(true)
+        mIsSetup(false), mIsTransformInvalidated(false), mTransforms(TransformSystem::getDefault())
     {
+        mTransformIndex = mTransforms->allocate();
         mScale = { 1,1,1 };
         mIsConstantTransform = false;
         setName("Node");
@@ -52,6 +60,15 @@ namespace melo
     {
         // remove all children safely
         removeChildren();
+        if (mIsTransformInvalidated)
+            sInvalidatedCount--;
+        mTransforms->release(mTransformIndex);
+    }
+
+    void Node::setParent(NodeRef node)
+    {
+        mParent = NodeWeakRef(node);
+        mTransforms->setParent(mTransformIndex, node ? node->mTransformIndex : TransformSystem::INVALID);
     }
 
     void Node::removeFromParent()
@@ -113,18 +130,7 @@ namespace melo
 
     void Node::setTransform(const glm::mat4& transform) const
     {
-        mTransform = transform;
-
-        auto parent = getParent();
-        if (parent)
-            mWorldTransform = parent->getWorldTransform() * mTransform;
-        else
-            mWorldTransform = mTransform;
-
-        mIsTransformInvalidated = false;
-
-        for (auto& child : mChildren)
-            child->invalidateTransform();
+        mTransforms->setLocal(mTransformIndex, transform);
     }
 
     void Node::treeVisitor(std::function<void(NodeRef)> visitor)
@@ -151,9 +157,18 @@ namespace melo
     }
 
     void Node::treeUpdate(double elapsed)
+    {
+        treeUpdateNodes(elapsed);
+
+        // one pass over the flat transforms of the whole subtree, large ones on the worker pool
+        mTransforms->update(mTransformIndex, JobSystem::getDefault().get());
+    }
+
+    void Node::treeUpdateNodes(double elapsed)
     {
         // let derived class perform animation
         update(elapsed);
+        validateTransform();
 
         if (!mIsSetup)
         {
@@ -163,23 +178,23 @@ namespace melo
 
         // update this node's children
         for (auto& node : mChildren)
-            node->treeUpdate(elapsed);
+            node->treeUpdateNodes(elapsed);
     }
 
-    void Node::treeDraw(DrawOrder order)
+    void Node::treeDraw(DrawOrder order, const FrustumCuller* culler)
     {
         if (!mIsVisible)
             return;
 
+        // before culling, setup() may add the children that make up the subtree
         if (!mIsSetup)
         {
             setup();
             mIsSetup = true;
         }
 
-        // update transform matrix by calling derived class's function
-        if (mIsTransformInvalidated)
-            transform();
+        if (culler && !culler->isSubtreeVisible(*this))
+            return;
 
         // let derived class know we are about to draw stuff
 #if defined(CINDER_MSW_DESKTOP)
@@ -195,7 +210,7 @@ namespace melo
         // usual way to update model matrix
         gl::setModelMatrix(getWorldTransform());
 
-        if (order == mDrawOrder)
+        if (order == mDrawOrder && (!culler || culler->isVisible(*this)))
         {
             // draw this node by calling derived class
             draw(order);
@@ -203,7 +218,7 @@ namespace melo
 
         // draw this node's children
         for (auto& child : mChildren)
-            child->treeDraw(order);
+            child->treeDraw(order, culler);
 
         // restore transform
         gl::popModelView();
@@ -216,28 +231,76 @@ namespace melo
 #endif
     }
 
+    void Node::treeSubmit(RenderQueue& queue)
+    {
+        if (!mIsVisible)
+            return;
+
+        if (!mIsSetup)
+        {
+            setup();
+            mIsSetup = true;
+        }
+
+        submitDraws(queue);
+        for (auto& child : mChildren)
+            child->treeSubmit(queue);
+    }
+
+    void Node::drawInstances(DrawOrder order, uint32_t item, const glm::mat4* transforms, uint32_t count)
+    {
+#ifdef CINDER_LESS
+        (void)transforms;
+#endif
+        for (uint32_t i = 0; i < count; i++)
+        {
+#ifndef CINDER_LESS
+            gl::setModelMatrix(transforms[i]);
+#endif
+            drawPacket(order, item);
+        }
+    }
+
     void Node::setName(const string& name) { mName = name; }
 
     const string& Node::getName() const { return mName; }
 
     const glm::mat4& Node::getTransform() const
     {
-        if (mIsTransformInvalidated) transform();
-        return mTransform;
+        validateTransform();
+        return mTransforms->getLocal(mTransformIndex);
     }
 
     const glm::mat4& Node::getWorldTransform() const
     {
-        if (mIsTransformInvalidated) transform();
-        return mWorldTransform;
+        // a flagged ancestor changes the world transform as well
+        if (sInvalidatedCount.load(memory_order_relaxed) > 0)
+        {
+            validateTransform();
+            for (NodeRef node = getParent(); node; node = node->getParent())
+                node->validateTransform();
+        }
+        return mTransforms->getWorld(mTransformIndex);
     }
 
     void Node::invalidateTransform() const
     {
-        mIsTransformInvalidated = true;
+        // only this node is flagged, descendants see the new transform through it once it is computed
+        if (!mIsTransformInvalidated)
+        {
+            mIsTransformInvalidated = true;
+            sInvalidatedCount++;
+        }
+    }
 
-        for (auto& child : mChildren)
-            child->invalidateTransform();
+    void Node::validateTransform() const
+    {
+        if (mIsTransformInvalidated)
+        {
+            mIsTransformInvalidated = false;
+            sInvalidatedCount--;
+            transform();
+        }
     }
 
     NodeRef Node::create()
@@ -290,6 +353,7 @@ namespace melo
     {
         mIsConstantTransform = true;
         mConstantTransform = transform;
+        invalidateTransform();
     }
 
 #ifndef CINDER_LESS
@@ -1,4 +1,5 @@
 #include "NodeExt.h"
+#include "RenderQueue.h"
 #include "cinder/GeomIo.h"
 #include "cinder/gl/gl.h"
 #include "cinder/TriMesh.h"
@@ -24,6 +25,11 @@ void DirectionalLightNode::draw(DrawOrder order)
     gl::drawSphere({}, radius);
 }
 
+void DirectionalLightNode::submitDraws(RenderQueue& queue)
+{
+    queue.add(*this, mDrawOrder);
+}
+
 GridNode::Ref GridNode::create(float meters)
 {
     return std::make_shared<GridNode>(meters);
@@ -56,6 +62,11 @@ GridNode::GridNode(float meters) : mMeters(meters)
     setName("GridNode");
 }
 
+void GridNode::submitDraws(RenderQueue& queue)
+{
+    queue.add(*this, mDrawOrder, shader.get(), nullptr, vertBatch.get());
+}
+
 void GridNode::draw(DrawOrder order)
 {
     gl::ScopedDepthTest depthTest(false);
@@ -69,7 +80,7 @@ MeshNode::Ref MeshNode::create(TriMeshRef triMesh)
     return std::make_shared<MeshNode>(triMesh);
 }
 
-MeshNode::MeshNode(TriMeshRef triMesh)
+MeshNode::MeshNode(TriMeshRef triMesh) : triMesh(triMesh)
 {
     rayCategory = 0xFF;
     auto aabb = triMesh->calcBoundingBox();
@@ -89,6 +100,19 @@ MeshNode::Ref MeshNode::create(const geom::Source& source)
     return ref;
 }
 
+void MeshNode::addToPicking(PickingScene& picking)
+{
+    auto shape = picking.addShape(triMesh->getPositions<3>(), triMesh->getNumVertices(), triMesh->getIndices().data(),
+        triMesh->getNumIndices());
+    picking.addInstance(shape, shared_from_this());
+}
+
+void MeshNode::submitDraws(RenderQueue& queue)
+{
+    if (vboMesh)
+        queue.add(*this, mDrawOrder, shader.get(), nullptr, vboMesh.get());
+}
+
 void MeshNode::draw(DrawOrder order)
 {
     if (vboMesh)
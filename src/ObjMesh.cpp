@@ -0,0 +1,177 @@
+#include "../include/ObjMesh.h"
+
+#include <algorithm>
+
+namespace melo
+{
+    namespace
+    {
+        // vertex / normal / texcoord indices of a corner and the vertex they became, 16 bytes so that a probe
+        // stays within a cache line
+        struct CornerSlot
+        {
+            int vertex;
+            int normal;
+            int texcoord;
+            uint32_t id; // UINT32_MAX when empty
+        };
+
+        // open addressing with linear probing, grows at half load
+        class CornerTable
+        {
+        public:
+            explicit CornerTable(size_t expected)
+            {
+                size_t capacity = 64;
+                while (capacity < expected * 2)
+                    capacity *= 2;
+                mSlots.assign(capacity, {0, 0, 0, UINT32_MAX});
+            }
+
+            // the id of the corner's vertex, next if it is new
+            uint32_t findOrInsert(const tinyobj::index_t& corner, uint32_t next, bool* inserted)
+            {
+                if ((mCount + 1) * 2 > mSlots.size())
+                    grow();
+                CornerSlot* slot = find(mSlots, corner);
+                *inserted = slot->id == UINT32_MAX;
+                if (*inserted)
+                {
+                    *slot = {corner.vertex_index, corner.normal_index, corner.texcoord_index, next};
+                    mCount++;
+                }
+                return slot->id;
+            }
+
+        private:
+            static uint32_t hash(int vertex, int normal, int texcoord)
+            {
+                // murmur3's finalizer over a mix of the three, the indices of neighbouring corners are close
+                uint32_t h = (uint32_t)vertex * 0x9e3779b1u ^ (uint32_t)normal * 0x85ebca6bu ^ (uint32_t)texcoord * 0xc2b2ae35u;
+                h ^= h >> 16;
+                h *= 0x85ebca6bu;
+                h ^= h >> 13;
+                h *= 0xc2b2ae35u;
+                h ^= h >> 16;
+                return h;
+            }
+
+            static CornerSlot* find(std::vector<CornerSlot>& slots, const tinyobj::index_t& corner)
+            {
+                size_t mask = slots.size() - 1;
+                size_t i = hash(corner.vertex_index, corner.normal_index, corner.texcoord_index) & mask;
+                while (true)
+                {
+                    auto& slot = slots[i];
+                    if (slot.id == UINT32_MAX || (slot.vertex == corner.vertex_index &&
+                                                  slot.normal == corner.normal_index &&
+                                                  slot.texcoord == corner.texcoord_index))
+                        return &slot;
+                    i = (i + 1) & mask;
+                }
+            }
+
+            void grow()
+            {
+                std::vector<CornerSlot> slots(mSlots.size() * 2, {0, 0, 0, UINT32_MAX});
+                for (const auto& slot : mSlots)
+                {
+                    if (slot.id != UINT32_MAX)
+                        *find(slots, {slot.vertex, slot.normal, slot.texcoord}) = slot;
+                }
+                mSlots.swap(slots);
+            }
+
+            std::vector<CornerSlot> mSlots;
+            size_t mCount = 0;
+        };
+    }
+
+    std::vector<ObjSubmesh> buildObjSubmeshes(const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape,
+                                              bool deduplicate)
+    {
+        const auto& corners = shape.mesh.indices;
+        const auto& materialIds = shape.mesh.material_ids;
+
+        // submeshes in order of first use, and their corner counts
+        std::vector<ObjSubmesh> submeshes;
+        std::vector<size_t> cornerCounts;
+        std::vector<int> faceSubmeshes(corners.size() / 3);
+        for (size_t face = 0; face < faceSubmeshes.size(); face++)
+        {
+            int material = face < materialIds.size() ? std::max(0, materialIds[face]) : 0;
+            size_t s = 0;
+            while (s < submeshes.size() && submeshes[s].material != material)
+                s++;
+            if (s == submeshes.size())
+            {
+                submeshes.emplace_back();
+                submeshes.back().material = material;
+                cornerCounts.push_back(0);
+            }
+            faceSubmeshes[face] = (int)s;
+            cornerCounts[s] += 3;
+        }
+
+        // a closed mesh has about a sixth as many vertices as corners, the tables start at a fourth
+        std::vector<CornerTable> tables;
+        std::vector<bool> allNormals(submeshes.size(), true), allTexcoords(submeshes.size(), true);
+        for (size_t s = 0; s < submeshes.size(); s++)
+        {
+            submeshes[s].indices.reserve(cornerCounts[s]);
+            tables.emplace_back(deduplicate ? cornerCounts[s] / 4 : 0);
+        }
+
+        bool hasNormals = !attrib.normals.empty();
+        bool hasTexcoords = !attrib.texcoords.empty();
+        bool hasColors = !attrib.colors.empty();
+        for (size_t i = 0; i < faceSubmeshes.size() * 3; i++)
+        {
+            size_t s = faceSubmeshes[i / 3];
+            auto& submesh = submeshes[s];
+            const auto& corner = corners[i];
+            bool inserted = true;
+            uint32_t id = (uint32_t)submesh.positions.size();
+            if (deduplicate)
+                id = tables[s].findOrInsert(corner, id, &inserted);
+            submesh.indices.push_back(id);
+            if (!inserted)
+                continue;
+
+            const float* p = &attrib.vertices[3 * corner.vertex_index];
+            submesh.positions.push_back({p[0], p[1], p[2]});
+            if (hasNormals && corner.normal_index >= 0)
+            {
+                const float* n = &attrib.normals[3 * corner.normal_index];
+                submesh.normals.push_back({n[0], n[1], n[2]});
+            }
+            else
+            {
+                allNormals[s] = false;
+            }
+            if (hasTexcoords && corner.texcoord_index >= 0)
+            {
+                const float* t = &attrib.texcoords[2 * corner.texcoord_index];
+                submesh.texcoords.push_back({t[0], t[1]});
+            }
+            else
+            {
+                allTexcoords[s] = false;
+            }
+            if (hasColors)
+            {
+                const float* c = &attrib.colors[3 * corner.vertex_index];
+                submesh.colors.push_back({c[0], c[1], c[2]});
+            }
+        }
+
+        for (size_t s = 0; s < submeshes.size(); s++)
+        {
+            if (!allNormals[s])
+                std::vector<glm::vec3>().swap(submeshes[s].normals);
+            if (!allTexcoords[s])
+                std::vector<glm::vec2>().swap(submeshes[s].texcoords);
+        }
+        return submeshes;
+    }
+}
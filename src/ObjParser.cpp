@@ -0,0 +1,667 @@
+#include "../include/ObjParser.h"
+#include "../include/JobSystem.h"
+#include "../include/MappedFile.h"
+#include "../include/ObjMesh.h"
+#include "../3rdparty/yocto/yocto_scene.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+namespace melo
+{
+    namespace
+    {
+        // statements that depend on the ones before them, replayed in file order once the chunks are parsed
+        enum class ObjStatementType
+        {
+            Group,
+            Object,
+            UseMaterial,
+            MaterialLibrary,
+            Smoothing,
+        };
+
+        struct ObjStatement
+        {
+            ObjStatementType type;
+            size_t triangle; // triangles of the chunk before it
+            std::string text;
+        };
+
+        struct ObjChunk
+        {
+            const char* begin = nullptr;
+            const char* end = nullptr;
+
+            std::vector<float> positions;
+            std::vector<float> colors; // empty until the first colored vertex, white before it
+            std::vector<float> normals;
+            std::vector<float> texcoords;
+            std::vector<tinyobj::index_t> corners;
+            // corner * 3 + 0 / 1 / 2 for a vertex / normal / texcoord index counted from the chunk's first one
+            std::vector<size_t> relativeCorners;
+            std::vector<ObjStatement> statements;
+            bool skippedPrimitives = false;
+            const char* error = nullptr; // the line parsing stopped at
+        };
+
+        // where the elements of a chunk start in the merged arrays
+        struct ChunkOffsets
+        {
+            size_t vertex = 0;
+            size_t normal = 0;
+            size_t texcoord = 0;
+            size_t corner = 0;
+        };
+
+        inline bool isSpace(char c) { return c == ' ' || c == '\t'; }
+
+        inline const char* skipSpaces(const char* p, const char* end)
+        {
+            while (p < end && isSpace(*p))
+                p++;
+            return p;
+        }
+
+        bool parseFloat(const char*& p, const char* end, float* value)
+        {
+            const char* begin = skipSpaces(p, end);
+            if (begin < end && *begin == '+')
+                begin++;
+            auto result = std::from_chars(begin, end, *value);
+            if (result.ec == std::errc::result_out_of_range)
+            {
+                // from_chars leaves the value alone, strtof rounds to inf or 0 like the other loaders
+                char buffer[64];
+                size_t length = std::min<size_t>(result.ptr - begin, sizeof(buffer) - 1);
+                memcpy(buffer, begin, length);
+                buffer[length] = 0;
+                *value = strtof(buffer, nullptr);
+            }
+            else if (result.ec != std::errc())
+            {
+                return false;
+            }
+            p = result.ptr;
+            return true;
+        }
+
+        // a 1-based or negative index as written, made 0-based, -1 when missing
+        inline int resolveIndex(int value, size_t count, uint32_t bit, uint32_t* relative)
+        {
+            if (value > 0)
+                return value - 1;
+            if (value == 0)
+                return -1;
+            *relative |= bit;
+            return (int)count + value;
+        }
+
+        // v, v/t, v//n or v/t/n
+        bool parseCorner(const char*& p, const char* end, const ObjChunk& chunk, tinyobj::index_t* corner,
+                         uint32_t* relative)
+        {
+            int values[3] = {}; // vertex, texcoord, normal
+            for (int i = 0; i < 3; i++)
+            {
+                if (i > 0)
+                {
+                    if (p == end || *p != '/')
+                        break;
+                    p++;
+                    if (i == 1 && p < end && *p == '/')
+                        continue;
+                }
+                auto result = std::from_chars(p, end, values[i]);
+                if (result.ec != std::errc() || (i == 0 && values[i] == 0))
+                    return false;
+                p = result.ptr;
+            }
+            *relative = 0;
+            corner->vertex_index = resolveIndex(values[0], chunk.positions.size() / 3, 1, relative);
+            corner->normal_index = resolveIndex(values[2], chunk.normals.size() / 3, 2, relative);
+            corner->texcoord_index = resolveIndex(values[1], chunk.texcoords.size() / 2, 4, relative);
+            return true;
+        }
+
+        std::string getRest(const char* p, const char* end)
+        {
+            p = skipSpaces(p, end);
+            while (end > p && isSpace(end[-1]))
+                end--;
+            return std::string(p, end);
+        }
+
+        void addStatement(ObjChunk& chunk, ObjStatementType type, std::string text)
+        {
+            chunk.statements.push_back({type, chunk.corners.size() / 3, std::move(text)});
+        }
+
+        bool parseLine(ObjChunk& chunk, const char* p, const char* end, std::vector<tinyobj::index_t>& face,
+                       std::vector<uint32_t>& faceRelative)
+        {
+            const char* keyword = p;
+            while (p < end && !isSpace(*p))
+                p++;
+            size_t length = p - keyword;
+            // a bare g, o or s is ignored like tinyobj does
+            bool hasArguments = skipSpaces(p, end) < end;
+
+            if (length == 1 && keyword[0] == 'v')
+            {
+                float x, y, z;
+                if (!parseFloat(p, end, &x) || !parseFloat(p, end, &y) || !parseFloat(p, end, &z))
+                    return false;
+                chunk.positions.insert(chunk.positions.end(), {x, y, z});
+                // x y z r g b, a lone fourth value is a weight and ignored
+                float r, g, b;
+                if (parseFloat(p, end, &r) && parseFloat(p, end, &g) && parseFloat(p, end, &b))
+                {
+                    if (chunk.colors.empty())
+                        chunk.colors.assign(chunk.positions.size() - 3, 1.0f);
+                    chunk.colors.insert(chunk.colors.end(), {r, g, b});
+                }
+                else if (!chunk.colors.empty())
+                {
+                    chunk.colors.insert(chunk.colors.end(), {1.0f, 1.0f, 1.0f});
+                }
+            }
+            else if (length == 2 && keyword[0] == 'v' && keyword[1] == 'n')
+            {
+                float x, y, z;
+                if (!parseFloat(p, end, &x) || !parseFloat(p, end, &y) || !parseFloat(p, end, &z))
+                    return false;
+                chunk.normals.insert(chunk.normals.end(), {x, y, z});
+            }
+            else if (length == 2 && keyword[0] == 'v' && keyword[1] == 't')
+            {
+                float u, v = 0.0f;
+                if (!parseFloat(p, end, &u))
+                    return false;
+                parseFloat(p, end, &v);
+                chunk.texcoords.insert(chunk.texcoords.end(), {u, v});
+            }
+            else if (length == 1 && keyword[0] == 'f')
+            {
+                face.clear();
+                faceRelative.clear();
+                p = skipSpaces(p, end);
+                while (p < end)
+                {
+                    tinyobj::index_t corner;
+                    uint32_t relative;
+                    if (!parseCorner(p, end, chunk, &corner, &relative))
+                        return false;
+                    face.push_back(corner);
+                    faceRelative.push_back(relative);
+                    p = skipSpaces(p, end);
+                }
+                // a fan around the first corner, degenerate faces are skipped like tinyobj does
+                for (size_t i = 2; i < face.size(); i++)
+                {
+                    for (size_t k : {(size_t)0, i - 1, i})
+                    {
+                        for (uint32_t component = 0; component < 3; component++)
+                        {
+                            if (faceRelative[k] & (1u << component))
+                                chunk.relativeCorners.push_back(chunk.corners.size() * 3 + component);
+                        }
+                        chunk.corners.push_back(face[k]);
+                    }
+                }
+            }
+            else if (length == 1 && keyword[0] == 'g' && hasArguments)
+            {
+                // several group names are joined with a space
+                std::string name;
+                p = skipSpaces(p, end);
+                while (p < end)
+                {
+                    const char* word = p;
+                    while (p < end && !isSpace(*p))
+                        p++;
+                    if (!name.empty())
+                        name += ' ';
+                    name.append(word, p);
+                    p = skipSpaces(p, end);
+                }
+                addStatement(chunk, ObjStatementType::Group, std::move(name));
+            }
+            else if (length == 1 && keyword[0] == 'o' && hasArguments)
+            {
+                addStatement(chunk, ObjStatementType::Object, getRest(p, end));
+            }
+            else if (length == 1 && keyword[0] == 's' && hasArguments)
+            {
+                addStatement(chunk, ObjStatementType::Smoothing, getRest(p, end));
+            }
+            else if (length == 6 && memcmp(keyword, "usemtl", 6) == 0)
+            {
+                std::string name = getRest(p, end);
+                addStatement(chunk, ObjStatementType::UseMaterial, name.substr(0, name.find_first_of(" \t")));
+            }
+            else if (length == 6 && memcmp(keyword, "mtllib", 6) == 0)
+            {
+                addStatement(chunk, ObjStatementType::MaterialLibrary, getRest(p, end));
+            }
+            else if (length == 1 && (keyword[0] == 'l' || keyword[0] == 'p'))
+            {
+                chunk.skippedPrimitives = true;
+            }
+            return true;
+        }
+
+        void parseChunk(ObjChunk& chunk)
+        {
+            // a third of the bytes of a scan are faces, a vertex takes about 30 bytes and a corner 10
+            size_t bytes = chunk.end - chunk.begin;
+            chunk.positions.reserve(bytes / 30);
+            chunk.corners.reserve(bytes / 30);
+
+            std::vector<tinyobj::index_t> face;
+            std::vector<uint32_t> faceRelative;
+            const char* p = chunk.begin;
+            while (p < chunk.end)
+            {
+                const char* lineEnd = (const char*)memchr(p, '\n', chunk.end - p);
+                if (!lineEnd)
+                    lineEnd = chunk.end;
+                const char* end = lineEnd > p && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd;
+                const char* line = skipSpaces(p, end);
+                if (line < end && *line != '#' && !parseLine(chunk, line, end, face, faceRelative))
+                {
+                    chunk.error = p;
+                    return;
+                }
+                p = lineEnd + 1;
+            }
+        }
+
+        // adds the chunk's offsets to its relative indices and copies its elements to the merged arrays
+        bool mergeChunk(ObjChunk& chunk, const ChunkOffsets& offsets, tinyobj::attrib_t* attrib,
+                        std::vector<tinyobj::index_t>& corners)
+        {
+            std::copy(chunk.positions.begin(), chunk.positions.end(), attrib->vertices.begin() + offsets.vertex * 3);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), attrib->normals.begin() + offsets.normal * 3);
+            std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib->texcoords.begin() + offsets.texcoord * 2);
+            if (!attrib->colors.empty())
+            {
+                auto colors = attrib->colors.begin() + offsets.vertex * 3;
+                if (chunk.colors.empty())
+                    std::fill(colors, colors + chunk.positions.size(), 1.0f);
+                else
+                    std::copy(chunk.colors.begin(), chunk.colors.end(), colors);
+            }
+
+            for (size_t relative : chunk.relativeCorners)
+            {
+                auto& corner = chunk.corners[relative / 3];
+                switch (relative % 3)
+                {
+                case 0: corner.vertex_index += (int)offsets.vertex; break;
+                case 1: corner.normal_index += (int)offsets.normal; break;
+                default: corner.texcoord_index += (int)offsets.texcoord; break;
+                }
+            }
+
+            int vertexCount = (int)(attrib->vertices.size() / 3);
+            int normalCount = (int)(attrib->normals.size() / 3);
+            int texcoordCount = (int)(attrib->texcoords.size() / 2);
+            bool valid = true;
+            auto destination = corners.begin() + offsets.corner;
+            for (const auto& corner : chunk.corners)
+            {
+                valid &= corner.vertex_index >= 0 && corner.vertex_index < vertexCount;
+                valid &= corner.normal_index >= -1 && corner.normal_index < normalCount;
+                valid &= corner.texcoord_index >= -1 && corner.texcoord_index < texcoordCount;
+                *destination++ = corner;
+            }
+            chunk = {};
+            return valid;
+        }
+
+        int getLineNumber(const char* begin, const char* position)
+        {
+            return 1 + (int)std::count(begin, position, '\n');
+        }
+    }
+
+    bool loadObj(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+                 std::vector<tinyobj::material_t>* materials, std::string* warn, std::string* err,
+                 const std::string& path, const std::string& mtlBaseDir, bool defaultColors)
+    {
+        *attrib = {};
+        shapes->clear();
+
+        auto file = MappedFile::create(path);
+        if (!file)
+        {
+            if (err)
+                *err += "Cannot open file [" + path + "]\n";
+            return false;
+        }
+        auto data = (const char*)file->getData();
+        size_t size = file->getSize();
+
+        // a few chunks per worker so that the slow ones don't hold up the merge, and at least a MB each
+        auto jobs = JobSystem::getDefault();
+        size_t chunkSize = std::max<size_t>(1 << 20, size / ((jobs->getThreadCount() + 1) * 4) + 1);
+        std::vector<ObjChunk> chunks;
+        for (const char *begin = data, *end = data + size; begin < end;)
+        {
+            const char* split = begin + std::min(chunkSize, (size_t)(end - begin));
+            if (split < end)
+            {
+                auto newline = (const char*)memchr(split, '\n', end - split);
+                split = newline ? newline + 1 : end;
+            }
+            chunks.emplace_back();
+            chunks.back().begin = begin;
+            chunks.back().end = split;
+            begin = split;
+        }
+
+        std::vector<JobRef> chunkJobs;
+        for (auto& chunk : chunks)
+            chunkJobs.push_back(jobs->add([&chunk] { parseChunk(chunk); }));
+        jobs->wait(chunkJobs);
+
+        // prefix sums of the element counts
+        std::vector<ChunkOffsets> offsets(chunks.size() + 1);
+        bool hasColors = defaultColors, skippedPrimitives = false;
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            const auto& chunk = chunks[c];
+            if (chunk.error)
+            {
+                if (err)
+                    *err += path + ": parse error at line " + std::to_string(getLineNumber(data, chunk.error)) + "\n";
+                return false;
+            }
+            offsets[c + 1].vertex = offsets[c].vertex + chunk.positions.size() / 3;
+            offsets[c + 1].normal = offsets[c].normal + chunk.normals.size() / 3;
+            offsets[c + 1].texcoord = offsets[c].texcoord + chunk.texcoords.size() / 2;
+            offsets[c + 1].corner = offsets[c].corner + chunk.corners.size();
+            hasColors |= !chunk.colors.empty();
+            skippedPrimitives |= chunk.skippedPrimitives;
+        }
+        const auto& totals = offsets.back();
+        attrib->vertices.resize(totals.vertex * 3);
+        attrib->normals.resize(totals.normal * 3);
+        attrib->texcoords.resize(totals.texcoord * 2);
+        attrib->colors.resize(hasColors ? totals.vertex * 3 : 0);
+
+        // statements are kept for the replay below, everything else is released as soon as it is copied
+        std::vector<std::vector<ObjStatement>> statements(chunks.size());
+        for (size_t c = 0; c < chunks.size(); c++)
+            statements[c].swap(chunks[c].statements);
+
+        std::vector<tinyobj::index_t> corners(totals.corner);
+        std::vector<uint8_t> valid(chunks.size(), 0);
+        chunkJobs.clear();
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            chunkJobs.push_back(jobs->add([&, c] { valid[c] = mergeChunk(chunks[c], offsets[c], attrib, corners); }));
+        }
+        jobs->wait(chunkJobs);
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            if (!valid[c])
+            {
+                if (err)
+                    *err += path + ": index out of range\n";
+                *attrib = {};
+                return false;
+            }
+        }
+
+        // shapes, materials and smoothing groups in file order
+        struct ShapeRange
+        {
+            std::string name;
+            size_t begin;
+            size_t end;
+        };
+        size_t triangleCount = totals.corner / 3;
+        std::vector<int> materialIds(triangleCount);
+        std::vector<unsigned int> smoothingIds(triangleCount);
+        std::vector<ShapeRange> ranges;
+        std::map<std::string, int> materialMap;
+        std::string baseDir = mtlBaseDir;
+        if (!baseDir.empty() && baseDir.back() != '/' && baseDir.back() != '\\')
+            baseDir += '/';
+        tinyobj::MaterialFileReader materialReader(baseDir);
+
+        std::string name;
+        int material = -1;
+        unsigned int smoothing = 0;
+        size_t shapeBegin = 0, runBegin = 0;
+        auto endRun = [&](size_t end) {
+            std::fill(materialIds.begin() + runBegin, materialIds.begin() + end, material);
+            std::fill(smoothingIds.begin() + runBegin, smoothingIds.begin() + end, smoothing);
+            runBegin = end;
+        };
+        auto endShape = [&](size_t end) {
+            endRun(end);
+            if (end > shapeBegin)
+                ranges.push_back({name, shapeBegin, end});
+            shapeBegin = end;
+        };
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            for (auto& statement : statements[c])
+            {
+                size_t triangle = offsets[c].corner / 3 + statement.triangle;
+                switch (statement.type)
+                {
+                case ObjStatementType::Group:
+                case ObjStatementType::Object:
+                    endShape(triangle);
+                    name = std::move(statement.text);
+                    break;
+                case ObjStatementType::UseMaterial:
+                {
+                    endRun(triangle);
+                    auto it = materialMap.find(statement.text);
+                    material = it != materialMap.end() ? it->second : -1;
+                    if (it == materialMap.end() && warn)
+                        *warn += "material [ '" + statement.text + "' ] not found in .mtl\n";
+                    break;
+                }
+                case ObjStatementType::MaterialLibrary:
+                {
+                    // the first of the files that can be read
+                    bool found = false;
+                    size_t begin = 0;
+                    while (!found && begin < statement.text.size())
+                    {
+                        size_t end = std::min(statement.text.find(' ', begin), statement.text.size());
+                        std::string mtlWarn, mtlErr;
+                        if (end > begin)
+                            found = materialReader(statement.text.substr(begin, end - begin), materials, &materialMap,
+                                                   &mtlWarn, &mtlErr);
+                        if (warn)
+                            *warn += mtlWarn;
+                        if (err)
+                            *err += mtlErr;
+                        begin = end + 1;
+                    }
+                    if (!found && warn)
+                        *warn += "Failed to load material file(s). Use default material.\n";
+                    break;
+                }
+                case ObjStatementType::Smoothing:
+                    endRun(triangle);
+                    smoothing = statement.text.compare(0, 3, "off") == 0 ? 0 : (unsigned int)std::max(0, atoi(statement.text.c_str()));
+                    break;
+                }
+            }
+        }
+        endShape(triangleCount);
+        if (skippedPrimitives && warn)
+            *warn += "lines and points are not loaded\n";
+
+        shapes->resize(ranges.size());
+        auto fillShape = [&](size_t s) {
+            auto& shape = (*shapes)[s];
+            const auto& range = ranges[s];
+            shape.name = range.name;
+            if (ranges.size() == 1 && range.begin == 0 && range.end == triangleCount)
+            {
+                shape.mesh.indices.swap(corners);
+                shape.mesh.material_ids.swap(materialIds);
+                shape.mesh.smoothing_group_ids.swap(smoothingIds);
+            }
+            else
+            {
+                shape.mesh.indices.assign(corners.begin() + range.begin * 3, corners.begin() + range.end * 3);
+                shape.mesh.material_ids.assign(materialIds.begin() + range.begin, materialIds.begin() + range.end);
+                shape.mesh.smoothing_group_ids.assign(smoothingIds.begin() + range.begin,
+                                                      smoothingIds.begin() + range.end);
+            }
+            shape.mesh.num_face_vertices.assign(range.end - range.begin, 3);
+        };
+        chunkJobs.clear();
+        for (size_t s = 0; s < ranges.size(); s++)
+            chunkJobs.push_back(jobs->add([&, s] { fillShape(s); }));
+        jobs->wait(chunkJobs);
+        return true;
+    }
+
+    bool loadObjScene(const std::string& path, yocto::scene_scene& scene, std::string& error,
+                      std::vector<std::string>* texturePaths)
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+        std::string dirname = path.substr(0, path.find_last_of("/\\") + 1);
+        if (!loadObj(&attrib, &shapes, &materials, &warn, &err, path, dirname, false))
+        {
+            error = err;
+            return false;
+        }
+        // yocto's obj loader has no vertex colors
+        std::vector<float>().swap(attrib.colors);
+
+        // faces without a material get the default one yocto adds
+        int defaultMaterial = -1;
+        for (auto& shape : shapes)
+        {
+            for (int& id : shape.mesh.material_ids)
+            {
+                if (id >= 0)
+                    continue;
+                if (defaultMaterial < 0)
+                {
+                    defaultMaterial = (int)materials.size();
+                    materials.emplace_back();
+                    materials.back().name = "__default__";
+                    std::fill(materials.back().diffuse, materials.back().diffuse + 3, 0.8f);
+                }
+                id = defaultMaterial;
+            }
+        }
+
+        scene = {};
+        texturePaths->clear();
+        std::unordered_map<std::string, int> textureIds;
+        auto getTexture = [&](const std::string& name) {
+            if (name.empty())
+                return yocto::invalid_handle;
+            auto it = textureIds.find(name);
+            if (it != textureIds.end())
+                return it->second;
+            int id = (int)scene.textures.size();
+            textureIds[name] = id;
+            scene.textures.emplace_back();
+            scene.texture_names.push_back(name);
+            texturePaths->push_back(dirname + name);
+            return id;
+        };
+        auto exponentToRoughness = [](float exponent) {
+            if (exponent >= 1000)
+                return 0.0f;
+            float roughness = std::pow(2 / (exponent + 2), 1 / 4.0f);
+            if (roughness < 0.01f)
+                roughness = 0;
+            if (roughness > 0.99f)
+                roughness = 1;
+            return roughness;
+        };
+        auto toVec3 = [](const float* value) { return yocto::vec3f{value[0], value[1], value[2]}; };
+        auto maxOf = [](const float* value) { return std::max(value[0], std::max(value[1], value[2])); };
+        for (const auto& source : materials)
+        {
+            auto& material = scene.materials.emplace_back();
+            material.emission = toVec3(source.emission);
+            material.emission_tex = getTexture(source.emissive_texname);
+            if (maxOf(source.transmittance) > 0.1f)
+            {
+                material.type = yocto::material_type::thinglass;
+                material.color = toVec3(source.transmittance);
+            }
+            else if (maxOf(source.specular) > 0.2f)
+            {
+                material.type = yocto::material_type::metal;
+                material.color = toVec3(source.specular);
+                material.color_tex = getTexture(source.specular_texname);
+            }
+            else
+            {
+                material.type = maxOf(source.specular) > 0 ? yocto::material_type::plastic : yocto::material_type::matte;
+                material.color = toVec3(source.diffuse);
+                material.color_tex = getTexture(source.diffuse_texname);
+            }
+            material.roughness = exponentToRoughness(source.shininess);
+            material.ior = source.ior;
+            material.metallic = 0;
+            material.opacity = source.dissolve;
+            material.normal_tex = getTexture(source.normal_texname);
+            scene.material_names.push_back(source.name);
+        }
+
+        // a shape per material of every obj shape, deduplicated in parallel
+        std::vector<std::vector<ObjSubmesh>> submeshes(shapes.size());
+        auto jobs = JobSystem::getDefault();
+        std::vector<JobRef> shapeJobs;
+        for (size_t s = 0; s < shapes.size(); s++)
+        {
+            shapeJobs.push_back(jobs->add([&, s] {
+                submeshes[s] = buildObjSubmeshes(attrib, shapes[s]);
+                std::vector<tinyobj::index_t>().swap(shapes[s].mesh.indices);
+            }));
+        }
+        jobs->wait(shapeJobs);
+
+        for (size_t s = 0; s < shapes.size(); s++)
+        {
+            for (auto& submesh : submeshes[s])
+            {
+                auto& shape = scene.shapes.emplace_back();
+                auto positions = (const yocto::vec3f*)submesh.positions.data();
+                shape.positions.assign(positions, positions + submesh.positions.size());
+                auto normals = (const yocto::vec3f*)submesh.normals.data();
+                shape.normals.assign(normals, normals + submesh.normals.size());
+                shape.texcoords.reserve(submesh.texcoords.size());
+                for (const auto& texcoord : submesh.texcoords)
+                    shape.texcoords.push_back({texcoord.x, 1 - texcoord.y});
+                auto triangles = (const yocto::vec3i*)submesh.indices.data();
+                shape.triangles.assign(triangles, triangles + submesh.indices.size() / 3);
+
+                auto& instance = scene.instances.emplace_back();
+                instance.shape = (int)scene.shapes.size() - 1;
+                instance.material = submesh.material;
+                submesh = {};
+                scene.shape_names.push_back(shapes[s].name);
+                scene.instance_names.push_back(shapes[s].name);
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,436 @@
+#include "../include/OcclusionCuller.h"
+#include "../include/JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MELO_SSE2
+#endif
+
+namespace melo
+{
+    // the near plane, then the sides at GUARD_BAND times the screen: clipping the sides keeps the edge functions
+    // within float precision, the rest of the guard band is left to the bounding rectangle
+    static constexpr float GUARD_BAND = 4.0f;
+    static const glm::vec4 CLIP_PLANES[] = {
+        {0, 0, 1, 1}, {1, 0, 0, GUARD_BAND}, {-1, 0, 0, GUARD_BAND}, {0, 1, 0, GUARD_BAND}, {0, -1, 0, GUARD_BAND},
+    };
+    static constexpr int CLIP_PLANE_COUNT = 5;
+    // each plane adds a vertex at most
+    static constexpr int MAX_CLIPPED_VERTICES = 3 + CLIP_PLANE_COUNT;
+
+    static float dot4(const glm::vec4& a, const glm::vec4& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    }
+
+    OcclusionCullerRef OcclusionCuller::create(uint32_t width, uint32_t height)
+    {
+        return OcclusionCullerRef(new OcclusionCuller(width, height));
+    }
+
+    OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+        : mWidth((std::max<uint32_t>(width, 4) + 3) & ~3u), mHeight(std::max<uint32_t>(height, 1))
+    {
+        uint32_t levelWidth = mWidth, levelHeight = mHeight;
+        while (true)
+        {
+            mLevels.emplace_back((size_t)levelWidth * levelHeight, 0.0f);
+            mLevelWidths.push_back(levelWidth);
+            mLevelHeights.push_back(levelHeight);
+            if (levelWidth == 1 && levelHeight == 1)
+                break;
+            levelWidth = (levelWidth + 1) / 2;
+            levelHeight = (levelHeight + 1) / 2;
+        }
+    }
+
+    uint32_t OcclusionCuller::addShape(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices,
+                                       size_t indexCount)
+    {
+        if (vertexCount == 0 || indexCount < 3)
+            return INVALID;
+
+        Shape shape;
+        shape.positions.assign(positions, positions + vertexCount);
+        shape.indices.assign(indices, indices + indexCount / 3 * 3);
+        shape.boundsMin = shape.boundsMax = positions[0];
+        for (const auto& position : shape.positions)
+        {
+            shape.boundsMin = glm::min(shape.boundsMin, position);
+            shape.boundsMax = glm::max(shape.boundsMax, position);
+        }
+        mShapes.emplace_back(std::move(shape));
+        return (uint32_t)mShapes.size() - 1;
+    }
+
+    uint32_t OcclusionCuller::addOccluder(uint32_t shape, NodeRef node)
+    {
+        if (shape == INVALID || !node)
+            return INVALID;
+        mOccluderShapes.push_back(shape);
+        mOccluderNodes.push_back(node);
+        return (uint32_t)mOccluderNodes.size() - 1;
+    }
+
+    void OcclusionCuller::clear()
+    {
+        mShapes.clear();
+        mOccluderShapes.clear();
+        mOccluderNodes.clear();
+    }
+
+    void OcclusionCuller::setupTriangle(const glm::vec4* clip, std::vector<Triangle>* triangles) const
+    {
+        // nothing to clip when every vertex is inside every plane, nothing to draw when all are outside of one
+        uint32_t outsideAny = 0, outsideAll = (1u << CLIP_PLANE_COUNT) - 1;
+        for (int vertex = 0; vertex < 3; vertex++)
+        {
+            uint32_t outside = 0;
+            for (int plane = 0; plane < CLIP_PLANE_COUNT; plane++)
+                outside |= dot4(clip[vertex], CLIP_PLANES[plane]) < 0 ? 1u << plane : 0;
+            outsideAny |= outside;
+            outsideAll &= outside;
+        }
+        if (outsideAll)
+            return;
+
+        glm::vec4 polygon[MAX_CLIPPED_VERTICES], clipped[MAX_CLIPPED_VERTICES];
+        int count = 3;
+        std::copy(clip, clip + 3, polygon);
+        for (int plane = 0; plane < CLIP_PLANE_COUNT && count >= 3; plane++)
+        {
+            if (!(outsideAny & (1u << plane)))
+                continue;
+            int clippedCount = 0;
+            for (int i = 0; i < count; i++)
+            {
+                const glm::vec4& a = polygon[i];
+                const glm::vec4& b = polygon[(i + 1) % count];
+                float distanceA = dot4(a, CLIP_PLANES[plane]), distanceB = dot4(b, CLIP_PLANES[plane]);
+                if (distanceA >= 0)
+                    clipped[clippedCount++] = a;
+                if ((distanceA >= 0) != (distanceB >= 0))
+                    clipped[clippedCount++] = a + (b - a) * (distanceA / (distanceA - distanceB));
+            }
+            count = clippedCount;
+            std::copy(clipped, clipped + count, polygon);
+        }
+        if (count < 3)
+            return;
+
+        // pixels with y up, 1/w for the depth
+        glm::vec3 screen[MAX_CLIPPED_VERTICES];
+        for (int i = 0; i < count; i++)
+        {
+            if (!(polygon[i].w > 0))
+                return;
+            float inverseW = 1.0f / polygon[i].w;
+            screen[i] = {(polygon[i].x * inverseW * 0.5f + 0.5f) * mWidth,
+                         (polygon[i].y * inverseW * 0.5f + 0.5f) * mHeight, inverseW};
+        }
+        for (int i = 2; i < count; i++)
+        {
+            glm::vec3 fan[3] = {screen[0], screen[i - 1], screen[i]};
+            addScreenTriangle(fan, triangles);
+        }
+    }
+
+    void OcclusionCuller::addScreenTriangle(const glm::vec3* screen, std::vector<Triangle>* triangles) const
+    {
+        glm::vec3 v[3] = {screen[0], screen[1], screen[2]};
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (!(std::abs(area) > 0))
+            return;
+        // occluders are seen from both sides, the edge functions are positive inside once counterclockwise
+        if (area < 0)
+        {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        Triangle triangle;
+        triangle.minX = std::max(0, (int)std::ceil(std::min({v[0].x, v[1].x, v[2].x}) - 0.5f));
+        triangle.maxX = std::min((int)mWidth - 1, (int)std::floor(std::max({v[0].x, v[1].x, v[2].x}) - 0.5f));
+        triangle.minY = std::max(0, (int)std::ceil(std::min({v[0].y, v[1].y, v[2].y}) - 0.5f));
+        triangle.maxY = std::min((int)mHeight - 1, (int)std::floor(std::max({v[0].y, v[1].y, v[2].y}) - 0.5f));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return;
+
+        // edge i runs from vertex i to the next one, facing the vertex after; 1/w is the sum of the vertex depths
+        // weighted by the edges facing them
+        triangle.depthA = triangle.depthB = triangle.depthC = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec3& a = v[i];
+            const glm::vec3& b = v[(i + 1) % 3];
+            triangle.edgeA[i] = a.y - b.y;
+            triangle.edgeB[i] = b.x - a.x;
+            triangle.edgeC[i] = a.x * b.y - a.y * b.x;
+            float weight = v[(i + 2) % 3].z / area;
+            triangle.depthA += triangle.edgeA[i] * weight;
+            triangle.depthB += triangle.edgeB[i] * weight;
+            triangle.depthC += triangle.edgeC[i] * weight;
+        }
+        triangles->push_back(triangle);
+    }
+
+    void OcclusionCuller::rasterize(const Triangle& triangle, int binMinY, int binMaxY)
+    {
+        int minY = std::max(triangle.minY, binMinY), maxY = std::min(triangle.maxY, binMaxY);
+        // rows start on a multiple of 4 pixels, the rows are a multiple of 4 wide
+        int minX = triangle.minX & ~3, maxX = triangle.maxX;
+        float* depth = mLevels[0].data();
+        for (int y = minY; y <= maxY; y++)
+        {
+            float pixelY = y + 0.5f;
+            float* row = depth + (size_t)y * mWidth;
+#if defined(MELO_SSE2)
+            const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            __m128 pixelX = _mm_add_ps(_mm_set1_ps((float)minX), offsets);
+            __m128 edge[3], edgeStep[3];
+            for (int i = 0; i < 3; i++)
+            {
+                __m128 a = _mm_set1_ps(triangle.edgeA[i]);
+                edge[i] = _mm_add_ps(_mm_mul_ps(a, pixelX), _mm_set1_ps(triangle.edgeB[i] * pixelY + triangle.edgeC[i]));
+                edgeStep[i] = _mm_mul_ps(a, _mm_set1_ps(4.0f));
+            }
+            __m128 depthA = _mm_set1_ps(triangle.depthA);
+            __m128 pixelDepth =
+                _mm_add_ps(_mm_mul_ps(depthA, pixelX), _mm_set1_ps(triangle.depthB * pixelY + triangle.depthC));
+            __m128 depthStep = _mm_mul_ps(depthA, _mm_set1_ps(4.0f));
+            const __m128 zero = _mm_setzero_ps();
+            for (int x = minX; x <= maxX; x += 4)
+            {
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge[0], zero), _mm_cmpge_ps(edge[1], zero)),
+                                           _mm_cmpge_ps(edge[2], zero));
+                // the buffer is never negative, max() with 0 leaves the pixels outside as they were
+                _mm_storeu_ps(row + x, _mm_max_ps(_mm_loadu_ps(row + x), _mm_and_ps(inside, pixelDepth)));
+                for (int i = 0; i < 3; i++)
+                    edge[i] = _mm_add_ps(edge[i], edgeStep[i]);
+                pixelDepth = _mm_add_ps(pixelDepth, depthStep);
+            }
+#else
+            for (int x = minX; x <= maxX; x++)
+            {
+                float pixelX = x + 0.5f;
+                bool inside = true;
+                for (int i = 0; i < 3; i++)
+                    inside &= triangle.edgeA[i] * pixelX + triangle.edgeB[i] * pixelY + triangle.edgeC[i] >= 0;
+                if (inside)
+                    row[x] = std::max(row[x], triangle.depthA * pixelX + triangle.depthB * pixelY + triangle.depthC);
+            }
+#endif
+        }
+    }
+
+    void OcclusionCuller::buildPyramid()
+    {
+        for (size_t level = 1; level < mLevels.size(); level++)
+        {
+            const auto& below = mLevels[level - 1];
+            uint32_t belowWidth = mLevelWidths[level - 1], belowHeight = mLevelHeights[level - 1];
+            auto& cells = mLevels[level];
+            for (uint32_t y = 0; y < mLevelHeights[level]; y++)
+            {
+                uint32_t y0 = y * 2, y1 = std::min(y0 + 1, belowHeight - 1);
+                for (uint32_t x = 0; x < mLevelWidths[level]; x++)
+                {
+                    uint32_t x0 = x * 2, x1 = std::min(x0 + 1, belowWidth - 1);
+                    cells[y * mLevelWidths[level] + x] =
+                        std::min(std::min(below[y0 * belowWidth + x0], below[y0 * belowWidth + x1]),
+                                 std::min(below[y1 * belowWidth + x0], below[y1 * belowWidth + x1]));
+                }
+            }
+        }
+    }
+
+    void OcclusionCuller::render(const glm::mat4& viewProjection, JobSystem* jobs)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        mViewProjection = viewProjection;
+
+        // the occluders by the screen area of their box, a box crossing the near plane may cover all of it
+        struct Candidate
+        {
+            uint32_t occluder;
+            float area;
+            glm::mat4 transform;
+        };
+        std::vector<Candidate> candidates;
+        for (uint32_t occluder = 0; occluder < (uint32_t)mOccluderNodes.size(); occluder++)
+        {
+            auto node = mOccluderNodes[occluder].lock();
+            if (!node || !node->isVisible())
+                continue;
+            const Shape& shape = mShapes[mOccluderShapes[occluder]];
+            glm::mat4 transform = viewProjection * node->getWorldTransform();
+            glm::vec2 rectMin(FLT_MAX), rectMax(-FLT_MAX);
+            uint32_t outsideAll = (1u << CLIP_PLANE_COUNT) - 1;
+            bool crossesNear = false;
+            for (int corner = 0; corner < 8; corner++)
+            {
+                glm::vec3 p((corner & 1) ? shape.boundsMax.x : shape.boundsMin.x,
+                            (corner & 2) ? shape.boundsMax.y : shape.boundsMin.y,
+                            (corner & 4) ? shape.boundsMax.z : shape.boundsMin.z);
+                glm::vec4 clip = transform * glm::vec4(p, 1.0f);
+                uint32_t outside = 0;
+                for (int plane = 0; plane < CLIP_PLANE_COUNT; plane++)
+                    outside |= dot4(clip, CLIP_PLANES[plane]) < 0 ? 1u << plane : 0;
+                outsideAll &= outside;
+                if (clip.w <= 0 || (outside & 1))
+                {
+                    crossesNear = true;
+                    continue;
+                }
+                glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+                rectMin = glm::min(rectMin, ndc);
+                rectMax = glm::max(rectMax, ndc);
+            }
+            if (outsideAll)
+                continue;
+            float area = (float)mWidth * mHeight;
+            if (!crossesNear)
+            {
+                rectMin = glm::clamp(rectMin, -1.0f, 1.0f);
+                rectMax = glm::clamp(rectMax, -1.0f, 1.0f);
+                area = (rectMax.x - rectMin.x) * 0.5f * mWidth * (rectMax.y - rectMin.y) * 0.5f * mHeight;
+            }
+            if (area >= MIN_OCCLUDER_AREA)
+                candidates.push_back({occluder, area, transform});
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Candidate& a, const Candidate& b) { return a.area > b.area; });
+        size_t triangleCount = 0, selected = 0;
+        for (; selected < candidates.size(); selected++)
+        {
+            size_t shapeTriangles = mShapes[mOccluderShapes[candidates[selected].occluder]].indices.size() / 3;
+            if (mTriangleBudget && selected > 0 && triangleCount + shapeTriangles > mTriangleBudget)
+                break;
+            triangleCount += shapeTriangles;
+        }
+        candidates.resize(selected);
+
+        // triangle setup per group of occluders, then the bins of rows each go through all the triangles
+        size_t setupCount = jobs ? std::max<size_t>(1, std::min(candidates.size(), jobs->getThreadCount() + 1)) : 1;
+        mTriangles.resize(setupCount);
+        auto setup = [&](size_t group) {
+            auto& triangles = mTriangles[group];
+            triangles.clear();
+            std::vector<glm::vec4> clip;
+            for (size_t i = group; i < candidates.size(); i += setupCount)
+            {
+                const Shape& shape = mShapes[mOccluderShapes[candidates[i].occluder]];
+                clip.resize(shape.positions.size());
+                for (size_t vertex = 0; vertex < clip.size(); vertex++)
+                    clip[vertex] = candidates[i].transform * glm::vec4(shape.positions[vertex], 1.0f);
+                for (size_t index = 0; index + 2 < shape.indices.size(); index += 3)
+                {
+                    glm::vec4 triangle[3] = {clip[shape.indices[index]], clip[shape.indices[index + 1]],
+                                             clip[shape.indices[index + 2]]};
+                    setupTriangle(triangle, &triangles);
+                }
+            }
+        };
+
+        uint32_t binCount = (mHeight + BIN_HEIGHT - 1) / BIN_HEIGHT;
+        auto rasterizeBin = [&](uint32_t bin) {
+            int binMinY = (int)(bin * BIN_HEIGHT), binMaxY = std::min((int)mHeight, binMinY + (int)BIN_HEIGHT) - 1;
+            std::fill(mLevels[0].begin() + (size_t)binMinY * mWidth, mLevels[0].begin() + (size_t)(binMaxY + 1) * mWidth,
+                      0.0f);
+            for (const auto& triangles : mTriangles)
+            {
+                for (const auto& triangle : triangles)
+                {
+                    if (triangle.maxY >= binMinY && triangle.minY <= binMaxY)
+                        rasterize(triangle, binMinY, binMaxY);
+                }
+            }
+        };
+
+        if (jobs && setupCount > 1)
+        {
+            std::vector<JobRef> pending;
+            for (size_t group = 0; group < setupCount; group++)
+                pending.push_back(jobs->add([&, group] { setup(group); }));
+            jobs->wait(pending);
+        }
+        else
+        {
+            setup(0);
+        }
+        if (jobs)
+        {
+            std::vector<JobRef> pending;
+            for (uint32_t bin = 0; bin < binCount; bin++)
+                pending.push_back(jobs->add([&, bin] { rasterizeBin(bin); }));
+            jobs->wait(pending);
+        }
+        else
+        {
+            for (uint32_t bin = 0; bin < binCount; bin++)
+                rasterizeBin(bin);
+        }
+        buildPyramid();
+
+        mStats.occluderCount = candidates.size();
+        mStats.triangleCount = 0;
+        for (const auto& triangles : mTriangles)
+            mStats.triangleCount += triangles.size();
+        mEmpty = mStats.triangleCount == 0;
+        mStats.milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    bool OcclusionCuller::isVisible(const glm::vec3& worldMin, const glm::vec3& worldMax) const
+    {
+        if (mEmpty)
+            return true;
+
+        // screen rectangle and nearest point of the box, anything reaching the near plane is visible
+        glm::vec2 rectMin(FLT_MAX), rectMax(-FLT_MAX);
+        float nearest = 0;
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec4 clip = mViewProjection * glm::vec4((corner & 1) ? worldMax.x : worldMin.x,
+                                                         (corner & 2) ? worldMax.y : worldMin.y,
+                                                         (corner & 4) ? worldMax.z : worldMin.z, 1.0f);
+            if (!(clip.w > 0) || clip.z < -clip.w)
+                return true;
+            float inverseW = 1.0f / clip.w;
+            glm::vec2 pixel((clip.x * inverseW * 0.5f + 0.5f) * mWidth, (clip.y * inverseW * 0.5f + 0.5f) * mHeight);
+            rectMin = glm::min(rectMin, pixel);
+            rectMax = glm::max(rectMax, pixel);
+            nearest = std::max(nearest, inverseW);
+        }
+
+        // every pixel the rectangle touches
+        int minX = std::max(0, (int)std::floor(rectMin.x)), maxX = std::min((int)mWidth - 1, (int)std::floor(rectMax.x));
+        int minY = std::max(0, (int)std::floor(rectMin.y)), maxY = std::min((int)mHeight - 1, (int)std::floor(rectMax.y));
+        if (minX > maxX || minY > maxY)
+            return true;
+
+        // the finest level where the rectangle spans TEST_CELLS cells at most
+        size_t level = 0;
+        while (level + 1 < mLevels.size() &&
+               ((uint32_t)(maxX - minX) >> level >= TEST_CELLS || (uint32_t)(maxY - minY) >> level >= TEST_CELLS))
+            level++;
+        const auto& cells = mLevels[level];
+        uint32_t levelWidth = mLevelWidths[level];
+        for (int y = minY >> level; y <= maxY >> level; y++)
+        {
+            for (int x = minX >> level; x <= maxX >> level; x++)
+            {
+                // the box is hidden where its nearest point is behind the farthest occluder of the cell, with some
+                // slack for an occluder hiding its own box
+                if (nearest * DEPTH_SLACK >= cells[y * levelWidth + x])
+                    return true;
+            }
+        }
+        return false;
+    }
+}
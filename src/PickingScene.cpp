@@ -0,0 +1,220 @@
+#include "../include/PickingScene.h"
+
+#undef near
+#undef far
+#include "../3rdparty/yocto/yocto_bvh.h"
+
+#include <algorithm>
+
+namespace melo
+{
+    struct PickingBvh
+    {
+        yocto::scene_scene scene;
+        yocto::bvh_scene bvh;
+    };
+
+    static yocto::frame3f toFrame(const glm::mat4& transform)
+    {
+        yocto::frame3f frame;
+        frame.x = {transform[0][0], transform[0][1], transform[0][2]};
+        frame.y = {transform[1][0], transform[1][1], transform[1][2]};
+        frame.z = {transform[2][0], transform[2][1], transform[2][2]};
+        frame.o = {transform[3][0], transform[3][1], transform[3][2]};
+        return frame;
+    }
+
+    PickingSceneRef PickingScene::create()
+    {
+        return PickingSceneRef(new PickingScene());
+    }
+
+    PickingScene::PickingScene() : mBvh(new PickingBvh())
+    {
+    }
+
+    PickingScene::~PickingScene() = default;
+
+    uint32_t PickingScene::addShape(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices,
+        size_t indexCount)
+    {
+        if (vertexCount == 0 || indexCount < 3)
+            return INVALID;
+
+        yocto::scene_shape shape;
+        shape.positions.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            shape.positions[i] = {positions[i].x, positions[i].y, positions[i].z};
+        }
+        shape.triangles.resize(indexCount / 3);
+        for (size_t i = 0; i < shape.triangles.size(); i++)
+        {
+            shape.triangles[i] = {(int)indices[i * 3], (int)indices[i * 3 + 1], (int)indices[i * 3 + 2]};
+        }
+        mTriangleCount += shape.triangles.size();
+        mBvh->scene.shapes.emplace_back(std::move(shape));
+        mBuilt = false;
+        return (uint32_t)mBvh->scene.shapes.size() - 1;
+    }
+
+    void PickingScene::updateShape(uint32_t shape, const glm::vec3* positions)
+    {
+        auto& target = mBvh->scene.shapes[shape].positions;
+        for (size_t i = 0; i < target.size(); i++)
+        {
+            target[i] = {positions[i].x, positions[i].y, positions[i].z};
+        }
+        mUpdatedShapes.push_back(shape);
+    }
+
+    uint32_t PickingScene::addInstance(uint32_t shape, NodeRef node)
+    {
+        if (shape == INVALID || !node)
+            return INVALID;
+
+        const auto& transform = node->getWorldTransform();
+        yocto::scene_instance instance;
+        instance.shape = (int)shape;
+        instance.frame = toFrame(transform);
+        mBvh->scene.instances.push_back(instance);
+        mNodes.push_back(node);
+        mTransforms.push_back(transform);
+        mBuilt = false;
+        return (uint32_t)mNodes.size() - 1;
+    }
+
+    void PickingScene::clear()
+    {
+        mBvh.reset(new PickingBvh());
+        mNodes.clear();
+        mTransforms.clear();
+        mUpdatedShapes.clear();
+        mTriangleCount = 0;
+        mBuilt = false;
+    }
+
+    size_t PickingScene::getShapeCount() const
+    {
+        return mBvh->scene.shapes.size();
+    }
+
+    void PickingScene::getShape(uint32_t shape, std::vector<glm::vec3>* positions, std::vector<uint32_t>* indices) const
+    {
+        const auto& source = mBvh->scene.shapes[shape];
+        positions->resize(source.positions.size());
+        for (size_t i = 0; i < source.positions.size(); i++)
+        {
+            (*positions)[i] = {source.positions[i].x, source.positions[i].y, source.positions[i].z};
+        }
+        indices->resize(source.triangles.size() * 3);
+        for (size_t i = 0; i < source.triangles.size(); i++)
+        {
+            for (int corner = 0; corner < 3; corner++)
+                (*indices)[i * 3 + corner] = (uint32_t)source.triangles[i][corner];
+        }
+    }
+
+    uint32_t PickingScene::getInstanceShape(uint32_t instance) const
+    {
+        return (uint32_t)mBvh->scene.instances[instance].shape;
+    }
+
+    void PickingScene::refit()
+    {
+        auto& scene = mBvh->scene;
+        std::vector<int> updatedInstances;
+        for (size_t i = 0; i < mNodes.size(); i++)
+        {
+            auto node = mNodes[i].lock();
+            if (!node)
+                continue;
+            const auto& transform = node->getWorldTransform();
+            if (transform == mTransforms[i])
+                continue;
+            mTransforms[i] = transform;
+            scene.instances[i].frame = toFrame(transform);
+            updatedInstances.push_back((int)i);
+        }
+
+        yocto::bvh_params params;
+        if (!mBuilt)
+        {
+            mBvh->bvh = yocto::make_bvh(scene, params);
+            mBuilt = true;
+        }
+        else if (!updatedInstances.empty() || !mUpdatedShapes.empty())
+        {
+            // the instance level is refit as a whole, the shape level only for the deformed shapes
+            std::sort(mUpdatedShapes.begin(), mUpdatedShapes.end());
+            mUpdatedShapes.erase(std::unique(mUpdatedShapes.begin(), mUpdatedShapes.end()), mUpdatedShapes.end());
+            std::vector<int> updatedShapes(mUpdatedShapes.begin(), mUpdatedShapes.end());
+            yocto::update_bvh(mBvh->bvh, scene, updatedInstances, updatedShapes, params);
+        }
+        mUpdatedShapes.clear();
+    }
+
+    PickResult PickingScene::pick(const glm::vec3& origin, const glm::vec3& direction, uint32_t rayMask,
+        float maxDistance) const
+    {
+        PickResult result;
+        const auto& nodes = mBvh->bvh.bvh.nodes;
+        if (!mBuilt || nodes.empty())
+            return result;
+
+        yocto::ray3f ray;
+        ray.o = {origin.x, origin.y, origin.z};
+        ray.d = {direction.x, direction.y, direction.z};
+        ray.tmin = 0;
+        ray.tmax = maxDistance;
+        auto rayInverse = yocto::vec3f{1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z};
+
+        // the instance level is walked here to skip masked instances, nearest child first. Each shape level walk
+        // is bounded by the nearest hit so far.
+        int stack[128];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        int hitInstance = -1;
+        while (stackSize > 0)
+        {
+            const auto& node = nodes[stack[--stackSize]];
+            if (!yocto::intersect_bbox(ray, rayInverse, node.bbox))
+                continue;
+
+            if (node.internal)
+            {
+                bool reversed = rayInverse[node.axis] < 0;
+                stack[stackSize++] = node.start + (reversed ? 0 : 1);
+                stack[stackSize++] = node.start + (reversed ? 1 : 0);
+                continue;
+            }
+
+            for (int i = node.start; i < node.start + node.num; i++)
+            {
+                int instance = mBvh->bvh.bvh.primitives[i];
+                auto target = mNodes[instance].lock();
+                if (!target || (target->rayCategory & rayMask) == 0)
+                    continue;
+
+                const auto& sceneInstance = mBvh->scene.instances[instance];
+                auto hit = yocto::intersect_bvh(mBvh->bvh, mBvh->scene, instance, ray);
+                if (!hit.hit)
+                    continue;
+
+                hitInstance = instance;
+                ray.tmax = hit.distance;
+                result.shape = (uint32_t)sceneInstance.shape;
+                result.triangle = (uint32_t)hit.element;
+                result.barycentrics = {hit.uv.x, hit.uv.y};
+                result.distance = hit.distance;
+            }
+        }
+
+        if (hitInstance >= 0)
+        {
+            result.node = mNodes[hitInstance].lock();
+            result.position = origin + direction * result.distance;
+        }
+        return result;
+    }
+}
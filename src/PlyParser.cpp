@@ -0,0 +1,560 @@
+#include "../include/PlyParser.h"
+#include "../include/JobSystem.h"
+#include "../include/MappedFile.h"
+#include "../3rdparty/yocto/yocto_scene.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MELO_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MELO_SSE2
+#endif
+
+namespace melo
+{
+    namespace
+    {
+        enum class PlyType
+        {
+            I8,
+            U8,
+            I16,
+            U16,
+            I32,
+            U32,
+            I64,
+            U64,
+            F32,
+            F64,
+            INVALID,
+        };
+
+        PlyType getPlyType(const std::string& name)
+        {
+            static const std::pair<const char*, PlyType> names[] = {
+                {"char", PlyType::I8},     {"int8", PlyType::I8},       {"uchar", PlyType::U8},
+                {"uint8", PlyType::U8},    {"short", PlyType::I16},     {"int16", PlyType::I16},
+                {"ushort", PlyType::U16},  {"uint16", PlyType::U16},    {"int", PlyType::I32},
+                {"int32", PlyType::I32},   {"uint", PlyType::U32},      {"uint32", PlyType::U32},
+                {"long", PlyType::I64},    {"int64", PlyType::I64},     {"ulong", PlyType::U64},
+                {"uint64", PlyType::U64},  {"float", PlyType::F32},     {"float32", PlyType::F32},
+                {"double", PlyType::F64},  {"float64", PlyType::F64},
+            };
+            for (const auto& entry : names)
+            {
+                if (name == entry.first)
+                    return entry.second;
+            }
+            return PlyType::INVALID;
+        }
+
+        size_t getTypeSize(PlyType type)
+        {
+            switch (type)
+            {
+            case PlyType::I8:
+            case PlyType::U8:
+                return 1;
+            case PlyType::I16:
+            case PlyType::U16:
+                return 2;
+            case PlyType::I32:
+            case PlyType::U32:
+            case PlyType::F32:
+                return 4;
+            default:
+                return 8;
+            }
+        }
+
+        struct PlyProperty
+        {
+            std::string name;
+            PlyType type = PlyType::INVALID;
+            bool isList = false;
+            PlyType countType = PlyType::INVALID;
+            size_t offset = 0; // in the vertex record
+        };
+
+        struct PlyElement
+        {
+            std::string name;
+            size_t count = 0;
+            std::vector<PlyProperty> properties;
+
+            const PlyProperty* find(const char* name) const
+            {
+                for (const auto& property : properties)
+                {
+                    if (property.name == name)
+                        return &property;
+                }
+                return nullptr;
+            }
+        };
+
+        // the header up to end_header, false for anything yocto should look at
+        bool parseHeader(const uint8_t* data, size_t size, bool* bigEndian, std::vector<PlyElement>* elements,
+                         size_t* headerSize)
+        {
+            const char* begin = (const char*)data;
+            const char* end = begin + size;
+            const char* line = begin;
+            bool binary = false;
+            for (int lineIndex = 0; line < end; lineIndex++)
+            {
+                const char* next = (const char*)memchr(line, '\n', end - line);
+                if (!next)
+                    return false;
+                std::istringstream tokens(std::string(line, next));
+                line = next + 1;
+                std::string command;
+                tokens >> command;
+                if (lineIndex == 0)
+                {
+                    if (command != "ply")
+                        return false;
+                }
+                else if (command == "format")
+                {
+                    std::string format;
+                    tokens >> format;
+                    binary = format == "binary_little_endian" || format == "binary_big_endian";
+                    *bigEndian = format == "binary_big_endian";
+                }
+                else if (command == "element")
+                {
+                    elements->emplace_back();
+                    tokens >> elements->back().name >> elements->back().count;
+                    if (!tokens)
+                        return false;
+                }
+                else if (command == "property")
+                {
+                    if (elements->empty())
+                        return false;
+                    PlyProperty property;
+                    std::string type;
+                    tokens >> type;
+                    if (type == "list")
+                    {
+                        property.isList = true;
+                        tokens >> type;
+                        property.countType = getPlyType(type);
+                        tokens >> type;
+                    }
+                    property.type = getPlyType(type);
+                    tokens >> property.name;
+                    if (!tokens || property.type == PlyType::INVALID ||
+                        (property.isList && property.countType == PlyType::INVALID))
+                        return false;
+                    elements->back().properties.push_back(property);
+                }
+                else if (command == "end_header")
+                {
+                    *headerSize = line - begin;
+                    return binary;
+                }
+                else if (command != "comment" && command != "obj_info" && !command.empty())
+                {
+                    return false;
+                }
+            }
+            return false;
+        }
+
+        template <size_t Size>
+        struct Bits;
+        template <>
+        struct Bits<1>
+        {
+            typedef uint8_t Type;
+        };
+        template <>
+        struct Bits<2>
+        {
+            typedef uint16_t Type;
+        };
+        template <>
+        struct Bits<4>
+        {
+            typedef uint32_t Type;
+        };
+        template <>
+        struct Bits<8>
+        {
+            typedef uint64_t Type;
+        };
+
+        inline uint8_t swapBytes(uint8_t v) { return v; }
+        inline uint16_t swapBytes(uint16_t v) { return (uint16_t)((v >> 8) | (v << 8)); }
+        inline uint32_t swapBytes(uint32_t v)
+        {
+            return (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+        }
+        inline uint64_t swapBytes(uint64_t v)
+        {
+            return ((uint64_t)swapBytes((uint32_t)v) << 32) | swapBytes((uint32_t)(v >> 32));
+        }
+
+        template <typename T, bool Swap>
+        inline T loadValue(const uint8_t* p)
+        {
+            typename Bits<sizeof(T)>::Type bits;
+            memcpy(&bits, p, sizeof(bits));
+            if (Swap)
+                bits = swapBytes(bits);
+            T value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        // count values every stride bytes, cast to Out like yocto's convert_property, every dstStride Outs
+        template <typename Out>
+        using GatherFunc = void (*)(const uint8_t* src, size_t stride, size_t count, Out* dst, size_t dstStride);
+
+        template <typename T, bool Swap, typename Out>
+        void gatherValues(const uint8_t* src, size_t stride, size_t count, Out* dst, size_t dstStride)
+        {
+            for (size_t i = 0; i < count; i++, src += stride, dst += dstStride)
+                *dst = (Out)loadValue<T, Swap>(src);
+        }
+
+        template <typename Out, bool Swap>
+        GatherFunc<Out> getGather(PlyType type)
+        {
+            switch (type)
+            {
+            case PlyType::I8: return gatherValues<int8_t, Swap, Out>;
+            case PlyType::U8: return gatherValues<uint8_t, Swap, Out>;
+            case PlyType::I16: return gatherValues<int16_t, Swap, Out>;
+            case PlyType::U16: return gatherValues<uint16_t, Swap, Out>;
+            case PlyType::I32: return gatherValues<int32_t, Swap, Out>;
+            case PlyType::U32: return gatherValues<uint32_t, Swap, Out>;
+            case PlyType::I64: return gatherValues<int64_t, Swap, Out>;
+            case PlyType::U64: return gatherValues<uint64_t, Swap, Out>;
+            case PlyType::F32: return gatherValues<float, Swap, Out>;
+            case PlyType::F64: return gatherValues<double, Swap, Out>;
+            default: return nullptr;
+            }
+        }
+
+        template <typename Out>
+        GatherFunc<Out> getGather(PlyType type, bool swap)
+        {
+            return swap ? getGather<Out, true>(type) : getGather<Out, false>(type);
+        }
+
+        // count 32 bit values from big to little endian or back
+        void swapBytes32(const uint8_t* src, size_t count, uint32_t* dst)
+        {
+            size_t i = 0;
+#if defined(MELO_AVX2)
+            const __m256i order = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6,
+                                                   5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i v = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_shuffle_epi8(v, order));
+            }
+#elif defined(MELO_SSE2)
+            // SSE2 has no byte shuffle: the bytes of every 16 bit half are swapped, then the halves
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+                v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+                v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+                _mm_storeu_si128((__m128i*)(dst + i), v);
+            }
+#endif
+            for (; i < count; i++)
+                dst[i] = loadValue<uint32_t, true>(src + i * 4);
+        }
+
+        template <typename Out>
+        bool isSameBits(PlyType type)
+        {
+            return std::is_same<Out, float>::value ? type == PlyType::F32
+                                                   : type == PlyType::I32 || type == PlyType::U32;
+        }
+
+        // the components of a vertex attribute or a face, at offsets within records of stride bytes
+        struct PlyStream
+        {
+            PlyType types[4] = {};
+            size_t offsets[4] = {};
+            int components = 0;
+            int dstComponents = 0; // a missing alpha becomes 1
+
+            template <typename Out>
+            void read(const uint8_t* records, size_t stride, size_t count, bool swap, Out* dst) const
+            {
+                bool dense = true;
+                for (int c = 0; c < components; c++)
+                    dense = dense && types[c] == types[0] && offsets[c] == offsets[0] + c * sizeof(Out);
+                if (dense && isSameBits<Out>(types[0]) && components == dstComponents)
+                {
+                    size_t bytes = components * sizeof(Out);
+                    if (stride == bytes && !swap)
+                    {
+                        memcpy(dst, records, count * bytes);
+                        return;
+                    }
+                    if (stride == bytes)
+                    {
+                        swapBytes32(records, count * components, (uint32_t*)dst);
+                        return;
+                    }
+                    if (!swap)
+                    {
+                        for (size_t i = 0; i < count; i++)
+                            memcpy(dst + i * components, records + i * stride + offsets[0], bytes);
+                        return;
+                    }
+                }
+                for (int c = 0; c < components; c++)
+                    getGather<Out>(types[c], swap)(records + offsets[c], stride, count, dst + c, dstComponents);
+                for (int c = components; c < dstComponents; c++)
+                {
+                    for (size_t i = 0; i < count; i++)
+                        dst[i * dstComponents + c] = 1;
+                }
+            }
+        };
+
+        // the named scalar properties of element, false if one is missing
+        bool findStream(const PlyElement& element, std::initializer_list<const char*> names, int dstComponents,
+                        PlyStream* stream)
+        {
+            for (const char* name : names)
+            {
+                auto property = element.find(name);
+                if (!property)
+                    return false;
+                stream->types[stream->components] = property->type;
+                stream->offsets[stream->components] = property->offset;
+                stream->components++;
+            }
+            stream->dstComponents = dstComponents;
+            return true;
+        }
+
+        const size_t kBlockSize = 4096;
+
+        // count records split over the workers, func(first, count) in blocks that stay in the cache
+        template <typename Func>
+        void forEachBlock(size_t count, const Func& func)
+        {
+            auto jobs = JobSystem::getDefault();
+            size_t jobSize = std::max<size_t>(1 << 16, count / ((jobs->getThreadCount() + 1) * 4) + 1);
+            std::vector<JobRef> blockJobs;
+            for (size_t first = 0; first < count; first += jobSize)
+            {
+                size_t last = std::min(count, first + jobSize);
+                blockJobs.push_back(jobs->add([&func, first, last] {
+                    for (size_t block = first; block < last; block += kBlockSize)
+                        func(block, std::min(kBlockSize, last - block));
+                }));
+            }
+            jobs->wait(blockJobs);
+        }
+    }
+
+    bool loadPlyShape(const std::string& path, yocto::shape_data& shape, std::string& error)
+    {
+        shape = {};
+        auto file = MappedFile::create(path);
+        if (!file)
+            return false;
+        const uint8_t* data = file->getData();
+        size_t size = file->getSize();
+
+        bool bigEndian = false;
+        std::vector<PlyElement> elements;
+        size_t headerSize = 0;
+        if (!parseHeader(data, size, &bigEndian, &elements, &headerSize))
+            return false;
+        if (elements.size() != 2 || elements[0].name != "vertex" || elements[1].name != "face")
+            return false;
+        const uint16_t one = 1;
+        bool swap = bigEndian != (*(const uint8_t*)&one == 0);
+        auto readError = [&] {
+            error = path + ": read error";
+            return false;
+        };
+        file->prefetch();
+
+        // vertex records: scalars only
+        auto& vertex = elements[0];
+        size_t vertexStride = 0;
+        for (auto& property : vertex.properties)
+        {
+            if (property.isList)
+                return false;
+            property.offset = vertexStride;
+            vertexStride += getTypeSize(property.type);
+        }
+        if (vertexStride == 0)
+            return false;
+        const uint8_t* vertices = data + headerSize;
+        if (vertex.count > (size - headerSize) / vertexStride)
+            return readError();
+
+        // face records: scalars around a uchar list of vertex_indices
+        auto& face = elements[1];
+        size_t listOffset = 0, afterList = 0;
+        const PlyProperty* indices = nullptr;
+        for (auto& property : face.properties)
+        {
+            if (property.isList)
+            {
+                if (indices || property.name != "vertex_indices" || property.countType != PlyType::U8)
+                    return false;
+                indices = &property;
+            }
+            else
+            {
+                (indices ? afterList : listOffset) += getTypeSize(property.type);
+            }
+        }
+        if (!indices || face.count == 0)
+            return false;
+        size_t indexSize = getTypeSize(indices->type);
+        const uint8_t* faces = vertices + vertex.count * vertexStride;
+        const uint8_t* end = data + size;
+
+        // vertex streams straight into the shape
+        PlyStream positions, normals, texcoords, colors, radius;
+        std::vector<std::pair<const PlyStream*, float*>> streams;
+        if (findStream(vertex, {"x", "y", "z"}, 3, &positions))
+        {
+            shape.positions.resize(vertex.count);
+            streams.push_back({&positions, (float*)shape.positions.data()});
+        }
+        if (findStream(vertex, {"nx", "ny", "nz"}, 3, &normals))
+        {
+            shape.normals.resize(vertex.count);
+            streams.push_back({&normals, (float*)shape.normals.data()});
+        }
+        if (vertex.find("u") ? findStream(vertex, {"u", "v"}, 2, &texcoords)
+                             : findStream(vertex, {"s", "t"}, 2, &texcoords))
+        {
+            shape.texcoords.resize(vertex.count);
+            streams.push_back({&texcoords, (float*)shape.texcoords.data()});
+        }
+        if (vertex.find("alpha") ? findStream(vertex, {"red", "green", "blue", "alpha"}, 4, &colors)
+                                 : findStream(vertex, {"red", "green", "blue"}, 4, &colors))
+        {
+            shape.colors.resize(vertex.count);
+            streams.push_back({&colors, (float*)shape.colors.data()});
+        }
+        if (findStream(vertex, {"radius"}, 1, &radius))
+        {
+            shape.radius.resize(vertex.count);
+            streams.push_back({&radius, shape.radius.data()});
+        }
+        if (vertex.count > 0)
+        {
+            forEachBlock(vertex.count, [&](size_t first, size_t count) {
+                for (const auto& stream : streams)
+                {
+                    stream.first->read(vertices + first * vertexStride, vertexStride, count, swap,
+                                       stream.second + first * stream.first->dstComponents);
+                }
+            });
+        }
+
+        // faces of one size: the records have a fixed stride and split over the workers as well
+        size_t corners = faces + listOffset < end ? faces[listOffset] : 0;
+        size_t faceStride = listOffset + 1 + corners * indexSize + afterList;
+        bool fixed = (corners == 3 || corners == 4) && face.count <= (size_t)(end - faces) / faceStride;
+        if (fixed)
+        {
+            PlyStream corner;
+            for (size_t c = 0; c < corners; c++)
+            {
+                corner.types[c] = indices->type;
+                corner.offsets[c] = listOffset + 1 + c * indexSize;
+            }
+            corner.components = corner.dstComponents = (int)corners;
+            int* dst;
+            if (corners == 3)
+            {
+                shape.triangles.resize(face.count);
+                dst = (int*)shape.triangles.data();
+            }
+            else
+            {
+                shape.quads.resize(face.count);
+                dst = (int*)shape.quads.data();
+            }
+            std::atomic<bool> mixed(false);
+            forEachBlock(face.count, [&](size_t first, size_t count) {
+                const uint8_t* records = faces + first * faceStride;
+                for (size_t i = 0; i < count; i++)
+                {
+                    if (records[i * faceStride + listOffset] != corners)
+                    {
+                        mixed = true;
+                        return;
+                    }
+                }
+                corner.read(records, faceStride, count, swap, dst + first * corners);
+            });
+            fixed = !mixed;
+        }
+        if (!fixed)
+        {
+            // another size somewhere: walked in order, polygons are fans, quads once some face has 4 corners
+            shape.triangles.clear();
+            shape.quads.clear();
+            bool hasQuads = false;
+            const uint8_t* record = faces;
+            for (size_t i = 0; i < face.count; i++)
+            {
+                if (record + listOffset >= end)
+                    return readError();
+                size_t count = record[listOffset];
+                hasQuads = hasQuads || count == 4;
+                record += listOffset + 1 + count * indexSize + afterList;
+                if (record > end)
+                    return readError();
+            }
+            auto gather = getGather<int>(indices->type, swap);
+            int polygon[255];
+            record = faces;
+            for (size_t i = 0; i < face.count; i++)
+            {
+                size_t count = record[listOffset];
+                gather(record + listOffset + 1, indexSize, count, polygon, 1);
+                record += listOffset + 1 + count * indexSize + afterList;
+                if (hasQuads && count == 4)
+                {
+                    shape.quads.push_back({polygon[0], polygon[1], polygon[2], polygon[3]});
+                    continue;
+                }
+                for (size_t c = 2; c < count; c++)
+                {
+                    if (hasQuads)
+                        shape.quads.push_back({polygon[0], polygon[c - 1], polygon[c], polygon[c]});
+                    else
+                        shape.triangles.push_back({polygon[0], polygon[c - 1], polygon[c]});
+                }
+            }
+        }
+        if (shape.triangles.empty() && shape.quads.empty())
+        {
+            shape = {};
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,133 @@
+#include "../include/ProgramCache.h"
+#include "../include/SceneCache.h"
+
+#include <algorithm>
+
+#ifndef CINDER_LESS
+#include <chrono>
+
+#include <cinder/Log.h>
+
+using namespace ci;
+#endif
+
+namespace melo
+{
+    namespace
+    {
+        // the length first, so that "ab" + "c" and "a" + "bc" differ
+        uint64_t hashString(const std::string& text, uint64_t seed)
+        {
+            uint64_t size = text.size();
+            return hashBytes(text.data(), text.size(), hashBytes(&size, sizeof(size), seed));
+        }
+    }
+
+    uint64_t hashProgramVariant(const std::vector<const std::string*>& sources,
+                                std::vector<std::pair<std::string, std::string>> defines,
+                                std::vector<std::string> bindings)
+    {
+        std::sort(defines.begin(), defines.end());
+        defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+        std::sort(bindings.begin(), bindings.end());
+        bindings.erase(std::unique(bindings.begin(), bindings.end()), bindings.end());
+
+        uint64_t counts[] = {sources.size(), defines.size(), bindings.size()};
+        uint64_t hash = hashBytes(counts, sizeof(counts));
+        for (const auto* source : sources)
+        {
+            uint8_t present = source ? 1 : 0;
+            hash = hashBytes(&present, sizeof(present), hash);
+            if (source)
+                hash = hashString(*source, hash);
+        }
+        for (const auto& define : defines)
+            hash = hashString(define.second, hashString(define.first, hash));
+        for (const auto& binding : bindings)
+            hash = hashString(binding, hash);
+        return hash;
+    }
+
+#ifndef CINDER_LESS
+    ProgramCacheRef ProgramCache::getDefault()
+    {
+        static ProgramCacheRef instance(new ProgramCache);
+        return instance;
+    }
+
+    uint64_t ProgramCache::getKey(const gl::GlslProg::Format& format)
+    {
+        std::vector<const std::string*> sources;
+        auto addStage = [&](const std::string& source) { sources.push_back(source.empty() ? nullptr : &source); };
+        addStage(format.getVertex());
+        addStage(format.getFragment());
+#if defined(CINDER_GL_HAS_GEOM_SHADER)
+        addStage(format.getGeometry());
+#endif
+#if defined(CINDER_GL_HAS_TESS_SHADER)
+        addStage(format.getTessellationCtrl());
+        addStage(format.getTessellationEval());
+#endif
+
+        // the label only names the program, it stays out of the key
+        std::vector<std::string> bindings;
+        bindings.push_back("version " + std::to_string(format.getVersion()));
+        bindings.push_back(format.isPreprocessingEnabled() ? "preprocess" : "raw");
+        for (const auto& attribute : format.getAttributes())
+        {
+            bindings.push_back("attrib " + attribute.mName + " " + std::to_string((int)attribute.mSemantic) + " " +
+                               std::to_string(attribute.mLoc));
+        }
+        for (const auto& uniform : format.getUniforms())
+            bindings.push_back("uniform " + uniform.mName + " " + std::to_string((int)uniform.mSemantic));
+        for (const auto& kv : format.getFragDataLocations())
+            bindings.push_back("output " + kv.first + " " + std::to_string(kv.second));
+#if !defined(CINDER_GL_ES_2)
+        // varyings keep their order in the buffer
+        const auto& varyings = format.getVaryings();
+        for (size_t i = 0; i < varyings.size(); i++)
+            bindings.push_back("varying " + std::to_string(i) + " " + varyings[i]);
+        if (!varyings.empty())
+            bindings.push_back("transform " + std::to_string(format.getTransformFormat()));
+#endif
+        return hashProgramVariant(sources, format.getDefines(), std::move(bindings));
+    }
+
+    gl::GlslProgRef ProgramCache::get(const gl::GlslProg::Format& format)
+    {
+        mStats.requestCount++;
+        uint64_t key = getKey(format);
+        auto it = mPrograms.find(key);
+        if (it != mPrograms.end())
+            return it->second;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        auto addCompile = [&] {
+            mStats.compileCount++;
+            mStats.compileMilliseconds +=
+                std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        };
+        gl::GlslProgRef program;
+        try
+        {
+            program = gl::GlslProg::create(format);
+        }
+        catch (...)
+        {
+            addCompile();
+            mStats.failureCount++;
+            throw;
+        }
+        addCompile();
+        CI_LOG_V("Compiled " << format.getLabel() << " (" << mPrograms.size() + 1 << " programs, "
+                 << mStats.compileMilliseconds << " ms)");
+        mPrograms[key] = program;
+        return program;
+    }
+
+    void ProgramCache::clear()
+    {
+        mPrograms.clear();
+    }
+#endif
+}
@@ -0,0 +1,357 @@
+#include "../include/RenderQueue.h"
+#include "../include/FrustumCuller.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#ifndef CINDER_LESS
+#include "cinder/gl/gl.h"
+using namespace ci;
+#endif
+
+namespace melo
+{
+    // the pass is in the top bits of every key, the rest depends on it
+    static constexpr int PASS_SHIFT = 61;
+
+    struct KeyLayout
+    {
+        int shaderShift, shaderBits;
+        int materialShift, materialBits;
+        int meshShift, meshBits;
+        int depthShift, depthBits; // no depth when 0 bits
+    };
+
+    // state first then front-to-back, as few state changes as the sort can give
+    static constexpr KeyLayout OPAQUE_LAYOUT = {50, 11, 34, 16, 18, 16, 0, 18};
+    // back-to-front first, the depth is stored inverted
+    static constexpr KeyLayout BLEND_LAYOUT = {28, 11, 14, 14, 0, 14, 39, 22};
+    // submission order in the low bits
+    static constexpr KeyLayout SEQUENCE_LAYOUT = {0, 0, 0, 0, 0, 0, 0, 0};
+
+    static const KeyLayout& getLayout(DrawOrder order)
+    {
+        switch (order)
+        {
+        case DRAW_SOLID:
+        case DRAW_SHADOW:
+            return OPAQUE_LAYOUT;
+        case DRAW_TRANSPARENCY:
+            return BLEND_LAYOUT;
+        default:
+            return SEQUENCE_LAYOUT;
+        }
+    }
+
+    static uint64_t packField(uint32_t value, int shift, int bits)
+    {
+        return bits ? (uint64_t)(value & ((1u << bits) - 1)) << shift : 0;
+    }
+
+    static uint32_t unpackField(uint64_t key, int shift, int bits)
+    {
+        return bits ? (uint32_t)(key >> shift) & ((1u << bits) - 1) : 0;
+    }
+
+    // the largest value of a field of bits marks ids that don't fit it, UINT32_MAX for a field the layout lacks
+    static uint32_t getOverflowId(int bits)
+    {
+        return bits ? (1u << bits) - 1 : UINT32_MAX;
+    }
+
+    // ids too large for the field all become its overflow id, which draw() always treats as a state change
+    static uint64_t packId(uint32_t id, int shift, int bits)
+    {
+        return packField(std::min(id, getOverflowId(bits)), shift, bits);
+    }
+
+    // ids 1 to the returned value fit the field in both sorted layouts
+    static uint32_t getIdLimit(int KeyLayout::*bits)
+    {
+        return getOverflowId(std::min(OPAQUE_LAYOUT.*bits, BLEND_LAYOUT.*bits)) - 1;
+    }
+
+    void RenderBackend::drawInstances(DrawOrder order, const DrawPacket* packets, uint32_t count,
+                                      const glm::mat4* /*transforms*/, uint32_t changes)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            drawPacket(order, packets[i], i == 0 ? changes : 0);
+    }
+
+#ifndef CINDER_LESS
+    void GlRenderBackend::beginPass(DrawOrder /*order*/)
+    {
+        gl::pushModelMatrix();
+    }
+
+    void GlRenderBackend::drawPacket(DrawOrder order, const DrawPacket& packet, uint32_t /*changes*/)
+    {
+        gl::setModelMatrix(packet.node->getWorldTransform());
+        packet.node->drawPacket(order, packet.item);
+    }
+
+    void GlRenderBackend::drawInstances(DrawOrder order, const DrawPacket* packets, uint32_t count,
+                                        const glm::mat4* transforms, uint32_t /*changes*/)
+    {
+        gl::setModelMatrix(transforms[0]);
+        packets[0].node->drawInstances(order, packets[0].item, transforms, count);
+    }
+
+    void GlRenderBackend::endPass(DrawOrder /*order*/)
+    {
+        gl::popModelMatrix();
+    }
+#endif
+
+    void RecordingRenderBackend::drawPacket(DrawOrder order, const DrawPacket& packet, uint32_t changes)
+    {
+        auto& counter = counters[order];
+        counter.drawCalls++;
+        counter.shaderChanges += (changes & CHANGE_SHADER) ? 1 : 0;
+        counter.materialChanges += (changes & CHANGE_MATERIAL) ? 1 : 0;
+        counter.meshChanges += (changes & CHANGE_MESH) ? 1 : 0;
+        packets[order].push_back(packet);
+    }
+
+    void RecordingRenderBackend::drawInstances(DrawOrder order, const DrawPacket* packets, uint32_t count,
+                                               const glm::mat4* /*transforms*/, uint32_t changes)
+    {
+        drawPacket(order, packets[0], changes);
+        counters[order].instancedDraws++;
+        counters[order].instances += count;
+        this->packets[order].insert(this->packets[order].end(), packets + 1, packets + count);
+    }
+
+    void RecordingRenderBackend::reset()
+    {
+        for (int order = 0; order < DRAW_ORDER_COUNT; order++)
+        {
+            counters[order] = {};
+            packets[order].clear();
+        }
+    }
+
+    RenderQueueRef RenderQueue::create()
+    {
+        return RenderQueueRef(new RenderQueue());
+    }
+
+    uint32_t RenderQueue::getId(IdTable& table, const void* pointer)
+    {
+        if (!pointer)
+            return 0;
+        auto it = table.ids.find(pointer);
+        if (it != table.ids.end())
+        {
+            it->second.build = mBuild;
+            return it->second.id;
+        }
+        // without free ids, the ids in use are 1 to ids.size()
+        uint32_t id = (uint32_t)table.ids.size() + 1;
+        if (!table.freeIds.empty())
+        {
+            id = table.freeIds.back();
+            table.freeIds.pop_back();
+        }
+        table.ids[pointer] = {id, mBuild};
+        return id;
+    }
+
+    void RenderQueue::pruneIds(IdTable& table, uint32_t limit)
+    {
+        if (table.ids.size() < limit)
+            return;
+        for (auto it = table.ids.begin(); it != table.ids.end();)
+        {
+            if (it->second.build + 1 < mBuild)
+            {
+                table.freeIds.push_back(it->second.id);
+                it = table.ids.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        // the smallest ids first, they fit the key fields
+        std::sort(table.freeIds.begin(), table.freeIds.end(), std::greater<uint32_t>());
+    }
+
+    uint32_t RenderQueue::getDepth(Node& node, uint32_t bits)
+    {
+        if (&node != mDepthNode)
+        {
+            mDepthNode = &node;
+            const auto& world = node.getWorldTransform();
+            glm::vec4 center = world[3];
+            const auto& boundsMin = node.mBoundBoxMin;
+            const auto& boundsMax = node.mBoundBoxMax;
+            if (boundsMin.x <= boundsMax.x && boundsMin.y <= boundsMax.y && boundsMin.z <= boundsMax.z &&
+                boundsMin != boundsMax)
+                center = world * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f);
+            // the camera looks down -z
+            mDepth = -(mView * center).z;
+            if (!(mDepth > 0))
+                mDepth = 0;
+        }
+
+        // the bits of a positive float grow with it, the sign bit is left out
+        uint32_t floatBits;
+        memcpy(&floatBits, &mDepth, sizeof(floatBits));
+        return floatBits >> (31 - bits);
+    }
+
+    void RenderQueue::build(const NodeRef& root, const glm::mat4& view, const FrustumCuller* culler)
+    {
+        // ids are only reused between builds, the packets of one build never share an id
+        mBuild++;
+        pruneIds(mShaderIds, getIdLimit(&KeyLayout::shaderBits));
+        pruneIds(mMaterialIds, getIdLimit(&KeyLayout::materialBits));
+        pruneIds(mMeshIds, getIdLimit(&KeyLayout::meshBits));
+        mInstanceKeys.clear();
+        mWideInstanceKeys.clear();
+
+        mPackets.clear();
+        mView = view;
+        mCuller = culler;
+        mSequence = 0;
+        mDepthNode = nullptr;
+        if (root)
+            root->treeSubmit(*this);
+
+        // packets with equal keys keep the tree order, from frame to frame
+        std::stable_sort(mPackets.begin(), mPackets.end(),
+                         [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+
+        for (int order = 0; order < DRAW_ORDER_COUNT; order++)
+        {
+            auto byKey = [](const DrawPacket& packet, uint64_t key) { return packet.key < key; };
+            mPassBegin[order] = std::lower_bound(mPackets.begin(), mPackets.end(), (uint64_t)order << PASS_SHIFT, byKey) -
+                                mPackets.begin();
+            mPassEnd[order] = std::lower_bound(mPackets.begin(), mPackets.end(), (uint64_t)(order + 1) << PASS_SHIFT,
+                                               byKey) - mPackets.begin();
+        }
+        buildBatches();
+
+        mCuller = nullptr;
+        mDepthNode = nullptr;
+    }
+
+    void RenderQueue::buildBatches()
+    {
+        mBatches.clear();
+        mInstanceTransforms.clear();
+        for (int order = 0; order < DRAW_ORDER_COUNT; order++)
+        {
+            mBatchBegin[order] = mBatches.size();
+            mInstancedDraws[order] = 0;
+            for (size_t i = mPassBegin[order]; i < mPassEnd[order];)
+            {
+                const auto& first = mPackets[i];
+                size_t end = i + 1;
+                if (mMinInstances > 0 && first.instanceKey)
+                {
+                    while (end < mPassEnd[order] && mPackets[end].instanceKey == first.instanceKey &&
+                           mPackets[end].item == first.item)
+                        end++;
+                }
+                if (end - i < std::max(mMinInstances, 2u))
+                {
+                    // packet by packet
+                    for (; i < end; i++)
+                        mBatches.push_back({(uint32_t)i, 1, 0});
+                    continue;
+                }
+
+                mBatches.push_back({(uint32_t)i, (uint32_t)(end - i), (uint32_t)mInstanceTransforms.size()});
+                for (; i < end; i++)
+                    mInstanceTransforms.push_back(mPackets[i].node->getWorldTransform());
+                mInstancedDraws[order]++;
+            }
+            mBatchEnd[order] = mBatches.size();
+        }
+    }
+
+    void RenderQueue::add(Node& node, DrawOrder order, const void* shader, const void* material, const void* mesh,
+                          uint32_t item, bool instanced)
+    {
+        if (order != DRAW_SHADOW && mCuller && !mCuller->isVisible(node))
+            return;
+
+        const auto& layout = getLayout(order);
+        uint64_t key = (uint64_t)order << PASS_SHIFT;
+        uint32_t instanceKey = 0;
+        if (&layout == &SEQUENCE_LAYOUT)
+        {
+            key |= mSequence++;
+        }
+        else
+        {
+            uint32_t shaderId = getId(mShaderIds, shader);
+            uint32_t materialId = getId(mMaterialIds, material);
+            uint32_t meshId = getId(mMeshIds, mesh);
+            key |= packId(shaderId, layout.shaderShift, layout.shaderBits);
+            key |= packId(materialId, layout.materialShift, layout.materialBits);
+            key |= packId(meshId, layout.meshShift, layout.meshBits);
+            uint32_t depth = getDepth(node, layout.depthBits);
+            if (order == DRAW_TRANSPARENCY)
+                depth = ((1u << layout.depthBits) - 1) - depth;
+            key |= packField(depth, layout.depthShift, layout.depthBits);
+
+            // the key saturates ids that don't fit, batches compare all of them
+            if (instanced)
+            {
+                uint32_t nextKey = (uint32_t)(mInstanceKeys.size() + mWideInstanceKeys.size() + 1);
+                if (std::max(shaderId, std::max(materialId, meshId)) < (1u << 21))
+                {
+                    uint64_t state = (uint64_t)shaderId << 42 | (uint64_t)materialId << 21 | meshId;
+                    instanceKey = mInstanceKeys.emplace(state, nextKey).first->second;
+                }
+                else
+                {
+                    auto state = std::make_tuple(shaderId, materialId, meshId);
+                    instanceKey = mWideInstanceKeys.emplace(state, nextKey).first->second;
+                }
+            }
+        }
+        mPackets.push_back({key, &node, item, instanceKey});
+    }
+
+    void RenderQueue::decodeState(DrawOrder order, uint64_t key, uint32_t* shader, uint32_t* material, uint32_t* mesh)
+    {
+        const auto& layout = getLayout(order);
+        *shader = unpackField(key, layout.shaderShift, layout.shaderBits);
+        *material = unpackField(key, layout.materialShift, layout.materialBits);
+        *mesh = unpackField(key, layout.meshShift, layout.meshBits);
+    }
+
+    void RenderQueue::draw(DrawOrder order, RenderBackend& backend) const
+    {
+        backend.beginPass(order);
+        const auto& layout = getLayout(order);
+        const uint32_t overflow[3] = {getOverflowId(layout.shaderBits), getOverflowId(layout.materialBits),
+                                      getOverflowId(layout.meshBits)};
+        uint32_t previous[3] = {};
+        for (size_t i = mBatchBegin[order]; i < mBatchEnd[order]; i++)
+        {
+            const auto& batch = mBatches[i];
+            const auto& packet = mPackets[batch.packet];
+            uint32_t state[3];
+            decodeState(order, packet.key, &state[0], &state[1], &state[2]);
+            uint32_t changes = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                // overflowing ids of different states look the same in the key
+                if (i == mBatchBegin[order] || state[k] != previous[k] || state[k] == overflow[k])
+                    changes |= (uint32_t)RenderBackend::CHANGE_SHADER << k;
+            }
+            if (batch.count > 1)
+                backend.drawInstances(order, &packet, batch.count, &mInstanceTransforms[batch.transform], changes);
+            else
+                backend.drawPacket(order, packet, changes);
+            std::copy(state, state + 3, previous);
+        }
+        backend.endPass(order);
+    }
+}
@@ -0,0 +1,561 @@
+#include "../include/SceneCache.h"
+#include "../3rdparty/tinygltf/json.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+namespace melo
+{
+    static const uint32_t kMagic = 0x434C454D; // "MELC"
+    static const size_t kAlignment = 64;
+    // the dependency list is a section of its own
+    static const uint32_t kDependencySection = 0xFFFFFFFF;
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+        uint64_t fileSize;
+        uint32_t sectionCount;
+        uint32_t reserved;
+    };
+
+    // size, modification time and length of the path, followed by the path
+    struct DependencyRecord
+    {
+        uint64_t size;
+        int64_t time;
+        uint32_t pathLength;
+    };
+
+    static bool getFileStamp(const std::string& path, uint64_t* size, int64_t* time)
+    {
+        std::error_code ec;
+        *size = (uint64_t)fs::file_size(path, ec);
+        if (ec)
+            return false;
+        *time = (int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+        return !ec;
+    }
+
+    static const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+    static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+    static const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+    static const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+    static const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+    static inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    static inline uint64_t read64(const uint8_t* p)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        return v;
+    }
+
+    static inline uint32_t read32(const uint8_t* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+
+    static inline uint64_t hashRound(uint64_t acc, uint64_t input)
+    {
+        acc += input * kPrime2;
+        return rotl(acc, 31) * kPrime1;
+    }
+
+    static inline uint64_t hashMerge(uint64_t acc, uint64_t value)
+    {
+        acc ^= hashRound(0, value);
+        return acc * kPrime1 + kPrime4;
+    }
+
+    uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+    {
+        auto p = (const uint8_t*)data;
+        auto end = p + size;
+        uint64_t h;
+        if (size >= 32)
+        {
+            uint64_t v1 = seed + kPrime1 + kPrime2;
+            uint64_t v2 = seed + kPrime2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - kPrime1;
+            for (; p + 32 <= end; p += 32)
+            {
+                v1 = hashRound(v1, read64(p));
+                v2 = hashRound(v2, read64(p + 8));
+                v3 = hashRound(v3, read64(p + 16));
+                v4 = hashRound(v4, read64(p + 24));
+            }
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = hashMerge(h, v1);
+            h = hashMerge(h, v2);
+            h = hashMerge(h, v3);
+            h = hashMerge(h, v4);
+        }
+        else
+        {
+            h = seed + kPrime5;
+        }
+        h += (uint64_t)size;
+
+        for (; p + 8 <= end; p += 8)
+            h = rotl(h ^ hashRound(0, read64(p)), 27) * kPrime1 + kPrime4;
+        if (p + 4 <= end)
+        {
+            h = rotl(h ^ (read32(p) * kPrime1), 23) * kPrime2 + kPrime3;
+            p += 4;
+        }
+        for (; p < end; p++)
+            h = rotl(h ^ (*p * kPrime5), 11) * kPrime1;
+
+        h ^= h >> 33;
+        h *= kPrime2;
+        h ^= h >> 29;
+        h *= kPrime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    bool parseGlb(const uint8_t* data, size_t size, const char** json, size_t* jsonSize, const uint8_t** bin,
+                  size_t* binSize)
+    {
+        // header: magic, version, length | chunk 0: length, "JSON" | chunk 1: length, "BIN\0"
+        uint32_t header[5];
+        if (size < sizeof(header))
+            return false;
+        memcpy(header, data, sizeof(header));
+        if (header[0] != 0x46546C67 || header[2] > size || header[4] != 0x4E4F534A ||
+            20 + (size_t)header[3] > header[2])
+            return false;
+        *json = (const char*)data + 20;
+        *jsonSize = header[3];
+        *bin = nullptr;
+        *binSize = 0;
+        size_t binChunk = 20 + ((*jsonSize + 3) & ~size_t(3));
+        if (binChunk + 8 <= header[2])
+        {
+            uint32_t chunk[2];
+            memcpy(chunk, data + binChunk, sizeof(chunk));
+            if (chunk[1] == 0x004E4942 && binChunk + 8 + chunk[0] <= header[2])
+            {
+                *bin = data + binChunk + 8;
+                *binSize = chunk[0];
+            }
+        }
+        return true;
+    }
+
+    std::string decodeUri(const std::string& uri)
+    {
+        std::string result;
+        for (size_t i = 0; i < uri.size(); i++)
+        {
+            // a '%' without two hex digits after it is kept as it is
+            if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((unsigned char)uri[i + 1]) &&
+                isxdigit((unsigned char)uri[i + 2]))
+            {
+                result += (char)std::stoi(uri.substr(i + 1, 2), nullptr, 16);
+                i += 2;
+            }
+            else
+            {
+                result += uri[i];
+            }
+        }
+        return result;
+    }
+
+    // the words after keyword at the start of a line (after blanks), e.g. the files of "mtllib a.mtl b.mtl"
+    static void findStatements(const char* text, size_t size, const char* keyword,
+                               std::vector<std::vector<std::string>>* statements)
+    {
+        std::string_view view(text, size);
+        size_t length = strlen(keyword);
+        for (size_t at = view.find(keyword); at != std::string_view::npos; at = view.find(keyword, at + length))
+        {
+            size_t lineStart = at;
+            while (lineStart > 0 && (view[lineStart - 1] == ' ' || view[lineStart - 1] == '\t'))
+                lineStart--;
+            if ((lineStart > 0 && view[lineStart - 1] != '\n') || at + length >= size ||
+                (view[at + length] != ' ' && view[at + length] != '\t'))
+                continue;
+
+            auto& words = statements->emplace_back();
+            size_t end = std::min(view.find('\n', at), size);
+            for (size_t i = at + length; i < end;)
+            {
+                while (i < end && isspace((unsigned char)view[i]))
+                    i++;
+                size_t wordStart = i;
+                while (i < end && !isspace((unsigned char)view[i]))
+                    i++;
+                if (i > wordStart)
+                    words.emplace_back(view.substr(wordStart, i - wordStart));
+            }
+        }
+    }
+
+    // the material libraries of an .obj and the textures they reference, relative to the .obj like ObjParser reads
+    // them
+    static void findObjDependencies(const char* text, size_t size, const fs::path& folder,
+                                    std::vector<std::string>* dependencies)
+    {
+        std::vector<std::vector<std::string>> libraries;
+        findStatements(text, size, "mtllib", &libraries);
+        for (const auto& library : libraries)
+        {
+            for (const auto& name : library)
+            {
+                auto mtlPath = (folder / name).string();
+                dependencies->push_back(mtlPath);
+                auto mtl = MappedFile::create(mtlPath);
+                if (!mtl)
+                    continue;
+
+                // the texture is the last word, after the options
+                std::vector<std::vector<std::string>> textures;
+                for (auto keyword : {"map_Ka", "map_Kd", "map_Ks", "map_Ke", "map_Ns", "map_d", "map_bump", "map_Bump",
+                                     "bump", "disp", "decal", "refl", "norm", "map_Pr", "map_Pm", "map_Ps"})
+                    findStatements((const char*)mtl->getData(), mtl->getSize(), keyword, &textures);
+                for (const auto& texture : textures)
+                {
+                    if (!texture.empty())
+                        dependencies->push_back((folder / texture.back()).string());
+                }
+            }
+        }
+    }
+
+    uint64_t hashSceneSource(const std::string& path, std::vector<std::string>* dependencies)
+    {
+        auto file = MappedFile::create(path);
+        if (!file)
+            return 0;
+
+        const char* json = nullptr;
+        size_t jsonSize = 0;
+        const uint8_t* bin;
+        size_t binSize;
+        auto extension = fs::path(path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == ".gltf")
+        {
+            json = (const char*)file->getData();
+            jsonSize = file->getSize();
+        }
+        else if (!parseGlb(file->getData(), file->getSize(), &json, &jsonSize, &bin, &binSize))
+        {
+            json = nullptr;
+        }
+
+        if (dependencies)
+            dependencies->assign(1, path);
+
+        if (!json)
+        {
+            if (dependencies && extension == ".obj")
+                findObjDependencies((const char*)file->getData(), file->getSize(), fs::path(path).parent_path(),
+                                    dependencies);
+            return hashBytes(file->getData(), file->getSize());
+        }
+
+        if (dependencies)
+        {
+            auto doc = nlohmann::json::parse(json, json + jsonSize, nullptr, false);
+            auto folder = fs::path(path).parent_path();
+            for (auto key : {"buffers", "images"})
+            {
+                auto items = doc.is_object() ? doc.find(key) : doc.end();
+                if (items == doc.end() || !items->is_array())
+                    continue;
+                for (auto& item : *items)
+                {
+                    std::string uri = item.is_object() ? item.value("uri", "") : "";
+                    if (!uri.empty() && uri.find("data:") != 0)
+                        dependencies->push_back((folder / decodeUri(uri)).string());
+                }
+            }
+        }
+        return hashBytes(json, jsonSize);
+    }
+
+    bool isCacheableScene(const std::string& path)
+    {
+        auto extension = fs::path(path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == ".gltf" || extension == ".glb" || extension == ".obj" || extension == ".ply" ||
+               extension == ".stl";
+    }
+
+    std::string SceneCache::getCachePath(const std::string& sourcePath, const std::string& cacheDir)
+    {
+        if (cacheDir.empty())
+            return sourcePath + ".melocache";
+
+        std::error_code ec;
+        auto absolute = fs::absolute(sourcePath, ec).generic_string();
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)hashBytes(absolute.data(), absolute.size()));
+        auto name = fs::path(sourcePath).filename().string() + "-" + hash + ".melocache";
+        return (fs::path(cacheDir) / name).string();
+    }
+
+    SceneCacheRef SceneCache::open(const std::string& path, uint64_t sourceHash)
+    {
+        std::error_code ec;
+        if (!fs::exists(path, ec))
+            return {};
+        auto file = MappedFile::create(path);
+        if (!file || file->getSize() < sizeof(CacheHeader))
+            return {};
+
+        CacheHeader header;
+        memcpy(&header, file->getData(), sizeof(header));
+        if (header.magic != kMagic || header.version != VERSION || header.sourceHash != sourceHash ||
+            header.fileSize != file->getSize() ||
+            sizeof(CacheHeader) + header.sectionCount * sizeof(Section) > file->getSize())
+            return {};
+
+        SceneCacheRef ref(new SceneCache());
+        ref->mFile = file;
+        ref->mSections = (const Section*)(file->getData() + sizeof(CacheHeader));
+        ref->mSectionCount = header.sectionCount;
+        for (size_t i = 0; i < ref->mSectionCount; i++)
+        {
+            const auto& section = ref->mSections[i];
+            if (section.offset > file->getSize() || section.size > file->getSize() - section.offset)
+                return {};
+        }
+
+        size_t size = 0;
+        auto p = ref->getSection(kDependencySection, 0, &size);
+        auto end = p + size;
+        while (p && p + sizeof(DependencyRecord) <= end)
+        {
+            DependencyRecord record;
+            memcpy(&record, p, sizeof(record));
+            p += sizeof(record);
+            if (record.pathLength > (size_t)(end - p))
+                return {};
+            std::string dependency((const char*)p, record.pathLength);
+            p += record.pathLength;
+
+            uint64_t fileSize;
+            int64_t time;
+            if (!getFileStamp(dependency, &fileSize, &time) || fileSize != record.size || time != record.time)
+                return {};
+        }
+
+        file->prefetch();
+        return ref;
+    }
+
+    const uint8_t* SceneCache::getSection(uint32_t kind, uint32_t index, size_t* size) const
+    {
+        auto end = mSections + mSectionCount;
+        auto it = std::lower_bound(mSections, end, std::make_pair(kind, index), [](const Section& a, const auto& b) {
+            return a.kind < b.first || (a.kind == b.first && a.index < b.second);
+        });
+        if (it == end || it->kind != kind || it->index != index)
+            return nullptr;
+        if (size)
+            *size = it->size;
+        return mFile->getData() + it->offset;
+    }
+
+    void SceneCacheWriter::addDependency(const std::string& path) { mDependencies.push_back(path); }
+
+    void SceneCacheWriter::addSectionRef(uint32_t kind, uint32_t index, const void* data, size_t size)
+    {
+        for (auto& entry : mEntries)
+        {
+            if (entry.kind == kind && entry.index == index)
+            {
+                entry = {kind, index, data, size, nullptr};
+                return;
+            }
+        }
+        mEntries.push_back({kind, index, data, size, nullptr});
+    }
+
+    void SceneCacheWriter::addSection(uint32_t kind, uint32_t index, const void* data, size_t size)
+    {
+        addSection(kind, index, std::vector<uint8_t>((const uint8_t*)data, (const uint8_t*)data + size));
+    }
+
+    void SceneCacheWriter::addSection(uint32_t kind, uint32_t index, std::vector<uint8_t>&& data)
+    {
+        auto bytes = std::make_shared<std::vector<uint8_t>>(std::move(data));
+        addSectionRef(kind, index, bytes->data(), bytes->size());
+        for (auto& entry : mEntries)
+        {
+            if (entry.kind == kind && entry.index == index)
+                entry.bytes = bytes;
+        }
+    }
+
+    bool SceneCacheWriter::write(const std::string& path) const
+    {
+        std::vector<uint8_t> dependencies;
+        for (auto& dependency : mDependencies)
+        {
+            DependencyRecord record = {};
+            if (!getFileStamp(dependency, &record.size, &record.time))
+                return false;
+            record.pathLength = (uint32_t)dependency.size();
+            auto p = (const uint8_t*)&record;
+            dependencies.insert(dependencies.end(), p, p + sizeof(record));
+            dependencies.insert(dependencies.end(), dependency.begin(), dependency.end());
+        }
+
+        std::vector<const Entry*> entries;
+        for (auto& entry : mEntries)
+            entries.push_back(&entry);
+        Entry dependencyEntry = {kDependencySection, 0, dependencies.data(), dependencies.size(), nullptr};
+        entries.push_back(&dependencyEntry);
+        std::sort(entries.begin(), entries.end(), [](const Entry* a, const Entry* b) {
+            return a->kind < b->kind || (a->kind == b->kind && a->index < b->index);
+        });
+
+        auto align = [](uint64_t offset) { return (offset + kAlignment - 1) & ~uint64_t(kAlignment - 1); };
+        std::vector<SceneCache::Section> sections(entries.size());
+        uint64_t offset = align(sizeof(CacheHeader) + sections.size() * sizeof(SceneCache::Section));
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            sections[i] = {entries[i]->kind, entries[i]->index, offset, entries[i]->size};
+            offset = align(offset + entries[i]->size);
+        }
+
+        CacheHeader header = {};
+        header.magic = kMagic;
+        header.version = SceneCache::VERSION;
+        header.sourceHash = mSourceHash;
+        header.fileSize = offset;
+        header.sectionCount = (uint32_t)sections.size();
+
+        std::error_code ec;
+        auto folder = fs::path(path).parent_path();
+        if (!folder.empty())
+            fs::create_directories(folder, ec);
+
+        auto tmpPath = path + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            static const char kPadding[kAlignment] = {};
+            uint64_t written = 0;
+            auto put = [&](const void* data, size_t size) {
+                out.write((const char*)data, size);
+                written += size;
+            };
+            auto pad = [&](uint64_t to) { put(kPadding, to - written); };
+
+            put(&header, sizeof(header));
+            put(sections.data(), sections.size() * sizeof(SceneCache::Section));
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                pad(sections[i].offset);
+                put(entries[i]->data, entries[i]->size);
+            }
+            pad(header.fileSize);
+            if (!out.good())
+            {
+                out.close();
+                fs::remove(tmpPath, ec);
+                return false;
+            }
+        }
+
+        fs::rename(tmpPath, path, ec);
+        if (ec)
+        {
+            fs::remove(tmpPath, ec);
+            return false;
+        }
+        return true;
+    }
+
+    void addCachedImage(SceneCacheWriter& writer, uint32_t kind, uint32_t index, const uint8_t* pixels,
+                        uint32_t width, uint32_t height, uint32_t components)
+    {
+        CachedImage image;
+        image.width = width;
+        image.height = height;
+        image.components = components;
+
+        uint32_t levelCount = 1;
+        while ((width >> levelCount) > 0 || (height >> levelCount) > 0)
+            levelCount++;
+
+        size_t size = 4 * sizeof(uint32_t);
+        for (uint32_t level = 0; level < levelCount; level++)
+            size += (size_t)image.getLevelWidth(level) * image.getLevelHeight(level) * components;
+
+        std::vector<uint8_t> bytes(size);
+        uint32_t header[4] = {width, height, components, levelCount};
+        memcpy(bytes.data(), header, sizeof(header));
+        uint8_t* dst = bytes.data() + sizeof(header);
+        memcpy(dst, pixels, (size_t)width * height * components);
+
+        for (uint32_t level = 1; level < levelCount; level++)
+        {
+            const uint8_t* src = dst;
+            uint32_t srcWidth = image.getLevelWidth(level - 1);
+            uint32_t srcHeight = image.getLevelHeight(level - 1);
+            dst += (size_t)srcWidth * srcHeight * components;
+            uint32_t dstWidth = image.getLevelWidth(level);
+            uint32_t dstHeight = image.getLevelHeight(level);
+            for (uint32_t y = 0; y < dstHeight; y++)
+            {
+                // the odd last row / column of the source is dropped, 1 pixel wide sources repeat themselves
+                const uint8_t* row0 = src + (size_t)std::min(2 * y, srcHeight - 1) * srcWidth * components;
+                const uint8_t* row1 = src + (size_t)std::min(2 * y + 1, srcHeight - 1) * srcWidth * components;
+                uint8_t* out = dst + (size_t)y * dstWidth * components;
+                for (uint32_t x = 0; x < dstWidth; x++)
+                {
+                    size_t x0 = std::min(2 * x, srcWidth - 1) * components;
+                    size_t x1 = std::min(2 * x + 1, srcWidth - 1) * components;
+                    for (uint32_t c = 0; c < components; c++)
+                        out[x * components + c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+                }
+            }
+        }
+        writer.addSection(kind, index, std::move(bytes));
+    }
+
+    bool getCachedImage(const SceneCache& cache, uint32_t kind, uint32_t index, CachedImage* image)
+    {
+        size_t size = 0;
+        auto data = cache.getSection(kind, index, &size);
+        uint32_t header[4];
+        if (!data || size < sizeof(header))
+            return false;
+        memcpy(header, data, sizeof(header));
+        image->width = header[0];
+        image->height = header[1];
+        image->components = header[2];
+        image->levels.clear();
+
+        size_t offset = sizeof(header);
+        for (uint32_t level = 0; level < header[3]; level++)
+        {
+            size_t levelSize = (size_t)image->getLevelWidth(level) * image->getLevelHeight(level) * image->components;
+            if (offset + levelSize > size)
+                return false;
+            image->levels.push_back(data + offset);
+            offset += levelSize;
+        }
+        return !image->levels.empty();
+    }
+}
@@ -0,0 +1,246 @@
+#include "../include/Skinning.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MELO_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MELO_SSE2
+#endif
+
+namespace melo
+{
+    DualQuat toDualQuat(const glm::mat4& rigid)
+    {
+        // rotation of the normalized basis, m[col][row]
+        glm::vec3 c0 = glm::normalize(glm::vec3(rigid[0]));
+        glm::vec3 c1 = glm::normalize(glm::vec3(rigid[1]));
+        glm::vec3 c2 = glm::normalize(glm::vec3(rigid[2]));
+        glm::vec4 q;
+        float trace = c0.x + c1.y + c2.z;
+        if (trace > 0)
+        {
+            float s = std::sqrt(trace + 1) * 2;
+            q = glm::vec4((c1.z - c2.y) / s, (c2.x - c0.z) / s, (c0.y - c1.x) / s, 0.25f * s);
+        }
+        else if (c0.x > c1.y && c0.x > c2.z)
+        {
+            float s = std::sqrt(1 + c0.x - c1.y - c2.z) * 2;
+            q = glm::vec4(0.25f * s, (c1.x + c0.y) / s, (c2.x + c0.z) / s, (c1.z - c2.y) / s);
+        }
+        else if (c1.y > c2.z)
+        {
+            float s = std::sqrt(1 + c1.y - c0.x - c2.z) * 2;
+            q = glm::vec4((c1.x + c0.y) / s, 0.25f * s, (c2.y + c1.z) / s, (c2.x - c0.z) / s);
+        }
+        else
+        {
+            float s = std::sqrt(1 + c2.z - c0.x - c1.y) * 2;
+            q = glm::vec4((c2.x + c0.z) / s, (c2.y + c1.z) / s, 0.25f * s, (c0.y - c1.x) / s);
+        }
+        q = glm::normalize(q);
+
+        // dual = 0.5 * (t, 0) * real
+        glm::vec3 t(rigid[3]);
+        glm::vec3 axis(q);
+        glm::vec3 dual = t * q.w + glm::cross(t, axis);
+        return {q, glm::vec4(dual, -glm::dot(t, axis)) * 0.5f};
+    }
+
+    void SkinningPalette::update(const glm::mat4* jointWorldTransforms, const glm::mat4* inverseBindMatrices,
+                                 size_t jointCount, const glm::mat4& meshWorldTransform, SkinningMethod method)
+    {
+        glm::mat4 meshInverse = glm::inverse(meshWorldTransform);
+        matrices.resize(jointCount);
+        for (size_t i = 0; i < jointCount; i++)
+        {
+            matrices[i] = meshInverse * jointWorldTransforms[i];
+            if (inverseBindMatrices)
+                matrices[i] = matrices[i] * inverseBindMatrices[i];
+        }
+
+        dualQuats.clear();
+        if (method == SKINNING_DUAL_QUATERNION)
+        {
+            dualQuats.resize(jointCount);
+            for (size_t i = 0; i < jointCount; i++)
+                dualQuats[i] = toDualQuat(matrices[i]);
+        }
+    }
+
+    static void skinLinear(const SkinningInput& input, const glm::mat4* matrices, size_t first, size_t count,
+                           glm::vec3* positions, glm::vec3* normals)
+    {
+        for (size_t v = first; v < first + count; v++)
+        {
+            const glm::uvec4& joint = input.joints[v];
+            const glm::vec4& weight = input.weights[v];
+            const glm::vec3& p = input.positions[v];
+            alignas(16) float position[4];
+            alignas(16) float normal[4];
+#if defined(MELO_AVX2)
+            // columns 0 | 1 and 2 | 3 of the blended matrix
+            const float* m0 = &matrices[joint.x][0][0];
+            const float* m1 = &matrices[joint.y][0][0];
+            const float* m2 = &matrices[joint.z][0][0];
+            const float* m3 = &matrices[joint.w][0][0];
+            __m256 w0 = _mm256_set1_ps(weight.x), w1 = _mm256_set1_ps(weight.y);
+            __m256 w2 = _mm256_set1_ps(weight.z), w3 = _mm256_set1_ps(weight.w);
+            __m256 c01 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(m0), w0), _mm256_mul_ps(_mm256_loadu_ps(m1), w1)),
+                                       _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(m2), w2), _mm256_mul_ps(_mm256_loadu_ps(m3), w3)));
+            __m256 c23 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(m0 + 8), w0), _mm256_mul_ps(_mm256_loadu_ps(m1 + 8), w1)),
+                                       _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(m2 + 8), w2), _mm256_mul_ps(_mm256_loadu_ps(m3 + 8), w3)));
+            // c0 * x + c1 * y | c2 * z + c3, then the two halves summed
+            __m256 xy = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(p.x)), _mm_set1_ps(p.y), 1);
+            __m256 z1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(p.z)), _mm_set1_ps(1.0f), 1);
+            __m256 sum = _mm256_add_ps(_mm256_mul_ps(c01, xy), _mm256_mul_ps(c23, z1));
+            _mm_store_ps(position, _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1)));
+            if (normals)
+            {
+                const glm::vec3& n = input.normals[v];
+                __m256 nxy = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(n.x)), _mm_set1_ps(n.y), 1);
+                __m256 nz0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(n.z)), _mm_setzero_ps(), 1);
+                sum = _mm256_add_ps(_mm256_mul_ps(c01, nxy), _mm256_mul_ps(c23, nz0));
+                _mm_store_ps(normal, _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1)));
+            }
+#elif defined(MELO_SSE2)
+            __m128 w[4] = {_mm_set1_ps(weight.x), _mm_set1_ps(weight.y), _mm_set1_ps(weight.z), _mm_set1_ps(weight.w)};
+            const float* m[4] = {&matrices[joint.x][0][0], &matrices[joint.y][0][0], &matrices[joint.z][0][0],
+                                 &matrices[joint.w][0][0]};
+            __m128 c[4];
+            for (int k = 0; k < 4; k++)
+            {
+                c[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m[0] + k * 4), w[0]), _mm_mul_ps(_mm_loadu_ps(m[1] + k * 4), w[1])),
+                                  _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m[2] + k * 4), w[2]), _mm_mul_ps(_mm_loadu_ps(m[3] + k * 4), w[3])));
+            }
+            __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0], _mm_set1_ps(p.x)), _mm_mul_ps(c[1], _mm_set1_ps(p.y))),
+                                    _mm_add_ps(_mm_mul_ps(c[2], _mm_set1_ps(p.z)), c[3]));
+            _mm_store_ps(position, sum);
+            if (normals)
+            {
+                const glm::vec3& n = input.normals[v];
+                sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0], _mm_set1_ps(n.x)), _mm_mul_ps(c[1], _mm_set1_ps(n.y))),
+                                 _mm_mul_ps(c[2], _mm_set1_ps(n.z)));
+                _mm_store_ps(normal, sum);
+            }
+#else
+            glm::mat4 m = matrices[joint.x] * weight.x + matrices[joint.y] * weight.y + matrices[joint.z] * weight.z +
+                          matrices[joint.w] * weight.w;
+            glm::vec4 skinned = m * glm::vec4(p, 1.0f);
+            std::copy(&skinned.x, &skinned.x + 4, position);
+            if (normals)
+            {
+                skinned = m * glm::vec4(input.normals[v], 0.0f);
+                std::copy(&skinned.x, &skinned.x + 4, normal);
+            }
+#endif
+            positions[v] = glm::vec3(position[0], position[1], position[2]);
+            if (normals)
+                normals[v] = glm::normalize(glm::vec3(normal[0], normal[1], normal[2]));
+        }
+    }
+
+    static void skinDualQuat(const SkinningInput& input, const DualQuat* dualQuats, size_t first, size_t count,
+                             glm::vec3* positions, glm::vec3* normals)
+    {
+        for (size_t v = first; v < first + count; v++)
+        {
+            const glm::uvec4& joint = input.joints[v];
+            const glm::vec4& weight = input.weights[v];
+            const DualQuat* dq[4] = {&dualQuats[joint.x], &dualQuats[joint.y], &dualQuats[joint.z], &dualQuats[joint.w]};
+            // blend in the hemisphere of the first joint, q and -q are the same rotation
+            float signedWeights[4] = {weight.x, weight.y, weight.z, weight.w};
+            for (int i = 1; i < 4; i++)
+            {
+                if (glm::dot(dq[i]->real, dq[0]->real) < 0)
+                    signedWeights[i] = -signedWeights[i];
+            }
+
+            alignas(16) float blended[8];
+#if defined(MELO_AVX2)
+            __m256 sum = _mm256_mul_ps(_mm256_loadu_ps(&dq[0]->real.x), _mm256_set1_ps(signedWeights[0]));
+            for (int i = 1; i < 4; i++)
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(&dq[i]->real.x), _mm256_set1_ps(signedWeights[i])));
+            _mm256_store_ps(blended, sum);
+#elif defined(MELO_SSE2)
+            __m128 sumReal = _mm_mul_ps(_mm_loadu_ps(&dq[0]->real.x), _mm_set1_ps(signedWeights[0]));
+            __m128 sumDual = _mm_mul_ps(_mm_loadu_ps(&dq[0]->dual.x), _mm_set1_ps(signedWeights[0]));
+            for (int i = 1; i < 4; i++)
+            {
+                __m128 wi = _mm_set1_ps(signedWeights[i]);
+                sumReal = _mm_add_ps(sumReal, _mm_mul_ps(_mm_loadu_ps(&dq[i]->real.x), wi));
+                sumDual = _mm_add_ps(sumDual, _mm_mul_ps(_mm_loadu_ps(&dq[i]->dual.x), wi));
+            }
+            _mm_store_ps(blended, sumReal);
+            _mm_store_ps(blended + 4, sumDual);
+#else
+            std::fill(blended, blended + 8, 0.0f);
+            for (int i = 0; i < 4; i++)
+            {
+                for (int k = 0; k < 4; k++)
+                {
+                    blended[k] += (&dq[i]->real.x)[k] * signedWeights[i];
+                    blended[k + 4] += (&dq[i]->dual.x)[k] * signedWeights[i];
+                }
+            }
+#endif
+            // rigid transform of the blended dual quaternion, the 1 / |real|^2 normalization is folded in
+            float x = blended[0], y = blended[1], z = blended[2], w = blended[3];
+            float dx = blended[4], dy = blended[5], dz = blended[6], dw = blended[7];
+            float scale = 1.0f / (x * x + y * y + z * z + w * w);
+            float s2 = 2 * scale;
+            float r00 = 1 - s2 * (y * y + z * z), r01 = s2 * (x * y - w * z), r02 = s2 * (x * z + w * y);
+            float r10 = s2 * (x * y + w * z), r11 = 1 - s2 * (x * x + z * z), r12 = s2 * (y * z - w * x);
+            float r20 = s2 * (x * z - w * y), r21 = s2 * (y * z + w * x), r22 = 1 - s2 * (x * x + y * y);
+            // 2 * dual * conjugate(real)
+            float tx = s2 * (w * dx - dw * x + y * dz - z * dy);
+            float ty = s2 * (w * dy - dw * y + z * dx - x * dz);
+            float tz = s2 * (w * dz - dw * z + x * dy - y * dx);
+
+            const glm::vec3& p = input.positions[v];
+            positions[v] = glm::vec3(r00 * p.x + r01 * p.y + r02 * p.z + tx, r10 * p.x + r11 * p.y + r12 * p.z + ty,
+                                     r20 * p.x + r21 * p.y + r22 * p.z + tz);
+            if (normals)
+            {
+                const glm::vec3& n = input.normals[v];
+                normals[v] = glm::vec3(r00 * n.x + r01 * n.y + r02 * n.z, r10 * n.x + r11 * n.y + r12 * n.z,
+                                       r20 * n.x + r21 * n.y + r22 * n.z);
+            }
+        }
+    }
+
+    void skinVertices(const SkinningInput& input, const SkinningPalette& palette, SkinningMethod method, size_t first,
+                      size_t count, glm::vec3* positions, glm::vec3* normals)
+    {
+        if (!input.normals)
+            normals = nullptr;
+        if (method == SKINNING_DUAL_QUATERNION && !palette.dualQuats.empty())
+            skinDualQuat(input, palette.dualQuats.data(), first, count, positions, normals);
+        else
+            skinLinear(input, palette.matrices.data(), first, count, positions, normals);
+    }
+
+    void skinVertices(const SkinningInput& input, const SkinningPalette& palette, SkinningMethod method,
+                      glm::vec3* positions, glm::vec3* normals, JobSystem* jobs, size_t chunkSize)
+    {
+        chunkSize = std::max(chunkSize, (size_t)1);
+        if (!jobs || input.vertexCount <= chunkSize)
+        {
+            skinVertices(input, palette, method, 0, input.vertexCount, positions, normals);
+            return;
+        }
+
+        std::vector<JobRef> chunks;
+        for (size_t first = 0; first < input.vertexCount; first += chunkSize)
+        {
+            size_t count = std::min(chunkSize, input.vertexCount - first);
+            chunks.push_back(jobs->add([&input, &palette, method, first, count, positions, normals] {
+                skinVertices(input, palette, method, first, count, positions, normals);
+            }));
+        }
+        jobs->wait(chunks);
+    }
+}
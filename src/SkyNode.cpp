@@ -1,5 +1,6 @@
 #include "SkyNode.h"
 #include "AssetManager.h"
+#include "RenderQueue.h"
 
 using namespace ci;
 
@@ -40,4 +41,16 @@ namespace melo
         mSkyBoxBatch->draw();
     }
 
+    void SkyNode::submitDraws(RenderQueue& queue)
+    {
+        queue.add(*this, mDrawOrder, skyBoxShader.get(), mSkyTex.get(), mSkyBoxBatch.get());
+    }
+
+    void SkyNode::drawPacket(DrawOrder order, uint32_t item)
+    {
+        // the uniforms treeDraw() sets from predraw()
+        predraw(order);
+        draw(order);
+    }
+
 }
@@ -0,0 +1,314 @@
+#include "../include/TransformSystem.h"
+#include "../include/JobSystem.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace melo
+{
+    TransformSystemRef TransformSystem::create()
+    {
+        return TransformSystemRef(new TransformSystem());
+    }
+
+    TransformSystemRef TransformSystem::getDefault()
+    {
+        static TransformSystemRef instance = create();
+        return instance;
+    }
+
+    TransformSystem::~TransformSystem() = default;
+
+    uint32_t TransformSystem::allocate()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        uint32_t index;
+        if (!mFreeSlots.empty())
+        {
+            index = mFreeSlots.back();
+            mFreeSlots.pop_back();
+        }
+        else
+        {
+            if (mSlotCount == mChunkCount * CHUNK_SIZE)
+            {
+                if (mChunkCount == MAX_CHUNKS)
+                    throw std::length_error("TransformSystem: too many transforms");
+                mChunks[mChunkCount++].reset(new Chunk());
+            }
+            index = mSlotCount++;
+        }
+
+        Chunk& chunk = getChunk(index);
+        uint32_t slot = index % CHUNK_SIZE;
+        chunk.local[slot] = glm::mat4(1);
+        chunk.world[slot] = glm::mat4(1);
+        chunk.parent[slot] = INVALID;
+        chunk.firstChild[slot] = INVALID;
+        chunk.prevSibling[slot] = INVALID;
+        chunk.nextSibling[slot] = INVALID;
+        chunk.parentVersion[slot] = 0;
+        chunk.verified[slot] = 0;
+        chunk.dirty[slot] = 1;
+        chunk.allocated[slot] = 1;
+        mChangeCount++;
+        mCount++;
+        mOrderChanged = true;
+        mHierarchyVersion++;
+        return index;
+    }
+
+    void TransformSystem::release(uint32_t index)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        unlink(index);
+        Chunk& chunk = getChunk(index);
+        for (uint32_t child = chunk.firstChild[index % CHUNK_SIZE]; child != INVALID;)
+        {
+            Chunk& childChunk = getChunk(child);
+            uint32_t next = childChunk.nextSibling[child % CHUNK_SIZE];
+            childChunk.parent[child % CHUNK_SIZE] = INVALID;
+            childChunk.prevSibling[child % CHUNK_SIZE] = INVALID;
+            childChunk.nextSibling[child % CHUNK_SIZE] = INVALID;
+            childChunk.dirty[child % CHUNK_SIZE] = 1;
+            child = next;
+        }
+        chunk.firstChild[index % CHUNK_SIZE] = INVALID;
+        chunk.allocated[index % CHUNK_SIZE] = 0;
+        mFreeSlots.push_back(index);
+        mChangeCount++;
+        mCount--;
+        mOrderChanged = true;
+        mHierarchyVersion++;
+    }
+
+    void TransformSystem::unlink(uint32_t index)
+    {
+        Chunk& chunk = getChunk(index);
+        uint32_t slot = index % CHUNK_SIZE;
+        uint32_t parent = chunk.parent[slot];
+        if (parent == INVALID)
+            return;
+
+        uint32_t prev = chunk.prevSibling[slot], next = chunk.nextSibling[slot];
+        if (prev != INVALID)
+            getChunk(prev).nextSibling[prev % CHUNK_SIZE] = next;
+        else
+            getChunk(parent).firstChild[parent % CHUNK_SIZE] = next;
+        if (next != INVALID)
+            getChunk(next).prevSibling[next % CHUNK_SIZE] = prev;
+        chunk.parent[slot] = INVALID;
+        chunk.prevSibling[slot] = INVALID;
+        chunk.nextSibling[slot] = INVALID;
+    }
+
+    void TransformSystem::setParent(uint32_t index, uint32_t parent)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Chunk& chunk = getChunk(index);
+        uint32_t slot = index % CHUNK_SIZE;
+        if (chunk.parent[slot] == parent)
+            return;
+
+        unlink(index);
+        if (parent != INVALID)
+        {
+            Chunk& parentChunk = getChunk(parent);
+            uint32_t first = parentChunk.firstChild[parent % CHUNK_SIZE];
+            chunk.parent[slot] = parent;
+            chunk.nextSibling[slot] = first;
+            if (first != INVALID)
+                getChunk(first).prevSibling[first % CHUNK_SIZE] = index;
+            parentChunk.firstChild[parent % CHUNK_SIZE] = index;
+        }
+        chunk.dirty[slot] = 1;
+        mChangeCount++;
+        mOrderChanged = true;
+        mHierarchyVersion++;
+    }
+
+    void TransformSystem::updateWorld(uint32_t index, uint32_t changeCount)
+    {
+        Chunk& chunk = getChunk(index);
+        uint32_t slot = index % CHUNK_SIZE;
+        chunk.verified[slot] = changeCount;
+        uint32_t parent = chunk.parent[slot];
+        if (parent == INVALID)
+        {
+            if (!chunk.dirty[slot])
+                return;
+            chunk.world[slot] = chunk.local[slot];
+            chunk.parentVersion[slot] = 0;
+        }
+        else
+        {
+            const Chunk& parentChunk = getChunk(parent);
+            uint32_t parentVersion = parentChunk.worldVersion[parent % CHUNK_SIZE];
+            if (!chunk.dirty[slot] && chunk.parentVersion[slot] == parentVersion)
+                return;
+            chunk.world[slot] = parentChunk.world[parent % CHUNK_SIZE] * chunk.local[slot];
+            chunk.parentVersion[slot] = parentVersion;
+        }
+        chunk.worldVersion[slot]++;
+        chunk.dirty[slot] = 0;
+    }
+
+    const glm::mat4& TransformSystem::getWorld(uint32_t index)
+    {
+        uint32_t changeCount = mChangeCount.load(std::memory_order_relaxed);
+        Chunk& chunk = getChunk(index);
+        if (chunk.verified[index % CHUNK_SIZE] == changeCount)
+            return chunk.world[index % CHUNK_SIZE];
+
+        // index and its ancestors up to the first verified one, then updated from the top down
+        uint32_t path[32];
+        size_t depth = 0;
+        std::vector<uint32_t> deepPath;
+        for (uint32_t ancestor = index; ancestor != INVALID; ancestor = getParent(ancestor))
+        {
+            if (getChunk(ancestor).verified[ancestor % CHUNK_SIZE] == changeCount)
+                break;
+            if (depth < 32)
+                path[depth++] = ancestor;
+            else
+                deepPath.push_back(ancestor);
+        }
+        for (auto it = deepPath.rbegin(); it != deepPath.rend(); ++it)
+            updateWorld(*it, changeCount);
+        while (depth > 0)
+            updateWorld(path[--depth], changeCount);
+        return chunk.world[index % CHUNK_SIZE];
+    }
+
+    void TransformSystem::rebuildOrder()
+    {
+        mOrder.clear();
+        mOrderPosition.assign(mSlotCount, INVALID);
+        mSubtreeSize.assign(mCount, 1);
+
+        // depth first from every root, the subtree sizes are summed back once a node's children are done
+        std::vector<uint32_t> stack, path;
+        for (uint32_t root = 0; root < mSlotCount; root++)
+        {
+            const Chunk& rootChunk = getChunk(root);
+            if (!rootChunk.allocated[root % CHUNK_SIZE] || rootChunk.parent[root % CHUNK_SIZE] != INVALID)
+                continue;
+            stack.push_back(root);
+            while (!stack.empty())
+            {
+                uint32_t index = stack.back();
+                stack.pop_back();
+                const Chunk& chunk = getChunk(index);
+                uint32_t parent = chunk.parent[index % CHUNK_SIZE];
+                // close the subtrees of path that index is not part of
+                while (!path.empty() && path.back() != parent)
+                {
+                    uint32_t done = mOrderPosition[path.back()];
+                    path.pop_back();
+                    if (!path.empty())
+                        mSubtreeSize[mOrderPosition[path.back()]] += mSubtreeSize[done];
+                }
+                mOrderPosition[index] = (uint32_t)mOrder.size();
+                mOrder.push_back(index);
+                path.push_back(index);
+                for (uint32_t child = chunk.firstChild[index % CHUNK_SIZE]; child != INVALID;
+                     child = getChunk(child).nextSibling[child % CHUNK_SIZE])
+                    stack.push_back(child);
+            }
+            while (!path.empty())
+            {
+                uint32_t done = mOrderPosition[path.back()];
+                path.pop_back();
+                if (!path.empty())
+                    mSubtreeSize[mOrderPosition[path.back()]] += mSubtreeSize[done];
+            }
+        }
+        mOrderChanged = false;
+    }
+
+    void TransformSystem::update(uint32_t root, JobSystem* jobs)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mOrderChanged)
+            rebuildOrder();
+        uint32_t changeCount = mChangeCount.load(std::memory_order_relaxed);
+
+        // ancestors of root first, the subtree is then self contained
+        uint32_t parent = getParent(root);
+        if (parent != INVALID)
+            getWorld(parent);
+
+        size_t begin = mOrderPosition[root];
+        size_t end = begin + mSubtreeSize[begin];
+        if (!jobs || end - begin < PARALLEL_MIN_COUNT)
+        {
+            for (size_t i = begin; i < end; i++)
+                updateWorld(mOrder[i], changeCount);
+            return;
+        }
+
+        // subtrees larger than grain are split: their root is updated here, in order, and their children
+        // become tasks. Sibling subtrees are then packed back into ranges of about grain transforms.
+        size_t grain = std::max<size_t>((end - begin) / ((jobs->getThreadCount() + 1) * 4), 1024);
+        std::vector<size_t> splits, stack = {begin};
+        std::vector<std::pair<size_t, size_t>> tasks;
+        while (!stack.empty())
+        {
+            size_t position = stack.back();
+            stack.pop_back();
+            size_t size = mSubtreeSize[position];
+            if (size <= grain)
+            {
+                tasks.push_back({position - begin, position - begin + size});
+                continue;
+            }
+            splits.push_back(position);
+            for (size_t child = position + 1; child < position + size; child += mSubtreeSize[child])
+                stack.push_back(child);
+        }
+
+        std::sort(splits.begin(), splits.end());
+        for (size_t position : splits)
+            updateWorld(mOrder[position], changeCount);
+
+        std::sort(tasks.begin(), tasks.end());
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (const auto& task : tasks)
+        {
+            if (!ranges.empty() && ranges.back().second == task.first && task.second - ranges.back().first <= grain)
+                ranges.back().second = task.second;
+            else
+                ranges.push_back(task);
+        }
+
+        // the jobs work on a copy of the order, the waiting thread may run jobs that allocate transforms
+        auto order = std::make_shared<std::vector<uint32_t>>(mOrder.begin() + begin, mOrder.begin() + end);
+        lock.unlock();
+
+        std::vector<JobRef> pending;
+        for (const auto& range : ranges)
+        {
+            pending.push_back(jobs->add([this, order, range, changeCount] {
+                for (size_t i = range.first; i < range.second; i++)
+                    updateWorld((*order)[i], changeCount);
+            }));
+        }
+        jobs->wait(pending);
+    }
+
+    void TransformSystem::update(JobSystem* jobs)
+    {
+        std::vector<uint32_t> roots;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (uint32_t index = 0; index < mSlotCount; index++)
+            {
+                const Chunk& chunk = getChunk(index);
+                if (chunk.allocated[index % CHUNK_SIZE] && chunk.parent[index % CHUNK_SIZE] == INVALID)
+                    roots.push_back(index);
+            }
+        }
+        for (uint32_t root : roots)
+            update(root, jobs);
+    }
+}
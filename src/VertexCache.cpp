@@ -0,0 +1,255 @@
+#include "../include/VertexCache.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace melo
+{
+    namespace
+    {
+        // a FIFO cache by timestamps: a vertex is in the cache while fewer than size misses followed its own
+        struct CacheSimulator
+        {
+            CacheSimulator(size_t vertexCount, uint32_t size) : stamps(vertexCount, 0), size(size), time(size + 1) {}
+
+            bool access(uint32_t vertex)
+            {
+                if (time - stamps[vertex] <= size)
+                    return false;
+                stamps[vertex] = time++;
+                return true;
+            }
+
+            uint32_t accessTriangle(const uint32_t* corners)
+            {
+                return (access(corners[0]) ? 1 : 0) + (access(corners[1]) ? 1 : 0) + (access(corners[2]) ? 1 : 0);
+            }
+
+            void flush() { time += size + 1; }
+
+            std::vector<uint32_t> stamps;
+            uint32_t size;
+            uint32_t time;
+        };
+    }
+
+    VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                        uint32_t cacheSize)
+    {
+        VertexCacheStats stats;
+        indexCount = indexCount / 3 * 3;
+        if (indexCount == 0 || vertexCount == 0)
+            return stats;
+
+        CacheSimulator cache(vertexCount, cacheSize);
+        std::vector<uint8_t> used(vertexCount, 0);
+        size_t usedCount = 0;
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            stats.vertexTransforms += cache.access(indices[i]) ? 1 : 0;
+            usedCount += used[indices[i]] ? 0 : 1;
+            used[indices[i]] = 1;
+        }
+        stats.acmr = (float)stats.vertexTransforms / (indexCount / 3);
+        stats.atvr = (float)stats.vertexTransforms / usedCount;
+        return stats;
+    }
+
+    void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                             uint32_t cacheSize)
+    {
+        indexCount = indexCount / 3 * 3;
+        if (indexCount == 0 || vertexCount == 0)
+            return;
+        std::vector<uint32_t> source(indices, indices + indexCount);
+        size_t triangleCount = indexCount / 3;
+
+        // triangles around every vertex, live counts the ones not emitted yet
+        std::vector<uint32_t> live(vertexCount, 0);
+        for (uint32_t index : source)
+            live[index]++;
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for (size_t i = 0; i < vertexCount; i++)
+            offsets[i + 1] = offsets[i] + live[i];
+        std::vector<uint32_t> triangles(indexCount);
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indexCount; i++)
+            triangles[fill[source[i]]++] = (uint32_t)(i / 3);
+
+        CacheSimulator cache(vertexCount, cacheSize);
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        std::vector<uint32_t> deadEnd, candidates;
+        deadEnd.reserve(indexCount);
+        size_t write = 0, cursor = 0;
+        int64_t fanning = source[0];
+        while (fanning >= 0)
+        {
+            // every triangle left around the fanning vertex
+            candidates.clear();
+            for (uint32_t i = offsets[fanning]; i < offsets[fanning + 1]; i++)
+            {
+                uint32_t triangle = triangles[i];
+                if (emitted[triangle])
+                    continue;
+                emitted[triangle] = 1;
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    uint32_t vertex = source[triangle * 3 + corner];
+                    destination[write++] = vertex;
+                    deadEnd.push_back(vertex);
+                    candidates.push_back(vertex);
+                    live[vertex]--;
+                    cache.access(vertex);
+                }
+            }
+
+            // the candidate that stays in the cache through its own fan and entered it the longest ago
+            fanning = -1;
+            int64_t bestPriority = -1;
+            for (uint32_t vertex : candidates)
+            {
+                if (live[vertex] == 0)
+                    continue;
+                int64_t age = cache.time - cache.stamps[vertex];
+                int64_t priority = age + 2 * live[vertex] <= cacheSize ? age : 0;
+                if (priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    fanning = vertex;
+                }
+            }
+
+            // dead end: the latest vertex with triangles left, else the next one in index order
+            while (fanning < 0 && !deadEnd.empty())
+            {
+                uint32_t vertex = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[vertex] > 0)
+                    fanning = vertex;
+            }
+            while (fanning < 0 && cursor < vertexCount)
+            {
+                if (live[cursor] > 0)
+                    fanning = (int64_t)cursor;
+                cursor++;
+            }
+        }
+    }
+
+    void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const glm::vec3* positions,
+                          size_t vertexCount, uint32_t cacheSize, float threshold)
+    {
+        indexCount = indexCount / 3 * 3;
+        if (indexCount == 0 || vertexCount == 0)
+            return;
+        std::vector<uint32_t> source(indices, indices + indexCount);
+        size_t triangleCount = indexCount / 3;
+
+        // hard boundaries where the cache starts over, a triangle missing all of its vertices
+        CacheSimulator cache(vertexCount, cacheSize);
+        std::vector<uint32_t> misses(triangleCount);
+        std::vector<uint32_t> hardStarts;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            misses[t] = cache.accessTriangle(&source[t * 3]);
+            if (t == 0 || misses[t] == 3)
+                hardStarts.push_back((uint32_t)t);
+        }
+        hardStarts.push_back((uint32_t)triangleCount);
+
+        // soft boundaries where a run from a cold cache has come within threshold of the ACMR of its hard cluster
+        std::vector<uint32_t> starts;
+        for (size_t h = 0; h + 1 < hardStarts.size(); h++)
+        {
+            uint32_t begin = hardStarts[h], end = hardStarts[h + 1];
+            double clusterAcmr = 0;
+            for (uint32_t t = begin; t < end; t++)
+                clusterAcmr += misses[t];
+            clusterAcmr /= end - begin;
+
+            cache.flush();
+            starts.push_back(begin);
+            uint32_t runStart = begin, runMisses = 0;
+            for (uint32_t t = begin; t < end; t++)
+            {
+                runMisses += cache.accessTriangle(&source[t * 3]);
+                if (t + 1 < end && runMisses <= threshold * clusterAcmr * (t - runStart + 1))
+                {
+                    starts.push_back(t + 1);
+                    cache.flush();
+                    runStart = t + 1;
+                    runMisses = 0;
+                }
+            }
+        }
+        size_t clusterCount = starts.size();
+        starts.push_back((uint32_t)triangleCount);
+
+        // area weighted centroids and normals
+        std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f)), normals(clusterCount, glm::vec3(0.0f));
+        std::vector<float> areas(clusterCount, 0.0f);
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0;
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            for (uint32_t t = starts[c]; t < starts[c + 1]; t++)
+            {
+                const glm::vec3& p0 = positions[source[t * 3]];
+                const glm::vec3& p1 = positions[source[t * 3 + 1]];
+                const glm::vec3& p2 = positions[source[t * 3 + 2]];
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float area = glm::length(normal);
+                centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+                normals[c] += normal;
+                areas[c] += area;
+            }
+            meshCentroid += centroids[c];
+            meshArea += areas[c];
+        }
+        if (meshArea > 0)
+            meshCentroid = meshCentroid / meshArea;
+
+        // clusters facing outwards far from the center first
+        std::vector<float> keys(clusterCount, 0.0f);
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            float normalLength = glm::length(normals[c]);
+            if (areas[c] > 0 && normalLength > 0)
+                keys[c] = glm::dot(centroids[c] / areas[c] - meshCentroid, normals[c] / normalLength);
+        }
+        std::vector<uint32_t> order(clusterCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+        size_t write = 0;
+        for (uint32_t c : order)
+        {
+            std::copy(source.begin() + starts[c] * 3, source.begin() + starts[c + 1] * 3, destination + write);
+            write += (starts[c + 1] - starts[c]) * 3;
+        }
+    }
+
+    void optimizeTriangleOrder(uint32_t* indices, size_t indexCount, const glm::vec3* positions, size_t vertexCount)
+    {
+        optimizeVertexCache(indices, indices, indexCount, vertexCount);
+        optimizeOverdraw(indices, indices, indexCount, positions, vertexCount);
+    }
+
+    size_t optimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+    {
+        std::fill(remap, remap + vertexCount, UINT32_MAX);
+        uint32_t next = 0;
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            if (remap[indices[i]] == UINT32_MAX)
+                remap[indices[i]] = next++;
+        }
+        return next;
+    }
+
+    void remapIndices(uint32_t* destination, const uint32_t* indices, size_t indexCount, const uint32_t* remap)
+    {
+        for (size_t i = 0; i < indexCount; i++)
+            destination[i] = remap[indices[i]];
+    }
+}
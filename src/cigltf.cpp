@@ -1,4 +1,8 @@
 #include "../include/cigltf.h"
+#include "../include/FrustumCuller.h"
+#include "../include/MeshoptDecoder.h"
+#include "../include/ProgramCache.h"
+#include "../include/RenderQueue.h"
 #ifndef CINDER_LESS
 #include "AssetManager.h"
 #include "cinder/Log.h"
@@ -17,10 +21,45 @@ using namespace ci;
 #define CI_LOG_E(msg) std::cout << msg
 #endif
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstring>
+#include "../3rdparty/tinygltf/json.hpp"
 
 using namespace std;
 using namespace melo;
 
+// Works for both the tinygltf owned and the mmap'ed buffers
+static const uint8_t* getBufferViewData(ModelGLTFRef modelGLTF, int bufferViewIndex)
+{
+    const tinygltf::BufferView& bufferView = modelGLTF->property.bufferViews[bufferViewIndex];
+    auto& cpuBuffer = modelGLTF->buffers[bufferView.buffer]->cpuBuffer;
+    return (const uint8_t*)cpuBuffer->getData() + bufferView.byteOffset;
+}
+
+static AccessorLayout getAccessorLayout(ModelGLTFRef modelGLTF, const tinygltf::Accessor& accessor)
+{
+    AccessorLayout layout;
+    if (accessor.bufferView != -1)
+    {
+        layout.data = getBufferViewData(modelGLTF, accessor.bufferView) + accessor.byteOffset;
+        layout.byteStride = modelGLTF->property.bufferViews[accessor.bufferView].byteStride;
+    }
+    layout.count = accessor.count;
+    layout.componentType = accessor.componentType;
+    int componentCount = tinygltf::GetNumComponentsInType(accessor.type);
+    layout.componentCount = componentCount > 0 ? componentCount : 0;
+    layout.normalized = accessor.normalized;
+    if (accessor.sparse.isSparse)
+    {
+        const auto& sparse = accessor.sparse;
+        layout.sparseCount = sparse.count;
+        layout.sparseIndices = getBufferViewData(modelGLTF, sparse.indices.bufferView) + sparse.indices.byteOffset;
+        layout.sparseIndexType = sparse.indices.componentType;
+        layout.sparseValues = getBufferViewData(modelGLTF, sparse.values.bufferView) + sparse.values.byteOffset;
+    }
+    return layout;
+}
+
 void AnimationGLTF::startAnimation()
 {
     animTime = start;
@@ -29,59 +68,221 @@ void AnimationGLTF::startAnimation()
 #endif
 }
 
+bool AnimationSampler::isValid() const
+{
+    if (compressed)
+        return true;
+    size_t stride = interpolation == CUBICSPLINE ? 3 : 1;
+    if (weightCount > 0)
+        return !inputs.empty() && outputsWeights.size() >= inputs.size() * stride * weightCount;
+    return !inputs.empty() && outputsVec4.size() >= inputs.size() * stride;
+}
+
+size_t AnimationSampler::findKey(float time, size_t* cursor) const
+{
+    size_t count = inputs.size();
+    if (count < 2 || time <= inputs[0])
+        return 0;
+    if (time >= inputs[count - 1])
+        return count - 1;
+
+    // monotonic playback stays in the same interval or moves to the next one
+    size_t key = *cursor;
+    if (key + 1 < count && inputs[key] <= time)
+    {
+        if (time < inputs[key + 1])
+            return key;
+        if (key + 2 < count && time < inputs[key + 2])
+        {
+            *cursor = key + 1;
+            return key + 1;
+        }
+    }
+
+    key = std::upper_bound(inputs.begin(), inputs.end(), time) - inputs.begin() - 1;
+    *cursor = key;
+    return key;
+}
+
+static glm::vec4 toVec4(const glm::quat& q) { return glm::vec4(q.x, q.y, q.z, q.w); }
+static glm::quat toQuat(const glm::vec4& v) { return glm::quat(v.w, v.x, v.y, v.z); }
+
+glm::vec4 AnimationSampler::sample(float time, size_t* cursor, bool rotation) const
+{
+    if (compressed)
+        return compressed->sample(time, cursor);
+    size_t key = findKey(time, cursor);
+    size_t stride = interpolation == CUBICSPLINE ? 3 : 1;
+    size_t valueOffset = interpolation == CUBICSPLINE ? 1 : 0;
+    const glm::vec4& value = outputsVec4[key * stride + valueOffset];
+    if (key + 1 >= inputs.size() || time <= inputs[key] || interpolation == STEP)
+        return value;
+
+    float delta = inputs[key + 1] - inputs[key];
+    float u = (time - inputs[key]) / delta;
+    const glm::vec4& next = outputsVec4[(key + 1) * stride + valueOffset];
+
+    if (interpolation == CUBICSPLINE)
+    {
+        // Hermite spline between the values, with the out-tangent of key and the in-tangent of key + 1
+        float u2 = u * u;
+        float u3 = u2 * u;
+        const glm::vec4& outTangent = outputsVec4[key * 3 + 2];
+        const glm::vec4& inTangent = outputsVec4[(key + 1) * 3];
+        glm::vec4 result = (2 * u3 - 3 * u2 + 1) * value + (u3 - 2 * u2 + u) * delta * outTangent +
+                           (-2 * u3 + 3 * u2) * next + (u3 - u2) * delta * inTangent;
+        return rotation ? toVec4(glm::normalize(toQuat(result))) : result;
+    }
+
+    if (rotation)
+        return toVec4(glm::normalize(glm::slerp(toQuat(value), toQuat(next), u)));
+    return glm::mix(value, next, u);
+}
+
+void AnimationSampler::sampleWeights(float time, size_t* cursor, float* weights) const
+{
+    size_t key = findKey(time, cursor);
+    size_t stride = interpolation == CUBICSPLINE ? 3 : 1;
+    size_t valueOffset = interpolation == CUBICSPLINE ? 1 : 0;
+    const float* value = &outputsWeights[(key * stride + valueOffset) * weightCount];
+    if (key + 1 >= inputs.size() || time <= inputs[key] || interpolation == STEP)
+    {
+        std::copy(value, value + weightCount, weights);
+        return;
+    }
+
+    float delta = inputs[key + 1] - inputs[key];
+    float u = (time - inputs[key]) / delta;
+    const float* next = &outputsWeights[((key + 1) * stride + valueOffset) * weightCount];
+
+    if (interpolation == CUBICSPLINE)
+    {
+        float u2 = u * u;
+        float u3 = u2 * u;
+        float a = 2 * u3 - 3 * u2 + 1, b = (u3 - 2 * u2 + u) * delta, c = -2 * u3 + 3 * u2, d = (u3 - u2) * delta;
+        const float* outTangent = &outputsWeights[(key * 3 + 2) * weightCount];
+        const float* inTangent = &outputsWeights[(key + 1) * 3 * weightCount];
+        for (uint32_t i = 0; i < weightCount; i++)
+            weights[i] = a * value[i] + b * outTangent[i] + c * next[i] + d * inTangent[i];
+        return;
+    }
+
+    for (uint32_t i = 0; i < weightCount; i++)
+        weights[i] = value[i] + (next[i] - value[i]) * u;
+}
+
+size_t AnimationSampler::getMemorySize() const
+{
+    size_t size = inputs.size() * sizeof(float) + outputsVec4.size() * sizeof(glm::vec4) +
+                  outputsWeights.size() * sizeof(float);
+    return compressed ? size + compressed->getMemorySize() : size;
+}
+
 void AnimationGLTF::getAnimatedValues(AnimatedValues* values)
+{
+    getAnimatedValues(animTime, values);
+}
+
+void AnimationGLTF::getAnimatedValues(float time, AnimatedValues* values)
 {
     CI_ASSERT(values);
     for (auto& channel : channels) {
-        AnimationSampler& sampler = samplers[channel.samplerIndex];
-        if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+        const AnimationSampler& sampler = samplers[channel.samplerIndex];
+        if (!sampler.isValid()) {
+            continue;
+        }
+        if (channel.path == AnimationChannel::PathType::WEIGHTS) {
+            values->W.resize(sampler.weightCount);
+            sampler.sampleWeights(time, &channel.cursor, values->W.data());
+            values->W_animated = true;
             continue;
         }
 
-        for (size_t i = 0; i < sampler.inputs.size() - 1; i++) {
-            if ((animTime >= sampler.inputs[i]) && (animTime <= sampler.inputs[i + 1])) {
-                float u = std::max(0.0f, animTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-                if (u <= 1.0f) {
-                    switch (channel.path) {
-                    case AnimationChannel::PathType::TRANSLATION: {
-                        glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-                        values->T = glm::vec3(trans);
-                        values->T_animated = true;
-                        break;
-                    }
-                    case AnimationChannel::PathType::SCALE: {
-                        glm::vec4 scale = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-                        values->S = glm::vec3(scale);
-                        values->S_animated = true;
-                        break;
-                    }
-                    case AnimationChannel::PathType::ROTATION: {
-                        glm::quat q1;
-                        q1.x = sampler.outputsVec4[i].x;
-                        q1.y = sampler.outputsVec4[i].y;
-                        q1.z = sampler.outputsVec4[i].z;
-                        q1.w = sampler.outputsVec4[i].w;
-                        glm::quat q2;
-                        q2.x = sampler.outputsVec4[i + 1].x;
-                        q2.y = sampler.outputsVec4[i + 1].y;
-                        q2.z = sampler.outputsVec4[i + 1].z;
-                        q2.w = sampler.outputsVec4[i + 1].w;
-                        values->R = glm::normalize(glm::slerp(q1, q2, u));
-                        values->R_animated = true;
-                        break;
-                    }
-                    }
-                }
-            }
+        glm::vec4 value = sampler.sample(time, &channel.cursor, channel.path == AnimationChannel::PathType::ROTATION);
+        switch (channel.path) {
+        case AnimationChannel::PathType::TRANSLATION: {
+            values->T = glm::vec3(value);
+            values->T_animated = true;
+            break;
+        }
+        case AnimationChannel::PathType::SCALE: {
+            values->S = glm::vec3(value);
+            values->S_animated = true;
+            break;
+        }
+        case AnimationChannel::PathType::ROTATION: {
+            values->R = toQuat(value);
+            values->R_animated = true;
+            break;
+        }
+        default:
+            break;
         }
     }
 }
 
+void AnimationGLTF::applyWeights(float time, ModelGLTF* modelGLTF)
+{
+    CI_ASSERT(modelGLTF);
+    for (auto& channel : channels) {
+        const AnimationSampler& sampler = samplers[channel.samplerIndex];
+        if (channel.path != AnimationChannel::PathType::WEIGHTS || !sampler.isValid() ||
+            channel.node >= (int)modelGLTF->nodes.size()) {
+            continue;
+        }
+        auto& weights = modelGLTF->nodes[channel.node]->weights;
+        weights.resize(sampler.weightCount);
+        sampler.sampleWeights(time, &channel.cursor, weights.data());
+    }
+}
+
+melo::BakedClipRef AnimationGLTF::bake(float sampleRate) const
+{
+    std::vector<bool> rotations;
+    for (auto& channel : channels)
+        rotations.push_back(channel.path == AnimationChannel::PathType::ROTATION);
+
+    std::vector<size_t> cursors(channels.size());
+    return melo::BakedClip::create(start, end, sampleRate, rotations, [&](uint32_t c, float time) {
+        const AnimationSampler& sampler = samplers[channels[c].samplerIndex];
+        if (!sampler.isValid() || channels[c].path == AnimationChannel::PathType::WEIGHTS)
+            return rotations[c] ? glm::vec4(0, 0, 0, 1) : glm::vec4(0);
+        return sampler.sample(time, &cursors[c], rotations[c]);
+    });
+}
+
+void AnimationGLTF::compress(float tolerance, float rotationTolerance)
+{
+    for (auto& channel : channels) {
+        AnimationSampler& sampler = samplers[channel.samplerIndex];
+        if (sampler.compressed || !sampler.isValid() || sampler.weightCount > 0 ||
+            sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE ||
+            channel.path == AnimationChannel::PathType::WEIGHTS) {
+            continue;
+        }
+        bool rotation = channel.path == AnimationChannel::PathType::ROTATION;
+        sampler.compressed = melo::CompressedTrack::create(
+            sampler.inputs.data(), sampler.outputsVec4.data(), sampler.inputs.size(), rotation,
+            sampler.interpolation == AnimationSampler::InterpolationType::STEP,
+            rotation ? rotationTolerance : tolerance);
+        std::vector<float>().swap(sampler.inputs);
+        std::vector<glm::vec4>().swap(sampler.outputsVec4);
+    }
+}
+
+size_t AnimationGLTF::getMemorySize() const
+{
+    size_t size = 0;
+    for (auto& sampler : samplers)
+        size += sampler.getMemorySize();
+    return size;
+}
+
 AnimationGLTF::Ref AnimationGLTF::create(ModelGLTFRef modelGLTF,
                                          const tinygltf::Animation& property)
 {
     Ref ref = make_shared<AnimationGLTF>();
-    ref->property = property;
+    ref->property = &property;
     ref->name = property.name;
     if (property.name.empty()) {
         //ref->name = std::to_string(animations.size());
@@ -90,7 +291,7 @@ AnimationGLTF::Ref AnimationGLTF::create(ModelGLTFRef modelGLTF,
     // Samplers
     for (auto& samp : property.samplers) {
         AnimationSampler sampler{};
-        sampler.property = samp;
+        sampler.property = &samp;
 
         if (samp.interpolation == "LINEAR") {
             sampler.interpolation = AnimationSampler::InterpolationType::LINEAR;
@@ -105,16 +306,9 @@ AnimationGLTF::Ref AnimationGLTF::create(ModelGLTFRef modelGLTF,
         // Read sampler input time values
         {
             const tinygltf::Accessor& accessor = modelGLTF->property.accessors[samp.input];
-            const tinygltf::BufferView& bufferView = modelGLTF->property.bufferViews[accessor.bufferView];
-            const tinygltf::Buffer& buffer = modelGLTF->property.buffers[bufferView.buffer];
 
-            assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-            const void* dataPtr = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
-            const float* buf = static_cast<const float*>(dataPtr);
-            for (size_t index = 0; index < accessor.count; index++) {
-                sampler.inputs.push_back(buf[index]);
-            }
+            sampler.inputs.resize(accessor.count);
+            readAccessor(getAccessorLayout(modelGLTF, accessor), sampler.inputs.data());
 
             for (auto input : sampler.inputs) {
                 if (input < ref->start) {
@@ -129,23 +323,29 @@ AnimationGLTF::Ref AnimationGLTF::create(ModelGLTFRef modelGLTF,
         // Read sampler output T/R/S values 
         {
             const tinygltf::Accessor& accessor = modelGLTF->property.accessors[samp.output];
-            const tinygltf::BufferView& bufferView = modelGLTF->property.bufferViews[accessor.bufferView];
-            const tinygltf::Buffer& buffer = modelGLTF->property.buffers[bufferView.buffer];
-
-            assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-            const void* dataPtr = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
+            // rotations may be normalized integers
+            std::vector<float> values(accessor.count * tinygltf::GetNumComponentsInType(accessor.type));
+            readAccessor(getAccessorLayout(modelGLTF, accessor), values.data());
 
             switch (accessor.type) {
+            case TINYGLTF_TYPE_SCALAR: {
+                // morph weights, one float per target for every output
+                bool cubic = sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE;
+                size_t outputCount = sampler.inputs.size() * (cubic ? 3 : 1);
+                sampler.weightCount = outputCount > 0 ? (uint32_t)(accessor.count / outputCount) : 0;
+                sampler.outputsWeights = std::move(values);
+                break;
+            }
             case TINYGLTF_TYPE_VEC3: {
-                const glm::vec3* buf = static_cast<const glm::vec3*>(dataPtr);
+                const glm::vec3* buf = reinterpret_cast<const glm::vec3*>(values.data());
                 for (size_t index = 0; index < accessor.count; index++) {
                     sampler.outputsVec4.push_back(glm::vec4(buf[index], 0.0f));
                 }
                 break;
             }
             case TINYGLTF_TYPE_VEC4: {
-                const glm::vec4* buf = static_cast<const glm::vec4*>(dataPtr);
+                const glm::vec4* buf = reinterpret_cast<const glm::vec4*>(values.data());
                 for (size_t index = 0; index < accessor.count; index++) {
                     sampler.outputsVec4.push_back(buf[index]);
                 }
@@ -164,7 +364,7 @@ AnimationGLTF::Ref AnimationGLTF::create(ModelGLTFRef modelGLTF,
     // Channels
     for (auto& source : property.channels) {
         AnimationChannel channel{};
-        channel.property = source;
+        channel.property = &source;
 
         if (source.target_path == "rotation") {
             channel.path = AnimationChannel::PathType::ROTATION;
@@ -176,12 +376,11 @@ AnimationGLTF::Ref AnimationGLTF::create(ModelGLTFRef modelGLTF,
             channel.path = AnimationChannel::PathType::SCALE;
         }
         if (source.target_path == "weights") {
-            std::cout << "weights not yet supported, skipping channel" << std::endl;
-            continue;
+            channel.path = AnimationChannel::PathType::WEIGHTS;
         }
         channel.samplerIndex = source.sampler;
         channel.node = source.target_node;
-        if (!channel.node) {
+        if (channel.node < 0) {
             continue;
         }
 
@@ -194,7 +393,7 @@ AnimationGLTF::Ref AnimationGLTF::create(ModelGLTFRef modelGLTF,
 CameraGLTF::Ref CameraGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Camera& property)
 {
     Ref ref = make_shared<CameraGLTF>();
-    ref->property = property;
+    ref->property = &property;
     if (property.type == "perspective")
     {
         ref->perspective = property.perspective;
@@ -211,15 +410,13 @@ CameraGLTF::Ref CameraGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Camer
 SamplerGLTF::Ref SamplerGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Sampler& property)
 {
     Ref ref = make_shared<SamplerGLTF>();
-    ref->property = property;
+    ref->property = &property;
 #ifndef CINDER_LESS
-    if (ref->property.minFilter == -1)
-        ref->property.minFilter = GL_LINEAR;
-    if (ref->property.magFilter == -1)
-        ref->property.magFilter = GL_LINEAR;
+    GLenum minFilter = property.minFilter == -1 ? GL_LINEAR : (GLenum)property.minFilter;
+    GLenum magFilter = property.magFilter == -1 ? GL_LINEAR : (GLenum)property.magFilter;
     auto fmt = gl::Sampler::Format()
-                   .minFilter((GLenum)ref->property.minFilter)
-                   .magFilter((GLenum)ref->property.magFilter)
+                   .minFilter(minFilter)
+                   .magFilter(magFilter)
                    .wrap(property.wrapS, property.wrapT, property.wrapR)
                    .label(property.name);
     ref->ciSampler = gl::Sampler::create(fmt);
@@ -229,7 +426,7 @@ SamplerGLTF::Ref SamplerGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Sam
     return ref;
 }
 
-void PrimitiveGLTF::draw(DrawOrder order)
+void PrimitiveGLTF::draw(DrawOrder order, uint32_t lodLevel)
 {
     if (material)
     {
@@ -237,7 +434,10 @@ void PrimitiveGLTF::draw(DrawOrder order)
             return;
     }
 #ifndef CINDER_LESS
-    gl::draw(ciVboMesh);
+    if (lodLevel > 0 && lodLevel < lods.size())
+        gl::draw(ciVboMesh, lods[lodLevel].indexOffset, lods[lodLevel].indexCount);
+    else
+        gl::draw(ciVboMesh);
 #endif
     if (material)
     {
@@ -248,12 +448,14 @@ void PrimitiveGLTF::draw(DrawOrder order)
 MeshGLTF::Ref MeshGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Mesh& property)
 {
     Ref ref = make_shared<MeshGLTF>();
-    ref->property = property;
+    ref->property = &property;
     int primId = 0;
     for (auto& item : property.primitives)
     {
         auto primitive = PrimitiveGLTF::create(modelGLTF, item);
         ref->primitives.emplace_back(primitive);
+        if (primitive->morphTargets)
+            ref->weights.resize(std::max(ref->weights.size(), primitive->morphTargets->getTargetCount()));
 #ifndef CINDER_LESS
         // Setting labels for vbos and ibo
         char info[256];
@@ -272,16 +474,38 @@ MeshGLTF::Ref MeshGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Mesh& pro
         }
 #endif
     }
+    for (size_t i = 0; i < property.weights.size() && i < ref->weights.size(); i++)
+        ref->weights[i] = (float)property.weights[i];
 
     return ref;
 }
 
+bool MeshGLTF::isMorphed() const
+{
+    for (auto& item : primitives)
+        if (item->isMorphed())
+            return true;
+    return false;
+}
+
 void MeshGLTF::update()
 {
     for (auto& item : primitives)
         item->update();
 }
 
+void MeshGLTF::skin(const SkinningPalette& palette, SkinningMethod method, JobSystem* jobs)
+{
+    for (auto& item : primitives)
+        item->skin(palette, method, jobs);
+}
+
+void MeshGLTF::morph(const float* targetWeights, size_t weightCount)
+{
+    for (auto& item : primitives)
+        item->morph(targetWeights, weightCount);
+}
+
 void MeshGLTF::draw(DrawOrder order)
 {
     for (auto& item : primitives)
@@ -291,14 +515,51 @@ void MeshGLTF::draw(DrawOrder order)
 SkinGLTF::Ref SkinGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Skin& property)
 {
     Ref ref = make_shared<SkinGLTF>();
-    ref->property = property;
+    ref->property = &property;
+    ref->joints = property.joints;
+    if (property.inverseBindMatrices != -1)
+    {
+        const tinygltf::Accessor& accessor = modelGLTF->property.accessors[property.inverseBindMatrices];
+        if (accessor.type == TINYGLTF_TYPE_MAT4 && accessor.count >= property.joints.size())
+        {
+            ref->inverseBindMatrices.resize(accessor.count);
+            readAccessor(getAccessorLayout(modelGLTF, accessor), &ref->inverseBindMatrices[0][0][0]);
+        }
+        else
+        {
+            CI_LOG_W("Skin " << property.name << " has invalid inverseBindMatrices");
+        }
+    }
     return ref;
 }
 
+void SkinGLTF::updatePalette(const ModelGLTF& modelGLTF, const glm::mat4& meshWorldTransform, SkinningMethod method,
+                             SkinningPalette* palette) const
+{
+    // the world transforms are gathered in place, update() turns them into the palette
+    palette->matrices.resize(joints.size());
+    for (size_t i = 0; i < joints.size(); i++)
+        palette->matrices[i] = modelGLTF.nodes[joints[i]]->getWorldTransform();
+    palette->update(palette->matrices.data(), inverseBindMatrices.empty() ? nullptr : inverseBindMatrices.data(),
+                    joints.size(), meshWorldTransform, method);
+}
+
 void NodeGLTF::update(double elapsed)
 {
     if (mesh)
     {
+        // morphing first, skinning reads the morphed streams
+        if (mesh->isMorphed())
+            mesh->morph(weights.data(), weights.size());
+        if (skin)
+        {
+            const auto& option = modelGLTF->option;
+            JobSystem* jobs = nullptr;
+            if (option.parallel)
+                jobs = option.jobSystem ? option.jobSystem.get() : JobSystem::getDefault().get();
+            skin->updatePalette(*modelGLTF, getWorldTransform(), option.skinning, &skinningPalette);
+            mesh->skin(skinningPalette, option.skinning, jobs);
+        }
         mesh->update();
     }
 }
@@ -307,8 +568,51 @@ void NodeGLTF::draw(DrawOrder order)
 {
     if (mesh)
     {
-        mesh->draw(order);
+        for (uint32_t i = 0; i < (uint32_t)mesh->primitives.size(); i++)
+            mesh->primitives[i]->draw(order, selectLod(order, i));
+    }
+}
+
+void NodeGLTF::submitDraws(RenderQueue& queue)
+{
+    if (!mesh)
+        return;
+    for (size_t i = 0; i < mesh->primitives.size(); i++)
+    {
+        // a primitive owns its vbo mesh, it stands for it
+        const auto& primitive = mesh->primitives[i];
+        const auto& material = primitive->material;
+        const void* shader = nullptr;
+#ifndef CINDER_LESS
+        if (material)
+            shader = material->ciShader.get();
+#endif
+        queue.add(*this, mDrawOrder, shader, material.get(), primitive.get(), (uint32_t)i);
+    }
+}
+
+void NodeGLTF::drawPacket(DrawOrder order, uint32_t item)
+{
+    if (mesh && item < mesh->primitives.size())
+        mesh->primitives[item]->draw(order, selectLod(order, item));
+}
+
+uint32_t NodeGLTF::selectLod(DrawOrder order, uint32_t item)
+{
+    const auto& lods = mesh->primitives[item]->lods;
+    if (lods.size() < 2)
+        return 0;
+    if (lodLevels.size() != mesh->primitives.size())
+        lodLevels.assign(mesh->primitives.size(), 0);
+#ifndef CINDER_LESS
+    if (order != DRAW_SHADOW)
+    {
+        float pixelScale = getLodPixelScale(gl::getModelView(), gl::getProjectionMatrix(),
+                                            (float)gl::getViewport().second.y, mBoundBoxMin, mBoundBoxMax);
+        lodLevels[item] = melo::selectLod(lods.data(), lods.size(), lodLevels[item], pixelScale);
     }
+#endif
+    return lodLevels[item];
 }
 
 void NodeGLTF::predraw(DrawOrder order)
@@ -322,6 +626,378 @@ void NodeGLTF::postdraw(DrawOrder order)
 }
 
 
+// A placeholder tinygltf accepts for buffers whose bytes are served from elsewhere
+static void setPlaceholderBuffer(nlohmann::json& buffer)
+{
+    buffer["uri"] = "data:application/octet-stream;base64,AA==";
+    buffer["byteLength"] = 1;
+}
+
+struct ImageBufferView
+{
+    uint32_t image;
+    int32_t bufferView;
+};
+
+// Stands in for images read from a mapping: a data uri keeps tinygltf from looking for a file, and
+// deferImageData drops its four bytes ("melo") instead of keeping them for decoding.
+static const char* MAPPED_IMAGE_URI = "data:application/octet-stream;base64,bWVsbw==";
+
+static bool isMappedImagePlaceholder(const unsigned char* bytes, int size)
+{
+    return size == 4 && memcmp(bytes, "melo", 4) == 0;
+}
+
+// tinygltf would decode embedded images from the placeholders, ImageGLTF reads the mapping instead
+static std::vector<ImageBufferView> detachImageBufferViews(nlohmann::json& doc)
+{
+    std::vector<ImageBufferView> imageBufferViews;
+    auto& images = doc["images"];
+    for (size_t i = 0; images.is_array() && i < images.size(); i++)
+    {
+        auto& image = images[i];
+        if (image.find("bufferView") != image.end())
+        {
+            imageBufferViews.push_back({(uint32_t)i, image["bufferView"].get<int32_t>()});
+            image.erase("bufferView");
+            image["uri"] = MAPPED_IMAGE_URI;
+        }
+    }
+    return imageBufferViews;
+}
+
+static void attachImageBufferViews(tinygltf::Model* model, const std::vector<ImageBufferView>& imageBufferViews)
+{
+    for (auto& item : imageBufferViews)
+    {
+        if (item.image >= model->images.size()) break;
+        model->images[item.image].uri.clear();
+        model->images[item.image].bufferView = item.bufferView;
+    }
+}
+
+// tinygltf always copies buffers into std::vector, so the json is rewritten before handing it over:
+// every file backed buffer becomes a one byte data uri and the real bytes are served from mappings.
+static bool loadMappedModel(ModelGLTF* ref, tinygltf::TinyGLTF& loader, tinygltf::Model* model,
+                            std::string* err, std::string* warn)
+{
+    const auto& meshPath = ref->meshPath;
+    auto file = MappedFile::create(meshPath.string());
+    if (!file || file->getSize() < 20)
+    {
+        *err = "Failed to map " + meshPath.string();
+        return false;
+    }
+    ref->mappedFiles.push_back(file);
+    file->prefetch();
+
+    const char* jsonData = (const char*)file->getData();
+    size_t jsonSize = file->getSize();
+    const uint8_t* binData = nullptr;
+    size_t binSize = 0;
+
+    if (memcmp(file->getData(), "glTF", 4) == 0 &&
+        !parseGlb(file->getData(), file->getSize(), &jsonData, &jsonSize, &binData, &binSize))
+    {
+        *err = "Invalid GLB header";
+        return false;
+    }
+
+    auto doc = nlohmann::json::parse(jsonData, jsonData + jsonSize, nullptr, false);
+    if (doc.is_discarded() || !doc.is_object())
+    {
+        *err = "Failed to parse json of " + meshPath.string();
+        return false;
+    }
+
+    auto& buffers = doc["buffers"];
+    ref->mappedBuffers.resize(buffers.is_array() ? buffers.size() : 0);
+    for (size_t i = 0; i < ref->mappedBuffers.size(); i++)
+    {
+        auto& buffer = buffers[i];
+        size_t byteLength = buffer.value("byteLength", size_t(0));
+        std::string uri = buffer.value("uri", "");
+        if (uri.find("data:") == 0)
+        {
+            // base64 payloads can't be mapped, leave them to tinygltf
+            continue;
+        }
+
+        // EXT_meshopt_compression fallback buffers have no bytes, the decoder gives them storage later
+        auto extensions = buffer.find("extensions");
+        if (uri.empty() && extensions != buffer.end() && extensions->is_object())
+        {
+            auto meshopt = extensions->find("EXT_meshopt_compression");
+            if (meshopt != extensions->end() && meshopt->is_object() && meshopt->value("fallback", false))
+                continue;
+        }
+
+        const uint8_t* data = binData;
+        size_t size = binSize;
+        if (!uri.empty())
+        {
+            auto binPath = meshPath.parent_path() / decodeUri(uri);
+            auto binFile = MappedFile::create(binPath.string());
+            if (!binFile)
+            {
+                *err = "Failed to map " + binPath.string();
+                return false;
+            }
+            ref->mappedFiles.push_back(binFile);
+            binFile->prefetch();
+            data = binFile->getData();
+            size = binFile->getSize();
+        }
+        if (!data || byteLength > size)
+        {
+            *err = "Invalid byteLength of buffer " + std::to_string(i);
+            return false;
+        }
+        ref->mappedBuffers[i] = WeakBuffer::create((void*)data, byteLength);
+        setPlaceholderBuffer(buffer);
+    }
+
+    auto imageBufferViews = detachImageBufferViews(doc);
+    auto json = doc.dump();
+    auto baseDir = meshPath.parent_path().string();
+    bool ret = loader.LoadASCIIFromString(model, err, warn, json.c_str(), (unsigned int)json.size(), baseDir);
+    attachImageBufferViews(model, imageBufferViews);
+    return ret;
+}
+
+// tinygltf decodes images while parsing, this keeps the encoded bytes so the decoding can run on the workers.
+// Images in a bufferView are read from the buffer later on.
+static bool deferImageData(tinygltf::Image* image, const int imageIdx, std::string* err, std::string* warn,
+                           int reqWidth, int reqHeight, const unsigned char* bytes, int size, void* userData)
+{
+    if (image->bufferView != -1 || isMappedImagePlaceholder(bytes, size))
+        return true;
+    auto encodedImages = (std::vector<std::vector<unsigned char>>*)userData;
+    if (encodedImages->size() <= (size_t)imageIdx)
+        encodedImages->resize(imageIdx + 1);
+    (*encodedImages)[imageIdx].assign(bytes, bytes + size);
+    return true;
+}
+
+// runs func as a job, or right away if jobs is null
+static JobRef runJob(const JobSystemRef& jobs, std::function<void()> func, const std::vector<JobRef>& dependencies = {})
+{
+    if (jobs)
+        return jobs->add(std::move(func), dependencies);
+    func();
+    return {};
+}
+
+static void prepareIndices(const ModelGLTFRef& modelGLTF, const tinygltf::Primitive& property,
+                           PreparedIndicesGLTF* prepared);
+
+static size_t getExtensionSize(const tinygltf::Value& extension, const char* key)
+{
+    const auto& value = extension.Get(key);
+    return value.IsNumber() ? (size_t)value.GetNumberAsDouble() : 0;
+}
+
+// EXT_meshopt_compression: the fallback buffers get storage and the compressed views are decoded into it, one job per view.
+// Views of buffers that came with data (an uncompressed fallback file) are left alone. Returns the errors.
+static std::string decodeMeshoptBufferViews(ModelGLTFRef ref, const JobSystemRef& jobs)
+{
+    const auto& model = ref->property;
+    std::vector<size_t> fallbackSizes(model.buffers.size());
+    std::vector<size_t> compressedViews;
+    for (size_t i = 0; i < model.bufferViews.size(); i++)
+    {
+        const auto& bufferView = model.bufferViews[i];
+        if (!bufferView.extensions.count("EXT_meshopt_compression") || bufferView.buffer < 0 ||
+            bufferView.buffer >= (int)model.buffers.size() || ref->buffers[bufferView.buffer]->cpuBuffer->getSize() > 0)
+            continue;
+        auto& size = fallbackSizes[bufferView.buffer];
+        size = std::max(size, bufferView.byteOffset + bufferView.byteLength);
+        compressedViews.push_back(i);
+    }
+    if (compressedViews.empty())
+        return {};
+
+    for (size_t i = 0; i < fallbackSizes.size(); i++)
+    {
+        if (fallbackSizes[i] > 0)
+            ref->buffers[i]->cpuBuffer = WeakBuffer::createStorage(fallbackSizes[i]);
+    }
+
+    std::vector<std::string> errors(compressedViews.size());
+    std::vector<JobRef> decodeJobs;
+    for (size_t j = 0; j < compressedViews.size(); j++)
+    {
+        decodeJobs.push_back(runJob(jobs, [&, j] {
+            size_t index = compressedViews[j];
+            const auto& bufferView = model.bufferViews[index];
+            const auto& extension = bufferView.extensions.at("EXT_meshopt_compression");
+
+            MeshoptBufferView meshopt;
+            const auto& mode = extension.Get("mode");
+            const auto& filter = extension.Get("filter");
+            bool validMode = false, validFilter = false;
+            meshopt.mode = getMeshoptMode(mode.IsString() ? mode.Get<std::string>().c_str() : "", &validMode);
+            meshopt.filter = getMeshoptFilter(filter.IsString() ? filter.Get<std::string>().c_str() : "", &validFilter);
+            meshopt.count = getExtensionSize(extension, "count");
+            meshopt.byteStride = getExtensionSize(extension, "byteStride");
+            meshopt.byteLength = getExtensionSize(extension, "byteLength");
+
+            int source = extension.Get("buffer").IsNumber() ? extension.Get("buffer").GetNumberAsInt() : -1;
+            size_t byteOffset = getExtensionSize(extension, "byteOffset");
+            if (validMode && validFilter && source >= 0 && source < (int)ref->buffers.size())
+            {
+                auto& sourceBuffer = ref->buffers[source]->cpuBuffer;
+                if (byteOffset + meshopt.byteLength <= sourceBuffer->getSize())
+                    meshopt.data = (const uint8_t*)sourceBuffer->getData() + byteOffset;
+            }
+
+            uint8_t* dst = (uint8_t*)ref->buffers[bufferView.buffer]->cpuBuffer->getData() + bufferView.byteOffset;
+            if (meshopt.count * meshopt.byteStride > bufferView.byteLength || !decodeMeshopt(meshopt, dst))
+                errors[j] = "Failed to decode EXT_meshopt_compression of bufferView " + std::to_string(index) + "\n";
+        }));
+    }
+    if (jobs)
+        jobs->wait(decodeJobs);
+
+    std::string err;
+    for (auto& error : errors)
+        err += error;
+    return err;
+}
+
+// Sections of the ModelGLTF scene cache
+enum CacheSection
+{
+    CACHE_JSON,               // the json with every buffer as a placeholder and the image bufferViews detached
+    CACHE_IMAGE_BUFFER_VIEWS, // ImageBufferView[]
+    CACHE_BUFFER,             // index: buffer, bytes after EXT_meshopt_compression decoding
+    CACHE_IMAGE,              // index: image, decoded mip chain
+    CACHE_HAS_IMAGES,         // empty, present if the images were decoded when the cache was written
+    CACHE_STRINGS,            // CompactGLTF::strings
+    CACHE_DEFAULT_SCENE,      // CompactGLTF::defaultScene
+    CACHE_COMPACT,            // index: CompactGLTF array, in forEachCompactArray() order
+};
+
+// The source hash is seeded with the record sizes, a layout change invalidates the old caches
+static uint64_t getCacheHash(const fs::path& meshPath, std::vector<std::string>* dependencies = nullptr)
+{
+    const uint32_t layout[] = {
+        (uint32_t)sizeof(CompactGLTF::AccessorRecord), (uint32_t)sizeof(CompactGLTF::MaterialRecord),
+        (uint32_t)sizeof(CompactGLTF::PrimitiveRecord), (uint32_t)sizeof(CompactGLTF::NodeRecord),
+        (uint32_t)sizeof(ImageBufferView), NUM_ATTRIBS,
+    };
+    uint64_t hash = hashSceneSource(meshPath.string(), dependencies);
+    return hashBytes(&hash, sizeof(hash), hashBytes(layout, sizeof(layout)));
+}
+
+static bool noFileExists(const std::string&, void*) { return false; }
+
+// Warm load from ModelGLTF::cache. The buffers come from the cache and the json is parsed without touching
+// the file system, images are in the cache as well. Option::compactOnly doesn't parse the json at all.
+static bool loadCachedModel(ModelGLTF* ref, tinygltf::TinyGLTF& loader, tinygltf::Model* model, std::string* err)
+{
+    const auto& cache = *ref->cache;
+    ref->compact = CompactGLTF::create(cache);
+    if (!ref->compact)
+    {
+        *err = "Invalid cache of " + ref->meshPath.string();
+        return false;
+    }
+
+    ref->mappedBuffers.resize(ref->compact->buffers.size());
+    for (size_t i = 0; i < ref->mappedBuffers.size(); i++)
+    {
+        size_t size = 0;
+        auto data = cache.getSection(CACHE_BUFFER, (uint32_t)i, &size);
+        if (!data)
+        {
+            *err = "Buffer " + std::to_string(i) + " is missing from the cache of " + ref->meshPath.string();
+            return false;
+        }
+        ref->mappedBuffers[i] = WeakBuffer::create((void*)data, size);
+    }
+
+    if (ref->option.compactOnly)
+    {
+        model->buffers.resize(ref->mappedBuffers.size());
+        return true;
+    }
+
+    size_t jsonSize = 0;
+    auto json = (const char*)cache.getSection(CACHE_JSON, 0, &jsonSize);
+    std::vector<ImageBufferView> imageBufferViews;
+    if (!json || !cache.getArray(CACHE_IMAGE_BUFFER_VIEWS, 0, &imageBufferViews))
+    {
+        *err = "Invalid cache of " + ref->meshPath.string();
+        return false;
+    }
+
+    loader.SetFsCallbacks({noFileExists, tinygltf::ExpandFilePath, tinygltf::ReadWholeFile,
+                           tinygltf::WriteWholeFile, nullptr});
+    // the warnings are about the missing image files and were reported by the cold load
+    std::string warn;
+    bool ret = loader.LoadASCIIFromString(model, err, &warn, json, (unsigned int)jsonSize,
+                                          ref->meshPath.parent_path().string());
+    loader.SetFsCallbacks({tinygltf::FileExists, tinygltf::ExpandFilePath, tinygltf::ReadWholeFile,
+                           tinygltf::WriteWholeFile, nullptr});
+    attachImageBufferViews(model, imageBufferViews);
+    return ret;
+}
+
+// Written at the end of a cold load with Option::useCache, everything a warm load needs
+static bool writeModelCache(const ModelGLTFRef& ref, const std::string& cachePath, bool hasImages)
+{
+    std::vector<std::string> dependencies;
+    SceneCacheWriter writer(getCacheHash(ref->meshPath, &dependencies));
+    for (auto& dependency : dependencies)
+        writer.addDependency(dependency);
+
+    // the source json again, ModelGLTF::property may have been released by Option::compactOnly
+    auto file = MappedFile::create(ref->meshPath.string());
+    if (!file || !file->getData())
+        return false;
+    const char* jsonData = (const char*)file->getData();
+    size_t jsonSize = file->getSize();
+    const uint8_t* binData;
+    size_t binSize;
+    if (memcmp(file->getData(), "glTF", 4) == 0 &&
+        !parseGlb(file->getData(), file->getSize(), &jsonData, &jsonSize, &binData, &binSize))
+        return false;
+    auto doc = nlohmann::json::parse(jsonData, jsonData + jsonSize, nullptr, false);
+    if (doc.is_discarded() || !doc.is_object())
+        return false;
+    auto& buffers = doc["buffers"];
+    for (size_t i = 0; buffers.is_array() && i < buffers.size(); i++)
+        setPlaceholderBuffer(buffers[i]);
+    auto imageBufferViews = detachImageBufferViews(doc);
+    auto json = doc.dump();
+    writer.addSectionRef(CACHE_JSON, 0, json.data(), json.size());
+    writer.addArray(CACHE_IMAGE_BUFFER_VIEWS, 0, imageBufferViews);
+
+    for (size_t i = 0; i < ref->buffers.size(); i++)
+    {
+        const auto& cpuBuffer = ref->buffers[i]->cpuBuffer;
+        writer.addSectionRef(CACHE_BUFFER, (uint32_t)i, cpuBuffer->getData(), cpuBuffer->getSize());
+    }
+
+    ref->compact->writeCache(writer);
+
+    if (hasImages)
+    {
+        const auto& images = ref->property.images;
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            const auto& image = images[i];
+            if (image.bits == 8 && image.width > 0 && image.height > 0 &&
+                image.image.size() == (size_t)image.width * image.height * image.component)
+                addCachedImage(writer, CACHE_IMAGE, (uint32_t)i, image.image.data(), image.width, image.height,
+                               image.component);
+        }
+        writer.addSection(CACHE_HAS_IMAGES, 0, nullptr, 0);
+    }
+    return writer.write(cachePath);
+}
+
 ModelGLTFRef ModelGLTF::create(const fs::path& meshPath, const Option& option, std::string* loadingError)
 {
     if (!fs::exists(meshPath))
@@ -330,22 +1006,61 @@ ModelGLTFRef ModelGLTF::create(const fs::path& meshPath, const Option& option, s
         return {};
     }
     tinygltf::TinyGLTF loader;
-    tinygltf::Model model;
+    tinygltf::Model gltfModel;
     std::string err;
     std::string warn;
     std::string input_filename(meshPath.string());
     std::string ext = meshPath.extension().string();
 
+    ModelGLTFRef ref = make_shared<ModelGLTF>();
+    ref->option = option;
+    ref->meshPath = meshPath;
+
+    std::vector<std::vector<unsigned char>> encodedImages;
+    loader.SetImageLoader(deferImageData, &encodedImages);
+
+    bool loadImages = !option.compactOnly && !option.loadAnimationOnly && option.loadTextures;
+    std::string cachePath;
+    if (option.useCache)
+    {
+        cachePath = SceneCache::getCachePath(meshPath.string(), option.cacheDir.string());
+        ref->cache = SceneCache::open(cachePath, getCacheHash(meshPath));
+        if (ref->cache && loadImages && !ref->cache->hasSection(CACHE_HAS_IMAGES))
+            ref->cache.reset();
+    }
+
     bool ret = false;
-    if (ext.compare(".glb") == 0)
+    if (ref->cache)
     {
-        // assume binary glTF.
-        ret = loader.LoadBinaryFromFile(&model, &err, &warn, input_filename.c_str());
+        ret = loadCachedModel(ref.get(), loader, &gltfModel, &err);
+        if (!ret)
+        {
+            // falls back to a cold load, which rewrites the cache
+            CI_LOG_W(err);
+            err.clear();
+            gltfModel = tinygltf::Model();
+            ref->cache.reset();
+            ref->compact.reset();
+            ref->mappedBuffers.clear();
+        }
     }
-    else
+
+    if (!ref->cache)
     {
-        // assume ascii glTF.
-        ret = loader.LoadASCIIFromFile(&model, &err, &warn, input_filename.c_str());
+        if (option.mapBuffers)
+        {
+            ret = loadMappedModel(ref.get(), loader, &gltfModel, &err, &warn);
+        }
+        else if (ext.compare(".glb") == 0)
+        {
+            // assume binary glTF.
+            ret = loader.LoadBinaryFromFile(&gltfModel, &err, &warn, input_filename.c_str());
+        }
+        else
+        {
+            // assume ascii glTF.
+            ret = loader.LoadASCIIFromFile(&gltfModel, &err, &warn, input_filename.c_str());
+        }
     }
 
     if (!warn.empty())
@@ -365,10 +1080,7 @@ ModelGLTFRef ModelGLTF::create(const fs::path& meshPath, const Option& option, s
         return {};
     }
 
-    ModelGLTFRef ref = make_shared<ModelGLTF>();
-    ref->option = option;
-    ref->property = model;
-    ref->meshPath = meshPath;
+    ref->property = std::move(gltfModel);
     ref->rayCategory = 0xFF;
     ref->setName(meshPath.generic_string());
 
@@ -388,17 +1100,90 @@ ModelGLTFRef ModelGLTF::create(const fs::path& meshPath, const Option& option, s
     }
 #endif
 
-    if (!option.loadAnimationOnly)
+    const auto& model = ref->property;
+
+    if (!ref->compact)
+        ref->compact = CompactGLTF::create(model, ref->mappedBuffers);
+
+    // buffers are only views, animations need them as well
+    for (auto& item : model.buffers)
+        ref->buffers.emplace_back(BufferGLTF::create(ref, item));
+
+    // Everything below that doesn't touch GL runs on the workers:
+    // meshopt decoding, image decoding -> ImageGLTF, per mesh vertex preparation (CINDER_LESS) and animations
+    JobSystemRef jobs;
+    if (option.parallel)
+        jobs = option.jobSystem ? option.jobSystem : JobSystem::getDefault();
+
+    err = decodeMeshoptBufferViews(ref, jobs);
+    if (!err.empty())
+    {
+        CI_LOG_E(err);
+        if (loadingError) *loadingError = err;
+        return {};
+    }
+
+    if (option.compactOnly)
+    {
+        // keep the bytes, drop the rest of the source model, the buffer vector moves without reallocating
+        std::vector<tinygltf::Buffer> buffers = std::move(ref->property.buffers);
+        ref->property = tinygltf::Model();
+        ref->property.buffers = std::move(buffers);
+    }
+
+    std::vector<JobRef> imageJobs(loadImages ? model.images.size() : 0);
+    std::vector<std::string> imageErrors(imageJobs.size());
+    for (size_t i = 0; i < imageJobs.size(); i++)
+    {
+        if (ref->cache && ref->cache->hasSection(CACHE_IMAGE, (uint32_t)i))
+            continue;
+        imageJobs[i] = runJob(jobs, [&, i] {
+            auto& image = ref->property.images[i];
+            const unsigned char* bytes = nullptr;
+            size_t size = 0;
+            if (i < encodedImages.size() && !encodedImages[i].empty())
+            {
+                bytes = encodedImages[i].data();
+                size = encodedImages[i].size();
+            }
+            else if (image.bufferView != -1)
+            {
+                const auto& bufferView = model.bufferViews[image.bufferView];
+                bytes = (const unsigned char*)ref->buffers[bufferView.buffer]->cpuBuffer->getData() + bufferView.byteOffset;
+                size = bufferView.byteLength;
+            }
+            if (bytes)
+            {
+                std::string warn;
+                tinygltf::LoadImageData(&image, (int)i, &imageErrors[i], &warn, image.width, image.height, bytes,
+                                        (int)size, nullptr);
+            }
+        });
+    }
+
+    std::vector<JobRef> animationJobs;
+    if (!option.compactOnly)
     {
+        ref->animations.resize(model.animations.size());
+        for (size_t i = 0; i < model.animations.size(); i++)
         {
-            tinygltf::Material mtrl;
+            animationJobs.push_back(runJob(jobs, [&, i] {
+                ref->animations[i] = AnimationGLTF::create(ref, model.animations[i]);
+                if (option.compressAnimations)
+                    ref->animations[i]->compress(option.animationTolerance, option.rotationTolerance);
+            }));
+        }
+    }
+
+    if (!option.compactOnly && !option.loadAnimationOnly)
+    {
+        {
+            auto& mtrl = ref->fallbackMaterialProperty;
             mtrl.name = "default";
             mtrl.extensions["KHR_materials_unlit"] = {};
             ref->fallbackMaterial = MaterialGLTF::create(ref, mtrl);
         }
 
-        for (auto& item : model.buffers)
-            ref->buffers.emplace_back(BufferGLTF::create(ref, item));
         for (auto& item : model.bufferViews)
             ref->bufferViews.emplace_back(BufferViewGLTF::create(ref, item));
         for (auto& item : model.accessors)
@@ -406,18 +1191,58 @@ ModelGLTFRef ModelGLTF::create(const fs::path& meshPath, const Option& option, s
 
         if (option.loadTextures)
         {
-            for (auto& item : model.images)
-                ref->images.emplace_back(ImageGLTF::create(ref, item));
-            for (auto& item : model.samplers)
-                ref->samplers.emplace_back(SamplerGLTF::create(ref, item));
-            for (auto& item : model.textures)
-                ref->textures.emplace_back(TextureGLTF::create(ref, item));
-            for (auto& item : model.materials)
-                ref->materials.emplace_back(MaterialGLTF::create(ref, item));
+            // in file order, later images keep decoding meanwhile
+            for (size_t i = 0; i < model.images.size(); i++)
+            {
+                if (jobs)
+                    jobs->wait(imageJobs[i]);
+                if (!imageErrors[i].empty())
+                {
+                    CI_LOG_E(imageErrors[i]);
+                }
+                ref->images.emplace_back(ImageGLTF::create(ref, model.images[i]));
+            }
+            for (auto& item : model.samplers)
+                ref->samplers.emplace_back(SamplerGLTF::create(ref, item));
+            for (auto& item : model.textures)
+                ref->textures.emplace_back(TextureGLTF::create(ref, item));
+            for (auto& item : model.materials)
+                ref->materials.emplace_back(MaterialGLTF::create(ref, item));
+        }
+
+#ifdef CINDER_LESS
+        std::vector<JobRef> meshJobs;
+        ref->meshes.resize(model.meshes.size());
+        for (size_t i = 0; i < model.meshes.size(); i++)
+        {
+            meshJobs.push_back(runJob(jobs, [&, i] {
+                ref->meshes[i] = MeshGLTF::create(ref, model.meshes[i]);
+            }));
+        }
+        // nodes point to the meshes
+        if (jobs)
+            jobs->wait(meshJobs);
+#else
+        // the simplification and reordering go to the worker pool first, only the vbos are left to this thread
+        if (jobs && (option.lodLevels > 1 || option.optimizeIndices))
+        {
+            for (auto& mesh : model.meshes)
+                for (auto& primitive : mesh.primitives)
+                    ref->preparedIndices[&primitive];
+            std::vector<JobRef> indexJobs;
+            for (auto& kv : ref->preparedIndices)
+            {
+                auto entry = &kv;
+                indexJobs.push_back(runJob(jobs, [&, entry] { prepareIndices(ref, *entry->first, &entry->second); }));
+            }
+            jobs->wait(indexJobs);
         }
 
+        // creates vbos
         for (auto& item : model.meshes)
             ref->meshes.emplace_back(MeshGLTF::create(ref, item));
+        ref->preparedIndices.clear();
+#endif
         for (auto& item : model.skins)
             ref->skins.emplace_back(SkinGLTF::create(ref, item));
         for (auto& item : model.cameras)
@@ -427,7 +1252,7 @@ ModelGLTFRef ModelGLTF::create(const fs::path& meshPath, const Option& option, s
         int nodeId = 0;
         for (auto& item : model.nodes)
         {
-            auto& node = NodeGLTF::create(ref, item);
+            auto node = NodeGLTF::create(ref, item);
             if (item.name.empty())
             {
                 sprintf(name, "node_%d", nodeId);
@@ -443,37 +1268,92 @@ ModelGLTFRef ModelGLTF::create(const fs::path& meshPath, const Option& option, s
             ref->scenes.emplace_back(scene);
         }
 
-        if (model.defaultScene == -1)
-            model.defaultScene = 0;
-        ref->currentScene = ref->scenes[model.defaultScene];
+        ref->currentScene = ref->scenes[model.defaultScene == -1 ? 0 : model.defaultScene];
 
         ref->addChild(ref->currentScene);
     }
 
-    for (auto& item : model.animations)
-        ref->animations.emplace_back(AnimationGLTF::create(ref, item));
+    if (jobs)
+    {
+        jobs->wait(imageJobs);
+        jobs->wait(animationJobs);
+    }
 
-    ref->mBoundBoxMin = { +FLT_MAX, +FLT_MAX, +FLT_MAX };
-    ref->mBoundBoxMax = {-FLT_MIN, -FLT_MIN, -FLT_MIN};
-    for (auto& item : model.accessors)
+    // mesh bounds from the POSITION accessors of their primitives. Nodes of static meshes get them, skinned and
+    // morphed ones leave them and stay unbounded.
+    vector<pair<glm::vec3, glm::vec3>> meshBounds(ref->nodes.size(), {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)});
+    for (size_t i = 0; i < ref->nodes.size(); i++)
     {
-        if (item.type == TINYGLTF_TYPE_VEC3 && !item.minValues.empty())
+        auto& node = ref->nodes[i];
+        if (!node->mesh)
+            continue;
+        for (auto& primitive : node->mesh->primitives)
+        {
+            auto position = primitive->property->attributes.find("POSITION");
+            if (position == primitive->property->attributes.end() || position->second < 0)
+                continue;
+            const auto& accessor = ref->compact->accessors[position->second];
+            if (!accessor.hasBounds)
+                continue;
+            meshBounds[i].first = glm::min(meshBounds[i].first, accessor.boundsMin);
+            meshBounds[i].second = glm::max(meshBounds[i].second, accessor.boundsMax);
+        }
+        if (meshBounds[i].first.x <= meshBounds[i].second.x && !node->skin && !node->mesh->isMorphed())
         {
-            glm::vec3 newMin = { item.minValues[0], item.minValues[1], item.minValues[2] };
-            glm::vec3 newMax = { item.maxValues[0], item.maxValues[1], item.maxValues[2] };
-            ref->mBoundBoxMin = glm::min(ref->mBoundBoxMin, newMin);
-            ref->mBoundBoxMax = glm::max(ref->mBoundBoxMax, newMax);
+            node->mBoundBoxMin = meshBounds[i].first;
+            node->mBoundBoxMax = meshBounds[i].second;
         }
     }
+
+    // the model bounds are those of its meshes placed by the node transforms of the current scene
+    ref->mBoundBoxMin = glm::vec3(FLT_MAX);
+    ref->mBoundBoxMax = glm::vec3(-FLT_MAX);
+    std::function<void(int, const glm::mat4&)> addNodeBounds = [&](int index, const glm::mat4& parentTransform) {
+        auto& node = ref->nodes[index];
+        glm::mat4 transform = parentTransform * node->getTransform();
+        if (meshBounds[index].first.x <= meshBounds[index].second.x)
+        {
+            glm::vec3 worldMin, worldMax;
+            melo::transformBounds(transform, meshBounds[index].first, meshBounds[index].second, &worldMin, &worldMax);
+            ref->mBoundBoxMin = glm::min(ref->mBoundBoxMin, worldMin);
+            ref->mBoundBoxMax = glm::max(ref->mBoundBoxMax, worldMax);
+        }
+        for (int child : node->property->children)
+            addNodeBounds(child, transform);
+    };
+    if (ref->currentScene)
+    {
+        for (int index : ref->currentScene->sceneProperty->nodes)
+            addNodeBounds(index, ref->currentScene->getTransform());
+    }
+    if (ref->mBoundBoxMin.x > ref->mBoundBoxMax.x)
+        ref->mBoundBoxMin = ref->mBoundBoxMax = glm::vec3(0);
     ref->treeUpdate();
 
+    if (option.useCache && !ref->cache)
+    {
+        if (!writeModelCache(ref, cachePath, loadImages))
+        {
+            CI_LOG_W("Failed to write the cache ") << cachePath;
+        }
+    }
+
     return ref;
 }
 
-//void ModelGLTF::update(double elapsed)
-//{
-//    currentScene->treeUpdate(elapsed);
-//}
+void ModelGLTF::playAnimation(const AnimationGLTF::Ref& animation)
+{
+    playingAnimation = animation;
+    if (animation)
+        animation->startAnimation();
+}
+
+// runs before the update of the nodes below, which morph with the weights written here
+void ModelGLTF::update(double elapsed)
+{
+    if (playingAnimation)
+        playingAnimation->applyWeights(playingAnimation->animTime, this);
+}
 
 void ModelGLTF::predraw(DrawOrder order)
 {
@@ -501,7 +1381,10 @@ void ModelGLTF::postdraw(DrawOrder order)
 
 void NodeGLTF::setup()
 {
-    for (auto& child : property.children)
+    // SceneGLTF has no node property
+    if (!property)
+        return;
+    for (auto& child : property->children)
     {
         addChild(modelGLTF->nodes[child]);
     }
@@ -510,7 +1393,7 @@ void NodeGLTF::setup()
 NodeGLTF::Ref NodeGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Node& property)
 {
     NodeGLTF::Ref ref = make_shared<NodeGLTF>();
-    ref->property = property;
+    ref->property = &property;
     ref->rayCategory = 0xFF;
 
     if (property.camera != -1)
@@ -518,10 +1401,14 @@ NodeGLTF::Ref NodeGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Node& pro
     if (property.mesh != -1)
     {
         ref->mesh = modelGLTF->meshes[property.mesh];
-        ref->setName(ref->mesh->property.name);
+        ref->setName(ref->mesh->property->name);
     }
     if (property.skin != -1)
         ref->skin = modelGLTF->skins[property.skin];
+    if (!property.weights.empty())
+        ref->weights.assign(property.weights.begin(), property.weights.end());
+    else if (ref->mesh)
+        ref->weights = ref->mesh->weights;
 
     if (!property.matrix.empty())
     {
@@ -551,7 +1438,7 @@ NodeGLTF::Ref NodeGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Node& pro
 SceneGLTF::Ref SceneGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Scene& property)
 {
     SceneGLTF::Ref ref = make_shared<SceneGLTF>();
-    ref->sceneProperty = property;
+    ref->sceneProperty = &property;
 
     for (auto& item : property.nodes)
     {
@@ -572,25 +1459,48 @@ SceneGLTF::Ref SceneGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Scene&
 
 AccessorGLTF::Ref AccessorGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Accessor& property)
 {
-    // CI_ASSERT_MSG(property.sparse.count == -1, "Unsupported");
-
     AccessorGLTF::Ref ref = make_shared<AccessorGLTF>();
-    auto bufferView = modelGLTF->bufferViews[property.bufferView];
-    ref->property = property;
-    ref->byteStride = bufferView->property.byteStride;
-    ref->cpuBuffer = bufferView->cpuBuffer;
+    ref->property = &property;
+    ref->byteStride = 0;
+    ref->layout = getAccessorLayout(modelGLTF, property);
+    if (property.bufferView != -1)
+    {
+        auto bufferView = modelGLTF->bufferViews[property.bufferView];
+        ref->byteStride = bufferView->property->byteStride;
+        ref->cpuBuffer = bufferView->cpuBuffer;
 #ifndef CINDER_LESS
-    ref->gpuBuffer = bufferView->gpuBuffer;
+        ref->gpuBuffer = bufferView->gpuBuffer;
 #endif
+    }
     return ref;
 }
 
 ImageGLTF::Ref ImageGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Image& property)
 {
     ImageGLTF::Ref ref = make_shared<ImageGLTF>();
-    ref->property = property;
+    ref->property = &property;
+    if (modelGLTF->cache)
+    {
+        auto index = (uint32_t)(&property - modelGLTF->property.images.data());
+        getCachedImage(*modelGLTF->cache, CACHE_IMAGE, index, &ref->cachedImage);
+    }
 #ifndef CINDER_LESS
-    if (property.image.empty())
+    const auto& cached = ref->cachedImage;
+    if (!cached.levels.empty())
+    {
+        ref->surface = Surface::create((uint8_t*)cached.levels[0], cached.width, cached.height,
+            cached.width * cached.components,
+            (cached.components == 4) ? SurfaceChannelOrder::RGBA : SurfaceChannelOrder::RGB);
+    }
+    else if (property.image.empty() && property.bufferView != -1)
+    {
+        // Option::mapBuffers skips the decoding in tinygltf
+        auto cpuBuffer = modelGLTF->bufferViews[property.bufferView]->cpuBuffer;
+        auto extension = property.mimeType.substr(property.mimeType.find('/') + 1);
+        auto source = DataSourceBuffer::create(Buffer::create(cpuBuffer->getData(), cpuBuffer->getSize()));
+        ref->surface = Surface::create(loadImage(source, ImageSource::Options(), extension));
+    }
+    else if (property.image.empty())
     {
         if (property.uri.find(".dds") != string::npos || property.uri.find(".DDS") != string::npos)
         {
@@ -618,15 +1528,21 @@ ImageGLTF::Ref ImageGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Image&
 BufferGLTF::Ref BufferGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Buffer& property)
 {
     BufferGLTF::Ref ref = make_shared<BufferGLTF>();
-    ref->property = property;
-    ref->cpuBuffer = WeakBuffer::create((void*)ref->property.data.data(), ref->property.data.size());
+    ref->property = &property;
+
+    // buffers are created in order
+    auto index = modelGLTF->buffers.size();
+    if (index < modelGLTF->mappedBuffers.size() && modelGLTF->mappedBuffers[index])
+        ref->cpuBuffer = modelGLTF->mappedBuffers[index];
+    else
+        ref->cpuBuffer = WeakBuffer::create((void*)property.data.data(), property.data.size());
     return ref;
 }
 
 MaterialGLTF::Ref MaterialGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Material& property)
 {
     MaterialGLTF::Ref ref = make_shared<MaterialGLTF>();
-    ref->property = property;
+    ref->property = &property;
     ref->modelGLTF = modelGLTF;
 
     ref->doubleSided = property.doubleSided;
@@ -849,6 +1765,15 @@ bool MaterialGLTF::predraw(DrawOrder order)
         return true;
     }
 
+    // the program may be shared with other materials of the same variant
+    ciShader->uniform("u_SpecularGlossinessValues", vec4(specularFactor, glossinessFactor));
+    ciShader->uniform("u_DiffuseFactor", diffuseFactor);
+    ciShader->uniform("u_MetallicRoughnessValues", vec2(metallicFactor, roughnessFactor));
+    ciShader->uniform("u_BaseColorFactor", baseColorFacor);
+    ciShader->uniform("u_NormalScale", normalTextureScale);
+    ciShader->uniform("u_EmissiveFactor", emissiveFactor);
+    ciShader->uniform("u_OcclusionStrength", occlusionStrength);
+
     ciShader->uniform("u_flipV", modelGLTF->flipV);
     ciShader->uniform("u_Camera", modelGLTF->cameraPosition);
     ciShader->uniform("u_LightDirection", modelGLTF->lightDirection);
@@ -1008,28 +1933,110 @@ static inline int32_t getTypeSizeInBytes(GltfType ty)
     return -1;
 }
 
-WeakBufferRef createFromAccessor(AccessorGLTF::Ref acc, GltfType assumedType,
-                                 GltfComponentType assumedComponentType)
+// A view if the accessor is already tightly packed in the wanted format, a converted copy otherwise.
+// componentType is either COMPONENT_TYPE_FLOAT or COMPONENT_TYPE_UNSIGNED_INT.
+WeakBufferRef createFromAccessor(AccessorGLTF::Ref acc, GltfType type, GltfComponentType componentType)
 {
-    CI_ASSERT(acc->property.type == (int)assumedType);
-    CI_ASSERT(acc->property.componentType == (int)assumedComponentType);
+    if (acc->property->type != (int)type)
+    {
+        CI_LOG_E("Unexpected accessor type ") << acc->property->type << std::endl;
+        return {};
+    }
+
+    const auto& layout = acc->layout;
+    size_t size = getTypeSizeInBytes(type) * getComponentSizeInBytes(componentType) * layout.count;
+    bool packed = layout.byteStride == 0 || layout.byteStride == layout.componentCount * getComponentSize(layout.componentType);
 
-    int typeSize = getTypeSizeInBytes(assumedType);
-    int compSize = getComponentSizeInBytes(assumedComponentType);
-    auto ref = WeakBuffer::create((uint8_t*)acc->cpuBuffer->getData() + acc->property.byteOffset,
-                                  typeSize * compSize * acc->property.count);
-    auto ptr = (float*)acc->cpuBuffer->getData();
-    ref->type = assumedType;
-    ref->componentType = assumedComponentType;
+    WeakBufferRef ref;
+    if (layout.data && packed && layout.sparseCount == 0 && layout.componentType == (uint32_t)componentType)
+    {
+        ref = WeakBuffer::create((void*)layout.data, size);
+    }
+    else
+    {
+        ref = WeakBuffer::createStorage(size);
+        if (componentType == COMPONENT_TYPE_FLOAT)
+            readAccessor(layout, (float*)ref->getData());
+        else
+            readAccessor(layout, (uint32_t*)ref->getData());
+    }
+    ref->type = type;
+    ref->componentType = componentType;
 
     return ref;
 }
 
+// POSITION / NORMAL deltas of every target, densified from (possibly sparse) accessors then stored sparsely
+static MorphTargetsRef createMorphTargets(ModelGLTFRef modelGLTF, const tinygltf::Primitive& property,
+                                          uint32_t vertexCount)
+{
+    auto morphTargets = MorphTargets::create(vertexCount);
+    for (auto& target : property.targets)
+    {
+        WeakBufferRef deltas[2];
+        const char* names[2] = {"POSITION", "NORMAL"};
+        for (int k = 0; k < 2; k++)
+        {
+            auto it = target.find(names[k]);
+            if (it == target.end())
+                continue;
+            auto acc = modelGLTF->accessors[it->second];
+            if (acc->property->count == vertexCount)
+                deltas[k] = createFromAccessor(acc, TYPE_VEC3, COMPONENT_TYPE_FLOAT);
+            else
+                CI_LOG_W("Morph target " << names[k] << " doesn't match the vertex count, ignored");
+        }
+        morphTargets->addTarget(deltas[0] ? (const glm::vec3*)deltas[0]->getData() : nullptr,
+                                deltas[1] ? (const glm::vec3*)deltas[1]->getData() : nullptr);
+    }
+    return morphTargets;
+}
+
+// LOD chain and / or triangle order of an indexed triangle primitive, left empty when neither applies
+static void prepareIndices(const ModelGLTFRef& modelGLTF, const tinygltf::Primitive& property,
+                           PreparedIndicesGLTF* prepared)
+{
+    const auto& option = modelGLTF->option;
+    auto position = property.attributes.find("POSITION");
+    if ((option.lodLevels <= 1 && !option.optimizeIndices) || property.indices < 0 ||
+        (property.mode != -1 && property.mode != MODE_TRIANGLES) || position == property.attributes.end() || position->second < 0)
+        return;
+
+    // the levels share the vertices, only the indices are simplified
+    auto sourceIndices = createFromAccessor(modelGLTF->accessors[property.indices], TYPE_SCALAR, COMPONENT_TYPE_UNSIGNED_INT);
+    auto positions = createFromAccessor(modelGLTF->accessors[position->second], TYPE_VEC3, COMPONENT_TYPE_FLOAT);
+    if (!sourceIndices || !positions)
+        return;
+    auto indexData = (const uint32_t*)sourceIndices->getData();
+    size_t indexCount = sourceIndices->getSize() / sizeof(uint32_t);
+    auto positionData = (const glm::vec3*)positions->getData();
+    size_t vertexCount = positions->getSize() / sizeof(glm::vec3);
+    if (option.lodLevels > 1)
+    {
+        buildLodChain(indexData, indexCount, positionData, vertexCount, option.lodLevels, option.lodRatio,
+                      &prepared->indices, &prepared->lods);
+    }
+    else
+    {
+        prepared->indices.assign(indexData, indexData + indexCount);
+        prepared->lods = {{0, (uint32_t)indexCount, 0.0f}};
+    }
+
+    if (!option.optimizeIndices)
+    {
+        if (prepared->lods.size() < 2)
+            *prepared = {};
+        return;
+    }
+    for (const auto& level : prepared->lods)
+        optimizeTriangleOrder(prepared->indices.data() + level.indexOffset, level.indexCount, positionData, vertexCount);
+}
+
 PrimitiveGLTF::Ref PrimitiveGLTF::create(ModelGLTFRef modelGLTF,
                                          const tinygltf::Primitive& property)
 {
     PrimitiveGLTF::Ref ref = make_shared<PrimitiveGLTF>();
-    ref->property = property;
+    ref->property = &property;
     ref->primitiveMode = (GltfMode)property.mode;
 
     if (property.material == -1)
@@ -1048,11 +2055,32 @@ PrimitiveGLTF::Ref PrimitiveGLTF::create(ModelGLTFRef modelGLTF,
     {
         indices = modelGLTF->accessors[property.indices];
     }
+
+    PreparedIndicesGLTF prepared;
+    auto found = modelGLTF->preparedIndices.find(&property);
+    if (found != modelGLTF->preparedIndices.end())
+        prepared = std::move(found->second);
+    else
+        prepareIndices(modelGLTF, property, &prepared);
+    if (!prepared.lods.empty())
+    {
+        ref->lods = std::move(prepared.lods);
+        ref->lodIndices = WeakBuffer::createStorage(prepared.indices.size() * sizeof(uint32_t));
+        memcpy(ref->lodIndices->getData(), prepared.indices.data(), ref->lodIndices->getSize());
+    }
 #ifdef CINDER_LESS
-    if (indices)
+    if (ref->lodIndices)
+    {
+        ref->indexCount = ref->lods[0].indexCount;
+        ref->indices = WeakBuffer::createStorage(ref->indexCount * sizeof(uint32_t));
+        memcpy(ref->indices->getData(), ref->lodIndices->getData(), ref->indices->getSize());
+        ref->indices->type = TYPE_SCALAR;
+        ref->indices->componentType = COMPONENT_TYPE_UNSIGNED_INT;
+    }
+    else if (indices)
     {
         ref->indices = createFromAccessor(indices, TYPE_SCALAR, COMPONENT_TYPE_UNSIGNED_INT);
-        ref->indexCount = indices->property.count;
+        ref->indexCount = indices->property->count;
     }
 
     ref->vertexCount = 0;
@@ -1065,24 +2093,36 @@ PrimitiveGLTF::Ref PrimitiveGLTF::create(ModelGLTFRef modelGLTF,
             ref->normals = createFromAccessor(acc, TYPE_VEC3, COMPONENT_TYPE_FLOAT);
         if (kv.first == "TEXCOORD_0")
             ref->uvs = createFromAccessor(acc, TYPE_VEC2, COMPONENT_TYPE_FLOAT);
-        ref->vertexCount = acc->property.count;
+        if (kv.first == "JOINTS_0")
+            ref->joints = createFromAccessor(acc, TYPE_VEC4, COMPONENT_TYPE_UNSIGNED_INT);
+        if (kv.first == "WEIGHTS_0")
+            ref->weights = createFromAccessor(acc, TYPE_VEC4, COMPONENT_TYPE_FLOAT);
+        ref->vertexCount = acc->property->count;
     }
 #else
+    // skinned and morphed primitives keep their cpu streams, POSITION / NORMAL go to dynamic vbos that skin() and
+    // morph() rewrite
+    bool skinned = property.attributes.count("JOINTS_0") && property.attributes.count("WEIGHTS_0");
+    bool dynamic = (skinned || !property.targets.empty()) && property.attributes.count("POSITION");
 
     gl::VboRef oglIndexVbo;
-    if (indices)
+    if (ref->lodIndices)
+    {
+        oglIndexVbo = gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, ref->lodIndices->getSize(), ref->lodIndices->getData());
+    }
+    else if (indices)
     {
-        if (indices->property.byteOffset == 0)
+        if (indices->property->byteOffset == 0)
         {
             oglIndexVbo = indices->gpuBuffer;
             oglIndexVbo->setTarget(GL_ELEMENT_ARRAY_BUFFER);
         }
         else
         {
-            int bytesPerUnit = getComponentSizeInBytes((GltfComponentType)indices->property.componentType);
+            int bytesPerUnit = getComponentSizeInBytes((GltfComponentType)indices->property->componentType);
             oglIndexVbo =
-                gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, bytesPerUnit * indices->property.count,
-                (uint8_t*)indices->cpuBuffer->getData() + indices->property.byteOffset);
+                gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, bytesPerUnit * indices->property->count,
+                (uint8_t*)indices->cpuBuffer->getData() + indices->property->byteOffset);
         }
     }
 
@@ -1100,19 +2140,57 @@ PrimitiveGLTF::Ref PrimitiveGLTF::create(ModelGLTFRef modelGLTF,
             if (attrib == geom::TANGENT) material->ciShaderFormat.define("HAS_TANGENTS");
             if (attrib == geom::COLOR) material->ciShaderFormat.define("HAS_COLOR");
         }
-        layout.append(
-            attrib, getDataType((GltfComponentType)acc->property.componentType),
-            getTypeSizeInBytes((GltfType)acc->property.type), acc->byteStride, acc->property.byteOffset);
-        oglVboLayouts.emplace_back(layout, acc->gpuBuffer);
+        auto componentType = (GltfComponentType)acc->property->componentType;
+        auto dims = getTypeSizeInBytes((GltfType)acc->property->type);
+        if (dynamic)
+        {
+            if (attrib == geom::BONE_INDEX)
+                ref->joints = createFromAccessor(acc, TYPE_VEC4, COMPONENT_TYPE_UNSIGNED_INT);
+            if (attrib == geom::BONE_WEIGHT)
+                ref->weights = createFromAccessor(acc, TYPE_VEC4, COMPONENT_TYPE_FLOAT);
+            if (attrib == geom::POSITION)
+                ref->positions = createFromAccessor(acc, TYPE_VEC3, COMPONENT_TYPE_FLOAT);
+            if (attrib == geom::NORMAL)
+                ref->normals = createFromAccessor(acc, TYPE_VEC3, COMPONENT_TYPE_FLOAT);
+            ref->vertexCount = acc->property->count;
+        }
+        if (dynamic && (attrib == geom::POSITION || attrib == geom::NORMAL))
+        {
+            const auto& source = (attrib == geom::POSITION) ? ref->positions : ref->normals;
+            auto vbo = gl::Vbo::create(GL_ARRAY_BUFFER, source->getSize(), source->getData(), GL_DYNAMIC_DRAW);
+            (attrib == geom::POSITION ? ref->ciDynamicPositions : ref->ciDynamicNormals) = vbo;
+            layout.append(attrib, geom::FLOAT, 3, 0, 0);
+            oglVboLayouts.emplace_back(layout, vbo);
+        }
+        else if (componentType == COMPONENT_TYPE_FLOAT && acc->layout.sparseCount == 0 && acc->gpuBuffer)
+        {
+            layout.append(attrib, getDataType(componentType), dims, acc->byteStride, acc->property->byteOffset);
+            oglVboLayouts.emplace_back(layout, acc->gpuBuffer);
+        }
+        else
+        {
+            // KHR_mesh_quantization and sparse accessors: VboMesh only knows float and 32 bit integer attributes,
+            // the gpu gets a float copy while the cpu side keeps the quantized bytes
+            auto floats = createFromAccessor(acc, (GltfType)acc->property->type, COMPONENT_TYPE_FLOAT);
+            layout.append(attrib, geom::FLOAT, dims, 0, 0);
+            oglVboLayouts.emplace_back(layout, gl::Vbo::create(GL_ARRAY_BUFFER, floats->getSize(), floats->getData()));
+        }
 
-        numVertices = acc->property.count;
+        numVertices = acc->property->count;
     }
 
-    if (indices)
+    if (ref->lodIndices)
+    {
+        // level 0 by default, draw() picks the range of the others
+        ref->ciVboMesh = gl::VboMesh::create(numVertices, (GLenum)ref->primitiveMode, oglVboLayouts,
+                                             ref->lods[0].indexCount, GL_UNSIGNED_INT, oglIndexVbo);
+        ref->lodIndices.reset();
+    }
+    else if (indices)
     {
         ref->ciVboMesh =
-            gl::VboMesh::create(numVertices, (GLenum)ref->primitiveMode, oglVboLayouts, indices->property.count,
-            (GLenum)indices->property.componentType, oglIndexVbo);
+            gl::VboMesh::create(numVertices, (GLenum)ref->primitiveMode, oglVboLayouts, indices->property->count,
+            (GLenum)indices->property->componentType, oglIndexVbo);
     }
     else
     {
@@ -1128,7 +2206,7 @@ PrimitiveGLTF::Ref PrimitiveGLTF::create(ModelGLTFRef modelGLTF,
 #if 1
         try
         {
-            material->ciShader = gl::GlslProg::create(material->ciShaderFormat);
+            material->ciShader = melo::ProgramCache::getDefault()->get(material->ciShaderFormat);
         }
         catch (Exception& e)
         {
@@ -1173,28 +2251,93 @@ PrimitiveGLTF::Ref PrimitiveGLTF::create(ModelGLTFRef modelGLTF,
             ciShader->uniform("u_SpecularEnvSampler", 6);
             ciShader->uniform("u_brdfLUT", 7);
         }
+    }
 
-        ciShader->uniform("u_SpecularGlossinessValues", vec4(material->specularFactor, material->glossinessFactor));
-        ciShader->uniform("u_DiffuseFactor", material->diffuseFactor);
+#endif
+    if (ref->positions && !property.targets.empty())
+        ref->morphTargets = createMorphTargets(modelGLTF, property, ref->vertexCount);
+    if (ref->joints)
+    {
+        auto joints = (const uint32_t*)ref->joints->getData();
+        auto count = ref->joints->getSize() / sizeof(uint32_t);
+        ref->jointLimit = count > 0 ? *std::max_element(joints, joints + count) + 1 : 0;
+    }
+    return ref;
+}
+
+void PrimitiveGLTF::update() {}
+
+#ifndef CINDER_LESS
+static void uploadDynamicStreams(PrimitiveGLTF& primitive, const WeakBufferRef& positions,
+                                 const WeakBufferRef& normals)
+{
+    primitive.ciDynamicPositions->bufferSubData(0, positions->getSize(), positions->getData());
+    if (primitive.ciDynamicNormals && normals)
+        primitive.ciDynamicNormals->bufferSubData(0, normals->getSize(), normals->getData());
+}
+#endif
 
-        ciShader->uniform("u_MetallicRoughnessValues", vec2(material->metallicFactor, material->roughnessFactor));
-        ciShader->uniform("u_BaseColorFactor", material->baseColorFacor);
+void PrimitiveGLTF::morph(const float* targetWeights, size_t weightCount)
+{
+    if (!isMorphed())
+        return;
+    // static weights don't need blending again
+    if (morphedPositions && morphedWeights.size() == weightCount &&
+        std::equal(morphedWeights.begin(), morphedWeights.end(), targetWeights))
+        return;
+    morphedWeights.assign(targetWeights, targetWeights + weightCount);
 
-        ciShader->uniform("u_NormalScale", material->normalTextureScale);
-        ciShader->uniform("u_EmissiveFactor", material->emissiveFactor);
-        ciShader->uniform("u_OcclusionStrength", material->occlusionStrength);
+    if (!morphedPositions)
+    {
+        morphedPositions = WeakBuffer::createStorage(positions->getSize());
+        if (normals)
+            morphedNormals = WeakBuffer::createStorage(normals->getSize());
     }
+    morphTargets->apply(targetWeights, weightCount, (const glm::vec3*)positions->getData(),
+                        normals ? (const glm::vec3*)normals->getData() : nullptr,
+                        (glm::vec3*)morphedPositions->getData(),
+                        morphedNormals ? (glm::vec3*)morphedNormals->getData() : nullptr);
 
+#ifndef CINDER_LESS
+    // skin() uploads skinned primitives
+    if (!isSkinned())
+        uploadDynamicStreams(*this, morphedPositions, morphedNormals);
 #endif
-    return ref;
 }
 
-void PrimitiveGLTF::update() {}
+void PrimitiveGLTF::skin(const SkinningPalette& palette, SkinningMethod method, JobSystem* jobs)
+{
+    if (!isSkinned() || jointLimit > palette.matrices.size())
+        return;
+
+    if (!skinnedPositions)
+    {
+        skinnedPositions = WeakBuffer::createStorage(positions->getSize());
+        if (normals)
+            skinnedNormals = WeakBuffer::createStorage(normals->getSize());
+    }
+
+    // the morphed streams if morph() ran
+    const auto& sourcePositions = morphedPositions ? morphedPositions : positions;
+    const auto& sourceNormals = morphedNormals ? morphedNormals : normals;
+    SkinningInput input;
+    input.positions = (const glm::vec3*)sourcePositions->getData();
+    input.normals = sourceNormals ? (const glm::vec3*)sourceNormals->getData() : nullptr;
+    input.joints = (const glm::uvec4*)joints->getData();
+    input.weights = (const glm::vec4*)weights->getData();
+    input.vertexCount = vertexCount;
+    skinVertices(input, palette, method, (glm::vec3*)skinnedPositions->getData(),
+                 skinnedNormals ? (glm::vec3*)skinnedNormals->getData() : nullptr, jobs);
+
+#ifndef CINDER_LESS
+    uploadDynamicStreams(*this, skinnedPositions, skinnedNormals);
+#endif
+}
 
 TextureGLTF::Ref TextureGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Texture& property)
 {
     TextureGLTF::Ref ref = make_shared<TextureGLTF>();
-    ref->property = property;
+    ref->property = &property;
     ref->imageSource = modelGLTF->images[property.source];
 #ifndef CINDER_LESS
     if (ref->imageSource->surface)
@@ -1202,18 +2345,27 @@ TextureGLTF::Ref TextureGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Tex
         auto texFormat =
             gl::Texture2d::Format().mipmap().minFilter(GL_LINEAR_MIPMAP_LINEAR).wrap(GL_REPEAT);
     #if 0
-        ref->ciTexture = am::texture2d((modelGLTF->meshPath.parent_path() / ref->imageSource->property.uri).string(), texFormat, true);
+        ref->ciTexture = am::texture2d((modelGLTF->meshPath.parent_path() / ref->imageSource->property->uri).string(), texFormat, true);
     #else
         ref->ciTexture = gl::Texture2d::create(*ref->imageSource->surface, texFormat);
     #endif
         if (!ref->ciTexture) return ref;
+
+        // a warm cache load comes with the mip chain, it replaces the generated levels
+        const auto& cached = ref->imageSource->cachedImage;
+        for (size_t level = 1; level < cached.levels.size(); level++)
+        {
+            auto width = cached.getLevelWidth(level);
+            ref->ciTexture->update(Surface8u((uint8_t*)cached.levels[level], width, cached.getLevelHeight(level),
+                width * cached.components, ref->imageSource->surface->getChannelOrder()), (int)level);
+        }
     }
     else if (ref->imageSource->compressedSurface)
     {
     #if 1
         ref->ciTexture = gl::Texture2d::createFromDds(ref->imageSource->compressedSurface);
     #else
-        ref->ciTexture = am::texture2d((modelGLTF->meshPath.parent_path() / ref->imageSource->property.uri).string());
+        ref->ciTexture = am::texture2d((modelGLTF->meshPath.parent_path() / ref->imageSource->property->uri).string());
     #endif
         if (!ref->ciTexture) return ref;
     }
@@ -1222,7 +2374,7 @@ TextureGLTF::Ref TextureGLTF::create(ModelGLTFRef modelGLTF, const tinygltf::Tex
         return ref;
     }
 
-    ref->ciTexture->setLabel(ref->imageSource->property.uri);
+    ref->ciTexture->setLabel(ref->imageSource->property->uri);
 
     if (property.sampler != -1)
     {
@@ -1275,7 +2427,7 @@ BufferViewGLTF::Ref BufferViewGLTF::create(ModelGLTFRef modelGLTF,
     // CI_ASSERT_MSG(property.byteStride == 0, "TODO: non zero byteStride");
 
     BufferViewGLTF::Ref ref = make_shared<BufferViewGLTF>();
-    ref->property = property;
+    ref->property = &property;
     ref->target = (GltfTarget)property.target;
 
     auto buffer = modelGLTF->buffers[property.buffer];
@@ -1297,3 +2449,444 @@ BufferViewGLTF::Ref BufferViewGLTF::create(ModelGLTFRef modelGLTF,
 #endif
     return ref;
 }
+
+StringTable::StringTable()
+{
+    mChars.push_back('\0');
+    mOffsets.push_back(0);
+    mSlots.resize(16);
+}
+
+static uint32_t hashString(const char* str, size_t length)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t StringTable::find(const std::string& str) const
+{
+    if (str.empty())
+        return 0;
+    size_t mask = mSlots.size() - 1;
+    for (size_t slot = hashString(str.data(), str.size()) & mask;; slot = (slot + 1) & mask)
+    {
+        uint32_t id = mSlots[slot];
+        if (id == 0)
+            return 0;
+        if (strcmp(get(id), str.c_str()) == 0)
+            return id;
+    }
+}
+
+uint32_t StringTable::intern(const std::string& str)
+{
+    if (str.empty())
+        return 0;
+    uint32_t id = find(str);
+    if (id != 0)
+        return id;
+
+    id = (uint32_t)mOffsets.size();
+    mOffsets.push_back((uint32_t)mChars.size());
+    mChars.insert(mChars.end(), str.c_str(), str.c_str() + str.size() + 1);
+
+    // keep the load factor under 1/2
+    if (mOffsets.size() * 2 > mSlots.size())
+        rehash(mSlots.size() * 2);
+    else
+    {
+        size_t mask = mSlots.size() - 1;
+        size_t slot = hashString(str.data(), str.size()) & mask;
+        while (mSlots[slot] != 0)
+            slot = (slot + 1) & mask;
+        mSlots[slot] = id;
+    }
+    return id;
+}
+
+void StringTable::rehash(size_t slotCount)
+{
+    mSlots.assign(slotCount, 0);
+    size_t mask = slotCount - 1;
+    for (uint32_t id = 1; id < mOffsets.size(); id++)
+    {
+        const char* str = get(id);
+        size_t slot = hashString(str, strlen(str)) & mask;
+        while (mSlots[slot] != 0)
+            slot = (slot + 1) & mask;
+        mSlots[slot] = id;
+    }
+}
+
+void StringTable::assign(const char* chars, size_t size)
+{
+    *this = StringTable();
+    if (size == 0 || chars[0] != '\0' || chars[size - 1] != '\0')
+        return;
+    mChars.assign(chars, chars + size);
+    for (size_t i = 1; i < size; i++)
+    {
+        if (chars[i - 1] == '\0')
+            mOffsets.push_back((uint32_t)i);
+    }
+    size_t slotCount = mSlots.size();
+    while (mOffsets.size() * 2 > slotCount)
+        slotCount *= 2;
+    rehash(slotCount);
+}
+
+size_t StringTable::getMemorySize() const
+{
+    return mChars.capacity() + (mOffsets.capacity() + mSlots.capacity()) * sizeof(uint32_t);
+}
+
+template <typename T>
+static size_t getCapacityBytes(const std::vector<T>& records)
+{
+    return records.capacity() * sizeof(T);
+}
+
+size_t CompactGLTF::getMemorySize() const
+{
+    return sizeof(CompactGLTF) + strings.getMemorySize() + getCapacityBytes(buffers) +
+           getCapacityBytes(bufferViews) + getCapacityBytes(accessors) + getCapacityBytes(images) +
+           getCapacityBytes(samplers) + getCapacityBytes(textures) + getCapacityBytes(materials) +
+           getCapacityBytes(primitives) + getCapacityBytes(meshes) + getCapacityBytes(skins) +
+           getCapacityBytes(skinJoints) + getCapacityBytes(cameras) + getCapacityBytes(nodes) +
+           getCapacityBytes(nodeMatrices) + getCapacityBytes(scenes) + getCapacityBytes(sceneNodes) +
+           getCapacityBytes(animations) + getCapacityBytes(animationChannels) +
+           getCapacityBytes(animationSamplers);
+}
+
+// the same order for CompactGLTF::writeCache() and the reading create()
+template <typename Compact, typename Func>
+static void forEachCompactArray(Compact& compact, Func func)
+{
+    func(compact.buffers);
+    func(compact.bufferViews);
+    func(compact.accessors);
+    func(compact.images);
+    func(compact.samplers);
+    func(compact.textures);
+    func(compact.materials);
+    func(compact.primitives);
+    func(compact.meshes);
+    func(compact.skins);
+    func(compact.skinJoints);
+    func(compact.cameras);
+    func(compact.nodes);
+    func(compact.nodeMatrices);
+    func(compact.scenes);
+    func(compact.sceneNodes);
+    func(compact.animations);
+    func(compact.animationChannels);
+    func(compact.animationSamplers);
+}
+
+void CompactGLTF::writeCache(SceneCacheWriter& writer) const
+{
+    const auto& chars = strings.getChars();
+    writer.addSectionRef(CACHE_STRINGS, 0, chars.data(), chars.size());
+    writer.addSectionRef(CACHE_DEFAULT_SCENE, 0, &defaultScene, sizeof(defaultScene));
+    uint32_t index = 0;
+    forEachCompactArray(*this, [&](const auto& records) {
+        writer.addSectionRef(CACHE_COMPACT, index++, records.data(), records.size() * sizeof(records[0]));
+    });
+}
+
+CompactGLTF::Ref CompactGLTF::create(const SceneCache& cache)
+{
+    Ref ref = make_shared<CompactGLTF>();
+    size_t size = 0, sceneSize = 0;
+    auto chars = (const char*)cache.getSection(CACHE_STRINGS, 0, &size);
+    auto defaultScene = cache.getSection(CACHE_DEFAULT_SCENE, 0, &sceneSize);
+    if (!chars || sceneSize != sizeof(ref->defaultScene))
+        return {};
+    ref->strings.assign(chars, size);
+    memcpy(&ref->defaultScene, defaultScene, sizeof(ref->defaultScene));
+
+    bool valid = true;
+    uint32_t index = 0;
+    forEachCompactArray(*ref, [&](auto& records) { valid &= cache.getArray(CACHE_COMPACT, index++, &records); });
+    if (!valid)
+        return {};
+    return ref;
+}
+
+static HandleGLTF toHandle(int index)
+{
+    return index < 0 ? INVALID_HANDLE : (HandleGLTF)index;
+}
+
+// unlike getAttribFromString() unknown attributes are skipped instead of asserted
+static AttribGLTF findAttrib(const string& str)
+{
+    static const pair<const char*, AttribGLTF> kAttribs[] = {
+        {"POSITION", POSITION}, {"COLOR_0", COLOR}, {"NORMAL", NORMAL}, {"TANGENT", TANGENT},
+        {"BITANGENT", BITANGENT}, {"JOINTS_0", BONE_INDEX}, {"WEIGHTS_0", BONE_WEIGHT},
+        {"TEXCOORD_0", TEX_COORD_0}, {"TEXCOORD_1", TEX_COORD_1}, {"TEXCOORD_2", TEX_COORD_2},
+        {"TEXCOORD_3", TEX_COORD_3},
+    };
+    for (auto& kv : kAttribs)
+    {
+        if (str == kv.first)
+            return kv.second;
+    }
+    return NUM_ATTRIBS;
+}
+
+CompactGLTF::Ref CompactGLTF::create(const tinygltf::Model& model, const std::vector<WeakBufferRef>& mappedBuffers)
+{
+    Ref ref = make_shared<CompactGLTF>();
+    auto& strings = ref->strings;
+
+    ref->buffers.reserve(model.buffers.size());
+    for (size_t i = 0; i < model.buffers.size(); i++)
+    {
+        // Option::mapBuffers leaves a one byte placeholder in data, the mapping has the real length
+        const auto& item = model.buffers[i];
+        size_t byteLength = item.data.size();
+        if (i < mappedBuffers.size() && mappedBuffers[i])
+            byteLength = mappedBuffers[i]->getSize();
+        ref->buffers.push_back({strings.intern(item.name), strings.intern(item.uri), (uint64_t)byteLength});
+    }
+
+    ref->bufferViews.reserve(model.bufferViews.size());
+    for (auto& item : model.bufferViews)
+    {
+        ref->bufferViews.push_back({strings.intern(item.name), toHandle(item.buffer), (uint64_t)item.byteOffset,
+                                    (uint64_t)item.byteLength, (uint32_t)item.byteStride, (uint32_t)item.target});
+    }
+
+    ref->accessors.reserve(model.accessors.size());
+    for (auto& item : model.accessors)
+    {
+        AccessorRecord record = {};
+        record.name = strings.intern(item.name);
+        record.bufferView = toHandle(item.bufferView);
+        record.byteOffset = item.byteOffset;
+        record.count = (uint32_t)item.count;
+        record.componentType = (uint16_t)item.componentType;
+        record.type = (uint8_t)item.type;
+        record.normalized = item.normalized;
+        record.sparseCount = item.sparse.isSparse ? (uint32_t)item.sparse.count : 0;
+        if (item.type == TINYGLTF_TYPE_VEC3 && item.minValues.size() == 3 && item.maxValues.size() == 3)
+        {
+            record.hasBounds = true;
+            record.boundsMin = {item.minValues[0], item.minValues[1], item.minValues[2]};
+            record.boundsMax = {item.maxValues[0], item.maxValues[1], item.maxValues[2]};
+            if (item.normalized)
+            {
+                // KHR_mesh_quantization, min / max hold the integer values
+                float scale = 1.0f;
+                if (item.componentType == COMPONENT_TYPE_BYTE)
+                    scale = 1.0f / 127.0f;
+                else if (item.componentType == COMPONENT_TYPE_UNSIGNED_BYTE)
+                    scale = 1.0f / 255.0f;
+                else if (item.componentType == COMPONENT_TYPE_SHORT)
+                    scale = 1.0f / 32767.0f;
+                else if (item.componentType == COMPONENT_TYPE_UNSIGNED_SHORT)
+                    scale = 1.0f / 65535.0f;
+                record.boundsMin = glm::max(record.boundsMin * scale, glm::vec3(-1.0f));
+                record.boundsMax = glm::max(record.boundsMax * scale, glm::vec3(-1.0f));
+            }
+        }
+        ref->accessors.push_back(record);
+    }
+
+    ref->images.reserve(model.images.size());
+    for (auto& item : model.images)
+    {
+        ref->images.push_back({strings.intern(item.name), strings.intern(item.uri), strings.intern(item.mimeType),
+                               toHandle(item.bufferView)});
+    }
+
+    ref->samplers.reserve(model.samplers.size());
+    for (auto& item : model.samplers)
+        ref->samplers.push_back({item.minFilter, item.magFilter, item.wrapS, item.wrapT});
+
+    ref->textures.reserve(model.textures.size());
+    for (auto& item : model.textures)
+        ref->textures.push_back({toHandle(item.source), toHandle(item.sampler)});
+
+    ref->materials.reserve(model.materials.size());
+    for (auto& item : model.materials)
+    {
+        MaterialRecord record = {};
+        record.name = strings.intern(item.name);
+        record.materialType = MATERIAL_PBR_METAL_ROUGHNESS;
+        if (item.extensions.count("KHR_materials_unlit"))
+            record.materialType = MATERIAL_UNLIT;
+        else if (item.extensions.count("KHR_materials_pbrSpecularGlossiness"))
+            record.materialType = MATERIAL_PBR_SPEC_GLOSSINESS;
+        record.alphaMode = MaterialGLTF::ALPHA_OPAQUE;
+        if (item.alphaMode == "BLEND")
+            record.alphaMode = MaterialGLTF::ALPHA_BLEND;
+        else if (item.alphaMode == "MASK")
+            record.alphaMode = MaterialGLTF::ALPHA_MASK;
+        record.alphaCutoff = (float)item.alphaCutoff;
+        record.doubleSided = item.doubleSided;
+
+        const auto& pbr = item.pbrMetallicRoughness;
+        record.baseColorFactor = {1, 1, 1, 1};
+        if (pbr.baseColorFactor.size() == 4)
+            record.baseColorFactor = glm::make_vec4(pbr.baseColorFactor.data());
+        if (item.emissiveFactor.size() == 3)
+            record.emissiveFactor = glm::make_vec3(item.emissiveFactor.data());
+        record.metallicFactor = (float)pbr.metallicFactor;
+        record.roughnessFactor = (float)pbr.roughnessFactor;
+        record.normalScale = (float)item.normalTexture.scale;
+        record.occlusionStrength = (float)item.occlusionTexture.strength;
+        record.baseColorTexture = toHandle(pbr.baseColorTexture.index);
+        record.metallicRoughnessTexture = toHandle(pbr.metallicRoughnessTexture.index);
+        record.normalTexture = toHandle(item.normalTexture.index);
+        record.occlusionTexture = toHandle(item.occlusionTexture.index);
+        record.emissiveTexture = toHandle(item.emissiveTexture.index);
+        ref->materials.push_back(record);
+    }
+
+    ref->meshes.reserve(model.meshes.size());
+    for (auto& item : model.meshes)
+    {
+        ref->meshes.push_back(
+            {strings.intern(item.name), (uint32_t)ref->primitives.size(), (uint32_t)item.primitives.size()});
+        for (auto& prim : item.primitives)
+        {
+            PrimitiveRecord record;
+            for (auto& handle : record.attributes)
+                handle = INVALID_HANDLE;
+            for (auto& kv : prim.attributes)
+            {
+                auto attrib = findAttrib(kv.first);
+                if (attrib != NUM_ATTRIBS)
+                    record.attributes[attrib] = toHandle(kv.second);
+            }
+            record.indices = toHandle(prim.indices);
+            record.material = toHandle(prim.material);
+            record.mode = prim.mode == -1 ? MODE_TRIANGLES : (uint32_t)prim.mode;
+            ref->primitives.push_back(record);
+        }
+    }
+
+    ref->skins.reserve(model.skins.size());
+    for (auto& item : model.skins)
+    {
+        ref->skins.push_back({strings.intern(item.name), toHandle(item.skeleton), toHandle(item.inverseBindMatrices),
+                              (uint32_t)ref->skinJoints.size(), (uint32_t)item.joints.size()});
+        for (auto joint : item.joints)
+            ref->skinJoints.push_back(toHandle(joint));
+    }
+
+    ref->cameras.reserve(model.cameras.size());
+    for (auto& item : model.cameras)
+    {
+        CameraRecord record = {};
+        record.name = strings.intern(item.name);
+        record.perspective = item.type == "perspective";
+        if (record.perspective)
+        {
+            record.yfovOrXmag = (float)item.perspective.yfov;
+            record.aspectOrYmag = (float)item.perspective.aspectRatio;
+            record.znear = (float)item.perspective.znear;
+            record.zfar = (float)item.perspective.zfar;
+        }
+        else
+        {
+            record.yfovOrXmag = (float)item.orthographic.xmag;
+            record.aspectOrYmag = (float)item.orthographic.ymag;
+            record.znear = (float)item.orthographic.znear;
+            record.zfar = (float)item.orthographic.zfar;
+        }
+        ref->cameras.push_back(record);
+    }
+
+    ref->nodes.resize(model.nodes.size());
+    for (size_t i = 0; i < model.nodes.size(); i++)
+    {
+        const auto& item = model.nodes[i];
+        auto& record = ref->nodes[i];
+        record.name = strings.intern(item.name);
+        record.mesh = toHandle(item.mesh);
+        record.skin = toHandle(item.skin);
+        record.camera = toHandle(item.camera);
+        record.matrix = INVALID_HANDLE;
+        if (item.matrix.size() == 16)
+        {
+            record.matrix = (HandleGLTF)ref->nodeMatrices.size();
+            ref->nodeMatrices.push_back(glm::make_mat4x4(item.matrix.data()));
+        }
+        record.translation = {0, 0, 0};
+        if (item.translation.size() == 3)
+            record.translation = glm::make_vec3(item.translation.data());
+        record.rotation = glm::quat(1, 0, 0, 0);
+        if (item.rotation.size() == 4)
+            record.rotation = glm::make_quat(item.rotation.data());
+        record.scale = {1, 1, 1};
+        if (item.scale.size() == 3)
+            record.scale = glm::make_vec3(item.scale.data());
+    }
+    for (auto& record : ref->nodes)
+    {
+        record.parent = INVALID_HANDLE;
+        record.firstChild = INVALID_HANDLE;
+        record.nextSibling = INVALID_HANDLE;
+    }
+    for (size_t i = 0; i < model.nodes.size(); i++)
+    {
+        // linked back to front so siblings keep the file order
+        const auto& children = model.nodes[i].children;
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+        {
+            auto& child = ref->nodes[*it];
+            child.parent = (HandleGLTF)i;
+            child.nextSibling = ref->nodes[i].firstChild;
+            ref->nodes[i].firstChild = (HandleGLTF)*it;
+        }
+    }
+
+    ref->scenes.reserve(model.scenes.size());
+    for (auto& item : model.scenes)
+    {
+        ref->scenes.push_back({strings.intern(item.name), (uint32_t)ref->sceneNodes.size(), (uint32_t)item.nodes.size()});
+        for (auto node : item.nodes)
+            ref->sceneNodes.push_back(toHandle(node));
+    }
+    ref->defaultScene = model.defaultScene == -1 ? 0 : (HandleGLTF)model.defaultScene;
+
+    ref->animations.reserve(model.animations.size());
+    for (auto& item : model.animations)
+    {
+        auto firstSampler = (uint32_t)ref->animationSamplers.size();
+        ref->animations.push_back({strings.intern(item.name), (uint32_t)ref->animationChannels.size(),
+                                   (uint32_t)item.channels.size(), firstSampler, (uint32_t)item.samplers.size()});
+        for (auto& samp : item.samplers)
+        {
+            AnimationSamplerRecord record = {toHandle(samp.input), toHandle(samp.output), AnimationSampler::LINEAR};
+            if (samp.interpolation == "STEP")
+                record.interpolation = AnimationSampler::STEP;
+            else if (samp.interpolation == "CUBICSPLINE")
+                record.interpolation = AnimationSampler::CUBICSPLINE;
+            ref->animationSamplers.push_back(record);
+        }
+        for (auto& channel : item.channels)
+        {
+            ChannelRecord record = {firstSampler + channel.sampler, toHandle(channel.target_node),
+                                    AnimationChannel::TRANSLATION};
+            if (channel.target_path == "rotation")
+                record.path = AnimationChannel::ROTATION;
+            else if (channel.target_path == "scale")
+                record.path = AnimationChannel::SCALE;
+            else if (channel.target_path == "weights")
+                record.path = WEIGHTS_PATH;
+            ref->animationChannels.push_back(record);
+        }
+    }
+
+    return ref;
+}
@@ -1,4 +1,11 @@
 #include "../include/ciobj.h"
+#include "../include/RenderQueue.h"
+#include "../include/JobSystem.h"
+#include "../include/MeshGeometry.h"
+#include "../include/ObjMesh.h"
+#include "../include/ObjParser.h"
+#include "../include/ProgramCache.h"
+#include "../include/VertexCache.h"
 #include "AssetManager.h"
 #include "MiniConfig.h"
 #include "cinder/Log.h"
@@ -18,62 +25,37 @@ MeshObj::Ref MeshObj::create(ModelObjRef modelObj, const tinyobj::shape_t& prope
 
     CI_ASSERT_MSG(property.lines.indices.empty(), "TODO: support line");
     CI_ASSERT_MSG(property.points.indices.empty(), "TODO: support points");
-    const auto& indices = property.mesh.indices;
     CI_ASSERT_MSG(property.mesh.num_face_vertices.size() == property.mesh.material_ids.size(), "indices.size() is not equal to material_ids.size()");
     CI_ASSERT(!attrib.vertices.empty());
 
-    int i = 0;
-    int prevMtrl = -1;
-    SubMesh* pSubMesh = nullptr;
-    for (const auto& index : indices)
+    // corners sharing vertex, normal and texcoord indices share a vertex
+    for (auto& source : buildObjSubmeshes(attrib, property))
     {
-        int mtrl = property.mesh.material_ids[i/3];
-        if (mtrl == -1) mtrl = 0;
-        if (mtrl != prevMtrl)
-        {
-            prevMtrl = mtrl;
-            if (ref->submeshes.find(mtrl) == ref->submeshes.end())
-            {
-                ref->submeshes[mtrl] = {};
-                ref->submeshes[mtrl].material = modelObj->materials[mtrl];
-            }
-            pSubMesh = &ref->submeshes[mtrl];
-        }
-
-        pSubMesh->indexArray.push_back(pSubMesh->positions.size());
-
-        if (!attrib.vertices.empty())
-        {
-            pSubMesh->positions.push_back({ attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            });
-        }
-        if (index.normal_index >= 0 && !attrib.normals.empty())
-        {
-            pSubMesh->normals.push_back({ attrib.normals[3 * index.normal_index + 0],
-                attrib.normals[3 * index.normal_index + 1],
-                attrib.normals[3 * index.normal_index + 2]
-            });
-        }
-        if (index.texcoord_index >=0 && !attrib.texcoords.empty())
-        {
-            pSubMesh->texcoords.push_back({ attrib.texcoords[2 * index.texcoord_index + 0],
-                attrib.texcoords[2 * index.texcoord_index + 1]
-            });
-        }
-        if (!attrib.colors.empty())
-        {
-            pSubMesh->colors.push_back({ attrib.colors[3 * index.vertex_index + 0],
-                attrib.colors[3 * index.vertex_index + 1],
-                attrib.colors[3 * index.vertex_index + 2]
-            });
-        }
-        i++;
+        auto& submesh = ref->submeshes[source.material];
+        submesh.material = modelObj->materials[source.material];
+        submesh.positions = std::move(source.positions);
+        submesh.normals = std::move(source.normals);
+        submesh.texcoords = std::move(source.texcoords);
+        submesh.colors.assign((const Color*)source.colors.data(), (const Color*)source.colors.data() + source.colors.size());
+        submesh.indexArray = std::move(source.indices);
     }
 
+    // the cpu work of every submesh in parallel, the vbos stay on this thread
+    auto jobs = JobSystem::getDefault();
+    vector<JobRef> geometryJobs;
+    bool flipV = modelObj->flipV;
+    for (auto& kv : ref->submeshes)
+    {
+        auto submesh = &kv.second;
+        geometryJobs.push_back(jobs->add([submesh, flipV] {
+            submesh->optimize();
+            submesh->computeGeometry(flipV);
+        }));
+    }
+    jobs->wait(geometryJobs);
+
     ref->mBoundBoxMin = { +FLT_MAX, +FLT_MAX, +FLT_MAX };
-    ref->mBoundBoxMax = { -FLT_MIN, -FLT_MIN, -FLT_MIN };
+    ref->mBoundBoxMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
     for (auto& kv : ref->submeshes)
     {
         auto& submesh = kv.second;
@@ -85,38 +67,52 @@ MeshObj::Ref MeshObj::create(ModelObjRef modelObj, const tinyobj::shape_t& prope
     return ref;
 }
 
-void MeshObj::SubMesh::setup()
+void MeshObj::SubMesh::optimize()
 {
-    TriMesh::Format fmt;
-    fmt.positions();
-    fmt.normals();
-    if (!texcoords.empty()) fmt.texCoords();
-    if (!colors.empty()) fmt.colors();
-    TriMesh triMesh(fmt);
-
-    triMesh.appendPositions(positions.data(), positions.size());
-    if (!normals.empty())
-        triMesh.appendNormals(normals.data(), normals.size());
-    if (!texcoords.empty())
-        triMesh.appendTexCoords0(texcoords.data(), texcoords.size());
-    if (!colors.empty())
-        triMesh.appendColors(colors.data(), colors.size());
-    triMesh.appendIndices(indexArray.data(), indexArray.size());
-    if (normals.empty())
-    {
-        triMesh.recalculateNormals();
-    }
-    triMesh.recalculateTangents();
-    boundBoxMin = triMesh.calcBoundingBox().getMin();
-    boundBoxMax = triMesh.calcBoundingBox().getMax();
+    optimizeTriangleOrder(indexArray.data(), indexArray.size(), positions.data(), positions.size());
+
+    vector<uint32_t> remap(positions.size());
+    size_t vertexCount = optimizeVertexFetchRemap(remap.data(), indexArray.data(), indexArray.size(), remap.size());
+    remapIndices(indexArray.data(), indexArray.data(), indexArray.size(), remap.data());
+    remapVertices(&positions, remap.data(), remap.size(), vertexCount);
+    remapVertices(&normals, remap.data(), remap.size(), vertexCount);
+    remapVertices(&texcoords, remap.data(), remap.size(), vertexCount);
+    remapVertices(&colors, remap.data(), remap.size(), vertexCount);
+}
 
-    positions.clear();
-    texcoords.clear();
-    colors.clear();
-    normals.clear();
-    indexArray.clear();
+void MeshObj::SubMesh::computeGeometry(bool flipV)
+{
+    computeMeshGeometry(positions.data(), positions.size(), indexArray.data(), indexArray.size(),
+        texcoords.empty() ? nullptr : texcoords.data(), &normals, &tangents, &boundBoxMin, &boundBoxMax, flipV);
+}
 
-    vboMesh = gl::VboMesh::create(triMesh);
+void MeshObj::SubMesh::setup()
+{
+    // one vbo per stream, straight from the scratch arrays
+    vector<pair<geom::BufferLayout, gl::VboRef>> vboLayouts;
+    auto addStream = [&](geom::Attrib attrib, uint8_t dims, const void* data, size_t size)
+    {
+        if (size == 0)
+            return;
+        geom::BufferLayout layout;
+        layout.append(attrib, dims, 0, 0);
+        vboLayouts.emplace_back(layout, gl::Vbo::create(GL_ARRAY_BUFFER, size, data));
+    };
+    addStream(geom::POSITION, 3, positions.data(), positions.size() * sizeof(glm::vec3));
+    addStream(geom::NORMAL, 3, normals.data(), normals.size() * sizeof(glm::vec3));
+    addStream(geom::TANGENT, 4, tangents.data(), tangents.size() * sizeof(glm::vec4));
+    addStream(geom::TEX_COORD_0, 2, texcoords.data(), texcoords.size() * sizeof(glm::vec2));
+    addStream(geom::COLOR, 3, colors.data(), colors.size() * sizeof(Color));
+    auto indexVbo = gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, indexArray.size() * sizeof(uint32_t), indexArray.data());
+    vboMesh = gl::VboMesh::create((uint32_t)positions.size(), GL_TRIANGLES, vboLayouts,
+        (uint32_t)indexArray.size(), GL_UNSIGNED_INT, indexVbo);
+
+    positions = {};
+    normals = {};
+    tangents = {};
+    texcoords = {};
+    colors = {};
+    indexArray = {};
 }
 
 void MeshObj::SubMesh::draw()
@@ -158,12 +154,37 @@ void MeshObj::draw(DrawOrder order)
     }
 }
 
+void MeshObj::submitDraws(RenderQueue& queue)
+{
+    for (auto& kv : submeshes)
+    {
+        const auto& material = kv.second.material;
+        queue.add(*this, mDrawOrder, material ? material->ciShader.get() : nullptr, material.get(),
+                  kv.second.vboMesh.get(), (uint32_t)kv.first);
+    }
+}
+
+void MeshObj::drawPacket(DrawOrder order, uint32_t item)
+{
+    auto it = submeshes.find((int)item);
+    if (it == submeshes.end())
+        return;
+    predraw(order);
+    it->second.draw();
+    postdraw(order);
+}
+
 void MaterialObj::predraw()
 {
     ciShader->bind();
     if (diffuseTexture)
         diffuseTexture->bind(0);
 
+    // the program may be shared with other materials of the same variant
+    ciShader->uniform("u_DiffuseFactor", diffuseFactor);
+    ciShader->uniform("u_SpecularGlossinessValues", vec4(specularFactor, glossinessFactor));
+    ciShader->uniform("u_EmissiveFactor", emissiveFactor);
+
     ciShader->uniform("u_flipV", modelObj->flipV);
     ciShader->uniform("u_Camera", modelObj->cameraPosition);
     ciShader->uniform("u_LightDirection", modelObj->lightDirection);
@@ -237,7 +258,7 @@ void MaterialObj::recreate(const tinyobj::material_t& property)
 
     // use stock shader for the moment
 #if 1
-    ciShader = gl::GlslProg::create(fmt);
+    ciShader = melo::ProgramCache::getDefault()->get(fmt);
 #else
     ciShader = am::glslProg("lambert texture");
 #endif
@@ -273,10 +294,6 @@ void MaterialObj::recreate(const tinyobj::material_t& property)
         ciShader->uniform("u_brdfLUT", 7);
     }
 
-    ciShader->uniform("u_DiffuseFactor", diffuseFactor);
-    ciShader->uniform("u_SpecularGlossinessValues", vec4(specularFactor, glossinessFactor));
-    ciShader->uniform("u_EmissiveFactor", emissiveFactor);
-
     ciShader->uniform("u_LightDirection", vec3(1.0f, 1.0f, 1.0f));
     ciShader->uniform("u_LightColor", vec3(1.0f, 1.0f, 1.0f));
     ciShader->uniform("u_Camera", vec3(1.0f, 1.0f, 1.0f));
@@ -321,8 +338,9 @@ ModelObjRef ModelObj::create(const fs::path& meshPath, std::string* loadingError
 
     std::string warn;
     std::string err;
-    bool ret = tinyobj::LoadObj(&ref->attrib, &shapes, &materials, &warn, &err,
-        meshPath.string().c_str(), ref->baseDir.string().c_str());
+    // tinyobj's layout, parsed on every worker
+    bool ret = melo::loadObj(&ref->attrib, &shapes, &materials, &warn, &err,
+        meshPath.string(), ref->baseDir.string());
     if (!warn.empty())
     {
         CI_LOG_W(warn);
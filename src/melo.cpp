@@ -132,6 +132,15 @@ namespace melo
         return hit;
     }
 
+    PickResult pick(const PickingScene& picking, const ci::CameraPersp& camera, const glm::ivec2& screenPos, uint32_t rayMask)
+    {
+        float u = screenPos.x / (float)getWindowWidth();
+        float v = screenPos.y / (float)getWindowHeight();
+        Ray ray = camera.generateRay(u, 1.0f - v, camera.getAspectRatio());
+
+        return picking.pick(ray.getOrigin(), ray.getDirection(), rayMask);
+    }
+
     NodeRef pick(NodeRef parentNode, const ci::Ray& ray, uint32_t rayMask)
     {
         AxisAlignedBox localBounds = { parentNode->mBoundBoxMin, parentNode->mBoundBoxMax };